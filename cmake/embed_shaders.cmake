@@ -0,0 +1,20 @@
+# Writes a translation unit defining findEmbeddedShader over the shader sources,
+# each as a raw string literal, so the renderer starts without reading them.
+#     cmake -DSHADER_DIR=<dir> -DSHADERS=<names> -DOUTPUT=<file> -P embed_shaders.cmake
+
+set(CONTENT "// generated by cmake/embed_shaders.cmake from the shaders directory, do not edit\n")
+string(APPEND CONTENT "#include \"embedded_shaders.h\"\n\nnamespace {\n\n\tconstexpr EmbeddedShader SHADERS[] = {\n")
+foreach(SHADER ${SHADERS})
+    file(READ ${SHADER_DIR}/${SHADER} TEXT)
+    string(FIND "${TEXT}" ")glsl\"" END)
+    if (NOT END EQUAL -1)
+        message(FATAL_ERROR "${SHADER} contains )glsl\" which would end the raw string it is embedded in")
+    endif()
+    string(APPEND CONTENT "\t\t{\"${SHADER}\", R\"glsl(${TEXT})glsl\"},\n")
+endforeach()
+string(APPEND CONTENT "\t};\n\n}\n\n")
+string(APPEND CONTENT "const EmbeddedShader *findEmbeddedShader(std::string_view name) {\n")
+string(APPEND CONTENT "\tfor (const EmbeddedShader &shader : SHADERS) {\n\t\tif (shader.name == name) {\n\t\t\treturn &shader;\n\t\t}\n\t}\n")
+string(APPEND CONTENT "\treturn nullptr;\n}\n")
+
+file(WRITE ${OUTPUT} "${CONTENT}")
@@ -0,0 +1,26 @@
+// for fragment shaders after surface.vs. reads the map with ALBEDO_MAP, which the includer declares
+
+// where the albedo is in albedoMap, see TextureSlot
+flat in vec4 fragAlbedoRect;
+flat in int fragAlbedoLayer;
+
+uniform sampler2DArray albedoMap;
+
+// albedo map, repeating once per world unit and projected along the face's major axis.
+// an image packed into an atlas repeats within its part of the layer, kept half a texel
+// inside it, with gradients from before the wrap so the seam picks the same mip
+vec3 sampleAlbedo(vec3 position, vec3 normal)
+{
+#ifdef ALBEDO_MAP
+    vec3 weights = abs(normal);
+    vec2 uv = weights.x > weights.y && weights.x > weights.z ? position.zy : weights.y > weights.z ? position.xz : position.xy;
+    if (fragAlbedoRect.z >= 1.0f && fragAlbedoRect.w >= 1.0f) {
+        return texture(albedoMap, vec3(uv, float(fragAlbedoLayer))).rgb;
+    }
+    vec2 inset = 0.5f / (fragAlbedoRect.zw * vec2(textureSize(albedoMap, 0).xy));
+    vec2 tile = fragAlbedoRect.xy + clamp(fract(uv), inset, 1.0f - inset) * fragAlbedoRect.zw;
+    return textureGrad(albedoMap, vec3(tile, float(fragAlbedoLayer)), dFdx(uv) * fragAlbedoRect.zw, dFdy(uv) * fragAlbedoRect.zw).rgb;
+#else
+    return vec3(1.0f);
+#endif
+}
@@ -1,7 +1,8 @@
 #version 330 core
+in vec4 color;
 out vec4 FragColor;
 
 void main()
 {
-    FragColor = vec4(1.0f);
-} 
+    FragColor = color;
+}
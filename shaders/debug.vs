@@ -0,0 +1,13 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aColor;
+
+#include "frame.glsl"
+
+out vec4 color;
+
+void main()
+{
+    color = aColor;
+    gl_Position = viewProjection * vec4(aPos, 1.0f);
+}
@@ -0,0 +1,40 @@
+#version 330 core
+// the sun's cascade shadows
+#pragma keyword SHADOWS
+in vec2 texCoord;
+out vec4 FragColor;
+
+#include "frame.glsl"
+#include "octahedral.glsl"
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+uniform float ambient;
+
+#ifdef SHADOWS
+#include "shadows.glsl"
+#endif
+
+void main()
+{
+    // nothing was drawn here, keep the clear color
+    float depth = texture(gDepth, texCoord).r;
+    if (depth == 1.0f) {
+        discard;
+    }
+    vec4 surface = texture(gAlbedo, texCoord);
+    if (surface.a > 0.5f) {
+        FragColor = vec4(surface.rgb, 1.0f);
+        return;
+    }
+
+    vec3 light = vec3(ambient);
+#ifdef SHADOWS
+    vec4 world = inverseViewProjection * vec4(vec3(texCoord, depth) * 2.0f - 1.0f, 1.0f);
+    vec3 position = world.xyz / world.w;
+    vec3 normal = decodeOctahedral(texture(gNormal, texCoord).rg);
+    light += sunColor.rgb * (max(dot(normal, -sunDirection.xyz), 0.0f) * cascadeShadow(position, normal));
+#endif
+    FragColor = vec4(surface.rgb * light, 1.0f);
+}
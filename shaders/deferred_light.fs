@@ -0,0 +1,42 @@
+#version 330 core
+// the lamp's cube shadow
+#pragma keyword SHADOWS
+flat in vec4 lightPositionRadius;
+flat in vec3 lightColor;
+flat in int lightIndex;
+out vec4 FragColor;
+
+#include "frame.glsl"
+#include "octahedral.glsl"
+#include "point_light.glsl"
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+
+#ifdef SHADOWS
+#include "shadows.glsl"
+#endif
+
+void main()
+{
+    vec2 uv = gl_FragCoord.xy * viewport.zw;
+    float depth = texture(gDepth, uv).r;
+    vec4 surface = texture(gAlbedo, uv);
+    if (depth == 1.0f || surface.a > 0.5f) {
+        discard;
+    }
+
+    // world position from depth instead of a position target
+    vec4 world = inverseViewProjection * vec4(vec3(uv, depth) * 2.0f - 1.0f, 1.0f);
+    vec3 position = world.xyz / world.w;
+    vec3 normal = decodeOctahedral(texture(gNormal, uv).rg);
+    vec3 light = shadePointLight(position, normal, lightPositionRadius, lightColor);
+#ifdef SHADOWS
+    // the lamp is the first light
+    if (lightIndex == 0) {
+        light *= pointShadow(position, normal);
+    }
+#endif
+    FragColor = vec4(surface.rgb * light, 0.0f);
+}
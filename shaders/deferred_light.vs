@@ -0,0 +1,25 @@
+#version 330 core
+// one instance per light
+layout (location = 0) in vec4 aLightPositionRadius;
+layout (location = 1) in vec4 aLightColor;
+
+#include "frame.glsl"
+
+flat out vec4 lightPositionRadius;
+flat out vec3 lightColor;
+flat out int lightIndex;
+
+// corners of a cube around the light, by bit: x 1, y 2, z 4. faces wind outwards
+const int CORNERS[36] = int[36](0, 6, 2, 0, 4, 6, 1, 3, 7, 1, 7, 5,
+                                0, 1, 5, 0, 5, 4, 2, 7, 3, 2, 6, 7,
+                                0, 3, 1, 0, 2, 3, 4, 5, 7, 4, 7, 6);
+
+void main()
+{
+    int corner = CORNERS[gl_VertexID];
+    vec3 offset = vec3((corner & 1) != 0 ? 1.0f : -1.0f, (corner & 2) != 0 ? 1.0f : -1.0f, (corner & 4) != 0 ? 1.0f : -1.0f);
+    lightPositionRadius = aLightPositionRadius;
+    lightColor = aLightColor.rgb;
+    lightIndex = gl_InstanceID;
+    gl_Position = viewProjection * vec4(aLightPositionRadius.xyz + offset * aLightPositionRadius.w, 1.0f);
+}
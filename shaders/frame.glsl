@@ -0,0 +1,10 @@
+// the camera, shared by every program
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    // for reconstructing positions from depth
+    mat4 inverseViewProjection;
+    // width, height and their reciprocals in pixels
+    vec4 viewport;
+};
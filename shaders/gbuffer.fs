@@ -0,0 +1,27 @@
+#version 330 core
+// albedo read from albedoMap, else white
+#pragma keyword ALBEDO_MAP
+// the albedo is written as light given off, left as it is by the lighting passes
+#pragma keyword EMISSIVE
+in vec3 fragPosition;
+// albedo, with alpha set where the surface emits its albedo unlit
+layout (location = 0) out vec4 gAlbedo;
+// octahedral normal, mapped to [0, 1]
+layout (location = 1) out vec2 gNormal;
+
+uniform vec3 albedo;
+
+#include "albedo.glsl"
+#include "octahedral.glsl"
+
+void main()
+{
+    // meshes carry no normals, so faces are shaded flat
+    vec3 normal = normalize(cross(dFdx(fragPosition), dFdy(fragPosition)));
+#ifdef EMISSIVE
+    gAlbedo = vec4(albedo, 1.0f);
+#else
+    gAlbedo = vec4(albedo * sampleAlbedo(fragPosition, normal), 0.0f);
+#endif
+    gNormal = encodeOctahedral(normal);
+}
@@ -0,0 +1,10 @@
+// diffuse light from a point light that fades to nothing at its radius
+vec3 shadePointLight(vec3 position, vec3 normal, vec4 positionRadius, vec3 color)
+{
+    vec3 toLight = positionRadius.xyz - position;
+    float distanceSquared = dot(toLight, toLight);
+    float ratio = distanceSquared / (positionRadius.w * positionRadius.w);
+    float window = clamp(1.0f - ratio * ratio, 0.0f, 1.0f);
+    float attenuation = window * window / (distanceSquared + 1.0f);
+    return color * (max(dot(normal, toLight * inversesqrt(distanceSquared)), 0.0f) * attenuation);
+}
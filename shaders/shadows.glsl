@@ -0,0 +1,48 @@
+// the sun's cascades and the lamp's cube shadow
+#include "frame.glsl"
+
+// read by lit programs when shadows are on
+layout (std140) uniform Shadow {
+    // world to shadow map clip space for each cascade, SHADOW_CASCADES of them
+    mat4 cascadeViewProjection[4];
+    // view depth each cascade reaches to
+    vec4 cascadeEnds;
+    // world size of a shadow map texel in each cascade, for offsetting lookups along the normal
+    vec4 cascadeTexelSizes;
+    // direction sunlight travels, and its color
+    vec4 sunDirection;
+    vec4 sunColor;
+    // the point light with a cube shadow, and the near and far planes in x
+    // and y that its shadow was drawn with
+    vec4 pointShadowPosition;
+    vec4 pointShadowPlanes;
+};
+
+uniform sampler2DArrayShadow cascadeShadowMap;
+uniform samplerCubeShadow pointShadowMap;
+
+// how much sunlight reaches a point, from the first cascade that covers it
+float cascadeShadow(vec3 position, vec3 normal)
+{
+    float depth = -(view * vec4(position, 1.0f)).z;
+    if (depth > cascadeEnds.w) {
+        return 1.0f;
+    }
+    int cascade = depth > cascadeEnds.x ? (depth > cascadeEnds.y ? (depth > cascadeEnds.z ? 3 : 2) : 1) : 0;
+    // pushed off the surface by a couple of texels against acne
+    vec4 shadowPosition = cascadeViewProjection[cascade] * vec4(position + normal * (cascadeTexelSizes[cascade] * 2.0f), 1.0f);
+    vec3 coord = shadowPosition.xyz * 0.5f + 0.5f;
+    return texture(cascadeShadowMap, vec4(coord.xy, float(cascade), coord.z));
+}
+
+// how much of the lamp's light reaches a point, from its cube shadow
+float pointShadow(vec3 position, vec3 normal)
+{
+    vec3 fromLight = position + normal * 0.02f - pointShadowPosition.xyz;
+    // depth the cube face's projection gives the distance along its axis
+    float major = max(abs(fromLight.x), max(abs(fromLight.y), abs(fromLight.z)));
+    float n = pointShadowPlanes.x;
+    float f = pointShadowPlanes.y;
+    float depth = (f + n) / (f - n) - 2.0f * f * n / ((f - n) * major);
+    return texture(pointShadowMap, vec4(fromLight, min(depth * 0.5f + 0.5f, 1.0f)));
+}
@@ -0,0 +1,74 @@
+#version 330 core
+// lit by the point lights, all of them or only the fragment's cluster's, else albedo as it is
+#pragma keyword LIT
+#pragma keyword CLUSTERED
+// the sun and the lamp's cube shadow
+#pragma keyword SHADOWS
+// albedo read from albedoMap, else white
+#pragma keyword ALBEDO_MAP
+in vec3 fragPosition;
+out vec4 FragColor;
+
+#include "frame.glsl"
+#include "albedo.glsl"
+
+#ifdef LIT
+uniform vec3 albedo;
+uniform float ambient;
+// from lightBase, two texels per light: position and radius, then color
+uniform samplerBuffer lights;
+uniform int lightBase;
+#ifdef CLUSTERED
+// from clusterBase, an offset and a light count per cluster, then the light indices
+uniform usamplerBuffer clusters;
+uniform int clusterBase;
+// tiles across, up and depth slices
+uniform ivec3 clusterGrid;
+// slice = log(view depth) * x + y
+uniform vec2 clusterDepth;
+#else
+uniform int lightCount;
+#endif
+
+#include "point_light.glsl"
+#endif
+
+#ifdef SHADOWS
+#include "shadows.glsl"
+#endif
+
+void main()
+{
+    // meshes carry no normals, so faces are shaded flat
+    vec3 normal = normalize(cross(dFdx(fragPosition), dFdy(fragPosition)));
+#ifdef LIT
+    vec3 light = vec3(ambient);
+#ifdef CLUSTERED
+    float depth = -(view * vec4(fragPosition, 1.0f)).z;
+    int slice = clamp(int(log(depth) * clusterDepth.x + clusterDepth.y), 0, clusterGrid.z - 1);
+    ivec2 tile = min(ivec2(gl_FragCoord.xy * viewport.zw * vec2(clusterGrid.xy)), clusterGrid.xy - 1);
+    int cluster = (slice * clusterGrid.y + tile.y) * clusterGrid.x + tile.x;
+    int offset = clusterBase + int(texelFetch(clusters, clusterBase + cluster * 2).r);
+    int count = int(texelFetch(clusters, clusterBase + cluster * 2 + 1).r);
+    for (int i = 0; i < count; ++i) {
+        int index = int(texelFetch(clusters, offset + i).r);
+#else
+    for (int index = 0; index < lightCount; ++index) {
+#endif
+        vec3 lit = shadePointLight(fragPosition, normal, texelFetch(lights, lightBase + index * 2), texelFetch(lights, lightBase + index * 2 + 1).rgb);
+#ifdef SHADOWS
+        // the lamp is the first light
+        if (index == 0) {
+            lit *= pointShadow(fragPosition, normal);
+        }
+#endif
+        light += lit;
+    }
+#ifdef SHADOWS
+    light += sunColor.rgb * (max(dot(normal, -sunDirection.xyz), 0.0f) * cascadeShadow(fragPosition, normal));
+#endif
+    FragColor = vec4(albedo * sampleAlbedo(fragPosition, normal) * light, 1.0f);
+#else
+    FragColor = vec4(sampleAlbedo(fragPosition, normal), 1.0f);
+#endif
+}
@@ -0,0 +1,46 @@
+#version 330 core
+// the model and albedo slot come from a buffer indexed per draw instead of uniforms
+#pragma keyword INDIRECT 430
+layout (location = 0) in vec3 aPos;
+
+#include "frame.glsl"
+
+#ifdef INDIRECT
+layout (location = 1) in uint aDrawId;
+
+struct DrawData {
+    mat4 model;
+    // where the albedo is in the bound array, see TextureSlot
+    vec4 albedoRect;
+    int albedoLayer;
+};
+
+layout (std430, binding = 0) readonly buffer DrawDataBuffer {
+    DrawData draws[];
+};
+#else
+uniform mat4 model;
+// where the albedo is in the bound array, see TextureSlot
+uniform vec4 albedoRect;
+uniform int albedoLayer;
+#endif
+
+// world space, for shading that needs the surface normal
+out vec3 fragPosition;
+flat out vec4 fragAlbedoRect;
+flat out int fragAlbedoLayer;
+
+void main()
+{
+#ifdef INDIRECT
+    fragAlbedoRect = draws[aDrawId].albedoRect;
+    fragAlbedoLayer = draws[aDrawId].albedoLayer;
+    vec4 position = draws[aDrawId].model * vec4(aPos, 1.0f);
+#else
+    fragAlbedoRect = albedoRect;
+    fragAlbedoLayer = albedoLayer;
+    vec4 position = model * vec4(aPos, 1.0f);
+#endif
+    fragPosition = position.xyz;
+    gl_Position = viewProjection * position;
+}
@@ -0,0 +1,903 @@
+#include "block_compression.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#include "float4.h"
+
+namespace {
+
+	constexpr uint32_t BLOCK_SIZE = 4;
+	constexpr uint32_t BLOCK_TEXELS = 16;
+
+	// how far along from the first endpoint to the second each index puts a texel
+	constexpr float BC1_WEIGHTS[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+	constexpr float BC4_WEIGHTS[8] = {0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f};
+	constexpr uint32_t BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+	constexpr uint32_t BC7_SPLIT_WEIGHTS[4] = {0, 21, 43, 64};
+	constexpr float BC7_SPLIT_FRACTIONS[4] = {0.0f, 21.0f / 64, 43.0f / 64, 1.0f};
+	constexpr float BC7_FRACTIONS[16] = {0.0f / 64, 4.0f / 64, 9.0f / 64, 13.0f / 64, 17.0f / 64, 21.0f / 64, 26.0f / 64, 30.0f / 64,
+	                                     34.0f / 64, 38.0f / 64, 43.0f / 64, 47.0f / 64, 51.0f / 64, 55.0f / 64, 60.0f / 64, 64.0f / 64};
+
+	// least squares passes over each block's endpoints, by quality
+	constexpr uint32_t REFINEMENTS[3] = {0, 1, 8};
+	// how far the high quality BC4 search moves each endpoint
+	constexpr int BC4_SEARCH_RADIUS = 2;
+
+	// the texels of a block, 0-255, a channel at a time so each row of 4 loads as a Float4
+	struct alignas(16) Block {
+		float values[4][BLOCK_TEXELS];
+	};
+
+	// the two ends of the line a block's colors are fitted to, 0-255
+	struct Endpoints {
+		float a[4] = {};
+		float b[4] = {};
+	};
+
+	// entries a block's indices pick from, 0-255
+	struct alignas(16) Palette {
+		float entries[16][4];
+	};
+
+	struct Bc1Tables {
+		// 565 endpoints whose first interpolated color comes closest to each 8-bit value, for blocks of one color
+		uint8_t match5[256][2];
+		uint8_t match6[256][2];
+
+		Bc1Tables() {
+			fill(match5, 31, 3);
+			fill(match6, 63, 2);
+		}
+
+		static uint32_t expand(uint32_t value, uint32_t shift) {
+			return (value << shift) | (value >> (8 - 2 * shift));
+		}
+
+		static void fill(uint8_t (*match)[2], uint32_t maximum, uint32_t shift) {
+			for (uint32_t value = 0; value < 256; ++value) {
+				uint32_t best = ~0u;
+				for (uint32_t first = 0; first <= maximum; ++first) {
+					for (uint32_t second = 0; second <= maximum; ++second) {
+						const uint32_t color = (2 * expand(first, shift) + expand(second, shift)) / 3;
+						const uint32_t error = color > value ? color - value : value - color;
+						if (error < best) {
+							best = error;
+							match[value][0] = static_cast<uint8_t>(first);
+							match[value][1] = static_cast<uint8_t>(second);
+						}
+					}
+				}
+			}
+		}
+	};
+
+	const Bc1Tables BC1;
+
+	// packs fields into a block from the least significant bit of its first byte up
+	class BitWriter {
+		uint8_t *m_out;
+		uint32_t m_bit = 0;
+
+	public:
+		BitWriter(uint8_t *out, uint32_t bytes)
+			: m_out{out} {
+			std::memset(out, 0, bytes);
+		}
+
+		void write(uint32_t value, uint32_t count) {
+			for (uint32_t i = 0; i < count; ++i, ++m_bit) {
+				if ((value >> i) & 1) {
+					m_out[m_bit >> 3] |= static_cast<uint8_t>(1 << (m_bit & 7));
+				}
+			}
+		}
+	};
+
+	class BitReader {
+		const uint8_t *m_in;
+		uint32_t m_bit = 0;
+
+	public:
+		explicit BitReader(const uint8_t *in)
+			: m_in{in} {}
+
+		uint32_t read(uint32_t count) {
+			uint32_t value = 0;
+			for (uint32_t i = 0; i < count; ++i, ++m_bit) {
+				value |= static_cast<uint32_t>((m_in[m_bit >> 3] >> (m_bit & 7)) & 1) << i;
+			}
+			return value;
+		}
+	};
+
+	void loadBlock(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, Block &block) {
+		for (uint32_t y = 0; y < BLOCK_SIZE; ++y) {
+			const size_t row = std::min(blockY * BLOCK_SIZE + y, height - 1);
+			for (uint32_t x = 0; x < BLOCK_SIZE; ++x) {
+				const uint8_t *texel = pixels + (row * width + std::min(blockX * BLOCK_SIZE + x, width - 1)) * 4;
+				for (uint32_t c = 0; c < 4; ++c) {
+					block.values[c][y * BLOCK_SIZE + x] = static_cast<float>(texel[c]);
+				}
+			}
+		}
+	}
+
+	bool isSolid(const Block &block, uint32_t first, uint32_t count) {
+		for (uint32_t c = first; c < first + count; ++c) {
+			for (uint32_t i = 1; i < BLOCK_TEXELS; ++i) {
+				if (block.values[c][i] != block.values[c][0]) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	// picks the palette entry nearest each texel over channels [first, first
+	// + count), four texels at a time, returning the summed squared error
+	float nearestIndices(const Block &block, uint32_t first, uint32_t count, const Palette &palette, uint32_t entries, uint8_t *indices) {
+		float error = 0.0f;
+		for (uint32_t row = 0; row < BLOCK_SIZE; ++row) {
+			Float4 texels[4];
+			for (uint32_t c = 0; c < count; ++c) {
+				texels[c] = Float4::load(block.values[first + c] + row * BLOCK_SIZE);
+			}
+			uint8_t *rowIndices = indices + row * BLOCK_SIZE;
+			std::fill(rowIndices, rowIndices + BLOCK_SIZE, 0);
+			Float4 best = Float4::splat(FLT_MAX);
+			for (uint32_t entry = 0; entry < entries; ++entry) {
+				Float4 distance = Float4::splat(0.0f);
+				for (uint32_t c = 0; c < count; ++c) {
+					const Float4 difference = texels[c] - Float4::splat(palette.entries[entry][first + c]);
+					distance = distance + difference * difference;
+				}
+				const uint32_t closer = bits(distance < best);
+				best = min(best, distance);
+				for (uint32_t lane = 0; lane < BLOCK_SIZE; ++lane) {
+					if ((closer >> lane) & 1) {
+						rowIndices[lane] = static_cast<uint8_t>(entry);
+					}
+				}
+			}
+			alignas(16) float distances[4];
+			best.store(distances);
+			error += distances[0] + distances[1] + distances[2] + distances[3];
+		}
+		return error;
+	}
+
+	// the corners of the texels' bounding box over channels [first, first +
+	// count), on the diagonal they lean along against the widest channel
+	Endpoints boxEndpoints(const Block &block, uint32_t first, uint32_t count) {
+		Endpoints endpoints;
+		float mean[4] = {};
+		uint32_t widest = first;
+		for (uint32_t c = first; c < first + count; ++c) {
+			endpoints.a[c] = *std::min_element(block.values[c], block.values[c] + BLOCK_TEXELS);
+			endpoints.b[c] = *std::max_element(block.values[c], block.values[c] + BLOCK_TEXELS);
+			for (uint32_t i = 0; i < BLOCK_TEXELS; ++i) {
+				mean[c] += block.values[c][i] / BLOCK_TEXELS;
+			}
+			if (endpoints.b[c] - endpoints.a[c] > endpoints.b[widest] - endpoints.a[widest]) {
+				widest = c;
+			}
+		}
+		for (uint32_t c = first; c < first + count; ++c) {
+			float covariance = 0.0f;
+			for (uint32_t i = 0; i < BLOCK_TEXELS; ++i) {
+				covariance += (block.values[c][i] - mean[c]) * (block.values[widest][i] - mean[widest]);
+			}
+			if (covariance < 0.0f) {
+				std::swap(endpoints.a[c], endpoints.b[c]);
+			}
+		}
+		return endpoints;
+	}
+
+	// the ends of the texels' principal axis over channels [first, first +
+	// count), found by power iteration on their covariance, as far along it
+	// as the texels reach
+	Endpoints principalEndpoints(const Block &block, uint32_t first, uint32_t count) {
+		float mean[4] = {};
+		for (uint32_t c = first; c < first + count; ++c) {
+			for (uint32_t i = 0; i < BLOCK_TEXELS; ++i) {
+				mean[c] += block.values[c][i] / BLOCK_TEXELS;
+			}
+		}
+		float covariance[4][4] = {};
+		for (uint32_t c = first; c < first + count; ++c) {
+			for (uint32_t d = c; d < first + count; ++d) {
+				for (uint32_t i = 0; i < BLOCK_TEXELS; ++i) {
+					covariance[c][d] += (block.values[c][i] - mean[c]) * (block.values[d][i] - mean[d]);
+				}
+				covariance[d][c] = covariance[c][d];
+			}
+		}
+
+		// starting from the bounding box diagonal converges in a few steps
+		const Endpoints box = boxEndpoints(block, first, count);
+		float axis[4] = {};
+		for (uint32_t c = first; c < first + count; ++c) {
+			axis[c] = box.b[c] - box.a[c];
+		}
+		for (uint32_t iteration = 0; iteration < 8; ++iteration) {
+			float next[4] = {};
+			float largest = 0.0f;
+			for (uint32_t c = first; c < first + count; ++c) {
+				for (uint32_t d = first; d < first + count; ++d) {
+					next[c] += covariance[c][d] * axis[d];
+				}
+				largest = std::max(largest, std::fabs(next[c]));
+			}
+			if (largest < 1e-6f) {
+				break;
+			}
+			for (uint32_t c = first; c < first + count; ++c) {
+				axis[c] = next[c] / largest;
+			}
+		}
+		float length = 0.0f;
+		for (uint32_t c = first; c < first + count; ++c) {
+			length += axis[c] * axis[c];
+		}
+		if (length < 1e-12f) {
+			return box;
+		}
+
+		float lowest = FLT_MAX;
+		float highest = -FLT_MAX;
+		for (uint32_t i = 0; i < BLOCK_TEXELS; ++i) {
+			float t = 0.0f;
+			for (uint32_t c = first; c < first + count; ++c) {
+				t += (block.values[c][i] - mean[c]) * axis[c];
+			}
+			lowest = std::min(lowest, t / length);
+			highest = std::max(highest, t / length);
+		}
+		Endpoints endpoints;
+		for (uint32_t c = first; c < first + count; ++c) {
+			endpoints.a[c] = std::clamp(mean[c] + axis[c] * lowest, 0.0f, 255.0f);
+			endpoints.b[c] = std::clamp(mean[c] + axis[c] * highest, 0.0f, 255.0f);
+		}
+		return endpoints;
+	}
+
+	// the endpoints that fit the texels best by least squares, with each
+	// texel weighted weights[index] of the way from a to b. false when the
+	// indices all put texels in one place, which fixes no line
+	bool fitEndpoints(const Block &block, uint32_t first, uint32_t count, const uint8_t *indices, const float *weights, Endpoints &endpoints) {
+		float aa = 0.0f;
+		float ab = 0.0f;
+		float bb = 0.0f;
+		float ax[4] = {};
+		float bx[4] = {};
+		for (uint32_t i = 0; i < BLOCK_TEXELS; ++i) {
+			const float w = weights[indices[i]];
+			aa += (1.0f - w) * (1.0f - w);
+			ab += (1.0f - w) * w;
+			bb += w * w;
+			for (uint32_t c = first; c < first + count; ++c) {
+				ax[c] += (1.0f - w) * block.values[c][i];
+				bx[c] += w * block.values[c][i];
+			}
+		}
+		const float determinant = aa * bb - ab * ab;
+		if (std::fabs(determinant) < 1e-6f) {
+			return false;
+		}
+		for (uint32_t c = first; c < first + count; ++c) {
+			endpoints.a[c] = std::clamp((bb * ax[c] - ab * bx[c]) / determinant, 0.0f, 255.0f);
+			endpoints.b[c] = std::clamp((aa * bx[c] - ab * ax[c]) / determinant, 0.0f, 255.0f);
+		}
+		return true;
+	}
+
+	inline uint32_t quantize(float value, uint32_t maximum) {
+		return static_cast<uint32_t>(std::clamp(value * static_cast<float>(maximum) / 255.0f + 0.5f, 0.0f, static_cast<float>(maximum)));
+	}
+
+	// BC1
+
+	uint16_t packColor(const float *color) {
+		return static_cast<uint16_t>((quantize(color[0], 31) << 11) | (quantize(color[1], 63) << 5) | quantize(color[2], 31));
+	}
+
+	void unpackColor(uint16_t color, uint32_t *rgb) {
+		rgb[0] = Bc1Tables::expand(color >> 11, 3);
+		rgb[1] = Bc1Tables::expand((color >> 5) & 63, 2);
+		rgb[2] = Bc1Tables::expand(color & 31, 3);
+	}
+
+	// the colors of a block in four color mode, as it decodes
+	void bc1Palette(uint16_t first, uint16_t second, Palette &palette) {
+		uint32_t a[3];
+		uint32_t b[3];
+		unpackColor(first, a);
+		unpackColor(second, b);
+		for (uint32_t c = 0; c < 3; ++c) {
+			palette.entries[0][c] = static_cast<float>(a[c]);
+			palette.entries[1][c] = static_cast<float>(b[c]);
+			palette.entries[2][c] = static_cast<float>((2 * a[c] + b[c]) / 3);
+			palette.entries[3][c] = static_cast<float>((a[c] + 2 * b[c]) / 3);
+		}
+	}
+
+	// four color mode needs the first color greater; equal colors can only
+	// mean three color mode, where every texel taking the first is still right
+	void writeBc1(uint16_t first, uint16_t second, uint8_t *indices, uint8_t *out) {
+		if (first < second) {
+			std::swap(first, second);
+			for (uint32_t i = 0; i < BLOCK_TEXELS; ++i) {
+				indices[i] ^= 1;
+			}
+		}
+		BitWriter writer{out, 8};
+		writer.write(first, 16);
+		writer.write(second, 16);
+		for (uint32_t i = 0; i < BLOCK_TEXELS; ++i) {
+			writer.write(first == second ? 0 : indices[i], 2);
+		}
+	}
+
+	// fits rgb from start, returning the error and leaving the colors and indices that gave it
+	float refineBc1(const Block &block, const Endpoints &start, uint32_t refinements, uint16_t *colors, uint8_t *indices) {
+		Palette palette;
+		colors[0] = packColor(start.a);
+		colors[1] = packColor(start.b);
+		bc1Palette(colors[0], colors[1], palette);
+		float error = nearestIndices(block, 0, 3, palette, 4, indices);
+		for (uint32_t i = 0; i < refinements && error > 0.0f; ++i) {
+			Endpoints fitted;
+			if (!fitEndpoints(block, 0, 3, indices, BC1_WEIGHTS, fitted)) {
+				break;
+			}
+			const uint16_t first = packColor(fitted.a);
+			const uint16_t second = packColor(fitted.b);
+			uint8_t fittedIndices[BLOCK_TEXELS];
+			bc1Palette(first, second, palette);
+			const float fittedError = nearestIndices(block, 0, 3, palette, 4, fittedIndices);
+			if (fittedError >= error) {
+				break;
+			}
+			error = fittedError;
+			colors[0] = first;
+			colors[1] = second;
+			std::copy(fittedIndices, fittedIndices + BLOCK_TEXELS, indices);
+		}
+		return error;
+	}
+
+	void encodeBc1(const Block &block, CompressionQuality quality, uint8_t *out) {
+		uint8_t indices[BLOCK_TEXELS];
+		if (isSolid(block, 0, 3)) {
+			// the first interpolated color gets nearer one color than either endpoint alone
+			const uint32_t r = static_cast<uint32_t>(block.values[0][0]);
+			const uint32_t g = static_cast<uint32_t>(block.values[1][0]);
+			const uint32_t b = static_cast<uint32_t>(block.values[2][0]);
+			std::fill(indices, indices + BLOCK_TEXELS, 2);
+			writeBc1(static_cast<uint16_t>((BC1.match5[r][0] << 11) | (BC1.match6[g][0] << 5) | BC1.match5[b][0]),
+			         static_cast<uint16_t>((BC1.match5[r][1] << 11) | (BC1.match6[g][1] << 5) | BC1.match5[b][1]), indices, out);
+			return;
+		}
+
+		const uint32_t refinements = REFINEMENTS[static_cast<uint32_t>(quality)];
+		uint16_t colors[2];
+		if (quality == CompressionQuality::Fast) {
+			refineBc1(block, boxEndpoints(block, 0, 3), refinements, colors, indices);
+		} else {
+			const float error = refineBc1(block, principalEndpoints(block, 0, 3), refinements, colors, indices);
+			if (quality == CompressionQuality::High && error > 0.0f) {
+				uint16_t boxColors[2];
+				uint8_t boxIndices[BLOCK_TEXELS];
+				if (refineBc1(block, boxEndpoints(block, 0, 3), refinements, boxColors, boxIndices) < error) {
+					std::copy(boxColors, boxColors + 2, colors);
+					std::copy(boxIndices, boxIndices + BLOCK_TEXELS, indices);
+				}
+			}
+		}
+		writeBc1(colors[0], colors[1], indices, out);
+	}
+
+	// BC4
+
+	// eight values when the first endpoint is greater, else six with 0 and 255
+	void bc4Palette(uint32_t first, uint32_t second, uint32_t channel, Palette &palette) {
+		palette.entries[0][channel] = static_cast<float>(first);
+		palette.entries[1][channel] = static_cast<float>(second);
+		if (first > second) {
+			for (uint32_t i = 2; i < 8; ++i) {
+				palette.entries[i][channel] = static_cast<float>(((8 - i) * first + (i - 1) * second + 3) / 7);
+			}
+		} else {
+			for (uint32_t i = 2; i < 6; ++i) {
+				palette.entries[i][channel] = static_cast<float>(((6 - i) * first + (i - 1) * second + 2) / 5);
+			}
+			palette.entries[6][channel] = 0.0f;
+			palette.entries[7][channel] = 255.0f;
+		}
+	}
+
+	struct Bc4Candidate {
+		uint32_t first = 0;
+		uint32_t second = 0;
+		float error = FLT_MAX;
+		uint8_t indices[BLOCK_TEXELS] = {};
+	};
+
+	// keeps the endpoints in best if they beat it
+	void tryBc4(const Block &block, uint32_t channel, uint32_t first, uint32_t second, Bc4Candidate &best) {
+		Palette palette;
+		bc4Palette(first, second, channel, palette);
+		uint8_t indices[BLOCK_TEXELS];
+		const float error = nearestIndices(block, channel, 1, palette, 8, indices);
+		if (error < best.error) {
+			best.first = first;
+			best.second = second;
+			best.error = error;
+			std::copy(indices, indices + BLOCK_TEXELS, best.indices);
+		}
+	}
+
+	void encodeBc4(const Block &block, uint32_t channel, CompressionQuality quality, uint8_t *out) {
+		const float *values = block.values[channel];
+		const uint32_t lowest = static_cast<uint32_t>(*std::min_element(values, values + BLOCK_TEXELS));
+		const uint32_t highest = static_cast<uint32_t>(*std::max_element(values, values + BLOCK_TEXELS));
+
+		Bc4Candidate best;
+		if (lowest == highest) {
+			best.first = best.second = lowest;
+		} else {
+			tryBc4(block, channel, highest, lowest, best);
+			if (quality != CompressionQuality::Fast) {
+				// six value mode spends its endpoints on the values between 0 and 255 when a block has those too
+				if (lowest == 0 || highest == 255) {
+					uint32_t innerLowest = 255;
+					uint32_t innerHighest = 0;
+					for (uint32_t i = 0; i < BLOCK_TEXELS; ++i) {
+						if (values[i] > 0.0f && values[i] < 255.0f) {
+							innerLowest = std::min(innerLowest, static_cast<uint32_t>(values[i]));
+							innerHighest = std::max(innerHighest, static_cast<uint32_t>(values[i]));
+						}
+					}
+					if (innerLowest <= innerHighest) {
+						tryBc4(block, channel, innerLowest, innerHighest, best);
+					}
+				}
+				Endpoints fitted;
+				if (best.first > best.second && fitEndpoints(block, channel, 1, best.indices, BC4_WEIGHTS, fitted)) {
+					const uint32_t first = quantize(fitted.a[channel], 255);
+					const uint32_t second = quantize(fitted.b[channel], 255);
+					if (first > second) {
+						tryBc4(block, channel, first, second, best);
+					}
+				}
+			}
+			if (quality == CompressionQuality::High) {
+				const Bc4Candidate start = best;
+				for (int firstStep = -BC4_SEARCH_RADIUS; firstStep <= BC4_SEARCH_RADIUS; ++firstStep) {
+					for (int secondStep = -BC4_SEARCH_RADIUS; secondStep <= BC4_SEARCH_RADIUS; ++secondStep) {
+						const int first = static_cast<int>(start.first) + firstStep;
+						const int second = static_cast<int>(start.second) + secondStep;
+						// stay in the mode the start is in
+						if (first >= 0 && first <= 255 && second >= 0 && second <= 255 && (first > second) == (start.first > start.second)) {
+							tryBc4(block, channel, static_cast<uint32_t>(first), static_cast<uint32_t>(second), best);
+						}
+					}
+				}
+			}
+		}
+
+		BitWriter writer{out, 8};
+		writer.write(best.first, 8);
+		writer.write(best.second, 8);
+		for (uint32_t i = 0; i < BLOCK_TEXELS; ++i) {
+			writer.write(best.indices[i], 3);
+		}
+	}
+
+	// BC7 mode 6: rgba endpoints of 7 bits a channel plus a low bit shared by
+	// the channels of each endpoint, and 4-bit indices
+
+	struct Bc7Endpoint {
+		uint32_t channels[4] = {};
+		uint32_t pBit = 0;
+
+		inline uint32_t value(uint32_t c) const {
+			return (channels[c] << 1) | pBit;
+		}
+	};
+
+	Bc7Endpoint quantizeBc7(const float *color, uint32_t pBit) {
+		Bc7Endpoint endpoint;
+		endpoint.pBit = pBit;
+		for (uint32_t c = 0; c < 4; ++c) {
+			endpoint.channels[c] = std::min(static_cast<uint32_t>(std::max((color[c] - static_cast<float>(pBit)) * 0.5f + 0.5f, 0.0f)), 127u);
+		}
+		return endpoint;
+	}
+
+	// the p-bit that brings an endpoint closer to color
+	Bc7Endpoint nearestBc7(const float *color) {
+		Bc7Endpoint best;
+		float bestError = FLT_MAX;
+		for (uint32_t pBit = 0; pBit < 2; ++pBit) {
+			const Bc7Endpoint endpoint = quantizeBc7(color, pBit);
+			float error = 0.0f;
+			for (uint32_t c = 0; c < 4; ++c) {
+				const float difference = static_cast<float>(endpoint.value(c)) - color[c];
+				error += difference * difference;
+			}
+			if (error < bestError) {
+				bestError = error;
+				best = endpoint;
+			}
+		}
+		return best;
+	}
+
+	void bc7Palette(const Bc7Endpoint &first, const Bc7Endpoint &second, Palette &palette) {
+		for (uint32_t i = 0; i < 16; ++i) {
+			for (uint32_t c = 0; c < 4; ++c) {
+				palette.entries[i][c] = static_cast<float>(((64 - BC7_WEIGHTS[i]) * first.value(c) + BC7_WEIGHTS[i] * second.value(c) + 32) >> 6);
+			}
+		}
+	}
+
+	struct Bc7Candidate {
+		Bc7Endpoint first;
+		Bc7Endpoint second;
+		float error = FLT_MAX;
+		uint8_t indices[BLOCK_TEXELS] = {};
+	};
+
+	// quantizes endpoints, at high quality trying every pair of p-bits, and keeps them in best if they beat it
+	void tryBc7(const Block &block, const Endpoints &endpoints, CompressionQuality quality, Bc7Candidate &best) {
+		Bc7Endpoint firsts[2] = {nearestBc7(endpoints.a)};
+		Bc7Endpoint seconds[2] = {nearestBc7(endpoints.b)};
+		uint32_t variants = 1;
+		if (quality == CompressionQuality::High) {
+			firsts[1] = quantizeBc7(endpoints.a, 1 - firsts[0].pBit);
+			seconds[1] = quantizeBc7(endpoints.b, 1 - seconds[0].pBit);
+			variants = 2;
+		}
+		for (uint32_t i = 0; i < variants; ++i) {
+			for (uint32_t j = 0; j < variants; ++j) {
+				Palette palette;
+				bc7Palette(firsts[i], seconds[j], palette);
+				uint8_t indices[BLOCK_TEXELS];
+				const float error = nearestIndices(block, 0, 4, palette, 16, indices);
+				if (error < best.error) {
+					best.first = firsts[i];
+					best.second = seconds[j];
+					best.error = error;
+					std::copy(indices, indices + BLOCK_TEXELS, best.indices);
+				}
+			}
+		}
+	}
+
+	Bc7Candidate encodeMode6(const Block &block, CompressionQuality quality) {
+		Bc7Candidate best;
+		tryBc7(block, quality == CompressionQuality::Fast ? boxEndpoints(block, 0, 4) : principalEndpoints(block, 0, 4), quality, best);
+		if (quality == CompressionQuality::High) {
+			tryBc7(block, boxEndpoints(block, 0, 4), quality, best);
+		}
+		const uint32_t refinements = REFINEMENTS[static_cast<uint32_t>(quality)];
+		for (uint32_t i = 0; i < refinements && best.error > 0.0f; ++i) {
+			Endpoints fitted;
+			const float error = best.error;
+			if (!fitEndpoints(block, 0, 4, best.indices, BC7_FRACTIONS, fitted)) {
+				break;
+			}
+			tryBc7(block, fitted, quality, best);
+			if (best.error >= error) {
+				break;
+			}
+		}
+		return best;
+	}
+
+	// BC7 mode 5: rgb endpoints of 7 bits a channel and alpha endpoints of 8
+	// bits, each with their own 2-bit indices, for blocks whose alpha does not
+	// follow their color along one line
+
+	struct Bc7SplitCandidate {
+		uint32_t color[2][3] = {};
+		uint32_t alpha[2] = {};
+		uint8_t colorIndices[BLOCK_TEXELS] = {};
+		uint8_t alphaIndices[BLOCK_TEXELS] = {};
+		float colorError = FLT_MAX;
+		float alphaError = FLT_MAX;
+	};
+
+	inline uint32_t expand7(uint32_t value) {
+		return (value << 1) | (value >> 6);
+	}
+
+	void splitPalette(const Bc7SplitCandidate &candidate, Palette &palette) {
+		for (uint32_t i = 0; i < 4; ++i) {
+			for (uint32_t c = 0; c < 3; ++c) {
+				palette.entries[i][c] = static_cast<float>(((64 - BC7_SPLIT_WEIGHTS[i]) * expand7(candidate.color[0][c])
+				                                            + BC7_SPLIT_WEIGHTS[i] * expand7(candidate.color[1][c]) + 32) >> 6);
+			}
+			palette.entries[i][3] = static_cast<float>(((64 - BC7_SPLIT_WEIGHTS[i]) * candidate.alpha[0] + BC7_SPLIT_WEIGHTS[i] * candidate.alpha[1] + 32) >> 6);
+		}
+	}
+
+	// keeps the color endpoints in best if they beat it
+	void trySplitColor(const Block &block, const Endpoints &endpoints, Bc7SplitCandidate &best) {
+		Bc7SplitCandidate candidate = best;
+		for (uint32_t c = 0; c < 3; ++c) {
+			candidate.color[0][c] = quantize(endpoints.a[c], 127);
+			candidate.color[1][c] = quantize(endpoints.b[c], 127);
+		}
+		Palette palette;
+		splitPalette(candidate, palette);
+		const float error = nearestIndices(block, 0, 3, palette, 4, candidate.colorIndices);
+		if (error < best.colorError) {
+			std::copy(candidate.color[0], candidate.color[0] + 3, best.color[0]);
+			std::copy(candidate.color[1], candidate.color[1] + 3, best.color[1]);
+			std::copy(candidate.colorIndices, candidate.colorIndices + BLOCK_TEXELS, best.colorIndices);
+			best.colorError = error;
+		}
+	}
+
+	void tryAlpha(const Block &block, uint32_t first, uint32_t second, Bc7SplitCandidate &best) {
+		Bc7SplitCandidate candidate = best;
+		candidate.alpha[0] = first;
+		candidate.alpha[1] = second;
+		Palette palette;
+		splitPalette(candidate, palette);
+		const float error = nearestIndices(block, 3, 1, palette, 4, candidate.alphaIndices);
+		if (error < best.alphaError) {
+			best.alpha[0] = first;
+			best.alpha[1] = second;
+			std::copy(candidate.alphaIndices, candidate.alphaIndices + BLOCK_TEXELS, best.alphaIndices);
+			best.alphaError = error;
+		}
+	}
+
+	Bc7SplitCandidate encodeMode5(const Block &block, CompressionQuality quality) {
+		Bc7SplitCandidate best;
+		trySplitColor(block, quality == CompressionQuality::Fast ? boxEndpoints(block, 0, 3) : principalEndpoints(block, 0, 3), best);
+		tryAlpha(block, static_cast<uint32_t>(*std::min_element(block.values[3], block.values[3] + BLOCK_TEXELS)),
+		         static_cast<uint32_t>(*std::max_element(block.values[3], block.values[3] + BLOCK_TEXELS)), best);
+		const uint32_t refinements = REFINEMENTS[static_cast<uint32_t>(quality)];
+		for (uint32_t i = 0; i < refinements && best.colorError + best.alphaError > 0.0f; ++i) {
+			const float error = best.colorError + best.alphaError;
+			Endpoints fitted;
+			if (fitEndpoints(block, 0, 3, best.colorIndices, BC7_SPLIT_FRACTIONS, fitted)) {
+				trySplitColor(block, fitted, best);
+			}
+			if (fitEndpoints(block, 3, 1, best.alphaIndices, BC7_SPLIT_FRACTIONS, fitted)) {
+				tryAlpha(block, quantize(fitted.a[3], 255), quantize(fitted.b[3], 255), best);
+			}
+			if (best.colorError + best.alphaError >= error) {
+				break;
+			}
+		}
+		return best;
+	}
+
+	void encodeBc7(const Block &block, CompressionQuality quality, uint8_t *out) {
+		Bc7Candidate best = encodeMode6(block, quality);
+		BitWriter writer{out, 16};
+
+		if (!isSolid(block, 3, 1)) {
+			Bc7SplitCandidate split = encodeMode5(block, quality);
+			if (split.colorError + split.alphaError < best.error) {
+				// as in mode 6, the first texel's indices drop their top bit
+				if (split.colorIndices[0] >= 2) {
+					std::swap(split.color[0], split.color[1]);
+					for (uint32_t i = 0; i < BLOCK_TEXELS; ++i) {
+						split.colorIndices[i] = static_cast<uint8_t>(3 - split.colorIndices[i]);
+					}
+				}
+				if (split.alphaIndices[0] >= 2) {
+					std::swap(split.alpha[0], split.alpha[1]);
+					for (uint32_t i = 0; i < BLOCK_TEXELS; ++i) {
+						split.alphaIndices[i] = static_cast<uint8_t>(3 - split.alphaIndices[i]);
+					}
+				}
+				// no rotation, alpha stays alpha
+				writer.write(1 << 5, 6);
+				writer.write(0, 2);
+				for (uint32_t c = 0; c < 3; ++c) {
+					writer.write(split.color[0][c], 7);
+					writer.write(split.color[1][c], 7);
+				}
+				writer.write(split.alpha[0], 8);
+				writer.write(split.alpha[1], 8);
+				for (uint32_t i = 0; i < BLOCK_TEXELS; ++i) {
+					writer.write(split.colorIndices[i], i == 0 ? 1 : 2);
+				}
+				for (uint32_t i = 0; i < BLOCK_TEXELS; ++i) {
+					writer.write(split.alphaIndices[i], i == 0 ? 1 : 2);
+				}
+				return;
+			}
+		}
+
+		// the first texel's index drops its top bit, so it must be in the first half
+		if (best.indices[0] >= 8) {
+			std::swap(best.first, best.second);
+			for (uint32_t i = 0; i < BLOCK_TEXELS; ++i) {
+				best.indices[i] = static_cast<uint8_t>(15 - best.indices[i]);
+			}
+		}
+		writer.write(1 << 6, 7);
+		for (uint32_t c = 0; c < 4; ++c) {
+			writer.write(best.first.channels[c], 7);
+			writer.write(best.second.channels[c], 7);
+		}
+		writer.write(best.first.pBit, 1);
+		writer.write(best.second.pBit, 1);
+		for (uint32_t i = 0; i < BLOCK_TEXELS; ++i) {
+			writer.write(best.indices[i], i == 0 ? 3 : 4);
+		}
+	}
+
+	// decoding, a block of rgba8 texels at a time
+
+	void decodeBc1(const uint8_t *in, bool fourColors, uint8_t (*texels)[4]) {
+		const uint16_t first = static_cast<uint16_t>(in[0] | (in[1] << 8));
+		const uint16_t second = static_cast<uint16_t>(in[2] | (in[3] << 8));
+		uint32_t colors[4][4];
+		unpackColor(first, colors[0]);
+		unpackColor(second, colors[1]);
+		colors[0][3] = colors[1][3] = colors[2][3] = colors[3][3] = 255;
+		for (uint32_t c = 0; c < 3; ++c) {
+			if (fourColors || first > second) {
+				colors[2][c] = (2 * colors[0][c] + colors[1][c]) / 3;
+				colors[3][c] = (colors[0][c] + 2 * colors[1][c]) / 3;
+			} else {
+				colors[2][c] = (colors[0][c] + colors[1][c]) / 2;
+				colors[3][c] = 0;
+			}
+		}
+		if (!fourColors && first <= second) {
+			colors[3][3] = 0;
+		}
+		BitReader reader{in + 4};
+		for (uint32_t i = 0; i < BLOCK_TEXELS; ++i) {
+			const uint32_t index = reader.read(2);
+			for (uint32_t c = 0; c < 4; ++c) {
+				texels[i][c] = static_cast<uint8_t>(colors[index][c]);
+			}
+		}
+	}
+
+	void decodeBc4(const uint8_t *in, uint32_t channel, uint8_t (*texels)[4]) {
+		Palette palette;
+		bc4Palette(in[0], in[1], channel, palette);
+		BitReader reader{in + 2};
+		for (uint32_t i = 0; i < BLOCK_TEXELS; ++i) {
+			texels[i][channel] = static_cast<uint8_t>(palette.entries[reader.read(3)][channel]);
+		}
+	}
+
+	void decodeBc7(const uint8_t *in, uint8_t (*texels)[4]) {
+		BitReader reader{in};
+		const uint32_t mode = reader.read(6);
+		Palette palette;
+		if (mode == 1 << 5) {
+			Bc7SplitCandidate split;
+			if (reader.read(2) != 0) {
+				std::memset(texels, 0, BLOCK_TEXELS * 4);
+				return;
+			}
+			for (uint32_t c = 0; c < 3; ++c) {
+				split.color[0][c] = reader.read(7);
+				split.color[1][c] = reader.read(7);
+			}
+			split.alpha[0] = reader.read(8);
+			split.alpha[1] = reader.read(8);
+			splitPalette(split, palette);
+			for (uint32_t i = 0; i < BLOCK_TEXELS; ++i) {
+				const uint32_t index = reader.read(i == 0 ? 1 : 2);
+				for (uint32_t c = 0; c < 3; ++c) {
+					texels[i][c] = static_cast<uint8_t>(palette.entries[index][c]);
+				}
+			}
+			for (uint32_t i = 0; i < BLOCK_TEXELS; ++i) {
+				texels[i][3] = static_cast<uint8_t>(palette.entries[reader.read(i == 0 ? 1 : 2)][3]);
+			}
+			return;
+		}
+		if (mode != 0 || reader.read(1) != 1) {
+			std::memset(texels, 0, BLOCK_TEXELS * 4);
+			return;
+		}
+		Bc7Endpoint first;
+		Bc7Endpoint second;
+		for (uint32_t c = 0; c < 4; ++c) {
+			first.channels[c] = reader.read(7);
+			second.channels[c] = reader.read(7);
+		}
+		first.pBit = reader.read(1);
+		second.pBit = reader.read(1);
+		bc7Palette(first, second, palette);
+		for (uint32_t i = 0; i < BLOCK_TEXELS; ++i) {
+			const uint32_t index = reader.read(i == 0 ? 3 : 4);
+			for (uint32_t c = 0; c < 4; ++c) {
+				texels[i][c] = static_cast<uint8_t>(palette.entries[index][c]);
+			}
+		}
+	}
+
+}
+
+void compressBlocks(TextureFormat format, CompressionQuality quality, const uint8_t *pixels, uint32_t width, uint32_t height,
+                    uint8_t *blocks, uint32_t firstRow, uint32_t lastRow) {
+	const uint32_t blocksWide = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	const uint32_t blockBytes = formatBlockBytes(format);
+	Block block;
+	for (uint32_t y = firstRow; y < lastRow; ++y) {
+		for (uint32_t x = 0; x < blocksWide; ++x) {
+			loadBlock(pixels, width, height, x, y, block);
+			uint8_t *out = blocks + (static_cast<size_t>(y) * blocksWide + x) * blockBytes;
+			switch (format) {
+				case TextureFormat::Bc1:
+					encodeBc1(block, quality, out);
+					break;
+				case TextureFormat::Bc3:
+					encodeBc4(block, 3, quality, out);
+					encodeBc1(block, quality, out + 8);
+					break;
+				case TextureFormat::Bc5:
+					encodeBc4(block, 0, quality, out);
+					encodeBc4(block, 1, quality, out + 8);
+					break;
+				case TextureFormat::Bc7:
+					encodeBc7(block, quality, out);
+					break;
+				default:
+					break;
+			}
+		}
+	}
+}
+
+void decompressBlocks(TextureFormat format, const uint8_t *blocks, uint32_t width, uint32_t height, uint8_t *pixels) {
+	const uint32_t blocksWide = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	const uint32_t blocksHigh = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	const uint32_t blockBytes = formatBlockBytes(format);
+	uint8_t texels[BLOCK_TEXELS][4];
+	for (uint32_t y = 0; y < blocksHigh; ++y) {
+		for (uint32_t x = 0; x < blocksWide; ++x) {
+			const uint8_t *in = blocks + (static_cast<size_t>(y) * blocksWide + x) * blockBytes;
+			switch (format) {
+				case TextureFormat::Bc1:
+					decodeBc1(in, false, texels);
+					break;
+				case TextureFormat::Bc3:
+					decodeBc1(in + 8, true, texels);
+					decodeBc4(in, 3, texels);
+					break;
+				case TextureFormat::Bc5:
+					for (uint32_t i = 0; i < BLOCK_TEXELS; ++i) {
+						texels[i][2] = 0;
+						texels[i][3] = 255;
+					}
+					decodeBc4(in, 0, texels);
+					decodeBc4(in + 8, 1, texels);
+					break;
+				case TextureFormat::Bc7:
+					decodeBc7(in, texels);
+					break;
+				default:
+					std::memset(texels, 0, sizeof(texels));
+					break;
+			}
+			for (uint32_t row = 0; row < BLOCK_SIZE && y * BLOCK_SIZE + row < height; ++row) {
+				for (uint32_t column = 0; column < BLOCK_SIZE && x * BLOCK_SIZE + column < width; ++column) {
+					std::memcpy(pixels + ((static_cast<size_t>(y) * BLOCK_SIZE + row) * width + x * BLOCK_SIZE + column) * 4, texels[row * BLOCK_SIZE + column], 4);
+				}
+			}
+		}
+	}
+}
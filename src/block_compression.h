@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+#include "texture_format.h"
+
+// How hard the encoder searches for each block's endpoints. Fast takes the
+// corners of the block's bounding box; Normal the ends of its principal
+// axis, refined once by least squares against the indices they give; High
+// keeps refining while the error falls, tries the bounding box as well, and
+// searches around the BC4 endpoints and over the BC7 p-bits.
+enum class CompressionQuality {
+    Fast,
+    Normal,
+    High,
+};
+
+// compresses the 4x4 blocks in block rows [firstRow, lastRow) of the width x
+// height rgba8 level pixels into blocks, which holds the whole level's
+// blocks row by row. row ranges are independent, so the blocks of a level
+// can be compressed on several threads. texels past the edge of a size that
+// is not a multiple of 4 repeat the last row or column. BC7 blocks are
+// written in mode 6, one line through rgba with 4-bit indices, or where alpha
+// varies apart from color in mode 5, separate rgb and alpha lines with 2-bit
+// indices each. Neither needs the partition tables of the other modes
+void compressBlocks(TextureFormat format, CompressionQuality quality, const uint8_t *pixels, uint32_t width, uint32_t height,
+                    uint8_t *blocks, uint32_t firstRow, uint32_t lastRow);
+
+// decodes the blocks of a width x height level back to rgba8 pixels, for
+// measuring what compression lost. interpolated values are rounded to
+// nearest, which gpus may differ from by one. BC5 comes back with blue 0 and
+// alpha 255. only the BC7 modes compressBlocks writes are decoded, blocks in
+// other modes come back black
+void decompressBlocks(TextureFormat format, const uint8_t *blocks, uint32_t width, uint32_t height, uint8_t *pixels);
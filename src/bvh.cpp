@@ -0,0 +1,409 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "float4.h"
+
+namespace {
+
+	// triangles per leaf, one packet
+	constexpr uint32_t LEAF_SIZE = 4;
+	// candidate split planes per axis when building
+	constexpr int SAH_BINS = 12;
+	// nodes waiting to be visited; each visit adds at most three, so this
+	// covers trees far deeper than binned SAH builds
+	constexpr int TRAVERSAL_STACK_SIZE = 256;
+	// rays this close to parallel with a triangle miss it
+	constexpr float DETERMINANT_EPSILON = 1e-12f;
+
+	constexpr float INF = std::numeric_limits<float>::infinity();
+
+	struct Bounds {
+		glm::vec3 min{INF};
+		glm::vec3 max{-INF};
+
+		inline void grow(const glm::vec3 &point) {
+			min = glm::min(min, point);
+			max = glm::max(max, point);
+		}
+
+		inline void grow(const Bounds &other) {
+			min = glm::min(min, other.min);
+			max = glm::max(max, other.max);
+		}
+
+		inline float area() const {
+			const glm::vec3 size = max - min;
+			return size.x < 0.0f ? 0.0f : 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+		}
+	};
+
+	// node of the binary tree built first; leaves have a count
+	struct BuildNode {
+		Bounds bounds;
+		uint32_t first = 0;
+		uint32_t count = 0;
+		uint32_t left = 0;
+		uint32_t right = 0;
+	};
+
+	class BinaryBuilder {
+		std::vector<Bounds> m_triangleBounds;
+		std::vector<glm::vec3> m_centroids;
+
+	public:
+		std::vector<uint32_t> order;
+		std::vector<BuildNode> nodes;
+
+		explicit BinaryBuilder(const std::vector<glm::vec3> &vertices) {
+			const uint32_t triangleCount = static_cast<uint32_t>(vertices.size() / 3);
+			m_triangleBounds.resize(triangleCount);
+			m_centroids.resize(triangleCount);
+			order.resize(triangleCount);
+			for (uint32_t i = 0; i < triangleCount; ++i) {
+				for (uint32_t corner = 0; corner < 3; ++corner) {
+					m_triangleBounds[i].grow(vertices[i * 3 + corner]);
+				}
+				m_centroids[i] = (m_triangleBounds[i].min + m_triangleBounds[i].max) * 0.5f;
+				order[i] = i;
+			}
+			nodes.reserve(triangleCount / 2 + 1);
+		}
+
+		// builds the subtree over order[first, first + count) and returns its node
+		uint32_t build(uint32_t first, uint32_t count) {
+			const uint32_t index = static_cast<uint32_t>(nodes.size());
+			nodes.emplace_back();
+
+			Bounds bounds;
+			Bounds centroidBounds;
+			for (uint32_t i = first; i < first + count; ++i) {
+				bounds.grow(m_triangleBounds[order[i]]);
+				centroidBounds.grow(m_centroids[order[i]]);
+			}
+			nodes[index].bounds = bounds;
+			if (count <= LEAF_SIZE) {
+				nodes[index].first = first;
+				nodes[index].count = count;
+				return index;
+			}
+
+			const uint32_t split = first + findSplit(first, count, centroidBounds);
+			const uint32_t left = build(first, split - first);
+			const uint32_t right = build(split, first + count - split);
+			nodes[index].left = left;
+			nodes[index].right = right;
+			return index;
+		}
+
+	private:
+		// partitions the range by the cheapest binned split on the widest
+		// axis and returns the size of the left half
+		uint32_t findSplit(uint32_t first, uint32_t count, const Bounds &centroidBounds) {
+			const glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+			const int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+			if (!(extent[axis] > 0.0f)) {
+				// every centroid in one place, any split is as good
+				return count / 2;
+			}
+
+			const float origin = centroidBounds.min[axis];
+			const float scale = SAH_BINS / extent[axis];
+			auto binOf = [&](uint32_t triangle) {
+				return std::min(SAH_BINS - 1, static_cast<int>((m_centroids[triangle][axis] - origin) * scale));
+			};
+
+			Bounds binBounds[SAH_BINS];
+			uint32_t binCounts[SAH_BINS] = {};
+			for (uint32_t i = first; i < first + count; ++i) {
+				const int bin = binOf(order[i]);
+				binBounds[bin].grow(m_triangleBounds[order[i]]);
+				++binCounts[bin];
+			}
+
+			// cost of splitting after each bin, from both sides
+			float leftCosts[SAH_BINS - 1];
+			Bounds sweep;
+			uint32_t sweepCount = 0;
+			for (int bin = 0; bin < SAH_BINS - 1; ++bin) {
+				sweep.grow(binBounds[bin]);
+				sweepCount += binCounts[bin];
+				leftCosts[bin] = sweep.area() * sweepCount;
+			}
+			int bestBin = -1;
+			float bestCost = INF;
+			sweep = Bounds{};
+			sweepCount = 0;
+			for (int bin = SAH_BINS - 1; bin > 0; --bin) {
+				sweep.grow(binBounds[bin]);
+				sweepCount += binCounts[bin];
+				const float cost = leftCosts[bin - 1] + sweep.area() * sweepCount;
+				if (sweepCount < count && cost < bestCost) {
+					bestCost = cost;
+					bestBin = bin;
+				}
+			}
+			if (bestBin < 0) {
+				return count / 2;
+			}
+
+			auto middle = std::partition(order.begin() + first, order.begin() + first + count,
+			                             [&](uint32_t triangle) { return binOf(triangle) < bestBin; });
+			const uint32_t leftCount = static_cast<uint32_t>(middle - (order.begin() + first));
+			return leftCount == 0 || leftCount == count ? count / 2 : leftCount;
+		}
+	};
+
+	// per ray constants for the box tests
+	struct RaySetup {
+		Float4 origin[3];
+		Float4 direction[3];
+		Float4 inverseDirection[3];
+		// bounds rows holding the near and far plane on each axis
+		int nearRow[3];
+		int farRow[3];
+
+		explicit RaySetup(const Ray &ray) {
+			for (int axis = 0; axis < 3; ++axis) {
+				// a zero component would turn the slab test into 0 * inf
+				float direction = ray.direction[axis];
+				if (std::fabs(direction) < 1e-20f) {
+					direction = std::signbit(direction) ? -1e-20f : 1e-20f;
+				}
+				origin[axis] = Float4::splat(ray.origin[axis]);
+				this->direction[axis] = Float4::splat(ray.direction[axis]);
+				inverseDirection[axis] = Float4::splat(1.0f / direction);
+				nearRow[axis] = axis * 2 + (direction < 0.0f ? 1 : 0);
+				farRow[axis] = axis * 2 + (direction < 0.0f ? 0 : 1);
+			}
+		}
+	};
+
+	// Moller-Trumbore against the four triangles of a leaf, returns the
+	// lanes hit closer than tMax and their distances
+	template <typename Packet>
+	inline uint32_t intersectPacket(const Packet &packet, const RaySetup &ray, Float4 tMax, Float4 &t) {
+		const Float4 zero = Float4::splat(0.0f);
+		const Float4 one = Float4::splat(1.0f);
+		const Float4 *direction = ray.direction;
+		const Float4 edge1[3] = {Float4::load(packet.edge1[0]), Float4::load(packet.edge1[1]), Float4::load(packet.edge1[2])};
+		const Float4 edge2[3] = {Float4::load(packet.edge2[0]), Float4::load(packet.edge2[1]), Float4::load(packet.edge2[2])};
+		const Float4 p[3] = {direction[1] * edge2[2] - direction[2] * edge2[1],
+		                     direction[2] * edge2[0] - direction[0] * edge2[2],
+		                     direction[0] * edge2[1] - direction[1] * edge2[0]};
+		const Float4 determinant = edge1[0] * p[0] + edge1[1] * p[1] + edge1[2] * p[2];
+		const Float4 inverseDeterminant = one / determinant;
+		const Float4 s[3] = {ray.origin[0] - Float4::load(packet.vertex[0]),
+		                     ray.origin[1] - Float4::load(packet.vertex[1]),
+		                     ray.origin[2] - Float4::load(packet.vertex[2])};
+		const Float4 u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inverseDeterminant;
+		const Float4 q[3] = {s[1] * edge1[2] - s[2] * edge1[1],
+		                     s[2] * edge1[0] - s[0] * edge1[2],
+		                     s[0] * edge1[1] - s[1] * edge1[0]};
+		const Float4 v = (direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) * inverseDeterminant;
+		t = (edge2[0] * q[0] + edge2[1] * q[1] + edge2[2] * q[2]) * inverseDeterminant;
+
+		const Float4 valid = (abs(determinant) > Float4::splat(DETERMINANT_EPSILON)) & (u >= zero) & (v >= zero) &
+		                     ((u + v) <= one) & (t > zero) & (t < tMax);
+		return bits(valid);
+	}
+
+	// slab test against a node's four boxes, returns the lanes the ray passes
+	// through before tMax and where it enters them
+	template <typename Node>
+	inline uint32_t intersectBoxes(const Node &node, const RaySetup &ray, Float4 tMax, Float4 &tNear) {
+		tNear = Float4::splat(0.0f);
+		Float4 tFar = tMax;
+		for (int axis = 0; axis < 3; ++axis) {
+			tNear = max(tNear, (Float4::load(node.bounds[ray.nearRow[axis]]) - ray.origin[axis]) * ray.inverseDirection[axis]);
+			tFar = min(tFar, (Float4::load(node.bounds[ray.farRow[axis]]) - ray.origin[axis]) * ray.inverseDirection[axis]);
+		}
+		return bits(tNear <= tFar);
+	}
+
+	struct StackEntry {
+		int32_t node;
+		float t;
+	};
+
+}
+
+void Bvh::build(const std::vector<glm::vec3> &vertices) {
+	m_nodes.clear();
+	m_packets.clear();
+	if (vertices.size() < 3) {
+		return;
+	}
+
+	BinaryBuilder builder{vertices};
+	const uint32_t root = builder.build(0, static_cast<uint32_t>(builder.order.size()));
+
+	auto emptyNode = []() {
+		Node node;
+		for (int row = 0; row < 6; ++row) {
+			std::fill_n(node.bounds[row], 4, row % 2 == 0 ? INF : -INF);
+		}
+		std::fill_n(node.children, 4, 0);
+		return node;
+	};
+
+	auto makePacket = [&](const BuildNode &leaf) {
+		TrianglePacket packet{};
+		for (uint32_t lane = 0; lane < 4; ++lane) {
+			packet.triangles[lane] = BVH_NO_HIT;
+			if (lane >= leaf.count) {
+				continue;
+			}
+			const uint32_t triangle = builder.order[leaf.first + lane];
+			const glm::vec3 &a = vertices[triangle * 3];
+			const glm::vec3 edge1 = vertices[triangle * 3 + 1] - a;
+			const glm::vec3 edge2 = vertices[triangle * 3 + 2] - a;
+			for (int axis = 0; axis < 3; ++axis) {
+				packet.vertex[axis][lane] = a[axis];
+				packet.edge1[axis][lane] = edge1[axis];
+				packet.edge2[axis][lane] = edge2[axis];
+			}
+			packet.triangles[lane] = triangle;
+		}
+		m_packets.push_back(packet);
+		return ~static_cast<int32_t>(m_packets.size() - 1);
+	};
+
+	// pulls grandchildren up until a node has four children, opening the
+	// largest inner child first since it is the most likely to be entered
+	auto collapse = [&](auto &self, uint32_t binary) -> int32_t {
+		uint32_t children[4];
+		int childCount = 0;
+		if (builder.nodes[binary].count > 0) {
+			children[childCount++] = binary;
+		} else {
+			children[childCount++] = builder.nodes[binary].left;
+			children[childCount++] = builder.nodes[binary].right;
+		}
+		while (childCount < 4) {
+			int widest = -1;
+			for (int i = 0; i < childCount; ++i) {
+				const BuildNode &child = builder.nodes[children[i]];
+				if (child.count == 0 && (widest < 0 || child.bounds.area() > builder.nodes[children[widest]].bounds.area())) {
+					widest = i;
+				}
+			}
+			if (widest < 0) {
+				break;
+			}
+			const BuildNode &opened = builder.nodes[children[widest]];
+			children[widest] = opened.left;
+			children[childCount++] = opened.right;
+		}
+
+		const int32_t index = static_cast<int32_t>(m_nodes.size());
+		m_nodes.push_back(emptyNode());
+		for (int i = 0; i < childCount; ++i) {
+			const BuildNode &child = builder.nodes[children[i]];
+			const int32_t reference = child.count > 0 ? makePacket(child) : self(self, children[i]);
+			Node &node = m_nodes[index];
+			for (int axis = 0; axis < 3; ++axis) {
+				node.bounds[axis * 2][i] = child.bounds.min[axis];
+				node.bounds[axis * 2 + 1][i] = child.bounds.max[axis];
+			}
+			node.children[i] = reference;
+		}
+		return index;
+	};
+	collapse(collapse, root);
+}
+
+bool Bvh::intersect(const Ray &ray, RayHit &hit) const {
+	hit.t = ray.tMax;
+	hit.triangle = BVH_NO_HIT;
+	if (m_nodes.empty()) {
+		return false;
+	}
+
+	const RaySetup setup{ray};
+	StackEntry stack[TRAVERSAL_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = StackEntry{0, 0.0f};
+	alignas(16) float distances[4];
+
+	while (stackSize > 0) {
+		const StackEntry entry = stack[--stackSize];
+		if (entry.t >= hit.t) {
+			continue;
+		}
+
+		if (entry.node < 0) {
+			const TrianglePacket &packet = m_packets[~entry.node];
+			Float4 t;
+			uint32_t mask = intersectPacket(packet, setup, Float4::splat(hit.t), t);
+			if (mask != 0) {
+				t.store(distances);
+				for (int lane = 0; lane < 4; ++lane, mask >>= 1) {
+					if ((mask & 1) && distances[lane] < hit.t) {
+						hit.t = distances[lane];
+						hit.triangle = packet.triangles[lane];
+					}
+				}
+			}
+			continue;
+		}
+
+		const Node &node = m_nodes[entry.node];
+		Float4 tNear;
+		uint32_t mask = intersectBoxes(node, setup, Float4::splat(hit.t), tNear);
+		if (mask == 0) {
+			continue;
+		}
+
+		// push the farthest first so the nearest is visited next
+		tNear.store(distances);
+		const int firstPushed = stackSize;
+		for (int lane = 0; lane < 4; ++lane, mask >>= 1) {
+			if (!(mask & 1)) {
+				continue;
+			}
+			const StackEntry child{node.children[lane], distances[lane]};
+			int position = stackSize++;
+			while (position > firstPushed && stack[position - 1].t < child.t) {
+				stack[position] = stack[position - 1];
+				--position;
+			}
+			stack[position] = child;
+		}
+	}
+	return hit.triangle != BVH_NO_HIT;
+}
+
+bool Bvh::occluded(const Ray &ray) const {
+	if (m_nodes.empty()) {
+		return false;
+	}
+
+	const RaySetup setup{ray};
+	const Float4 tMax = Float4::splat(ray.tMax);
+	int32_t stack[TRAVERSAL_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0) {
+		const int32_t reference = stack[--stackSize];
+		if (reference < 0) {
+			Float4 t;
+			if (intersectPacket(m_packets[~reference], setup, tMax, t) != 0) {
+				return true;
+			}
+			continue;
+		}
+
+		Float4 tNear;
+		uint32_t mask = intersectBoxes(m_nodes[reference], setup, tMax, tNear);
+		for (int lane = 0; lane < 4; ++lane, mask >>= 1) {
+			if (mask & 1) {
+				stack[stackSize++] = m_nodes[reference].children[lane];
+			}
+		}
+	}
+	return false;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// triangle index reported when a ray hits nothing
+constexpr uint32_t BVH_NO_HIT = UINT32_MAX;
+
+// A ray segment, hits are only reported closer than tMax
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;
+    float tMax;
+};
+
+struct RayHit {
+    float t;
+    uint32_t triangle = BVH_NO_HIT;
+};
+
+// Bounding volume hierarchy over world space triangles. Built with binned
+// SAH as a binary tree, then collapsed so every node has four children and
+// every leaf four triangles, which lets a ray test all four boxes or
+// triangles at once in SSE registers.
+class Bvh {
+    struct alignas(16) Node {
+        // child boxes by lane, rows are min x, max x, min y, max y, min z, max z.
+        // unused lanes hold inverted boxes that no ray can enter
+        float bounds[6][4];
+        // inner node index, or the bitwise not of a leaf's packet index
+        int32_t children[4];
+    };
+
+    // up to four triangles as a vertex and two edges, padded with degenerate ones
+    struct alignas(16) TrianglePacket {
+        float vertex[3][4];
+        float edge1[3][4];
+        float edge2[3][4];
+        uint32_t triangles[4];
+    };
+
+    std::vector<Node> m_nodes;
+    std::vector<TrianglePacket> m_packets;
+
+public:
+    // vertices holds three corners per triangle, hits report the triangle's position in it
+    void build(const std::vector<glm::vec3> &vertices);
+
+    // finds the closest hit along the ray, returns false if there is none
+    bool intersect(const Ray &ray, RayHit &hit) const;
+
+    // whether anything lies along the ray, stopping at the first hit
+    bool occluded(const Ray &ray) const;
+
+    inline size_t nodeCount() const {
+        return m_nodes.size();
+    }
+
+    inline size_t packetCount() const {
+        return m_packets.size();
+    }
+};
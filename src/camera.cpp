@@ -1,50 +1,75 @@
 #include "camera.h"
 
+#include <cmath>
+
 #include <glm/gtc/matrix_transform.hpp>
 
-Camera::Camera(glm::vec3 position, glm::vec3 up, float yaw, float pitch) 
-        : front{glm::vec3{0.0f, 0.0f, -1.0f}}, movementSpeed{SPEED}, mouseSensitivity{SENSITIVITY}, zoomOffset{ZOOM} {
-    this->position = position;
-    this->worldUp = up;
-    this->yaw = yaw;
-    this->pitch = pitch;
-    updateVectors();
+Frustum Frustum::fromMatrix(const glm::mat4 &viewProjection) {
+    // rows of the matrix, glm stores columns
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; ++i) {
+        rows[i] = glm::vec4{viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]};
+    }
+
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0]; // left
+    frustum.planes[1] = rows[3] - rows[0]; // right
+    frustum.planes[2] = rows[3] + rows[1]; // bottom
+    frustum.planes[3] = rows[3] - rows[1]; // top
+    frustum.planes[4] = rows[3] + rows[2]; // near
+    frustum.planes[5] = rows[3] - rows[2]; // far
+    for (glm::vec4 &plane : frustum.planes) {
+        plane /= glm::length(glm::vec3{plane});
+    }
+    return frustum;
 }
 
-glm::mat4 Camera::getViewMatrix() const {
-    return glm::lookAt(position, position + front, up);
+bool Frustum::intersectsSphere(const glm::vec3 &center, float radius) const {
+    for (const glm::vec4 &plane : planes) {
+        if (glm::dot(glm::vec3{plane}, center) + plane.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Camera::Camera(glm::vec3 position, glm::vec3 up, float yaw, float pitch)
+        : m_position{position}, m_front{glm::vec3{0.0f, 0.0f, -1.0f}}, m_worldUp{up}, m_yaw{yaw}, m_pitch{pitch}, m_zoom{ZOOM},
+          movementSpeed{SPEED}, mouseSensitivity{SENSITIVITY} {
+    updateVectors();
 }
 
 void Camera::move(Movement movement, float deltaTime) {
     const float velocity = movementSpeed * deltaTime;
     switch (movement) {
         case Movement::Forward:
-            position += front * velocity;
+            m_position += m_front * velocity;
             break;
         case Movement::Backward:
-            position -= front * velocity;
+            m_position -= m_front * velocity;
             break;
         case Movement::Left:
-            position -= right * velocity;
+            m_position -= m_right * velocity;
             break;
         case Movement::Right:
-            position += right * velocity;
+            m_position += m_right * velocity;
             break;
     }
+    m_dirty = true;
 }
 
 void Camera::rotate(float xOffset, float yOffset, bool constrainPitch) {
     xOffset *= mouseSensitivity;
     yOffset *= mouseSensitivity;
 
-    yaw += xOffset;
-    pitch += yOffset;
+    m_yaw += xOffset;
+    m_pitch += yOffset;
 
     if (constrainPitch) {
-        if (pitch > 89.0f) {
-            pitch = 89.0f;
-        } else if (pitch < -89.0f) {
-            pitch = -89.0f;
+        if (m_pitch > 89.0f) {
+            m_pitch = 89.0f;
+        } else if (m_pitch < -89.0f) {
+            m_pitch = -89.0f;
         }
     }
 
@@ -53,19 +78,116 @@ void Camera::rotate(float xOffset, float yOffset, bool constrainPitch) {
 
 void Camera::updateVectors() {
     glm::vec3 front;
-    front.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
-    front.y = sin(glm::radians(pitch));
-    front.z = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
-    this->front = glm::normalize(front);
-    right = glm::normalize(glm::cross(this->front, worldUp));
-    up = glm::normalize(glm::cross(right, this->front));
+    front.x = cos(glm::radians(m_yaw)) * cos(glm::radians(m_pitch));
+    front.y = sin(glm::radians(m_pitch));
+    front.z = sin(glm::radians(m_yaw)) * cos(glm::radians(m_pitch));
+    m_front = glm::normalize(front);
+    m_right = glm::normalize(glm::cross(m_front, m_worldUp));
+    m_up = glm::normalize(glm::cross(m_right, m_front));
+    m_dirty = true;
 }
 
 void Camera::zoom(float offset) {
-    zoomOffset -= offset;
-    if (zoomOffset < 1.0f) {
-        zoomOffset = 1.0f;
-    } else if (zoomOffset > 45.0f) {
-        zoomOffset = 45.0f;
+    float zoom = m_zoom - offset;
+    if (zoom < 1.0f) {
+        zoom = 1.0f;
+    } else if (zoom > 45.0f) {
+        zoom = 45.0f;
+    }
+    setZoom(zoom);
+}
+
+void Camera::setPosition(const glm::vec3 &position) {
+    if (position != m_position) {
+        m_position = position;
+        m_dirty = true;
+    }
+}
+
+void Camera::setOrientation(float yaw, float pitch) {
+    if (yaw != m_yaw || pitch != m_pitch) {
+        m_yaw = yaw;
+        m_pitch = pitch;
+        updateVectors();
+    }
+}
+
+void Camera::setDirection(const glm::vec3 &front, const glm::vec3 &up) {
+    const glm::vec3 normalized = glm::normalize(front);
+    if (normalized != m_front || up != m_worldUp) {
+        m_front = normalized;
+        m_worldUp = up;
+        m_right = glm::normalize(glm::cross(m_front, m_worldUp));
+        m_up = glm::normalize(glm::cross(m_right, m_front));
+        // kept in step so rotate() carries on from here
+        m_pitch = glm::degrees(std::asin(m_front.y));
+        m_yaw = glm::degrees(std::atan2(m_front.z, m_front.x));
+        m_dirty = true;
+    }
+}
+
+void Camera::setZoom(float zoom) {
+    if (zoom != m_zoom) {
+        m_zoom = zoom;
+        m_dirty = true;
+    }
+}
+
+void Camera::setPerspective(float aspect, float nearPlane, float farPlane) {
+    if (m_orthographic || aspect != m_aspect || nearPlane != m_nearPlane || farPlane != m_farPlane) {
+        m_orthographic = false;
+        m_aspect = aspect;
+        m_nearPlane = nearPlane;
+        m_farPlane = farPlane;
+        m_dirty = true;
+    }
+}
+
+void Camera::setOrthographic(const glm::vec2 &extent, float nearPlane, float farPlane) {
+    if (!m_orthographic || extent != m_orthographicExtent || nearPlane != m_nearPlane || farPlane != m_farPlane) {
+        m_orthographic = true;
+        m_orthographicExtent = extent;
+        m_nearPlane = nearPlane;
+        m_farPlane = farPlane;
+        m_dirty = true;
+    }
+}
+
+void Camera::update() const {
+    if (!m_dirty) {
+        return;
+    }
+    m_view = glm::lookAt(m_position, m_position + m_front, m_up);
+    if (m_orthographic) {
+        m_projection = glm::ortho(-m_orthographicExtent.x, m_orthographicExtent.x, -m_orthographicExtent.y, m_orthographicExtent.y, m_nearPlane, m_farPlane);
+    } else {
+        m_projection = glm::perspective(glm::radians(m_zoom), m_aspect, m_nearPlane, m_farPlane);
+    }
+    m_viewProjection = m_projection * m_view;
+    m_inverseView = glm::inverse(m_view);
+    m_inverseProjection = glm::inverse(m_projection);
+    m_inverseViewProjection = m_inverseView * m_inverseProjection;
+    m_frustum = Frustum::fromMatrix(m_viewProjection);
+    ++m_version;
+    m_dirty = false;
+}
+
+void Camera::frustumCorners(float nearDepth, float farDepth, glm::vec3 corners[8]) const {
+    update();
+    const float depths[2] = {nearDepth, farDepth};
+    for (int plane = 0; plane < 2; ++plane) {
+        // ndc depth of the plane at this distance
+        const glm::vec4 clip = m_projection * glm::vec4{0.0f, 0.0f, -depths[plane], 1.0f};
+        const float z = clip.z / clip.w;
+        for (int corner = 0; corner < 4; ++corner) {
+            const glm::vec4 point = m_inverseViewProjection * glm::vec4{(corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, z, 1.0f};
+            corners[plane * 4 + corner] = glm::vec3{point} / point.w;
+        }
+    }
+}
+
+void Camera::updateAll(const Camera *const *cameras, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        cameras[i]->update();
     }
 }
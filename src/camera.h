@@ -3,6 +3,9 @@
  */
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+
 #include <glm/glm.hpp>
 
 // Movements in a 3D environment
@@ -20,31 +23,171 @@ constexpr float SPEED = 2.5f;
 constexpr float SENSITIVITY = 0.1f;
 constexpr float ZOOM = 45.0f;
 
-// A viewpoint in a 3D environment
+// The six planes bounding what a camera sees, as (normal, distance) with the
+// normals pointing inwards
+struct Frustum {
+    glm::vec4 planes[6];
+
+    // extracts the planes from a view-projection matrix
+    static Frustum fromMatrix(const glm::mat4 &viewProjection);
+
+    bool intersectsSphere(const glm::vec3 &center, float radius) const;
+};
+
+// A viewpoint in a 3D environment. The matrices and frustum derived from it
+// are cached and only rebuilt after the pose or projection changed, which
+// also bumps version() so anything built from them can tell when to refresh.
+// The getters rebuild on demand, so call update() before reading a camera
+// from several threads at once.
 class Camera {
+    // pose
+    glm::vec3 m_position;
+    glm::vec3 m_front;
+    glm::vec3 m_up;
+    glm::vec3 m_right;
+    glm::vec3 m_worldUp;
+    float m_yaw;
+    float m_pitch;
+    float m_zoom;
+
+    // projection
+    float m_aspect = 1.0f;
+    float m_nearPlane = 0.1f;
+    float m_farPlane = 100.0f;
+    bool m_orthographic = false;
+    glm::vec2 m_orthographicExtent{1.0f};
+
+    // derived state
+    mutable bool m_dirty = true;
+    mutable uint64_t m_version = 0;
+    mutable glm::mat4 m_view;
+    mutable glm::mat4 m_projection;
+    mutable glm::mat4 m_viewProjection;
+    mutable glm::mat4 m_inverseView;
+    mutable glm::mat4 m_inverseProjection;
+    mutable glm::mat4 m_inverseViewProjection;
+    mutable Frustum m_frustum;
+
+    void updateVectors();
+
 public:
-    glm::vec3 position;
-    glm::vec3 front;
-    glm::vec3 up;
-    glm::vec3 right;
-    glm::vec3 worldUp;
-    float yaw;
-    float pitch;
     float movementSpeed;
     float mouseSensitivity;
-    float zoomOffset;
 
     Camera(glm::vec3 position = glm::vec3{0.0f, 0.0f, 0.0f}, glm::vec3 up = glm::vec3{0.0f, 1.0f, 0.0f}, float yaw = YAW, float pitch = PITCH);
 
-    glm::mat4 getViewMatrix() const;
-
     void move(Movement movement, float deltaTime);
 
     void rotate(float xOffset, float yOffset, bool constrainPitch = true);
 
     void zoom(float offset);
 
-private:
-    void updateVectors();
-};
+    // setters only invalidate the cache when the value actually changes
+    void setPosition(const glm::vec3 &position);
+
+    void setOrientation(float yaw, float pitch);
+
+    // points the camera along front, with up as the world's up, for views
+    // placed by a direction rather than turned by yaw and pitch
+    void setDirection(const glm::vec3 &front, const glm::vec3 &up);
+
+    void setZoom(float zoom);
+
+    // perspective projection with zoom as the vertical field of view in degrees
+    void setPerspective(float aspect, float nearPlane, float farPlane);
+
+    // orthographic projection covering extent either side of the view axis
+    void setOrthographic(const glm::vec2 &extent, float nearPlane, float farPlane);
+
+    // rebuilds the derived state if anything changed since the last time
+    void update() const;
+
+    // world space corners of the part of the view between two distances in
+    // front of the camera, near ones first. used to fit shadow cascades
+    void frustumCorners(float nearDepth, float farDepth, glm::vec3 corners[8]) const;
 
+    // updates cameras for split views or shadow cascades in one pass, so
+    // they can all be read from other threads afterwards
+    static void updateAll(const Camera *const *cameras, size_t count);
+
+    inline const glm::vec3 &position() const {
+        return m_position;
+    }
+
+    inline const glm::vec3 &front() const {
+        return m_front;
+    }
+
+    inline const glm::vec3 &up() const {
+        return m_up;
+    }
+
+    inline const glm::vec3 &right() const {
+        return m_right;
+    }
+
+    inline const glm::vec3 &worldUp() const {
+        return m_worldUp;
+    }
+
+    inline float yaw() const {
+        return m_yaw;
+    }
+
+    inline float pitch() const {
+        return m_pitch;
+    }
+
+    inline float zoomOffset() const {
+        return m_zoom;
+    }
+
+    inline float nearPlane() const {
+        return m_nearPlane;
+    }
+
+    inline float farPlane() const {
+        return m_farPlane;
+    }
+
+    // increases every time the derived state is rebuilt
+    inline uint64_t version() const {
+        update();
+        return m_version;
+    }
+
+    inline const glm::mat4 &view() const {
+        update();
+        return m_view;
+    }
+
+    inline const glm::mat4 &projection() const {
+        update();
+        return m_projection;
+    }
+
+    inline const glm::mat4 &viewProjection() const {
+        update();
+        return m_viewProjection;
+    }
+
+    inline const glm::mat4 &inverseView() const {
+        update();
+        return m_inverseView;
+    }
+
+    inline const glm::mat4 &inverseProjection() const {
+        update();
+        return m_inverseProjection;
+    }
+
+    inline const glm::mat4 &inverseViewProjection() const {
+        update();
+        return m_inverseViewProjection;
+    }
+
+    inline const Frustum &frustum() const {
+        update();
+        return m_frustum;
+    }
+};
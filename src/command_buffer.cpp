@@ -0,0 +1,8 @@
+#include "command_buffer.h"
+
+#include "mesh.h"
+#include "shaders.h"
+
+void CommandBuffer::draw(uint64_t key, const Shader &shader, const Mesh &mesh, const glm::mat4 &model, const TextureSlot *texture) {
+    m_packets.push_back(DrawPacket{key, shader.id(), mesh.vao(), texture, mesh.indexCount(), 0, model});
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+class Mesh;
+class Shader;
+struct TextureSlot;
+
+// Everything needed to issue one indexed draw, without touching opengl
+struct DrawPacket {
+    // orders packets in the render queue, see makeSortKey
+    uint64_t key;
+    uint32_t program;
+    uint32_t vao;
+    // array bound at ALBEDO_TEXTURE_UNIT, and where the albedo is in it, when not null
+    const TextureSlot *texture;
+    uint32_t indexCount;
+    uint32_t firstIndex;
+    glm::mat4 model;
+};
+
+// A linear list of draw packets filled by a single thread. Recording is plain
+// memory writes and is safe off the context thread; the render queue merges
+// the buffers and replays them on the context thread.
+// Aligned so neighbouring buffers filled by different threads never share a cache line.
+class alignas(64) CommandBuffer {
+    std::vector<DrawPacket> m_packets;
+
+public:
+    // clears recorded packets but keeps the allocation for the next frame
+    inline void reset() {
+        m_packets.clear();
+    }
+
+    void draw(uint64_t key, const Shader &shader, const Mesh &mesh, const glm::mat4 &model, const TextureSlot *texture = nullptr);
+
+    inline const std::vector<DrawPacket> &packets() const {
+        return m_packets;
+    }
+};
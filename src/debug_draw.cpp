@@ -0,0 +1,96 @@
+#include "debug_draw.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#include "glad/glad.h"
+
+#include "gl_state.h"
+#include "shaders.h"
+
+namespace {
+
+	// initial room for lines each frame, grown on demand
+	constexpr size_t INITIAL_VERTICES = 4096;
+
+	uint32_t packColor(const glm::vec3 &color) {
+		auto channel = [](float value) {
+			return static_cast<uint32_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+		};
+		return channel(color.x) | (channel(color.y) << 8) | (channel(color.z) << 16) | (0xffu << 24);
+	}
+
+}
+
+void DebugDraw::create(FrameController &frames) {
+	glGenVertexArrays(1, &m_vao);
+	m_stream.create(frames, INITIAL_VERTICES * sizeof(Vertex));
+	m_sourceBuffer = 0;
+}
+
+void DebugDraw::destroy() {
+	m_stream.destroy();
+	glstate::deleteVertexArray(m_vao);
+	m_vao = 0;
+	m_vertices.clear();
+}
+
+void DebugDraw::line(const glm::vec3 &from, const glm::vec3 &to, const glm::vec3 &color) {
+	const uint32_t packed = packColor(color);
+	m_vertices.push_back(Vertex{from, packed});
+	m_vertices.push_back(Vertex{to, packed});
+}
+
+void DebugDraw::cross(const glm::vec3 &center, float size, const glm::vec3 &color) {
+	const float half = size / 2.0f;
+	line(center - glm::vec3{half, 0.0f, 0.0f}, center + glm::vec3{half, 0.0f, 0.0f}, color);
+	line(center - glm::vec3{0.0f, half, 0.0f}, center + glm::vec3{0.0f, half, 0.0f}, color);
+	line(center - glm::vec3{0.0f, 0.0f, half}, center + glm::vec3{0.0f, 0.0f, half}, color);
+}
+
+void DebugDraw::box(const glm::vec3 &min, const glm::vec3 &max, const glm::vec3 &color) {
+	const glm::vec3 corners[8] = {
+		{min.x, min.y, min.z}, {max.x, min.y, min.z}, {max.x, max.y, min.z}, {min.x, max.y, min.z},
+		{min.x, min.y, max.z}, {max.x, min.y, max.z}, {max.x, max.y, max.z}, {min.x, max.y, max.z},
+	};
+	for (int i = 0; i < 4; ++i) {
+		// near face, far face, and the edges joining them
+		line(corners[i], corners[(i + 1) % 4], color);
+		line(corners[i + 4], corners[(i + 1) % 4 + 4], color);
+		line(corners[i], corners[i + 4], color);
+	}
+}
+
+void DebugDraw::axes(const glm::vec3 &origin, float length) {
+	line(origin, origin + glm::vec3{length, 0.0f, 0.0f}, glm::vec3{1.0f, 0.0f, 0.0f});
+	line(origin, origin + glm::vec3{0.0f, length, 0.0f}, glm::vec3{0.0f, 1.0f, 0.0f});
+	line(origin, origin + glm::vec3{0.0f, 0.0f, length}, glm::vec3{0.0f, 0.0f, 1.0f});
+}
+
+void DebugDraw::submit(const Shader &shader, FrameStats &stats) {
+	if (m_vertices.empty()) {
+		return;
+	}
+
+	const size_t bytes = m_vertices.size() * sizeof(Vertex);
+	m_stream.beginFrame(bytes);
+	const size_t offset = m_stream.write(m_vertices.data(), bytes, sizeof(Vertex));
+	m_stream.flush();
+
+	// growing the stream replaces its buffer, so re-point the attributes
+	glstate::bindVertexArray(m_vao);
+	if (m_sourceBuffer != m_stream.id()) {
+		m_sourceBuffer = m_stream.id();
+		glstate::bindBuffer(GL_ARRAY_BUFFER, m_sourceBuffer);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, position));
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void *)offsetof(Vertex, color));
+		glEnableVertexAttribArray(1);
+	}
+
+	shader.bind();
+	glDrawArrays(GL_LINES, static_cast<GLint>(offset / sizeof(Vertex)), static_cast<GLsizei>(m_vertices.size()));
+	++stats.drawCalls;
+
+	m_vertices.clear();
+}
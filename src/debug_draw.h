@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "stats.h"
+#include "stream_buffer.h"
+
+class FrameController;
+class Shader;
+
+// Lines queued from anywhere on the render thread during a frame and drawn in
+// one call, for visualising positions and volumes. Vertices are streamed to
+// the gpu every frame.
+class DebugDraw {
+    struct Vertex {
+        glm::vec3 position;
+        // rgba8
+        uint32_t color;
+    };
+
+    std::vector<Vertex> m_vertices;
+    StreamBuffer m_stream;
+    uint32_t m_vao = 0;
+    // buffer the VAO attributes currently point at
+    uint32_t m_sourceBuffer = 0;
+
+public:
+    void create(FrameController &frames);
+
+    void destroy();
+
+    void line(const glm::vec3 &from, const glm::vec3 &to, const glm::vec3 &color);
+
+    // three axis aligned lines through center
+    void cross(const glm::vec3 &center, float size, const glm::vec3 &color);
+
+    // edges of an axis aligned box
+    void box(const glm::vec3 &min, const glm::vec3 &max, const glm::vec3 &color);
+
+    // red, green and blue lines along x, y and z
+    void axes(const glm::vec3 &origin, float length);
+
+    // draws everything queued with shader (debug.vs + debug.fs) and clears the queue
+    void submit(const Shader &shader, FrameStats &stats);
+};
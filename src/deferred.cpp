@@ -0,0 +1,135 @@
+#include "deferred.h"
+
+#include "glad/glad.h"
+#include "spdlog/spdlog.h"
+
+#include "gl_state.h"
+#include "scene.h"
+#include "shaders.h"
+
+namespace {
+
+	// texture units the lighting passes read the g-buffer from
+	constexpr uint32_t ALBEDO_UNIT = 0;
+	constexpr uint32_t NORMAL_UNIT = 1;
+	constexpr uint32_t DEPTH_UNIT = 2;
+
+	// vertices of the cube deferred_light.vs builds around each light
+	constexpr GLsizei LIGHT_VOLUME_VERTICES = 36;
+
+	void allocateTarget(uint32_t texture, GLint format, GLenum layout, GLenum type, int width, int height) {
+		glstate::bindTexture(0, GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, layout, type, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+}
+
+void DeferredRenderer::create(int width, int height) {
+	glGenFramebuffers(1, &m_framebuffer);
+	glGenTextures(1, &m_albedoTexture);
+	glGenTextures(1, &m_normalTexture);
+	glGenTextures(1, &m_depthTexture);
+	glGenVertexArrays(1, &m_fullscreenVao);
+	glGenVertexArrays(1, &m_lightVao);
+	m_lightSource = 0;
+	resize(width, height);
+}
+
+void DeferredRenderer::destroy() {
+	glDeleteFramebuffers(1, &m_framebuffer);
+	glstate::deleteTexture(m_albedoTexture);
+	glstate::deleteTexture(m_normalTexture);
+	glstate::deleteTexture(m_depthTexture);
+	glstate::deleteVertexArray(m_fullscreenVao);
+	glstate::deleteVertexArray(m_lightVao);
+	m_framebuffer = m_albedoTexture = m_normalTexture = m_depthTexture = 0;
+	m_fullscreenVao = m_lightVao = m_lightSource = 0;
+}
+
+void DeferredRenderer::resize(int width, int height) {
+	m_width = width;
+	m_height = height;
+
+	// depth and stencil together, matching the usual default framebuffer so depth can be blitted to it
+	allocateTarget(m_albedoTexture, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+	allocateTarget(m_normalTexture, GL_RG16, GL_RG, GL_UNSIGNED_SHORT, width, height);
+	allocateTarget(m_depthTexture, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, width, height);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_albedoTexture, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_normalTexture, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, m_depthTexture, 0);
+	const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+	glDrawBuffers(2, drawBuffers);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		spdlog::error("G-buffer framebuffer is incomplete");
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	spdlog::info("G-buffer {}x{} at {} bytes per pixel, {:.1f} MB written and read back per frame", width, height, GBUFFER_BYTES_PER_PIXEL,
+	             static_cast<double>(width) * height * GBUFFER_BYTES_PER_PIXEL * 2.0 / (1024.0 * 1024.0));
+}
+
+void DeferredRenderer::beginGeometry() {
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glstate::depthMask(true);
+	const GLfloat zero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+	glClearBufferfv(GL_COLOR, 0, zero);
+	glClearBufferfv(GL_COLOR, 1, zero);
+	glClearBufferfi(GL_DEPTH_STENCIL, 0, 1.0f, 0);
+}
+
+void DeferredRenderer::light(const Shader &ambientShader, const Shader &lightShader, uint32_t lights, size_t lightOffset, uint32_t lightCount, FrameStats &stats) {
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glstate::bindTexture(ALBEDO_UNIT, GL_TEXTURE_2D, m_albedoTexture);
+	glstate::bindTexture(NORMAL_UNIT, GL_TEXTURE_2D, m_normalTexture);
+	glstate::bindTexture(DEPTH_UNIT, GL_TEXTURE_2D, m_depthTexture);
+	glstate::disable(GL_DEPTH_TEST);
+
+	// ambient light and emissive surfaces, over the cleared screen
+	glstate::useProgram(ambientShader.id());
+	glstate::bindVertexArray(m_fullscreenVao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	++stats.drawCalls;
+
+	if (lightCount > 0) {
+		glstate::bindVertexArray(m_lightVao);
+		if (m_lightSource != lights || m_lightOffset != lightOffset) {
+			m_lightSource = lights;
+			m_lightOffset = lightOffset;
+			glstate::bindBuffer(GL_ARRAY_BUFFER, lights);
+			glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(PointLight), (void *)lightOffset);
+			glVertexAttribDivisor(0, 1);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(PointLight), (void *)(lightOffset + 4 * sizeof(float)));
+			glVertexAttribDivisor(1, 1);
+			glEnableVertexAttribArray(1);
+		}
+
+		// only the far side of each volume, so lights the camera is inside of still cover their pixels.
+		// no depth test, since the g-buffer depth is being sampled
+		glstate::enable(GL_BLEND);
+		glstate::blendFunc(GL_ONE, GL_ONE);
+		glstate::enable(GL_CULL_FACE);
+		glstate::cullFace(GL_FRONT);
+		glstate::useProgram(lightShader.id());
+		glDrawArraysInstanced(GL_TRIANGLES, 0, LIGHT_VOLUME_VERTICES, static_cast<GLsizei>(lightCount));
+		++stats.drawCalls;
+		glstate::cullFace(GL_BACK);
+		glstate::disable(GL_CULL_FACE);
+		glstate::disable(GL_BLEND);
+	}
+
+	glstate::enable(GL_DEPTH_TEST);
+}
+
+void DeferredRenderer::copyDepth() {
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "stats.h"
+
+class Shader;
+
+// bytes the g-buffer holds per pixel: rgba8 albedo, rg16 normal, 24 bit depth and stencil
+constexpr uint32_t GBUFFER_BYTES_PER_PIXEL = 4 + 4 + 4;
+
+// Deferred shading. The scene is drawn once into a g-buffer of packed
+// targets, then lit in screen space: a fullscreen pass adds ambient light
+// and emissive surfaces, and every point light draws a cube around its
+// radius that shades only the pixels it covers, blended additively. Normals
+// are stored octahedrally in two channels and positions are rebuilt from
+// depth, so lighting reads 12 bytes a pixel.
+class DeferredRenderer {
+    uint32_t m_framebuffer = 0;
+    // albedo, with alpha set on surfaces that emit their albedo unlit
+    uint32_t m_albedoTexture = 0;
+    // octahedral normal in [0, 1]
+    uint32_t m_normalTexture = 0;
+    uint32_t m_depthTexture = 0;
+    int m_width = 0;
+    int m_height = 0;
+
+    uint32_t m_fullscreenVao = 0;
+    uint32_t m_lightVao = 0;
+    // buffer and offset the light VAO attributes currently point at
+    uint32_t m_lightSource = 0;
+    size_t m_lightOffset = 0;
+
+public:
+    void create(int width, int height);
+
+    void destroy();
+
+    // reallocates the targets, which are always the size of the screen
+    void resize(int width, int height);
+
+    // binds and clears the g-buffer. draw the scene with gbuffer.fs programs after
+    void beginGeometry();
+
+    // shades the default framebuffer from the g-buffer. ambientShader is
+    // present.vs + deferred_ambient.fs, lightShader deferred_light.vs + .fs.
+    // lights holds lightCount PointLights from lightOffset
+    void light(const Shader &ambientShader, const Shader &lightShader, uint32_t lights, size_t lightOffset, uint32_t lightCount, FrameStats &stats);
+
+    // copies the g-buffer depth to the default framebuffer, so later passes
+    // can test against the scene
+    void copyDepth();
+};
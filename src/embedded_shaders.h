@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string_view>
+
+// A shader source built into the binary, named by its path in the shaders directory
+struct EmbeddedShader {
+    std::string_view name;
+    std::string_view text;
+};
+
+// the embedded source with the name, or null. defined in the translation unit
+// cmake/embed_shaders.cmake generates from the shaders directory
+const EmbeddedShader *findEmbeddedShader(std::string_view name);
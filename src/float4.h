@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// Four floats in one register, or a plain array where SSE is unavailable.
+// Loads and stores need 16 byte alignment. Comparisons give lane masks that
+// combine with & and turn into one bit per lane with bits()
+#if defined(__SSE2__) || defined(_M_X64)
+struct Float4 {
+	__m128 v;
+
+	static inline Float4 load(const float *p) { return {_mm_load_ps(p)}; }
+	static inline Float4 splat(float s) { return {_mm_set1_ps(s)}; }
+	inline void store(float *p) const { _mm_store_ps(p, v); }
+};
+
+inline Float4 operator+(Float4 a, Float4 b) { return {_mm_add_ps(a.v, b.v)}; }
+inline Float4 operator-(Float4 a, Float4 b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline Float4 operator*(Float4 a, Float4 b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline Float4 operator/(Float4 a, Float4 b) { return {_mm_div_ps(a.v, b.v)}; }
+inline Float4 operator&(Float4 a, Float4 b) { return {_mm_and_ps(a.v, b.v)}; }
+inline Float4 operator<(Float4 a, Float4 b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+inline Float4 operator<=(Float4 a, Float4 b) { return {_mm_cmple_ps(a.v, b.v)}; }
+inline Float4 operator>(Float4 a, Float4 b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+inline Float4 operator>=(Float4 a, Float4 b) { return {_mm_cmpge_ps(a.v, b.v)}; }
+inline Float4 min(Float4 a, Float4 b) { return {_mm_min_ps(a.v, b.v)}; }
+inline Float4 max(Float4 a, Float4 b) { return {_mm_max_ps(a.v, b.v)}; }
+inline Float4 abs(Float4 a) { return {_mm_and_ps(a.v, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)))}; }
+inline uint32_t bits(Float4 mask) { return static_cast<uint32_t>(_mm_movemask_ps(mask.v)); }
+#else
+struct Float4 {
+	float v[4];
+
+	static inline Float4 load(const float *p) { return {{p[0], p[1], p[2], p[3]}}; }
+	static inline Float4 splat(float s) { return {{s, s, s, s}}; }
+	inline void store(float *p) const { std::copy(v, v + 4, p); }
+};
+
+// comparisons give 1 or 0 per lane rather than a bit mask
+template <typename Op>
+inline Float4 lanes(Float4 a, Float4 b, Op op) {
+	Float4 result;
+	for (int i = 0; i < 4; ++i) {
+		result.v[i] = op(a.v[i], b.v[i]);
+	}
+	return result;
+}
+
+inline Float4 operator+(Float4 a, Float4 b) { return lanes(a, b, [](float x, float y) { return x + y; }); }
+inline Float4 operator-(Float4 a, Float4 b) { return lanes(a, b, [](float x, float y) { return x - y; }); }
+inline Float4 operator*(Float4 a, Float4 b) { return lanes(a, b, [](float x, float y) { return x * y; }); }
+inline Float4 operator/(Float4 a, Float4 b) { return lanes(a, b, [](float x, float y) { return x / y; }); }
+inline Float4 operator&(Float4 a, Float4 b) { return lanes(a, b, [](float x, float y) { return x != 0.0f && y != 0.0f ? 1.0f : 0.0f; }); }
+inline Float4 operator<(Float4 a, Float4 b) { return lanes(a, b, [](float x, float y) { return x < y ? 1.0f : 0.0f; }); }
+inline Float4 operator<=(Float4 a, Float4 b) { return lanes(a, b, [](float x, float y) { return x <= y ? 1.0f : 0.0f; }); }
+inline Float4 operator>(Float4 a, Float4 b) { return lanes(a, b, [](float x, float y) { return x > y ? 1.0f : 0.0f; }); }
+inline Float4 operator>=(Float4 a, Float4 b) { return lanes(a, b, [](float x, float y) { return x >= y ? 1.0f : 0.0f; }); }
+inline Float4 min(Float4 a, Float4 b) { return lanes(a, b, [](float x, float y) { return x < y ? x : y; }); }
+inline Float4 max(Float4 a, Float4 b) { return lanes(a, b, [](float x, float y) { return x > y ? x : y; }); }
+inline Float4 abs(Float4 a) { return lanes(a, a, [](float x, float) { return std::fabs(x); }); }
+inline uint32_t bits(Float4 mask) {
+	uint32_t result = 0;
+	for (int i = 0; i < 4; ++i) {
+		result |= mask.v[i] != 0.0f ? 1u << i : 0u;
+	}
+	return result;
+}
+#endif
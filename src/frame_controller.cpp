@@ -0,0 +1,75 @@
+#include "frame_controller.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "spdlog/spdlog.h"
+
+void FrameController::create(uint32_t framesInFlight) {
+	m_framesInFlight = std::clamp<uint32_t>(framesInFlight, 1, MAX_FRAMES_IN_FLIGHT);
+	m_slot = 0;
+	m_frameNumber = 0;
+	m_fences.assign(m_framesInFlight, nullptr);
+	m_releases.assign(m_framesInFlight, {});
+	spdlog::debug("Allowing {} frames in flight", m_framesInFlight);
+}
+
+void FrameController::destroy() {
+	waitIdle();
+	m_fences.clear();
+	m_releases.clear();
+}
+
+double FrameController::retire(uint32_t slot) {
+	double waitedMs = 0.0;
+	if (GLsync fence = m_fences[slot]) {
+		auto start = std::chrono::steady_clock::now();
+
+		// flush on the first wait so the fence is guaranteed to signal
+		GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+		while (true) {
+			GLenum result = glClientWaitSync(fence, flags, 1000000000);
+			if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+				break;
+			}
+			if (result == GL_WAIT_FAILED) {
+				spdlog::error("Waiting on frame fence failed");
+				break;
+			}
+			flags = 0;
+		}
+		glDeleteSync(fence);
+		m_fences[slot] = nullptr;
+
+		waitedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	for (auto &release : m_releases[slot]) {
+		release();
+	}
+	m_releases[slot].clear();
+	return waitedMs;
+}
+
+double FrameController::beginFrame() {
+	m_slot = (m_slot + 1) % m_framesInFlight;
+	++m_frameNumber;
+	return retire(m_slot);
+}
+
+void FrameController::endFrame() {
+	if (m_fences[m_slot]) {
+		glDeleteSync(m_fences[m_slot]);
+	}
+	m_fences[m_slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void FrameController::waitIdle() {
+	for (uint32_t slot = 0; slot < m_fences.size(); ++slot) {
+		retire(slot);
+	}
+}
+
+void FrameController::deferRelease(std::function<void()> release) {
+	m_releases[m_slot].push_back(std::move(release));
+}
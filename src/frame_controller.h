@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "glad/glad.h"
+
+// frames the cpu may queue ahead of the gpu when not configured
+constexpr uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 3;
+
+// Bounds how far the cpu runs ahead of the gpu. Each frame gets a slot, fenced
+// at the end of the frame; starting a frame waits for the fence of the last
+// frame that used the same slot. Resources written per frame are indexed by
+// slot, and anything queued with deferRelease() is released once the gpu has
+// finished the frame that queued it.
+class FrameController {
+    uint32_t m_framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+    uint32_t m_slot = 0;
+    uint64_t m_frameNumber = 0;
+    std::vector<GLsync> m_fences;
+    std::vector<std::vector<std::function<void()>>> m_releases;
+
+    // blocks until slot's fence signals and runs its releases, returns ms waited
+    double retire(uint32_t slot);
+
+public:
+    // framesInFlight is clamped to [1, MAX_FRAMES_IN_FLIGHT]
+    void create(uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT);
+
+    // waits for the gpu to finish everything and releases all deferred resources
+    void destroy();
+
+    // moves to the next slot, waiting for the gpu to finish its previous use.
+    // returns the time spent waiting in milliseconds
+    double beginFrame();
+
+    // fences everything submitted since beginFrame()
+    void endFrame();
+
+    // waits for every frame in flight, e.g. before replacing shared resources
+    void waitIdle();
+
+    // release runs on this thread once the gpu is done with the current frame
+    void deferRelease(std::function<void()> release);
+
+    // slot of the current frame, in [0, framesInFlight())
+    inline uint32_t slot() const {
+        return m_slot;
+    }
+
+    inline uint32_t framesInFlight() const {
+        return m_framesInFlight;
+    }
+
+    inline uint64_t frameNumber() const {
+        return m_frameNumber;
+    }
+};
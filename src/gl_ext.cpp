@@ -0,0 +1,108 @@
+#include "gl_ext.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "spdlog/spdlog.h"
+
+#ifndef GL_VERSION_4_1
+PFNGLGETPROGRAMBINARYPROC glad_glGetProgramBinary = nullptr;
+PFNGLPROGRAMBINARYPROC glad_glProgramBinary = nullptr;
+PFNGLPROGRAMPARAMETERIPROC glad_glProgramParameteri = nullptr;
+#endif
+
+#ifndef GL_VERSION_4_2
+PFNGLTEXSTORAGE2DPROC glad_glTexStorage2D = nullptr;
+PFNGLTEXSTORAGE3DPROC glad_glTexStorage3D = nullptr;
+#endif
+
+#ifndef GL_VERSION_4_3
+PFNGLMULTIDRAWELEMENTSINDIRECTPROC glad_glMultiDrawElementsIndirect = nullptr;
+PFNGLCOPYIMAGESUBDATAPROC glad_glCopyImageSubData = nullptr;
+#endif
+
+#ifndef GL_VERSION_4_4
+PFNGLBUFFERSTORAGEPROC glad_glBufferStorage = nullptr;
+#endif
+
+namespace glext {
+
+	namespace {
+		Support supported;
+	}
+
+	void load(GLADloadproc loader) {
+		glad_glMultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)loader("glMultiDrawElementsIndirect");
+		glad_glBufferStorage = (PFNGLBUFFERSTORAGEPROC)loader("glBufferStorage");
+		glad_glTexStorage2D = (PFNGLTEXSTORAGE2DPROC)loader("glTexStorage2D");
+		glad_glTexStorage3D = (PFNGLTEXSTORAGE3DPROC)loader("glTexStorage3D");
+		glad_glCopyImageSubData = (PFNGLCOPYIMAGESUBDATAPROC)loader("glCopyImageSubData");
+		glad_glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)loader("glGetProgramBinary");
+		glad_glProgramBinary = (PFNGLPROGRAMBINARYPROC)loader("glProgramBinary");
+		glad_glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)loader("glProgramParameteri");
+
+		supported = Support{};
+		// reported as major.minor with anything after
+		const char *glsl = reinterpret_cast<const char *>(glGetString(GL_SHADING_LANGUAGE_VERSION));
+		int major = 0;
+		int minor = 0;
+		if (glsl && std::sscanf(glsl, "%d.%d", &major, &minor) == 2) {
+			supported.glslVersion = major * 100 + minor;
+		}
+
+		// the indirect shader variants are #version 430, which older contexts
+		// with the extensions may not compile
+		supported.multiDrawIndirect = glad_glMultiDrawElementsIndirect != nullptr
+			&& (hasVersion(4, 3) || (hasExtension("GL_ARB_multi_draw_indirect")
+			                         && hasExtension("GL_ARB_base_instance")
+			                         && hasExtension("GL_ARB_shader_storage_buffer_object")
+			                         && supported.glslVersion >= 430));
+		supported.bufferStorage = glad_glBufferStorage != nullptr
+			&& (hasVersion(4, 4) || hasExtension("GL_ARB_buffer_storage"));
+		supported.textureStorage = glad_glTexStorage2D != nullptr && glad_glTexStorage3D != nullptr
+			&& (hasVersion(4, 2) || hasExtension("GL_ARB_texture_storage"));
+		supported.copyImage = glad_glCopyImageSubData != nullptr
+			&& (hasVersion(4, 3) || hasExtension("GL_ARB_copy_image"));
+		supported.programBinary = glad_glGetProgramBinary != nullptr && glad_glProgramBinary != nullptr && glad_glProgramParameteri != nullptr
+			&& (hasVersion(4, 1) || hasExtension("GL_ARB_get_program_binary"));
+		if (supported.programBinary) {
+			// drivers may expose the entry points without any format to save in
+			GLint formats = 0;
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+			supported.programBinary = formats > 0;
+		}
+		supported.s3tc = hasExtension("GL_EXT_texture_compression_s3tc");
+		supported.bptc = hasVersion(4, 2) || hasExtension("GL_ARB_texture_compression_bptc");
+
+		spdlog::debug("OpenGL {}.{} context, GLSL {}, multi-draw indirect {}, buffer storage {}, texture storage {}, copy image {}, program binary {}, s3tc {}, bptc {}",
+		              GLVersion.major, GLVersion.minor, supported.glslVersion,
+		              supported.multiDrawIndirect ? "supported" : "unsupported",
+		              supported.bufferStorage ? "supported" : "unsupported",
+		              supported.textureStorage ? "supported" : "unsupported",
+		              supported.copyImage ? "supported" : "unsupported",
+		              supported.programBinary ? "supported" : "unsupported",
+		              supported.s3tc ? "supported" : "unsupported",
+		              supported.bptc ? "supported" : "unsupported");
+	}
+
+	const Support &support() {
+		return supported;
+	}
+
+	bool hasVersion(int major, int minor) {
+		return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+	}
+
+	bool hasExtension(const char *name) {
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; ++i) {
+			const char *extension = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+			if (extension && std::strcmp(extension, name) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+}
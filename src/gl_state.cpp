@@ -0,0 +1,269 @@
+#include "gl_state.h"
+
+#include <array>
+#include <cstddef>
+
+#include "gl_ext.h"
+
+namespace glstate {
+
+	namespace {
+
+		// value no opengl name or enum takes, marks state we have not seen set
+		constexpr GLuint UNKNOWN = 0xffffffff;
+
+		constexpr std::array<GLenum, 10> BUFFER_TARGETS = {
+			GL_ARRAY_BUFFER,
+			GL_ELEMENT_ARRAY_BUFFER,
+			GL_UNIFORM_BUFFER,
+			GL_TEXTURE_BUFFER,
+			GL_PIXEL_PACK_BUFFER,
+			GL_PIXEL_UNPACK_BUFFER,
+			GL_COPY_READ_BUFFER,
+			GL_COPY_WRITE_BUFFER,
+			GL_DRAW_INDIRECT_BUFFER,
+			GL_SHADER_STORAGE_BUFFER,
+		};
+
+		constexpr std::array<GLenum, 5> TEXTURE_TARGETS = {
+			GL_TEXTURE_2D,
+			GL_TEXTURE_2D_ARRAY,
+			GL_TEXTURE_CUBE_MAP,
+			GL_TEXTURE_3D,
+			GL_TEXTURE_BUFFER,
+		};
+
+		constexpr std::array<GLenum, 7> CAPABILITIES = {
+			GL_DEPTH_TEST,
+			GL_BLEND,
+			GL_CULL_FACE,
+			GL_SCISSOR_TEST,
+			GL_STENCIL_TEST,
+			GL_POLYGON_OFFSET_FILL,
+			GL_FRAMEBUFFER_SRGB,
+		};
+
+		constexpr GLuint TEXTURE_UNITS = 16;
+
+		template <std::size_t N>
+		int indexOf(const std::array<GLenum, N> &values, GLenum value) {
+			for (std::size_t i = 0; i < N; ++i) {
+				if (values[i] == value) {
+					return static_cast<int>(i);
+				}
+			}
+			return -1;
+		}
+
+		struct State {
+			GLuint program;
+			GLuint vao;
+			std::array<GLuint, BUFFER_TARGETS.size()> buffers;
+			GLuint activeUnit;
+			std::array<std::array<GLuint, TEXTURE_TARGETS.size()>, TEXTURE_UNITS> textures;
+			std::array<GLuint, CAPABILITIES.size()> capabilities;
+			GLuint depthFunc;
+			GLuint depthMask;
+			GLuint cullFace;
+			GLuint blendSource;
+			GLuint blendDestination;
+
+			State() {
+				reset();
+			}
+
+			void reset() {
+				program = UNKNOWN;
+				vao = UNKNOWN;
+				buffers.fill(UNKNOWN);
+				activeUnit = UNKNOWN;
+				for (auto &unit : textures) {
+					unit.fill(UNKNOWN);
+				}
+				capabilities.fill(UNKNOWN);
+				depthFunc = UNKNOWN;
+				depthMask = UNKNOWN;
+				cullFace = UNKNOWN;
+				blendSource = UNKNOWN;
+				blendDestination = UNKNOWN;
+			}
+		};
+
+		// only ever touched from the context thread
+		State state;
+		Counters counts;
+
+		// records the new value and returns whether the call has to be issued
+		inline bool change(GLuint &current, GLuint value) {
+			if (current == value) {
+				++counts.elided;
+				return false;
+			}
+			current = value;
+			++counts.issued;
+			return true;
+		}
+
+		// for state we do not shadow
+		inline void passThrough() {
+			++counts.issued;
+		}
+
+	}
+
+	void useProgram(GLuint program) {
+		if (change(state.program, program)) {
+			glUseProgram(program);
+		}
+	}
+
+	void bindVertexArray(GLuint vao) {
+		if (change(state.vao, vao)) {
+			glBindVertexArray(vao);
+			// the element array binding is part of the VAO we switched to
+			state.buffers[indexOf(BUFFER_TARGETS, GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+		}
+	}
+
+	void bindBuffer(GLenum target, GLuint buffer) {
+		int index = indexOf(BUFFER_TARGETS, target);
+		if (index < 0) {
+			passThrough();
+			glBindBuffer(target, buffer);
+			return;
+		}
+		if (change(state.buffers[index], buffer)) {
+			glBindBuffer(target, buffer);
+		}
+	}
+
+	void bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+		passThrough();
+		glBindBufferBase(target, index, buffer);
+		int slot = indexOf(BUFFER_TARGETS, target);
+		if (slot >= 0) {
+			state.buffers[slot] = buffer;
+		}
+	}
+
+	void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+		passThrough();
+		glBindBufferRange(target, index, buffer, offset, size);
+		int slot = indexOf(BUFFER_TARGETS, target);
+		if (slot >= 0) {
+			state.buffers[slot] = buffer;
+		}
+	}
+
+	void bindTexture(GLuint unit, GLenum target, GLuint texture) {
+		int index = indexOf(TEXTURE_TARGETS, target);
+		if (index < 0 || unit >= TEXTURE_UNITS) {
+			passThrough();
+			glActiveTexture(GL_TEXTURE0 + unit);
+			state.activeUnit = unit;
+			passThrough();
+			glBindTexture(target, texture);
+			return;
+		}
+		if (state.textures[unit][index] == texture) {
+			++counts.elided;
+			return;
+		}
+		if (change(state.activeUnit, unit)) {
+			glActiveTexture(GL_TEXTURE0 + unit);
+		}
+		change(state.textures[unit][index], texture);
+		glBindTexture(target, texture);
+	}
+
+	void setEnabled(GLenum capability, bool enabled) {
+		int index = indexOf(CAPABILITIES, capability);
+		if (index >= 0 && !change(state.capabilities[index], enabled ? 1 : 0)) {
+			return;
+		}
+		if (index < 0) {
+			passThrough();
+		}
+		if (enabled) {
+			glEnable(capability);
+		} else {
+			glDisable(capability);
+		}
+	}
+
+	void depthFunc(GLenum func) {
+		if (change(state.depthFunc, func)) {
+			glDepthFunc(func);
+		}
+	}
+
+	void depthMask(bool write) {
+		if (change(state.depthMask, write ? 1 : 0)) {
+			glDepthMask(write ? GL_TRUE : GL_FALSE);
+		}
+	}
+
+	void cullFace(GLenum face) {
+		if (change(state.cullFace, face)) {
+			glCullFace(face);
+		}
+	}
+
+	void blendFunc(GLenum source, GLenum destination) {
+		if (state.blendSource == source && state.blendDestination == destination) {
+			++counts.elided;
+			return;
+		}
+		state.blendSource = source;
+		state.blendDestination = destination;
+		++counts.issued;
+		glBlendFunc(source, destination);
+	}
+
+	void deleteProgram(GLuint program) {
+		if (state.program == program) {
+			state.program = UNKNOWN;
+		}
+		glDeleteProgram(program);
+	}
+
+	void deleteVertexArray(GLuint vao) {
+		if (state.vao == vao) {
+			state.vao = UNKNOWN;
+		}
+		glDeleteVertexArrays(1, &vao);
+	}
+
+	void deleteBuffer(GLuint buffer) {
+		for (GLuint &bound : state.buffers) {
+			if (bound == buffer) {
+				bound = UNKNOWN;
+			}
+		}
+		glDeleteBuffers(1, &buffer);
+	}
+
+	void deleteTexture(GLuint texture) {
+		for (auto &unit : state.textures) {
+			for (GLuint &bound : unit) {
+				if (bound == texture) {
+					bound = UNKNOWN;
+				}
+			}
+		}
+		glDeleteTextures(1, &texture);
+	}
+
+	void invalidate() {
+		state.reset();
+	}
+
+	const Counters &counters() {
+		return counts;
+	}
+
+	void resetCounters() {
+		counts = Counters{};
+	}
+
+}
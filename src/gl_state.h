@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+
+#include "glad/glad.h"
+
+// Shadows the opengl binding and render state of the context thread and drops
+// calls that would not change anything. Everything that binds state should go
+// through here, otherwise the shadow goes stale; call invalidate() after code
+// that touches state directly.
+namespace glstate {
+
+	// calls forwarded to and filtered from the driver since the last reset
+	struct Counters {
+		uint32_t issued = 0;
+		uint32_t elided = 0;
+	};
+
+	void useProgram(GLuint program);
+
+	void bindVertexArray(GLuint vao);
+
+	// the element array binding belongs to the bound VAO and is tracked with it
+	void bindBuffer(GLenum target, GLuint buffer);
+
+	// indexed bindings are not shadowed, but they also replace the generic binding
+	void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+	// selects unit with glActiveTexture before binding when needed
+	void bindTexture(GLuint unit, GLenum target, GLuint texture);
+
+	void setEnabled(GLenum capability, bool enabled);
+
+	inline void enable(GLenum capability) {
+		setEnabled(capability, true);
+	}
+
+	inline void disable(GLenum capability) {
+		setEnabled(capability, false);
+	}
+
+	void depthFunc(GLenum func);
+
+	void depthMask(bool write);
+
+	void cullFace(GLenum face);
+
+	void blendFunc(GLenum source, GLenum destination);
+
+	// delete objects and forget them, since opengl may reuse their names
+	void deleteProgram(GLuint program);
+	void deleteVertexArray(GLuint vao);
+	void deleteBuffer(GLuint buffer);
+	void deleteTexture(GLuint texture);
+
+	// forget everything, so the next call of each kind reaches the driver
+	void invalidate();
+
+	const Counters &counters();
+
+	void resetCounters();
+
+}
@@ -0,0 +1,53 @@
+#include "gpu_timer.h"
+
+#include "glad/glad.h"
+
+#include "frame_controller.h"
+
+void GpuTimer::create(const FrameController &frames, uint32_t scopes) {
+	m_frames = &frames;
+	m_scopes = scopes;
+	m_queries.assign(frames.framesInFlight(), std::vector<uint32_t>(scopes * 2));
+	for (std::vector<uint32_t> &queries : m_queries) {
+		glGenQueries(static_cast<GLsizei>(queries.size()), queries.data());
+	}
+	m_pending.assign(frames.framesInFlight(), std::vector<bool>(scopes, false));
+	m_milliseconds.assign(scopes, 0.0);
+}
+
+void GpuTimer::destroy() {
+	for (std::vector<uint32_t> &queries : m_queries) {
+		glDeleteQueries(static_cast<GLsizei>(queries.size()), queries.data());
+	}
+	m_queries.clear();
+	m_pending.clear();
+	m_milliseconds.clear();
+	m_frames = nullptr;
+}
+
+void GpuTimer::collect() {
+	const uint32_t slot = m_frames->slot();
+	for (uint32_t scope = 0; scope < m_scopes; ++scope) {
+		m_milliseconds[scope] = 0.0;
+		if (!m_pending[slot][scope]) {
+			continue;
+		}
+		// the slot's fence has signalled, so both results are available
+		GLuint64 begin = 0;
+		GLuint64 end = 0;
+		glGetQueryObjectui64v(m_queries[slot][scope * 2], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(m_queries[slot][scope * 2 + 1], GL_QUERY_RESULT, &end);
+		m_milliseconds[scope] = end > begin ? static_cast<double>(end - begin) * 1e-6 : 0.0;
+		m_pending[slot][scope] = false;
+	}
+}
+
+void GpuTimer::begin(uint32_t scope) {
+	glQueryCounter(m_queries[m_frames->slot()][scope * 2], GL_TIMESTAMP);
+}
+
+void GpuTimer::end(uint32_t scope) {
+	const uint32_t slot = m_frames->slot();
+	glQueryCounter(m_queries[slot][scope * 2 + 1], GL_TIMESTAMP);
+	m_pending[slot][scope] = true;
+}
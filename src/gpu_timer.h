@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class FrameController;
+
+// Measures how long the gpu spends on parts of a frame with timestamp queries.
+// Every frame slot has its own queries, read back once the slot comes around
+// again and its fence has signalled, so reading never stalls the cpu. Times
+// therefore describe the frame framesInFlight() frames ago.
+class GpuTimer {
+    const FrameController *m_frames = nullptr;
+    uint32_t m_scopes = 0;
+    // per slot, a begin and an end timestamp for every scope
+    std::vector<std::vector<uint32_t>> m_queries;
+    // per slot, the scopes that were ended since it was last read
+    std::vector<std::vector<bool>> m_pending;
+    std::vector<double> m_milliseconds;
+
+public:
+    void create(const FrameController &frames, uint32_t scopes);
+
+    void destroy();
+
+    // reads back what the current slot measured last time round, zero for
+    // scopes it did not measure. call after FrameController::beginFrame()
+    void collect();
+
+    void begin(uint32_t scope);
+
+    void end(uint32_t scope);
+
+    // gpu time between begin() and end() of the scope, from the last collect()
+    inline double milliseconds(uint32_t scope) const {
+        return m_milliseconds[scope];
+    }
+};
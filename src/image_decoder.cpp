@@ -0,0 +1,14 @@
+#include "image_decoder.h"
+
+#include "jpeg_decoder.h"
+#include "png_decoder.h"
+
+std::unique_ptr<ImageDecoder> ImageDecoder::create(const uint8_t *data, size_t size) {
+	if (PngDecoder::matches(data, size)) {
+		return std::make_unique<PngDecoder>(data, size);
+	}
+	if (JpegDecoder::matches(data, size)) {
+		return std::make_unique<JpegDecoder>(data, size);
+	}
+	return nullptr;
+}
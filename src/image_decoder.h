@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+// largest image the decoders accept, against sizes that overflow or exhaust memory
+constexpr uint64_t MAX_IMAGE_PIXELS = uint64_t{1} << 28;
+
+// A file that is not an image the decoders understand
+class ImageError: public std::runtime_error {
+public:
+	ImageError(const std::string &message)
+		: std::runtime_error{message} {}
+};
+
+// Decodes one image to rgba8 in stages the job system can spread over
+// threads. parse() reads the headers. The serial tasks then undo whatever
+// depends on everything before it in the file (inflating and unfiltering a
+// png, entropy decoding a jpeg between restart markers) and may run in
+// parallel with each other. Last, row blocks turn that into rgba8 rows,
+// again independently of each other. Everything throws ImageError on
+// malformed data. The file's bytes must outlive the decoder.
+class ImageDecoder {
+protected:
+    const uint8_t *m_data;
+    size_t m_size;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+
+public:
+    ImageDecoder(const uint8_t *data, size_t size) : m_data{data}, m_size{size} {}
+
+    virtual ~ImageDecoder() = default;
+
+    virtual void parse() = 0;
+
+    virtual size_t serialTasks() const = 0;
+
+    virtual void runSerialTask(size_t task) = 0;
+
+    // rows each block converts, the last block may have fewer
+    virtual uint32_t rowBlockHeight() const = 0;
+
+    // writes the rows of block into pixels, which holds the whole image top row first
+    virtual void convertRows(uint32_t block, uint8_t *pixels) const = 0;
+
+    // drops what decoding needed once every row block is converted
+    virtual void release() = 0;
+
+    inline uint32_t width() const {
+        return m_width;
+    }
+
+    inline uint32_t height() const {
+        return m_height;
+    }
+
+    inline uint32_t rowBlocks() const {
+        return (m_height + rowBlockHeight() - 1) / rowBlockHeight();
+    }
+
+    // a png or jpeg decoder by the file's signature, or null for neither
+    static std::unique_ptr<ImageDecoder> create(const uint8_t *data, size_t size);
+};
@@ -0,0 +1,189 @@
+#include "image_loader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "spdlog/spdlog.h"
+
+#include "image_decoder.h"
+#include "jobs.h"
+#include "utils.h"
+
+namespace {
+
+	using Clock = std::chrono::steady_clock;
+
+	// rows of a mip level one job makes
+	constexpr uint32_t MIP_ROWS_PER_JOB = 32;
+
+	struct PendingImage {
+		std::vector<uint8_t> bytes;
+		std::unique_ptr<ImageDecoder> decoder;
+		MipChain chain;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::atomic<bool> failed{false};
+	};
+
+	// logs the first failure of an image, whichever job hits it
+	void fail(PendingImage &image, const std::filesystem::path &path, const char *reason) {
+		if (!image.failed.exchange(true)) {
+			spdlog::warn("Skipping image {}: {}", path.string(), reason);
+		}
+	}
+
+	double millisecondsSince(Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+}
+
+std::vector<std::filesystem::path> listImages(const std::filesystem::path &directory) {
+	std::vector<std::filesystem::path> paths;
+	std::error_code error;
+	for (const auto &entry : std::filesystem::directory_iterator{directory, error}) {
+		std::string extension = entry.path().extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		if (entry.is_regular_file() && (extension == ".png" || extension == ".jpg" || extension == ".jpeg")) {
+			paths.push_back(entry.path());
+		}
+	}
+	if (error) {
+		spdlog::warn("Failed to list images in {}: {}", directory.string(), error.message());
+	}
+	std::sort(paths.begin(), paths.end());
+	return paths;
+}
+
+std::vector<LoadedImage> loadImages(JobSystem &jobs, const std::vector<std::filesystem::path> &paths, MipFilter filter, ImageLoadStats &stats) {
+	const Clock::time_point start = Clock::now();
+	stats = ImageLoadStats{};
+	stats.files = paths.size();
+	std::vector<PendingImage> images(paths.size());
+
+	// one file per job: read it and parse its headers
+	jobs.parallelFor(images.size(), 1, [&](size_t begin, size_t end, uint32_t) {
+		for (size_t i = begin; i < end; ++i) {
+			PendingImage &image = images[i];
+			if (!utils::fileReadBytes(paths[i], image.bytes)) {
+				fail(image, paths[i], "cannot read the file");
+				continue;
+			}
+			image.decoder = ImageDecoder::create(image.bytes.data(), image.bytes.size());
+			if (image.decoder == nullptr) {
+				fail(image, paths[i], "not a png or jpeg");
+				continue;
+			}
+			try {
+				image.decoder->parse();
+			} catch (const ImageError &e) {
+				fail(image, paths[i], e.what());
+			}
+		}
+	});
+	for (const PendingImage &image : images) {
+		stats.fileBytes += image.bytes.size();
+	}
+	stats.readMs = millisecondsSince(start);
+
+	// every serial task of every image, then every row block
+	const Clock::time_point decodeStart = Clock::now();
+	std::vector<std::pair<uint32_t, uint32_t>> tasks;
+	for (uint32_t i = 0; i < images.size(); ++i) {
+		if (!images[i].failed) {
+			for (size_t task = 0; task < images[i].decoder->serialTasks(); ++task) {
+				tasks.emplace_back(i, static_cast<uint32_t>(task));
+			}
+		}
+	}
+	jobs.parallelFor(tasks.size(), 1, [&](size_t begin, size_t end, uint32_t) {
+		for (size_t t = begin; t < end; ++t) {
+			PendingImage &image = images[tasks[t].first];
+			if (image.failed) {
+				continue;
+			}
+			try {
+				image.decoder->runSerialTask(tasks[t].second);
+			} catch (const ImageError &e) {
+				fail(image, paths[tasks[t].first], e.what());
+			}
+		}
+	});
+
+	tasks.clear();
+	for (uint32_t i = 0; i < images.size(); ++i) {
+		PendingImage &image = images[i];
+		if (image.failed) {
+			continue;
+		}
+		image.width = image.decoder->width();
+		image.height = image.decoder->height();
+		image.chain.reserve(mipLevelCount(image.width, image.height));
+		image.chain.emplace_back(static_cast<size_t>(image.width) * image.height * 4);
+		for (uint32_t block = 0; block < image.decoder->rowBlocks(); ++block) {
+			tasks.emplace_back(i, block);
+		}
+	}
+	jobs.parallelFor(tasks.size(), 1, [&](size_t begin, size_t end, uint32_t) {
+		for (size_t t = begin; t < end; ++t) {
+			PendingImage &image = images[tasks[t].first];
+			image.decoder->convertRows(tasks[t].second, image.chain.front().data());
+		}
+	});
+	for (PendingImage &image : images) {
+		image.decoder.reset();
+		image.bytes = std::vector<uint8_t>{};
+		if (!image.failed) {
+			stats.decodedBytes += image.chain.front().size();
+		}
+	}
+	stats.decodeMs = millisecondsSince(decodeStart);
+
+	// each level needs the one above it, so levels go one after another, with every image's rows of a level at once
+	const Clock::time_point mipStart = Clock::now();
+	for (;;) {
+		tasks.clear();
+		for (uint32_t i = 0; i < images.size(); ++i) {
+			PendingImage &image = images[i];
+			if (image.failed || image.chain.size() == mipLevelCount(image.width, image.height)) {
+				continue;
+			}
+			const uint32_t level = static_cast<uint32_t>(image.chain.size());
+			const uint32_t rows = mipLevelSize(image.height, level);
+			image.chain.emplace_back(static_cast<size_t>(mipLevelSize(image.width, level)) * rows * 4);
+			for (uint32_t row = 0; row < rows; row += MIP_ROWS_PER_JOB) {
+				tasks.emplace_back(i, row);
+			}
+		}
+		if (tasks.empty()) {
+			break;
+		}
+		jobs.parallelFor(tasks.size(), 1, [&](size_t begin, size_t end, uint32_t) {
+			for (size_t t = begin; t < end; ++t) {
+				PendingImage &image = images[tasks[t].first];
+				const uint32_t level = static_cast<uint32_t>(image.chain.size() - 1);
+				const uint32_t rows = mipLevelSize(image.height, level);
+				downsampleRows(image.chain[level - 1].data(), mipLevelSize(image.width, level - 1), mipLevelSize(image.height, level - 1),
+				               image.chain[level].data(), tasks[t].second, std::min(tasks[t].second + MIP_ROWS_PER_JOB, rows), filter);
+			}
+		});
+	}
+	stats.mipMs = millisecondsSince(mipStart);
+
+	std::vector<LoadedImage> loaded;
+	for (size_t i = 0; i < images.size(); ++i) {
+		PendingImage &image = images[i];
+		if (image.failed) {
+			++stats.failed;
+			continue;
+		}
+		loaded.push_back(LoadedImage{paths[i], image.width, image.height, std::move(image.chain)});
+	}
+	stats.totalMs = millisecondsSince(start);
+	return loaded;
+}
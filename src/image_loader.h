@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "mipmaps.h"
+#include "texture_format.h"
+
+class JobSystem;
+
+// An image decoded from a file, with its full mip chain
+struct LoadedImage {
+    std::filesystem::path path;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    MipChain chain;
+};
+
+// What loading a batch of images took
+struct ImageLoadStats {
+    size_t files = 0;
+    size_t failed = 0;
+    // bytes read from the files, and rgba8 bytes of the largest levels they decode to
+    size_t fileBytes = 0;
+    size_t decodedBytes = 0;
+    // reading files and parsing their headers, decoding them, making their mips, and all of it
+    double readMs = 0.0;
+    double decodeMs = 0.0;
+    double mipMs = 0.0;
+    double totalMs = 0.0;
+
+    // decoded megabytes per second spent decoding
+    inline double decodeMegabytesPerSecond() const {
+        return decodeMs > 0.0 ? static_cast<double>(decodedBytes) / (decodeMs * 1000.0) : 0.0;
+    }
+};
+
+// png and jpeg files directly in directory, sorted by name
+std::vector<std::filesystem::path> listImages(const std::filesystem::path &directory);
+
+// Reads, decodes and mipmaps the files at paths on the job system. Every
+// stage is spread over the files and over parts of each file at once, so a
+// few large images keep all threads busy as well as many small ones: files
+// are read and parsed one per job, then each decoder's serial tasks run as
+// jobs of their own, then its row blocks, then the rows of each mip level,
+// a level at a time. Files that cannot be read or decoded are logged and
+// left out; the rest come back in the order of paths.
+std::vector<LoadedImage> loadImages(JobSystem &jobs, const std::vector<std::filesystem::path> &paths, MipFilter filter, ImageLoadStats &stats);
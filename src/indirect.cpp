@@ -0,0 +1,142 @@
+#include "indirect.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "texture.h"
+
+namespace {
+
+	// draws the streams start out with room for, grown on demand
+	constexpr uint32_t INITIAL_DRAWS = 1024;
+
+}
+
+void IndirectRenderer::create(FrameController &frames) {
+	m_commandStream.create(frames, INITIAL_DRAWS * sizeof(DrawElementsIndirectCommand));
+	m_drawDataStream.create(frames, INITIAL_DRAWS * sizeof(IndirectDrawData));
+
+	GLint alignment = 0;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	m_drawDataAlignment = std::max<size_t>(alignment, 16);
+
+	glGenBuffers(1, &m_drawIdBuffer);
+	reserveDrawIds(INITIAL_DRAWS);
+}
+
+void IndirectRenderer::destroy() {
+	m_commandStream.destroy();
+	m_drawDataStream.destroy();
+	glstate::deleteBuffer(m_drawIdBuffer);
+	m_drawIdBuffer = 0;
+	m_drawIdCapacity = 0;
+	m_variants.clear();
+	m_preparedVaos.clear();
+}
+
+void IndirectRenderer::setVariant(uint32_t program, uint32_t indirectProgram) {
+	m_variants[program] = indirectProgram;
+}
+
+void IndirectRenderer::reserveDrawIds(uint32_t count) {
+	if (count <= m_drawIdCapacity) {
+		return;
+	}
+	m_drawIdCapacity = std::max(count, m_drawIdCapacity * 2);
+	std::vector<uint32_t> ids(m_drawIdCapacity);
+	std::iota(ids.begin(), ids.end(), 0);
+
+	// same buffer name, so VAOs already pointing at it stay valid
+	glstate::bindBuffer(GL_ARRAY_BUFFER, m_drawIdBuffer);
+	glBufferData(GL_ARRAY_BUFFER, ids.size() * sizeof(uint32_t), ids.data(), GL_STATIC_DRAW);
+}
+
+void IndirectRenderer::prepareVao(uint32_t vao) {
+	if (!m_preparedVaos.insert(vao).second) {
+		return;
+	}
+	glstate::bindVertexArray(vao);
+	glstate::bindBuffer(GL_ARRAY_BUFFER, m_drawIdBuffer);
+	glVertexAttribIPointer(DRAW_ID_LOCATION, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void *)0);
+	glVertexAttribDivisor(DRAW_ID_LOCATION, 1);
+	glEnableVertexAttribArray(DRAW_ID_LOCATION);
+}
+
+void IndirectRenderer::submit(const RenderQueue &queue, FrameStats &stats) {
+	const uint32_t drawCount = static_cast<uint32_t>(queue.size());
+	if (drawCount == 0) {
+		return;
+	}
+
+	// build commands, draw data and buckets from the sorted queue
+	m_commands.clear();
+	m_drawData.clear();
+	m_buckets.clear();
+	// images in the array of their bucket are picked per draw, without a bind
+	const TextureSlot *image = nullptr;
+	for (uint32_t i = 0; i < drawCount; ++i) {
+		const DrawPacket &packet = queue.packet(i);
+		const uint32_t texture = packet.texture != nullptr ? packet.texture->texture->id() : 0;
+		if (m_buckets.empty() || m_buckets.back().program != packet.program || m_buckets.back().vao != packet.vao
+		    || m_buckets.back().texture != texture) {
+			m_buckets.push_back(Bucket{packet.program, packet.vao, texture, i, 0});
+		} else if (packet.texture != nullptr && image != nullptr && packet.texture != image && texture == image->texture->id()) {
+			++stats.textureBindsSaved;
+		}
+		if (packet.texture != nullptr) {
+			image = packet.texture;
+		}
+		++m_buckets.back().commandCount;
+		m_commands.push_back(DrawElementsIndirectCommand{packet.indexCount, 1, packet.firstIndex, 0, i});
+		const TextureSlot slot = packet.texture != nullptr ? *packet.texture : TextureSlot{};
+		m_drawData.push_back(IndirectDrawData{packet.model, slot.rect, slot.layer, {}});
+	}
+
+	// stream this frame's commands and draw data
+	reserveDrawIds(drawCount);
+	const size_t commandBytes = m_commands.size() * sizeof(DrawElementsIndirectCommand);
+	const size_t drawDataBytes = m_drawData.size() * sizeof(IndirectDrawData);
+	m_commandStream.beginFrame(commandBytes);
+	m_drawDataStream.beginFrame(drawDataBytes);
+	const size_t commandOffset = m_commandStream.write(m_commands.data(), commandBytes, sizeof(uint32_t));
+	const size_t drawDataOffset = m_drawDataStream.write(m_drawData.data(), drawDataBytes, m_drawDataAlignment);
+	m_commandStream.flush();
+	m_drawDataStream.flush();
+	glstate::bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandStream.id());
+	glstate::bindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, m_drawDataStream.id(), drawDataOffset, drawDataBytes);
+
+	uint32_t program = 0;
+	uint32_t vao = 0;
+	uint32_t texture = 0;
+	for (const Bucket &bucket : m_buckets) {
+		auto variant = m_variants.find(bucket.program);
+		if (variant == m_variants.end()) {
+			continue;
+		}
+
+		if (variant->second != program) {
+			program = variant->second;
+			glstate::useProgram(program);
+			++stats.programChanges;
+		}
+		if (bucket.vao != vao) {
+			vao = bucket.vao;
+			prepareVao(vao);
+			glstate::bindVertexArray(vao);
+			++stats.vaoChanges;
+		}
+		if (bucket.texture != 0 && bucket.texture != texture) {
+			texture = bucket.texture;
+			glstate::bindTexture(ALBEDO_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, texture);
+			++stats.textureChanges;
+		}
+
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+		                            (void *)(commandOffset + bucket.firstCommand * sizeof(DrawElementsIndirectCommand)),
+		                            bucket.commandCount, 0);
+		stats.draws += bucket.commandCount;
+		++stats.drawCalls;
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "render_queue.h"
+#include "stats.h"
+#include "stream_buffer.h"
+
+class FrameController;
+
+// Layout read by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t baseInstance;
+};
+
+// Per-draw data indirect.vs reads from a shader storage buffer, std430
+struct IndirectDrawData {
+    glm::mat4 model;
+    // where the albedo is in the array bound for the draw, see TextureSlot
+    glm::vec4 albedoRect;
+    uint32_t albedoLayer;
+    uint32_t padding[3];
+};
+
+// Submits a sorted render queue with one glMultiDrawElementsIndirect per run of
+// draws sharing a program, VAO and albedo array. Each draw's base instance is its index into
+// the draw data buffer; an instanced vertex attribute turns that into a draw id
+// in the shader, since gl_DrawID needs GL 4.6. Needs glext::support().multiDrawIndirect.
+class IndirectRenderer {
+    struct Bucket {
+        uint32_t program;
+        uint32_t vao;
+        uint32_t texture;
+        uint32_t firstCommand;
+        uint32_t commandCount;
+    };
+
+    // both written every frame
+    StreamBuffer m_commandStream;
+    StreamBuffer m_drawDataStream;
+    size_t m_drawDataAlignment = 16;
+
+    uint32_t m_drawIdBuffer = 0;
+    uint32_t m_drawIdCapacity = 0;
+
+    std::vector<DrawElementsIndirectCommand> m_commands;
+    std::vector<IndirectDrawData> m_drawData;
+    std::vector<Bucket> m_buckets;
+
+    // per-draw program name to the program built from indirect.vs
+    std::unordered_map<uint32_t, uint32_t> m_variants;
+    // VAOs that already source the draw id attribute
+    std::unordered_set<uint32_t> m_preparedVaos;
+
+    // grows the draw id buffer to hold at least count ids
+    void reserveDrawIds(uint32_t count);
+
+    // points attribute DRAW_ID_LOCATION of vao at the draw id buffer
+    void prepareVao(uint32_t vao);
+
+public:
+    // attribute location of the draw id in indirect.vs
+    static constexpr uint32_t DRAW_ID_LOCATION = 1;
+    // shader storage binding of the draw data in indirect.vs
+    static constexpr uint32_t DRAW_DATA_BINDING = 0;
+
+    void create(FrameController &frames);
+
+    void destroy();
+
+    // draws recorded with program are submitted with indirectProgram instead
+    void setVariant(uint32_t program, uint32_t indirectProgram);
+
+    // programs read view and projection from the Frame uniform block
+    void submit(const RenderQueue &queue, FrameStats &stats);
+};
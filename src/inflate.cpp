@@ -0,0 +1,330 @@
+#include "inflate.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+	// codes up to this long decode with one table lookup
+	constexpr uint32_t FAST_BITS = 10;
+	constexpr uint32_t MAX_CODE_BITS = 15;
+
+	// length and distance symbols: base values and extra bits, RFC 1951 3.2.5
+	constexpr uint16_t LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	                                      35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+	constexpr uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+	constexpr uint16_t DISTANCE_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	                                        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+	constexpr uint8_t DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+	// order code length code lengths are sent in
+	constexpr uint8_t CODE_LENGTH_ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+	// least significant bit first. reading past the end gives zeros, which
+	// overrun() reports once they are actually consumed
+	class BitReader {
+		const uint8_t *m_data;
+		const uint8_t *m_end;
+		uint64_t m_bits = 0;
+		uint32_t m_count = 0;
+		uint32_t m_padding = 0;
+
+	public:
+		BitReader(const uint8_t *data, const uint8_t *end) : m_data{data}, m_end{end} {}
+
+		inline void refill() {
+			while (m_count <= 56) {
+				if (m_data < m_end) {
+					m_bits |= static_cast<uint64_t>(*m_data++) << m_count;
+				} else {
+					++m_padding;
+				}
+				m_count += 8;
+			}
+		}
+
+		inline uint32_t peek(uint32_t count) {
+			if (m_count < count) {
+				refill();
+			}
+			return static_cast<uint32_t>(m_bits & ((uint64_t{1} << count) - 1));
+		}
+
+		inline void consume(uint32_t count) {
+			m_bits >>= count;
+			m_count -= count;
+		}
+
+		inline uint32_t read(uint32_t count) {
+			const uint32_t value = peek(count);
+			consume(count);
+			return value;
+		}
+
+		inline bool overrun() const {
+			return m_padding * 8 > m_count;
+		}
+
+		// drops bits up to the next byte boundary
+		inline void alignToByte() {
+			consume(m_count % 8);
+		}
+
+		// first byte not yet consumed, once the bits are byte aligned
+		inline const uint8_t *bytePosition() const {
+			return m_data - (m_count / 8 - std::min(m_padding, m_count / 8));
+		}
+
+		inline void seek(const uint8_t *position) {
+			m_data = position;
+			m_bits = 0;
+			m_count = 0;
+			m_padding = 0;
+		}
+
+		inline const uint8_t *end() const {
+			return m_end;
+		}
+	};
+
+	// canonical huffman code, with a table for the short codes
+	struct Huffman {
+		// symbol << 4 | length, or 0 for codes longer than FAST_BITS
+		uint16_t fast[1 << FAST_BITS];
+		uint16_t counts[MAX_CODE_BITS + 1];
+		uint16_t symbols[288];
+
+		bool build(const uint8_t *lengths, uint32_t count) {
+			std::memset(counts, 0, sizeof(counts));
+			for (uint32_t i = 0; i < count; ++i) {
+				++counts[lengths[i]];
+			}
+			counts[0] = 0;
+
+			// over-subscribed sets are malformed, incomplete ones are allowed
+			int left = 1;
+			uint16_t offsets[MAX_CODE_BITS + 2];
+			offsets[1] = 0;
+			for (uint32_t length = 1; length <= MAX_CODE_BITS; ++length) {
+				left = (left << 1) - counts[length];
+				if (left < 0) {
+					return false;
+				}
+				offsets[length + 1] = static_cast<uint16_t>(offsets[length] + counts[length]);
+			}
+
+			// first code of each length, RFC 1951 3.2.2
+			std::memset(fast, 0, sizeof(fast));
+			uint32_t codes[MAX_CODE_BITS + 1];
+			uint32_t code = 0;
+			for (uint32_t length = 1; length <= MAX_CODE_BITS; ++length) {
+				code = (code + counts[length - 1]) << 1;
+				codes[length] = code;
+			}
+			for (uint32_t symbol = 0; symbol < count; ++symbol) {
+				const uint32_t length = lengths[symbol];
+				if (length == 0) {
+					continue;
+				}
+				symbols[offsets[length]++] = static_cast<uint16_t>(symbol);
+				if (length <= FAST_BITS) {
+					// codes are sent most significant bit first, the table is indexed by stream order
+					uint32_t reversed = 0;
+					for (uint32_t bit = 0; bit < length; ++bit) {
+						reversed |= ((codes[length] >> bit) & 1) << (length - 1 - bit);
+					}
+					for (uint32_t index = reversed; index < (1u << FAST_BITS); index += 1u << length) {
+						fast[index] = static_cast<uint16_t>(symbol << 4 | length);
+					}
+				}
+				++codes[length];
+			}
+			return true;
+		}
+
+		// returns the symbol, or -1 for a code not in the set
+		inline int decode(BitReader &reader) const {
+			const uint16_t entry = fast[reader.peek(FAST_BITS)];
+			if (entry != 0) {
+				reader.consume(entry & 15);
+				return entry >> 4;
+			}
+
+			// one bit at a time past the table, RFC 1951 style
+			const uint32_t bits = reader.peek(MAX_CODE_BITS);
+			int code = 0;
+			int first = 0;
+			int index = 0;
+			for (uint32_t length = 1; length <= MAX_CODE_BITS; ++length) {
+				code |= (bits >> (length - 1)) & 1;
+				const int count = counts[length];
+				if (code - count < first) {
+					reader.consume(length);
+					return symbols[index + (code - first)];
+				}
+				index += count;
+				first += count;
+				first <<= 1;
+				code <<= 1;
+			}
+			return -1;
+		}
+	};
+
+	bool inflateBlock(BitReader &reader, const Huffman &lengths, const Huffman &distances, std::vector<uint8_t> &out, size_t maxSize) {
+		for (;;) {
+			int symbol = lengths.decode(reader);
+			if (symbol < 0 || reader.overrun()) {
+				return false;
+			}
+			if (symbol < 256) {
+				if (out.size() >= maxSize) {
+					return false;
+				}
+				out.push_back(static_cast<uint8_t>(symbol));
+				continue;
+			}
+			if (symbol == 256) {
+				return true;
+			}
+
+			symbol -= 257;
+			if (symbol >= 29) {
+				return false;
+			}
+			const uint32_t length = LENGTH_BASE[symbol] + reader.read(LENGTH_EXTRA[symbol]);
+			const int distanceSymbol = distances.decode(reader);
+			if (distanceSymbol < 0 || distanceSymbol >= 30) {
+				return false;
+			}
+			const size_t distance = DISTANCE_BASE[distanceSymbol] + reader.read(DISTANCE_EXTRA[distanceSymbol]);
+			if (distance > out.size() || length > maxSize - std::min(out.size(), maxSize)) {
+				return false;
+			}
+
+			// copies may overlap what they write, byte by byte keeps runs right
+			const size_t start = out.size();
+			out.resize(start + length);
+			uint8_t *target = out.data() + start;
+			const uint8_t *source = target - distance;
+			if (distance >= length) {
+				std::memcpy(target, source, length);
+			} else {
+				for (uint32_t i = 0; i < length; ++i) {
+					target[i] = source[i];
+				}
+			}
+		}
+	}
+
+	bool readDynamicCodes(BitReader &reader, Huffman &lengths, Huffman &distances) {
+		const uint32_t literalCount = reader.read(5) + 257;
+		const uint32_t distanceCount = reader.read(5) + 1;
+		const uint32_t codeLengthCount = reader.read(4) + 4;
+		if (literalCount > 286 || distanceCount > 30) {
+			return false;
+		}
+
+		uint8_t codeLengthLengths[19] = {};
+		for (uint32_t i = 0; i < codeLengthCount; ++i) {
+			codeLengthLengths[CODE_LENGTH_ORDER[i]] = static_cast<uint8_t>(reader.read(3));
+		}
+		Huffman codeLengths;
+		if (!codeLengths.build(codeLengthLengths, 19)) {
+			return false;
+		}
+
+		// literal and distance lengths form one sequence that repeats may span
+		uint8_t codeLengthsRead[286 + 30] = {};
+		uint32_t count = 0;
+		while (count < literalCount + distanceCount) {
+			const int symbol = codeLengths.decode(reader);
+			if (symbol < 0) {
+				return false;
+			}
+			if (symbol < 16) {
+				codeLengthsRead[count++] = static_cast<uint8_t>(symbol);
+				continue;
+			}
+			uint8_t value = 0;
+			uint32_t repeat = 0;
+			if (symbol == 16) {
+				if (count == 0) {
+					return false;
+				}
+				value = codeLengthsRead[count - 1];
+				repeat = 3 + reader.read(2);
+			} else if (symbol == 17) {
+				repeat = 3 + reader.read(3);
+			} else {
+				repeat = 11 + reader.read(7);
+			}
+			if (count + repeat > literalCount + distanceCount) {
+				return false;
+			}
+			std::fill(codeLengthsRead + count, codeLengthsRead + count + repeat, value);
+			count += repeat;
+		}
+		if (codeLengthsRead[256] == 0) {
+			return false;
+		}
+		return lengths.build(codeLengthsRead, literalCount) && distances.build(codeLengthsRead + literalCount, distanceCount);
+	}
+
+}
+
+bool zlibDecompress(const uint8_t *data, size_t size, std::vector<uint8_t> &out, size_t maxSize) {
+	// deflate with a window of at most 32K and no preset dictionary
+	if (size < 2 || (data[0] & 15) != 8 || (data[0] >> 4) > 7 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20) != 0) {
+		return false;
+	}
+
+	BitReader reader{data + 2, data + size};
+	Huffman lengths;
+	Huffman distances;
+	Huffman fixedLengths;
+	Huffman fixedDistances;
+	bool fixedBuilt = false;
+	bool last = false;
+	while (!last) {
+		last = reader.read(1) != 0;
+		const uint32_t type = reader.read(2);
+		if (type == 0) {
+			// stored: byte aligned length, its complement, then raw bytes
+			reader.alignToByte();
+			const uint8_t *position = reader.bytePosition();
+			if (reader.end() - position < 4) {
+				return false;
+			}
+			const uint32_t length = position[0] | position[1] << 8;
+			const uint32_t complement = position[2] | position[3] << 8;
+			if ((length ^ 0xffff) != complement || static_cast<size_t>(reader.end() - position - 4) < length
+			    || length > maxSize - std::min(out.size(), maxSize)) {
+				return false;
+			}
+			out.insert(out.end(), position + 4, position + 4 + length);
+			reader.seek(position + 4 + length);
+		} else if (type == 1) {
+			if (!fixedBuilt) {
+				uint8_t fixed[288];
+				std::fill(fixed, fixed + 144, 8);
+				std::fill(fixed + 144, fixed + 256, 9);
+				std::fill(fixed + 256, fixed + 280, 7);
+				std::fill(fixed + 280, fixed + 288, 8);
+				fixedLengths.build(fixed, 288);
+				std::fill(fixed, fixed + 30, 5);
+				fixedDistances.build(fixed, 30);
+				fixedBuilt = true;
+			}
+			if (!inflateBlock(reader, fixedLengths, fixedDistances, out, maxSize)) {
+				return false;
+			}
+		} else if (type == 2) {
+			if (!readDynamicCodes(reader, lengths, distances) || !inflateBlock(reader, lengths, distances, out, maxSize)) {
+				return false;
+			}
+		} else {
+			return false;
+		}
+	}
+	return !reader.overrun();
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Decompresses a zlib stream (RFC 1950 around RFC 1951 deflate data) and
+// appends the result to out. Preset dictionaries are not supported and the
+// checksum is not verified. Returns false on malformed data, and as soon as
+// out would grow past maxSize bytes, so a small corrupt stream cannot expand
+// to far more than the caller expects.
+bool zlibDecompress(const uint8_t *data, size_t size, std::vector<uint8_t> &out, size_t maxSize);
@@ -0,0 +1,95 @@
+#include "jobs.h"
+
+#include <algorithm>
+
+#include "spdlog/spdlog.h"
+
+JobSystem::JobSystem(uint32_t workerCount) {
+    if (workerCount == 0) {
+        uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+    }
+
+    spdlog::debug("Starting job system with {} worker threads", workerCount);
+    m_workers.reserve(workerCount);
+    // the dispatching thread always runs as thread 0
+    for (uint32_t i = 0; i < workerCount; ++i) {
+        m_workers.emplace_back(&JobSystem::workerLoop, this, i + 1);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    for (std::thread &worker : m_workers) {
+        worker.join();
+    }
+}
+
+void JobSystem::parallelFor(size_t count, size_t chunkSize, const RangeJob &job) {
+    if (count == 0) {
+        return;
+    }
+    chunkSize = std::max<size_t>(chunkSize, 1);
+    const size_t chunks = (count + chunkSize - 1) / chunkSize;
+
+    // not worth waking anyone for a single chunk
+    if (chunks == 1 || m_workers.empty()) {
+        job(0, count, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = &job;
+        m_count = count;
+        m_chunkSize = chunkSize;
+        m_nextChunk.store(0, std::memory_order_relaxed);
+        m_busyWorkers = static_cast<uint32_t>(m_workers.size());
+        ++m_generation;
+    }
+    m_wake.notify_all();
+
+    runChunks(0);
+
+    // workers must be done touching the job before it goes out of scope
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_busyWorkers == 0; });
+    m_job = nullptr;
+}
+
+void JobSystem::workerLoop(uint32_t threadIndex) {
+    uint64_t seenGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_quit || m_generation != seenGeneration; });
+            if (m_quit) {
+                return;
+            }
+            seenGeneration = m_generation;
+        }
+
+        runChunks(threadIndex);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_busyWorkers == 0) {
+            m_done.notify_one();
+        }
+    }
+}
+
+void JobSystem::runChunks(uint32_t threadIndex) {
+    while (true) {
+        size_t chunk = m_nextChunk.fetch_add(1, std::memory_order_relaxed);
+        size_t begin = chunk * m_chunkSize;
+        if (begin >= m_count) {
+            return;
+        }
+        size_t end = std::min(begin + m_chunkSize, m_count);
+        (*m_job)(begin, end, threadIndex);
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed pool of worker threads that split data-parallel loops between them.
+// Only one thread may dispatch work at a time; the dispatching thread takes
+// part in the loop so no core sits idle while it waits.
+class JobSystem {
+public:
+    // job(begin, end, threadIndex) where threadIndex < threadCount()
+    using RangeJob = std::function<void(size_t, size_t, uint32_t)>;
+
+    // workerCount of 0 picks one worker per remaining hardware thread
+    explicit JobSystem(uint32_t workerCount = 0);
+
+    ~JobSystem();
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    // number of threads that can run jobs, including the dispatching thread
+    inline uint32_t threadCount() const {
+        return static_cast<uint32_t>(m_workers.size()) + 1;
+    }
+
+    // runs job over [0, count) in chunks of chunkSize and blocks until done
+    void parallelFor(size_t count, size_t chunkSize, const RangeJob &job);
+
+private:
+    void workerLoop(uint32_t threadIndex);
+
+    // grabs chunks of the current loop until none are left
+    void runChunks(uint32_t threadIndex);
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+
+    // current loop, guarded by m_mutex when published
+    const RangeJob *m_job = nullptr;
+    size_t m_count = 0;
+    size_t m_chunkSize = 1;
+    uint64_t m_generation = 0;
+    bool m_quit = false;
+
+    std::atomic<size_t> m_nextChunk{0};
+    uint32_t m_busyWorkers = 0;
+};
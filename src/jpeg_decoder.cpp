@@ -0,0 +1,535 @@
+#include "jpeg_decoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "float4.h"
+
+namespace {
+
+	// natural order index of each coefficient in zigzag order
+	constexpr uint8_t ZIGZAG[64] = {
+		0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+		12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+		35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+		58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+	};
+
+	constexpr uint32_t FAST_BITS = 9;
+
+	// markers, after their 0xff
+	constexpr uint8_t SOI = 0xd8;
+	constexpr uint8_t EOI = 0xd9;
+	constexpr uint8_t SOF0 = 0xc0;
+	constexpr uint8_t SOF1 = 0xc1;
+	constexpr uint8_t DHT = 0xc4;
+	constexpr uint8_t DQT = 0xdb;
+	constexpr uint8_t DRI = 0xdd;
+	constexpr uint8_t SOS = 0xda;
+	constexpr uint8_t RST0 = 0xd0;
+	constexpr uint8_t RST7 = 0xd7;
+	constexpr uint8_t APP14 = 0xee;
+
+	inline uint32_t readBigEndian16(const uint8_t *p) {
+		return static_cast<uint32_t>(p[0]) << 8 | p[1];
+	}
+
+	// basis[u][x] = c(u) / 2 * cos((2x + 1) u pi / 16), with c(0) = 1 / sqrt(2)
+	struct IdctBasis {
+		alignas(16) float basis[8][8];
+
+		IdctBasis() {
+			for (int u = 0; u < 8; ++u) {
+				const float scale = u == 0 ? 0.5f / std::sqrt(2.0f) : 0.5f;
+				for (int x = 0; x < 8; ++x) {
+					basis[u][x] = scale * std::cos(static_cast<float>((2 * x + 1) * u) * 3.14159265f / 16.0f);
+				}
+			}
+		}
+	};
+
+	const IdctBasis IDCT;
+
+	// inverse DCT of a block into 8 rows of 8 samples
+	void inverseDct(const int16_t *coefficients, const uint16_t *quant, uint8_t *out, size_t stride) {
+		bool acZero = true;
+		for (int i = 1; i < 64 && acZero; ++i) {
+			acZero = coefficients[i] == 0;
+		}
+		// flat blocks are common, and all their samples are the average
+		if (acZero) {
+			const float average = static_cast<float>(coefficients[0]) * quant[0] / 8.0f + 128.0f;
+			const uint8_t value = static_cast<uint8_t>(std::clamp(average + 0.5f, 0.0f, 255.0f));
+			for (int y = 0; y < 8; ++y) {
+				std::memset(out + y * stride, value, 8);
+			}
+			return;
+		}
+
+		// rows of the vertical frequencies first, then the columns, four samples a lane
+		Float4 rows[8][2];
+		for (int v = 0; v < 8; ++v) {
+			Float4 left = Float4::splat(0.0f);
+			Float4 right = Float4::splat(0.0f);
+			for (int u = 0; u < 8; ++u) {
+				if (coefficients[v * 8 + u] != 0) {
+					const Float4 scale = Float4::splat(static_cast<float>(coefficients[v * 8 + u]) * quant[v * 8 + u]);
+					left = left + scale * Float4::load(IDCT.basis[u]);
+					right = right + scale * Float4::load(IDCT.basis[u] + 4);
+				}
+			}
+			rows[v][0] = left;
+			rows[v][1] = right;
+		}
+
+		const Float4 bias = Float4::splat(128.5f);
+		const Float4 lowest = Float4::splat(0.0f);
+		const Float4 highest = Float4::splat(255.0f);
+		alignas(16) float samples[8];
+		for (int y = 0; y < 8; ++y) {
+			Float4 left = bias;
+			Float4 right = bias;
+			for (int v = 0; v < 8; ++v) {
+				const Float4 scale = Float4::splat(IDCT.basis[v][y]);
+				left = left + scale * rows[v][0];
+				right = right + scale * rows[v][1];
+			}
+			min(max(left, lowest), highest).store(samples);
+			min(max(right, lowest), highest).store(samples + 4);
+			for (int x = 0; x < 8; ++x) {
+				out[y * stride + x] = static_cast<uint8_t>(samples[x]);
+			}
+		}
+	}
+
+}
+
+// most significant bit first over one restart interval, with stuffed zero
+// bytes dropped. reading past the end gives zeros
+class JpegDecoder::BitReader {
+	const uint8_t *m_data;
+	const uint8_t *m_end;
+	uint64_t m_bits = 0;
+	uint32_t m_count = 0;
+
+	inline void refill() {
+		while (m_count <= 56) {
+			uint64_t byte = 0;
+			if (m_data < m_end) {
+				byte = *m_data++;
+				if (byte == 0xff && m_data < m_end && *m_data == 0) {
+					++m_data;
+				}
+			}
+			m_bits |= byte << (56 - m_count);
+			m_count += 8;
+		}
+	}
+
+public:
+	BitReader(const uint8_t *data, const uint8_t *end) : m_data{data}, m_end{end} {}
+
+	inline uint32_t peek(uint32_t count) {
+		if (m_count < count) {
+			refill();
+		}
+		return static_cast<uint32_t>(m_bits >> (64 - count));
+	}
+
+	inline void consume(uint32_t count) {
+		m_bits <<= count;
+		m_count -= count;
+	}
+
+	// count bits as a signed value, JPEG's EXTEND
+	inline int receive(uint32_t count) {
+		if (count == 0) {
+			return 0;
+		}
+		const int value = static_cast<int>(peek(count));
+		consume(count);
+		return value < (1 << (count - 1)) ? value - (1 << count) + 1 : value;
+	}
+
+	inline uint32_t decode(const Huffman &table) {
+		const uint32_t bits = peek(16);
+		const uint16_t entry = table.fast[bits >> (16 - FAST_BITS)];
+		if (entry != 0) {
+			consume(entry >> 8);
+			return entry & 0xff;
+		}
+		for (uint32_t length = FAST_BITS + 1; length <= 16; ++length) {
+			const int32_t code = static_cast<int32_t>(bits >> (16 - length));
+			if (code <= table.maxCode[length]) {
+				consume(length);
+				return table.values[code + table.valueOffset[length]];
+			}
+		}
+		throw ImageError{"jpeg has a huffman code not in its table"};
+	}
+};
+
+void JpegDecoder::Huffman::build(const uint8_t *counts, const uint8_t *codeValues) {
+	std::memset(fast, 0, sizeof(fast));
+	int32_t code = 0;
+	int32_t index = 0;
+	for (uint32_t length = 1; length <= 16; ++length) {
+		const int32_t count = counts[length - 1];
+		valueOffset[length] = index - code;
+		if (index + count > 256 || code + count > (1 << length)) {
+			throw ImageError{"jpeg huffman table is malformed"};
+		}
+		for (int32_t i = 0; i < count; ++i, ++code, ++index) {
+			values[index] = codeValues[index];
+			if (length <= FAST_BITS) {
+				const uint32_t first = static_cast<uint32_t>(code) << (FAST_BITS - length);
+				for (uint32_t fill = 0; fill < (1u << (FAST_BITS - length)); ++fill) {
+					fast[first + fill] = static_cast<uint16_t>(length << 8 | codeValues[index]);
+				}
+			}
+		}
+		maxCode[length] = count > 0 ? code - 1 : -1;
+		code <<= 1;
+	}
+	defined = true;
+}
+
+bool JpegDecoder::matches(const uint8_t *data, size_t size) {
+	return size >= 3 && data[0] == 0xff && data[1] == SOI && data[2] == 0xff;
+}
+
+void JpegDecoder::parse() {
+	if (!matches(m_data, m_size)) {
+		throw ImageError{"not a jpeg"};
+	}
+
+	size_t offset = 2;
+	for (;;) {
+		if (offset >= m_size || m_data[offset] != 0xff) {
+			throw ImageError{"jpeg ends before its image data"};
+		}
+		// fill bytes may pad before any marker
+		while (offset < m_size && m_data[offset] == 0xff) {
+			++offset;
+		}
+		if (offset >= m_size) {
+			throw ImageError{"jpeg ends before its image data"};
+		}
+		const uint8_t marker = m_data[offset++];
+		if (marker == EOI) {
+			throw ImageError{"jpeg has no image data"};
+		}
+		if ((marker >= RST0 && marker <= RST7) || marker == 0x01) {
+			continue;
+		}
+		if (m_size - offset < 2) {
+			throw ImageError{"jpeg ends inside a marker"};
+		}
+		const size_t length = readBigEndian16(m_data + offset);
+		if (length < 2 || length > m_size - offset) {
+			throw ImageError{"jpeg segment runs past the end of the file"};
+		}
+		const uint8_t *segment = m_data + offset + 2;
+		offset += length;
+
+		if (marker == SOF0 || marker == SOF1) {
+			readFrame(segment, length - 2);
+		} else if (marker == DHT) {
+			readHuffmanTables(segment, length - 2);
+		} else if (marker == DQT) {
+			readQuantTables(segment, length - 2);
+		} else if (marker == DRI) {
+			if (length != 4) {
+				throw ImageError{"jpeg restart interval has the wrong size"};
+			}
+			m_restartInterval = readBigEndian16(segment);
+		} else if (marker == APP14 && length >= 14 && std::memcmp(segment, "Adobe", 5) == 0) {
+			// transform 0 means the components are not YCbCr
+			m_rgb = segment[11] == 0;
+		} else if (marker == SOS) {
+			readScan(segment, length - 2, offset);
+			return;
+		} else if ((marker & 0xf0) == 0xc0 && marker != 0xc8 && marker != 0xcc) {
+			// SOF2 and up, apart from the JPG and DAC markers that share the range
+			throw ImageError{"only baseline and extended sequential jpegs are supported"};
+		}
+	}
+}
+
+void JpegDecoder::readFrame(const uint8_t *segment, size_t length) {
+	if (!m_components.empty()) {
+		throw ImageError{"jpeg has more than one frame"};
+	}
+	if (length < 6 || segment[0] != 8) {
+		throw ImageError{"only 8 bit jpegs are supported"};
+	}
+	m_height = readBigEndian16(segment + 1);
+	m_width = readBigEndian16(segment + 3);
+	const uint32_t count = segment[5];
+	if (m_width == 0 || m_height == 0 || static_cast<uint64_t>(m_width) * m_height > MAX_IMAGE_PIXELS) {
+		throw ImageError{"jpeg size is out of range"};
+	}
+	if ((count != 1 && count != 3) || length < 6 + count * 3) {
+		throw ImageError{"only gray and YCbCr jpegs are supported"};
+	}
+
+	m_components.resize(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		Component &component = m_components[i];
+		const uint8_t *entry = segment + 6 + i * 3;
+		component.id = entry[0];
+		component.h = entry[1] >> 4;
+		component.v = entry[1] & 15;
+		component.quantTable = entry[2];
+		if (component.h < 1 || component.h > 4 || component.v < 1 || component.v > 4 || component.quantTable > 3) {
+			throw ImageError{"jpeg component is malformed"};
+		}
+	}
+	if (count == 3 && m_components[0].id == 'R' && m_components[1].id == 'G' && m_components[2].id == 'B') {
+		m_rgb = true;
+	}
+	// a single component is never interleaved, so its MCU is one block whatever it declares
+	if (count == 1) {
+		m_components[0].h = 1;
+		m_components[0].v = 1;
+	}
+
+	m_maxH = 1;
+	m_maxV = 1;
+	for (const Component &component : m_components) {
+		m_maxH = std::max(m_maxH, component.h);
+		m_maxV = std::max(m_maxV, component.v);
+	}
+	m_mcusX = (m_width + 8 * m_maxH - 1) / (8 * m_maxH);
+	m_mcusY = (m_height + 8 * m_maxV - 1) / (8 * m_maxV);
+	for (Component &component : m_components) {
+		component.blocksPerLine = m_mcusX * component.h;
+		component.blocksPerColumn = m_mcusY * component.v;
+	}
+}
+
+void JpegDecoder::readHuffmanTables(const uint8_t *segment, size_t length) {
+	size_t offset = 0;
+	while (offset < length) {
+		if (length - offset < 17) {
+			throw ImageError{"jpeg huffman table is truncated"};
+		}
+		const uint8_t tableClass = segment[offset] >> 4;
+		const uint8_t index = segment[offset] & 15;
+		if (tableClass > 1 || index > 3) {
+			throw ImageError{"jpeg huffman table is malformed"};
+		}
+		const uint8_t *counts = segment + offset + 1;
+		size_t total = 0;
+		for (int i = 0; i < 16; ++i) {
+			total += counts[i];
+		}
+		if (total > 256 || length - offset - 17 < total) {
+			throw ImageError{"jpeg huffman table is truncated"};
+		}
+		Huffman &table = tableClass == 0 ? m_dcTables[index] : m_acTables[index];
+		table.build(counts, segment + offset + 17);
+		offset += 17 + total;
+	}
+}
+
+void JpegDecoder::readQuantTables(const uint8_t *segment, size_t length) {
+	size_t offset = 0;
+	while (offset < length) {
+		const uint8_t precision = segment[offset] >> 4;
+		const uint8_t index = segment[offset] & 15;
+		const size_t size = precision == 0 ? 64 : 128;
+		if (precision > 1 || index > 3 || length - offset - 1 < size) {
+			throw ImageError{"jpeg quantization table is malformed"};
+		}
+		const uint8_t *values = segment + offset + 1;
+		for (int i = 0; i < 64; ++i) {
+			m_quantTables[index][ZIGZAG[i]] = static_cast<uint16_t>(precision == 0 ? values[i] : readBigEndian16(values + i * 2));
+		}
+		offset += 1 + size;
+	}
+}
+
+void JpegDecoder::readScan(const uint8_t *segment, size_t length, size_t dataOffset) {
+	if (m_components.empty()) {
+		throw ImageError{"jpeg scan comes before its frame"};
+	}
+	if (length < 1 || segment[0] != m_components.size() || length < 4 + segment[0] * 2u) {
+		throw ImageError{"only jpegs with all components in one scan are supported"};
+	}
+	for (uint32_t i = 0; i < segment[0]; ++i) {
+		const uint8_t id = segment[1 + i * 2];
+		const uint8_t tables = segment[2 + i * 2];
+		auto component = std::find_if(m_components.begin(), m_components.end(), [id](const Component &c) { return c.id == id; });
+		if (component == m_components.end() || (tables >> 4) > 3 || (tables & 15) > 3) {
+			throw ImageError{"jpeg scan names an unknown component or table"};
+		}
+		component->dcTable = tables >> 4;
+		component->acTable = tables & 15;
+		if (!m_dcTables[component->dcTable].defined || !m_acTables[component->acTable].defined) {
+			throw ImageError{"jpeg scan uses a missing huffman table"};
+		}
+	}
+	for (Component &component : m_components) {
+		component.coefficients.assign(static_cast<size_t>(component.blocksPerLine) * component.blocksPerColumn * 64, 0);
+	}
+
+	// restart markers cut the data into intervals, anything else ends the scan
+	size_t start = dataOffset;
+	size_t offset = dataOffset;
+	for (;;) {
+		const void *found = offset < m_size ? std::memchr(m_data + offset, 0xff, m_size - offset) : nullptr;
+		if (found == nullptr) {
+			m_segments.emplace_back(start, m_size);
+			break;
+		}
+		offset = static_cast<size_t>(static_cast<const uint8_t *>(found) - m_data);
+		if (offset + 1 >= m_size) {
+			m_segments.emplace_back(start, offset);
+			break;
+		}
+		const uint8_t next = m_data[offset + 1];
+		if (next == 0 || next == 0xff) {
+			offset += next == 0 ? 2 : 1;
+		} else if (next >= RST0 && next <= RST7 && m_restartInterval > 0) {
+			m_segments.emplace_back(start, offset);
+			offset += 2;
+			start = offset;
+		} else {
+			m_segments.emplace_back(start, offset);
+			break;
+		}
+	}
+
+	// intervals past the last MCU are junk, missing ones stay flat gray
+	const size_t mcus = static_cast<size_t>(m_mcusX) * m_mcusY;
+	const size_t intervals = m_restartInterval > 0 ? (mcus + m_restartInterval - 1) / m_restartInterval : 1;
+	m_segments.resize(std::min(m_segments.size(), intervals));
+}
+
+void JpegDecoder::runSerialTask(size_t task) {
+	const size_t mcus = static_cast<size_t>(m_mcusX) * m_mcusY;
+	const size_t interval = m_restartInterval > 0 ? m_restartInterval : mcus;
+	const size_t first = task * interval;
+	const size_t last = std::min(first + interval, mcus);
+
+	BitReader reader{m_data + m_segments[task].first, m_data + m_segments[task].second};
+	int predictors[3] = {};
+	for (size_t mcu = first; mcu < last; ++mcu) {
+		const uint32_t mcuX = static_cast<uint32_t>(mcu % m_mcusX);
+		const uint32_t mcuY = static_cast<uint32_t>(mcu / m_mcusX);
+		for (size_t i = 0; i < m_components.size(); ++i) {
+			Component &component = m_components[i];
+			for (uint32_t y = 0; y < component.v; ++y) {
+				for (uint32_t x = 0; x < component.h; ++x) {
+					const size_t block = static_cast<size_t>(mcuY * component.v + y) * component.blocksPerLine + mcuX * component.h + x;
+					decodeBlock(reader, component, component.coefficients.data() + block * 64, predictors[i]);
+				}
+			}
+		}
+	}
+}
+
+void JpegDecoder::decodeBlock(BitReader &reader, const Component &component, int16_t *block, int &predictor) const {
+	const uint32_t dcLength = reader.decode(m_dcTables[component.dcTable]);
+	if (dcLength > 11) {
+		throw ImageError{"jpeg dc coefficient is out of range"};
+	}
+	predictor += reader.receive(dcLength);
+	block[0] = static_cast<int16_t>(predictor);
+
+	const Huffman &ac = m_acTables[component.acTable];
+	for (uint32_t k = 1; k < 64;) {
+		const uint32_t symbol = reader.decode(ac);
+		const uint32_t run = symbol >> 4;
+		const uint32_t size = symbol & 15;
+		if (size == 0) {
+			// end of block, or a run of 16 zeros
+			if (run != 15) {
+				break;
+			}
+			k += 16;
+			continue;
+		}
+		k += run;
+		if (k > 63 || size > 10) {
+			throw ImageError{"jpeg ac coefficients run past the end of a block"};
+		}
+		block[ZIGZAG[k++]] = static_cast<int16_t>(reader.receive(size));
+	}
+}
+
+void JpegDecoder::convertRows(uint32_t block, uint8_t *pixels) const {
+	// every component's rows of this MCU row, at their own resolution
+	uint8_t *planes[3] = {};
+	size_t strides[3] = {};
+	std::vector<uint8_t> storage;
+	size_t total = 0;
+	for (const Component &component : m_components) {
+		total += static_cast<size_t>(component.blocksPerLine) * 8 * component.v * 8;
+	}
+	storage.resize(total);
+	size_t offset = 0;
+	for (size_t i = 0; i < m_components.size(); ++i) {
+		const Component &component = m_components[i];
+		planes[i] = storage.data() + offset;
+		strides[i] = static_cast<size_t>(component.blocksPerLine) * 8;
+		offset += strides[i] * component.v * 8;
+		for (uint32_t y = 0; y < component.v; ++y) {
+			const size_t row = static_cast<size_t>(block * component.v + y) * component.blocksPerLine;
+			for (uint32_t x = 0; x < component.blocksPerLine; ++x) {
+				inverseDct(component.coefficients.data() + (row + x) * 64, m_quantTables[component.quantTable], planes[i] + y * 8 * strides[i] + x * 8, strides[i]);
+			}
+		}
+	}
+
+	const uint32_t firstRow = block * rowBlockHeight();
+	const uint32_t lastRow = std::min(firstRow + rowBlockHeight(), m_height);
+	for (uint32_t y = firstRow; y < lastRow; ++y) {
+		uint8_t *out = pixels + static_cast<size_t>(y) * m_width * 4;
+		const uint32_t localY = y - firstRow;
+		if (m_components.size() == 1) {
+			const uint8_t *gray = planes[0] + localY * strides[0];
+			for (uint32_t x = 0; x < m_width; ++x) {
+				out[x * 4] = out[x * 4 + 1] = out[x * 4 + 2] = gray[x];
+				out[x * 4 + 3] = 255;
+			}
+			continue;
+		}
+
+		const Component &cb = m_components[1];
+		const Component &cr = m_components[2];
+		const uint8_t *luma = planes[0] + localY * m_components[0].v / m_maxV * strides[0];
+		const uint8_t *blue = planes[1] + localY * cb.v / m_maxV * strides[1];
+		const uint8_t *red = planes[2] + localY * cr.v / m_maxV * strides[2];
+		const uint32_t lumaH = m_components[0].h;
+		if (m_rgb) {
+			for (uint32_t x = 0; x < m_width; ++x) {
+				out[x * 4] = luma[x * lumaH / m_maxH];
+				out[x * 4 + 1] = blue[x * cb.h / m_maxH];
+				out[x * 4 + 2] = red[x * cr.h / m_maxH];
+				out[x * 4 + 3] = 255;
+			}
+			continue;
+		}
+		for (uint32_t x = 0; x < m_width; ++x) {
+			// JFIF's conversion in 16.16 fixed point
+			const int l = luma[x * lumaH / m_maxH] << 16;
+			const int b = blue[x * cb.h / m_maxH] - 128;
+			const int r = red[x * cr.h / m_maxH] - 128;
+			const int half = 1 << 15;
+			out[x * 4] = static_cast<uint8_t>(std::clamp((l + 91881 * r + half) >> 16, 0, 255));
+			out[x * 4 + 1] = static_cast<uint8_t>(std::clamp((l - 22554 * b - 46802 * r + half) >> 16, 0, 255));
+			out[x * 4 + 2] = static_cast<uint8_t>(std::clamp((l + 116130 * b + half) >> 16, 0, 255));
+			out[x * 4 + 3] = 255;
+		}
+	}
+}
+
+void JpegDecoder::release() {
+	for (Component &component : m_components) {
+		component.coefficients = std::vector<int16_t>{};
+	}
+	m_segments.clear();
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "image_decoder.h"
+
+// Baseline and extended sequential huffman JPEGs with one or three
+// components in a single scan, at any chroma subsampling. Entropy decoding
+// is serial only up to the next restart marker, so each restart interval is
+// a serial task of its own and files written with restart markers decode on
+// as many threads as they have intervals. Row blocks are rows of MCUs: an
+// inverse DCT of each block, nearest neighbour chroma upsampling and
+// YCbCr to rgb. Progressive, arithmetic coded and lossless files are not
+// supported.
+class JpegDecoder: public ImageDecoder {
+    struct Huffman {
+        // (length << 8 | value) for codes of up to 9 bits, by the next 9 bits of the stream
+        uint16_t fast[1 << 9];
+        // last code of each length, -1 for none, and what to add to a code for its value's index
+        int32_t maxCode[17];
+        int32_t valueOffset[17];
+        uint8_t values[256];
+        bool defined = false;
+
+        // from the number of codes of each length 1 to 16 and the values in code order
+        void build(const uint8_t *counts, const uint8_t *codeValues);
+    };
+
+    struct Component {
+        uint8_t id = 0;
+        // sampling factors, in blocks per MCU
+        uint32_t h = 1;
+        uint32_t v = 1;
+        uint32_t quantTable = 0;
+        uint32_t dcTable = 0;
+        uint32_t acTable = 0;
+        // the block grid, padded to whole MCUs
+        uint32_t blocksPerLine = 0;
+        uint32_t blocksPerColumn = 0;
+        // quantized coefficients of every block in natural order
+        std::vector<int16_t> coefficients;
+    };
+
+    class BitReader;
+
+    uint16_t m_quantTables[4][64] = {};
+    Huffman m_dcTables[4];
+    Huffman m_acTables[4];
+    std::vector<Component> m_components;
+    uint32_t m_maxH = 1;
+    uint32_t m_maxV = 1;
+    uint32_t m_mcusX = 0;
+    uint32_t m_mcusY = 0;
+    uint32_t m_restartInterval = 0;
+    // three components stored as rgb, by an Adobe marker or their ids, rather than YCbCr
+    bool m_rgb = false;
+    // entropy coded data between restart markers, as offsets into the file
+    std::vector<std::pair<size_t, size_t>> m_segments;
+
+    void readFrame(const uint8_t *segment, size_t length);
+    void readHuffmanTables(const uint8_t *segment, size_t length);
+    void readQuantTables(const uint8_t *segment, size_t length);
+    // splits the entropy coded data from dataOffset on into restart intervals
+    void readScan(const uint8_t *segment, size_t length, size_t dataOffset);
+
+    void decodeBlock(BitReader &reader, const Component &component, int16_t *block, int &predictor) const;
+
+public:
+    using ImageDecoder::ImageDecoder;
+
+    void parse() override;
+
+    inline size_t serialTasks() const override {
+        return m_segments.size();
+    }
+
+    void runSerialTask(size_t task) override;
+
+    inline uint32_t rowBlockHeight() const override {
+        return 8 * m_maxV;
+    }
+
+    void convertRows(uint32_t block, uint8_t *pixels) const override;
+
+    void release() override;
+
+    // whether data starts with a start of image marker
+    static bool matches(const uint8_t *data, size_t size);
+};
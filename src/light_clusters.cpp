@@ -0,0 +1,194 @@
+#include "light_clusters.h"
+
+#include <cmath>
+#include <limits>
+
+#include "camera.h"
+#include "float4.h"
+#include "jobs.h"
+
+namespace {
+
+	constexpr float INF = std::numeric_limits<float>::infinity();
+
+	// view space box a cluster, or a row or slice of them, covers
+	struct Box {
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	// calls accept(packet, mask) for each packet in packets with lights whose
+	// spheres touch box, the mask having a bit set for every such lane
+	template <typename Packet, typename Accept>
+	void overlapping(const std::vector<Packet> &packets, const Box &box, Accept accept) {
+		const Float4 zero = Float4::splat(0.0f);
+		const Float4 minX = Float4::splat(box.min.x), maxX = Float4::splat(box.max.x);
+		const Float4 minY = Float4::splat(box.min.y), maxY = Float4::splat(box.max.y);
+		const Float4 minZ = Float4::splat(box.min.z), maxZ = Float4::splat(box.max.z);
+		for (const Packet &packet : packets) {
+			const Float4 x = Float4::load(packet.x);
+			const Float4 y = Float4::load(packet.y);
+			const Float4 z = Float4::load(packet.z);
+			const Float4 radius = Float4::load(packet.radius);
+
+			// distance from each center to the box along each axis, zero inside it
+			const Float4 dx = max(max(minX - x, x - maxX), zero);
+			const Float4 dy = max(max(minY - y, y - maxY), zero);
+			const Float4 dz = max(max(minZ - z, z - maxZ), zero);
+			const uint32_t mask = bits(dx * dx + dy * dy + dz * dz <= radius * radius);
+			if (mask != 0) {
+				accept(packet, mask);
+			}
+		}
+	}
+
+	// view space extent of the ndc range [from, to] along one axis between two view depths
+	inline void extent(float from, float to, float scale, float nearDepth, float farDepth, bool perspective, float &min, float &max) {
+		if (!perspective) {
+			min = from / scale;
+			max = to / scale;
+			return;
+		}
+		min = std::min(from * nearDepth, from * farDepth) / scale;
+		max = std::max(to * nearDepth, to * farDepth) / scale;
+	}
+
+}
+
+void LightClusters::PacketList::clear() {
+	packets.clear();
+	count = 0;
+}
+
+void LightClusters::PacketList::append(const LightPacket &from, uint32_t lane) {
+	const size_t slot = count % 4;
+	if (slot == 0) {
+		LightPacket empty;
+		for (int i = 0; i < 4; ++i) {
+			empty.x[i] = empty.y[i] = empty.z[i] = INF;
+			empty.radius[i] = 0.0f;
+			empty.lights[i] = 0;
+		}
+		packets.push_back(empty);
+	}
+	LightPacket &to = packets.back();
+	to.x[slot] = from.x[lane];
+	to.y[slot] = from.y[lane];
+	to.z[slot] = from.z[lane];
+	to.radius[slot] = from.radius[lane];
+	to.lights[slot] = from.lights[lane];
+	++count;
+}
+
+glm::vec2 LightClusters::depthScaleBias(float nearPlane, float farPlane) {
+	const float scale = static_cast<float>(CLUSTER_SLICES) / std::log(farPlane / nearPlane);
+	return glm::vec2{scale, -std::log(nearPlane) * scale};
+}
+
+void LightClusters::assign(JobSystem &jobs, const Camera &camera, const std::vector<PointLight> &lights) {
+	// lights to view space, four to a packet
+	const glm::mat4 &view = camera.view();
+	m_lights.clear();
+	for (uint32_t light = 0; light < lights.size(); ++light) {
+		const glm::vec3 center{view * glm::vec4{lights[light].position, 1.0f}};
+		LightPacket single;
+		single.x[0] = center.x;
+		single.y[0] = center.y;
+		single.z[0] = center.z;
+		single.radius[0] = lights[light].radius;
+		single.lights[0] = light;
+		m_lights.append(single, 0);
+	}
+
+	m_slices.resize(CLUSTER_SLICES);
+	jobs.parallelFor(CLUSTER_SLICES, 1, [&](size_t begin, size_t end, uint32_t) {
+		for (size_t slice = begin; slice < end; ++slice) {
+			assignSlice(static_cast<uint32_t>(slice), camera);
+		}
+	});
+
+	// offsets and counts first, then every slice's indices in order
+	size_t total = 0;
+	for (const Slice &slice : m_slices) {
+		total += slice.indices.size();
+	}
+	m_data.resize(CLUSTER_COUNT * 2 + total);
+	uint32_t offset = CLUSTER_COUNT * 2;
+	for (uint32_t slice = 0; slice < CLUSTER_SLICES; ++slice) {
+		const Slice &assigned = m_slices[slice];
+		std::copy(assigned.indices.begin(), assigned.indices.end(), m_data.begin() + offset);
+		for (uint32_t tile = 0; tile < CLUSTER_TILES_X * CLUSTER_TILES_Y; ++tile) {
+			const uint32_t cluster = slice * CLUSTER_TILES_X * CLUSTER_TILES_Y + tile;
+			m_data[cluster * 2] = offset;
+			m_data[cluster * 2 + 1] = assigned.counts[tile];
+			offset += assigned.counts[tile];
+		}
+	}
+}
+
+void LightClusters::assignSlice(uint32_t slice, const Camera &camera) {
+	Slice &out = m_slices[slice];
+	out.counts.assign(CLUSTER_TILES_X * CLUSTER_TILES_Y, 0);
+	out.indices.clear();
+	out.slice.clear();
+
+	const glm::mat4 &projection = camera.projection();
+	const bool perspective = projection[2][3] != 0.0f;
+	const float nearPlane = camera.nearPlane();
+	const float range = camera.farPlane() / nearPlane;
+	const float nearDepth = nearPlane * std::pow(range, static_cast<float>(slice) / CLUSTER_SLICES);
+	const float farDepth = nearPlane * std::pow(range, static_cast<float>(slice + 1) / CLUSTER_SLICES);
+
+	// view space looks down -z
+	Box box;
+	box.min.z = -farDepth;
+	box.max.z = -nearDepth;
+	extent(-1.0f, 1.0f, projection[0][0], nearDepth, farDepth, perspective, box.min.x, box.max.x);
+	extent(-1.0f, 1.0f, projection[1][1], nearDepth, farDepth, perspective, box.min.y, box.max.y);
+	overlapping(m_lights.packets, box, [&](const LightPacket &packet, uint32_t mask) {
+		for (uint32_t lane = 0; lane < 4; ++lane) {
+			if (mask & (1u << lane)) {
+				out.slice.append(packet, lane);
+			}
+		}
+	});
+	if (out.slice.count == 0) {
+		return;
+	}
+
+	for (uint32_t row = 0; row < CLUSTER_TILES_Y; ++row) {
+		const float bottom = static_cast<float>(row) / CLUSTER_TILES_Y * 2.0f - 1.0f;
+		const float top = static_cast<float>(row + 1) / CLUSTER_TILES_Y * 2.0f - 1.0f;
+		extent(-1.0f, 1.0f, projection[0][0], nearDepth, farDepth, perspective, box.min.x, box.max.x);
+		extent(bottom, top, projection[1][1], nearDepth, farDepth, perspective, box.min.y, box.max.y);
+		out.row.clear();
+		overlapping(out.slice.packets, box, [&](const LightPacket &packet, uint32_t mask) {
+			for (uint32_t lane = 0; lane < 4; ++lane) {
+				if (mask & (1u << lane)) {
+					out.row.append(packet, lane);
+				}
+			}
+		});
+
+		for (uint32_t column = 0; out.row.count > 0 && column < CLUSTER_TILES_X; ++column) {
+			const float left = static_cast<float>(column) / CLUSTER_TILES_X * 2.0f - 1.0f;
+			const float right = static_cast<float>(column + 1) / CLUSTER_TILES_X * 2.0f - 1.0f;
+			extent(left, right, projection[0][0], nearDepth, farDepth, perspective, box.min.x, box.max.x);
+			// every lane is written and only the overlapping ones kept, which
+			// saves a hard to predict branch per light. room for the last
+			// packet's writes past the end is trimmed after
+			const size_t before = out.indices.size();
+			out.indices.resize(before + out.row.count + 4);
+			uint32_t *write = out.indices.data() + before;
+			overlapping(out.row.packets, box, [&](const LightPacket &packet, uint32_t mask) {
+				for (uint32_t lane = 0; lane < 4; ++lane) {
+					*write = packet.lights[lane];
+					write += (mask >> lane) & 1u;
+				}
+			});
+			const size_t count = static_cast<size_t>(write - (out.indices.data() + before));
+			out.indices.resize(before + count);
+			out.counts[row * CLUSTER_TILES_X + column] = static_cast<uint32_t>(count);
+		}
+	}
+}
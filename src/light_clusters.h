@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "scene.h"
+
+class Camera;
+class JobSystem;
+
+// clusters across, up and into the view. depth slices grow exponentially
+constexpr uint32_t CLUSTER_TILES_X = 16;
+constexpr uint32_t CLUSTER_TILES_Y = 9;
+constexpr uint32_t CLUSTER_SLICES = 24;
+constexpr uint32_t CLUSTER_COUNT = CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES;
+
+// Splits the view frustum into clusters, screen tiles by depth slices, and
+// finds the point lights reaching each one, so shading only loops over
+// those. Slices are assigned in parallel, and each tests four lights at a
+// time against first the whole slice, then a row of tiles, then each tile.
+//
+// data() is what clustered.fs reads: an offset and a count per cluster,
+// slice major then row major, followed by the light indices the offsets
+// point into.
+class LightClusters {
+    // view space light spheres four at a time, with the index of each light.
+    // unused lanes sit at infinity
+    struct alignas(16) LightPacket {
+        float x[4];
+        float y[4];
+        float z[4];
+        float radius[4];
+        uint32_t lights[4];
+    };
+
+    // lights packed densely into packets
+    struct PacketList {
+        std::vector<LightPacket> packets;
+        size_t count = 0;
+
+        void clear();
+
+        void append(const LightPacket &from, uint32_t lane);
+    };
+
+    // what one slice's job produces, and its scratch lists of candidate lights
+    struct Slice {
+        std::vector<uint32_t> counts;
+        std::vector<uint32_t> indices;
+        PacketList slice;
+        PacketList row;
+    };
+
+    PacketList m_lights;
+    std::vector<Slice> m_slices;
+    std::vector<uint32_t> m_data;
+
+    void assignSlice(uint32_t slice, const Camera &camera);
+
+public:
+    // sorts lights, in world space, into the clusters of the camera's view.
+    // the camera has to be up to date as the threads read it concurrently
+    void assign(JobSystem &jobs, const Camera &camera, const std::vector<PointLight> &lights);
+
+    inline const std::vector<uint32_t> &data() const {
+        return m_data;
+    }
+
+    // light indices over every cluster
+    inline size_t indexCount() const {
+        return m_data.size() - CLUSTER_COUNT * 2;
+    }
+
+    // slice = log(view depth) * x + y, for the clip planes given
+    static glm::vec2 depthScaleBias(float nearPlane, float farPlane);
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+// A file mapped read-only into memory. Pages are read in as they are first
+// touched rather than up front, and come from the page cache without a copy
+// when the file was read recently.
+class MappedFile {
+    const uint8_t *m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void *m_file = nullptr;
+    void *m_mapping = nullptr;
+#endif
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile() {
+        close();
+    }
+
+    // returns false if the file cannot be opened or mapped
+    bool open(const std::filesystem::path &path);
+
+    void close();
+
+    inline const uint8_t *data() const {
+        return m_data;
+    }
+
+    inline size_t size() const {
+        return m_size;
+    }
+};
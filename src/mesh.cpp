@@ -0,0 +1,91 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "glad/glad.h"
+#include "spdlog/spdlog.h"
+
+#include "gl_state.h"
+
+Mesh Mesh::create(const std::vector<float> &positions, const std::vector<uint32_t> &indices, bool upload) {
+	Mesh mesh;
+	mesh.m_indexCount = static_cast<uint32_t>(indices.size());
+	mesh.m_positions = positions;
+	mesh.m_indices = indices;
+	for (size_t i = 0; i + 2 < positions.size(); i += 3) {
+		float radius = std::sqrt(positions[i] * positions[i] + positions[i + 1] * positions[i + 1] + positions[i + 2] * positions[i + 2]);
+		mesh.m_boundingRadius = std::max(mesh.m_boundingRadius, radius);
+	}
+	if (!upload) {
+		return mesh;
+	}
+
+	glGenVertexArrays(1, &mesh.m_vao);
+	glstate::bindVertexArray(mesh.m_vao);
+
+	// transfer vertices to VBO
+	glGenBuffers(1, &mesh.m_vbo);
+	glstate::bindBuffer(GL_ARRAY_BUFFER, mesh.m_vbo);
+	glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(float), positions.data(), GL_STATIC_DRAW);
+
+	// setup EBO, which is recorded in the VAO
+	glGenBuffers(1, &mesh.m_ebo);
+	glstate::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.m_ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+
+	// set shader attributes
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
+	glEnableVertexAttribArray(0);
+
+	glstate::bindVertexArray(0);
+	return mesh;
+}
+
+Mesh Mesh::createCube(bool upload) {
+    spdlog::debug("Creating cube mesh");
+	const std::vector<float> vertices = {
+		// front vertices
+		 0.5f,  0.5f,  0.5f,	// top right
+		 0.5f, -0.5f,  0.5f,	// bottom right
+		-0.5f, -0.5f,  0.5f,	// bottom left
+		-0.5f,  0.5f,  0.5f,	// top left
+		// back vertices
+		 0.5f,  0.5f, -0.5f,	// top right
+		 0.5f, -0.5f, -0.5f,	// bottom right
+		-0.5f, -0.5f, -0.5f,	// bottom left
+		-0.5f,  0.5f, -0.5f 	// top left
+	};
+	const std::vector<uint32_t> indices = {
+		// front face
+		0, 1, 3,
+		1, 2, 3,
+		// top face
+		0, 3, 4,
+		3, 4, 7,
+		// left face
+		2, 3, 6,
+		3, 6, 7,
+		// right face
+		0, 1, 4,
+		1, 4, 5,
+		// bottom face
+		1, 2, 5,
+		2, 5, 6,
+		// back face
+		4, 5, 7,
+		5, 6, 7
+	};
+	return create(vertices, indices, upload);
+}
+
+void Mesh::deleteMesh() {
+	glstate::deleteBuffer(m_ebo);
+	glstate::deleteBuffer(m_vbo);
+	glstate::deleteVertexArray(m_vao);
+	m_vao = m_vbo = m_ebo = 0;
+	m_indexCount = 0;
+	m_boundingRadius = 0.0f;
+	m_positions.clear();
+	m_indices.clear();
+}
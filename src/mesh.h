@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Vertex and index buffers bound together in a vertex array object
+class Mesh {
+	// opengl handles
+	uint32_t m_vao;
+	uint32_t m_vbo;
+	uint32_t m_ebo;
+	uint32_t m_indexCount;
+	// distance from the origin to the furthest vertex
+	float m_boundingRadius;
+	// copies kept for drawing on the cpu
+	std::vector<float> m_positions;
+	std::vector<uint32_t> m_indices;
+
+public:
+	Mesh() : m_vao{0}, m_vbo{0}, m_ebo{0}, m_indexCount{0}, m_boundingRadius{0.0f} {}
+
+	// uploads tightly packed vec3 positions and triangle indices. without
+	// upload only the cpu copy is kept, for drawing without a context
+	static Mesh create(const std::vector<float> &positions, const std::vector<uint32_t> &indices, bool upload = true);
+
+	// unit cube centered on the origin
+	static Mesh createCube(bool upload = true);
+
+	void deleteMesh();
+
+	inline uint32_t vao() const {
+		return m_vao;
+	}
+
+	inline uint32_t indexCount() const {
+		return m_indexCount;
+	}
+
+	inline float boundingRadius() const {
+		return m_boundingRadius;
+	}
+
+	inline const std::vector<float> &positions() const {
+		return m_positions;
+	}
+
+	inline const std::vector<uint32_t> &indices() const {
+		return m_indices;
+	}
+};
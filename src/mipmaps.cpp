@@ -0,0 +1,184 @@
+#include "mipmaps.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "float4.h"
+
+namespace {
+
+	constexpr uint32_t BYTES_PER_TEXEL = 4;
+	// steps of the linear to sRGB table, fine enough that every sRGB value comes back from its own linear value
+	constexpr uint32_t ENCODE_STEPS = 4096;
+
+	// kaiser window shape and half width in texels of the smaller level, and taps per axis
+	constexpr float KAISER_ALPHA = 4.0f;
+	constexpr float KAISER_WIDTH = 1.5f;
+	constexpr uint32_t KAISER_TAPS = 6;
+
+	struct SrgbTables {
+		float decode[256];
+		uint8_t encode[ENCODE_STEPS];
+
+		SrgbTables() {
+			for (uint32_t i = 0; i < 256; ++i) {
+				const float c = static_cast<float>(i) / 255.0f;
+				decode[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			for (uint32_t i = 0; i < ENCODE_STEPS; ++i) {
+				const float l = static_cast<float>(i) / static_cast<float>(ENCODE_STEPS - 1);
+				const float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+				encode[i] = static_cast<uint8_t>(c * 255.0f + 0.5f);
+			}
+		}
+	};
+
+	const SrgbTables SRGB;
+
+	// texels of the larger level that make up each texel of the smaller one along an axis, and their weights
+	struct Taps {
+		uint32_t count = 0;
+		std::vector<uint32_t> indices;
+		std::vector<float> weights;
+	};
+
+	// modified bessel function of the first kind, order 0
+	float besselI0(float x) {
+		float sum = 1.0f;
+		float term = 1.0f;
+		for (int k = 1; k < 16; ++k) {
+			term *= (x * 0.5f / static_cast<float>(k)) * (x * 0.5f / static_cast<float>(k));
+			sum += term;
+		}
+		return sum;
+	}
+
+	float kaiser(float t) {
+		if (std::fabs(t) >= KAISER_WIDTH) {
+			return 0.0f;
+		}
+		const float ratio = t / KAISER_WIDTH;
+		const float window = besselI0(KAISER_ALPHA * std::sqrt(1.0f - ratio * ratio)) / besselI0(KAISER_ALPHA);
+		const float sinc = t == 0.0f ? 1.0f : std::sin(3.14159265f * t) / (3.14159265f * t);
+		return sinc * window;
+	}
+
+	Taps makeTaps(uint32_t size, uint32_t next, MipFilter filter) {
+		Taps taps;
+		if (filter == MipFilter::Box) {
+			taps.count = 2;
+			for (uint32_t i = 0; i < next; ++i) {
+				taps.indices.push_back(std::min(i * 2, size - 1));
+				taps.indices.push_back(std::min(i * 2 + 1, size - 1));
+				taps.weights.push_back(0.5f);
+				taps.weights.push_back(0.5f);
+			}
+			return taps;
+		}
+
+		// distances are measured in texels of the smaller level
+		taps.count = KAISER_TAPS;
+		const float scale = static_cast<float>(size) / static_cast<float>(next);
+		for (uint32_t i = 0; i < next; ++i) {
+			const float center = (static_cast<float>(i) + 0.5f) * scale - 0.5f;
+			const int first = static_cast<int>(std::floor(center)) - static_cast<int>(KAISER_TAPS / 2 - 1);
+			float total = 0.0f;
+			for (uint32_t tap = 0; tap < KAISER_TAPS; ++tap) {
+				const int texel = first + static_cast<int>(tap);
+				const float weight = kaiser((static_cast<float>(texel) - center) / scale);
+				const int wrapped = texel % static_cast<int>(size);
+				taps.indices.push_back(static_cast<uint32_t>(wrapped < 0 ? wrapped + static_cast<int>(size) : wrapped));
+				taps.weights.push_back(weight);
+				total += weight;
+			}
+			for (uint32_t tap = 0; tap < KAISER_TAPS; ++tap) {
+				taps.weights[i * KAISER_TAPS + tap] /= total;
+			}
+		}
+		return taps;
+	}
+
+	inline Float4 decodeTexel(const uint8_t *texel) {
+		alignas(16) const float values[4] = {SRGB.decode[texel[0]], SRGB.decode[texel[1]], SRGB.decode[texel[2]], static_cast<float>(texel[3]) / 255.0f};
+		return Float4::load(values);
+	}
+
+	inline void encodeTexel(Float4 color, uint8_t *texel) {
+		alignas(16) static const float SCALE[4] = {ENCODE_STEPS - 1, ENCODE_STEPS - 1, ENCODE_STEPS - 1, 255.0f};
+		alignas(16) float values[4];
+		(min(max(color, Float4::splat(0.0f)), Float4::splat(1.0f)) * Float4::load(SCALE) + Float4::splat(0.5f)).store(values);
+		texel[0] = SRGB.encode[static_cast<uint32_t>(values[0])];
+		texel[1] = SRGB.encode[static_cast<uint32_t>(values[1])];
+		texel[2] = SRGB.encode[static_cast<uint32_t>(values[2])];
+		texel[3] = static_cast<uint8_t>(values[3]);
+	}
+
+}
+
+void downsampleRows(const uint8_t *source, uint32_t width, uint32_t height, uint8_t *target, uint32_t firstRow, uint32_t lastRow, MipFilter filter) {
+	const uint32_t nextWidth = std::max(width / 2, 1u);
+	const uint32_t nextHeight = std::max(height / 2, 1u);
+	const Taps columns = makeTaps(width, nextWidth, filter);
+	const Taps rows = makeTaps(height, nextHeight, filter);
+
+	// every source row the block reads, decoded to linear once
+	std::vector<int32_t> slots(height, -1);
+	uint32_t slotCount = 0;
+	for (uint32_t y = firstRow; y < lastRow; ++y) {
+		for (uint32_t tap = 0; tap < rows.count; ++tap) {
+			int32_t &slot = slots[rows.indices[y * rows.count + tap]];
+			if (slot < 0) {
+				slot = static_cast<int32_t>(slotCount++);
+			}
+		}
+	}
+	std::vector<Float4> linear(static_cast<size_t>(slotCount) * width);
+	for (uint32_t y = 0; y < height; ++y) {
+		if (slots[y] < 0) {
+			continue;
+		}
+		const uint8_t *row = source + static_cast<size_t>(y) * width * BYTES_PER_TEXEL;
+		Float4 *decoded = linear.data() + static_cast<size_t>(slots[y]) * width;
+		for (uint32_t x = 0; x < width; ++x) {
+			decoded[x] = decodeTexel(row + x * BYTES_PER_TEXEL);
+		}
+	}
+
+	// vertically into one row at the source width, then horizontally
+	std::vector<Float4> filtered(width);
+	for (uint32_t y = firstRow; y < lastRow; ++y) {
+		std::fill(filtered.begin(), filtered.end(), Float4::splat(0.0f));
+		for (uint32_t tap = 0; tap < rows.count; ++tap) {
+			const Float4 weight = Float4::splat(rows.weights[y * rows.count + tap]);
+			const Float4 *decoded = linear.data() + static_cast<size_t>(slots[rows.indices[y * rows.count + tap]]) * width;
+			for (uint32_t x = 0; x < width; ++x) {
+				filtered[x] = filtered[x] + weight * decoded[x];
+			}
+		}
+
+		uint8_t *out = target + static_cast<size_t>(y) * nextWidth * BYTES_PER_TEXEL;
+		for (uint32_t x = 0; x < nextWidth; ++x) {
+			Float4 color = Float4::splat(0.0f);
+			for (uint32_t tap = 0; tap < columns.count; ++tap) {
+				color = color + Float4::splat(columns.weights[x * columns.count + tap]) * filtered[columns.indices[x * columns.count + tap]];
+			}
+			encodeTexel(color, out + x * BYTES_PER_TEXEL);
+		}
+	}
+}
+
+MipChain buildMipChain(uint32_t width, uint32_t height, std::vector<uint8_t> pixels, MipFilter filter) {
+	MipChain chain;
+	chain.reserve(mipLevelCount(width, height));
+	chain.push_back(std::move(pixels));
+	while (width > 1 || height > 1) {
+		const uint32_t nextWidth = std::max(width / 2, 1u);
+		const uint32_t nextHeight = std::max(height / 2, 1u);
+		std::vector<uint8_t> next(static_cast<size_t>(nextWidth) * nextHeight * BYTES_PER_TEXEL);
+		downsampleRows(chain.back().data(), width, height, next.data(), 0, nextHeight, filter);
+		chain.push_back(std::move(next));
+		width = nextWidth;
+		height = nextHeight;
+	}
+	return chain;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "texture_format.h"
+
+// How a level is filtered down to the next. Both average in linear light,
+// decoding the sRGB color of rgba8 texels and encoding the result again so
+// distant surfaces keep their brightness, and leave alpha linear. Box
+// averages 2x2 texels, repeating the last row or column of odd sizes. Kaiser
+// is a windowed sinc over 6x6 texels that wraps around the edges like the
+// textures repeat, keeping more detail in the smaller levels at the cost of
+// slight ringing.
+enum class MipFilter {
+    Box,
+    Kaiser,
+};
+
+// writes rows [firstRow, lastRow) of the level below the width x height
+// rgba8 level source to target, which holds that whole level. row ranges
+// are independent, so the rows of a level can be made on several threads
+void downsampleRows(const uint8_t *source, uint32_t width, uint32_t height, uint8_t *target, uint32_t firstRow, uint32_t lastRow, MipFilter filter);
+
+// filters pixels down to 1x1 on the calling thread
+MipChain buildMipChain(uint32_t width, uint32_t height, std::vector<uint8_t> pixels, MipFilter filter = MipFilter::Box);
@@ -0,0 +1,168 @@
+#include "options.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+
+#include "spdlog/spdlog.h"
+
+namespace {
+
+	// reads the value following an option as an unsigned integer
+	uint32_t readUnsigned(int argc, char **argv, int &i) {
+		const std::string option = argv[i];
+		if (i + 1 >= argc) {
+			throw OptionsError{option + " expects a value"};
+		}
+		const std::string value = argv[++i];
+		// stoul would take a sign, wrapping "-1" around to the largest value
+		if (value.empty() || !std::isdigit(static_cast<unsigned char>(value[0]))) {
+			throw OptionsError{option + " expects a number, got " + value};
+		}
+		unsigned long long result = 0;
+		try {
+			size_t used = 0;
+			result = std::stoull(value, &used);
+			if (used != value.size()) {
+				throw OptionsError{option + " expects a number, got " + value};
+			}
+		} catch (const std::logic_error &) {
+			throw OptionsError{option + " expects a number, got " + value};
+		}
+		if (result > UINT32_MAX) {
+			throw OptionsError{option + " must be at most " + std::to_string(UINT32_MAX)};
+		}
+		return static_cast<uint32_t>(result);
+	}
+
+	// reads the value following an option as a finite number above 0
+	float readPositiveFloat(int argc, char **argv, int &i) {
+		const std::string option = argv[i];
+		if (i + 1 >= argc) {
+			throw OptionsError{option + " expects a value"};
+		}
+		const std::string value = argv[++i];
+		float result = 0.0f;
+		try {
+			size_t used = 0;
+			result = std::stof(value, &used);
+			if (used != value.size()) {
+				throw OptionsError{option + " expects a number, got " + value};
+			}
+		} catch (const std::logic_error &) {
+			throw OptionsError{option + " expects a number, got " + value};
+		}
+		// rejects nan as well as zero and below
+		if (!(result > 0.0f) || !std::isfinite(result)) {
+			throw OptionsError{option + " must be a positive number, got " + value};
+		}
+		return result;
+	}
+
+}
+
+Options parseOptions(int argc, char **argv) {
+	Options options;
+	for (int i = 1; i < argc; ++i) {
+		const std::string option = argv[i];
+		if (option == "--objects") {
+			options.benchmarkObjects = readUnsigned(argc, argv, i);
+		} else if (option == "--threads") {
+			options.workerThreads = readUnsigned(argc, argv, i);
+		} else if (option == "--frames") {
+			options.frameLimit = readUnsigned(argc, argv, i);
+		} else if (option == "--unsorted") {
+			options.unsortedDraws = true;
+		} else if (option == "--frames-in-flight") {
+			options.framesInFlight = readUnsigned(argc, argv, i);
+			if (options.framesInFlight < 1 || options.framesInFlight > MAX_FRAMES_IN_FLIGHT) {
+				throw OptionsError{option + " must be between 1 and " + std::to_string(MAX_FRAMES_IN_FLIGHT)};
+			}
+		} else if (option == "--inline-simulation") {
+			options.inlineSimulation = true;
+		} else if (option == "--sim-hz") {
+			options.simulationHz = readUnsigned(argc, argv, i);
+			if (options.simulationHz < 1 || options.simulationHz > MAX_SIMULATION_HZ) {
+				throw OptionsError{option + " must be between 1 and " + std::to_string(MAX_SIMULATION_HZ)};
+			}
+		} else if (option == "--raw-mouse") {
+			options.rawMouseMotion = true;
+		} else if (option == "--input-flood") {
+			options.inputFlood = readUnsigned(argc, argv, i);
+		} else if (option == "--software") {
+			options.softwareRasterizer = true;
+		} else if (option == "--path-trace") {
+			options.pathTraceSamples = readUnsigned(argc, argv, i);
+		} else if (option == "--output") {
+			if (i + 1 >= argc) {
+				throw OptionsError{option + " expects a value"};
+			}
+			options.outputPath = argv[++i];
+		} else if (option == "--lights") {
+			options.lightCount = readUnsigned(argc, argv, i);
+			if (options.lightCount > MAX_LIGHTS) {
+				throw OptionsError{option + " must be at most " + std::to_string(MAX_LIGHTS)};
+			}
+		} else if (option == "--deferred") {
+			options.deferredShading = true;
+		} else if (option == "--clustered") {
+			options.clusteredShading = true;
+		} else if (option == "--shadows") {
+			options.shadows = true;
+		} else if (option == "--no-shadow-cache") {
+			options.shadowCaching = false;
+		} else if (option == "--textures") {
+			options.textureCount = readUnsigned(argc, argv, i);
+		} else if (option == "--texture-budget") {
+			options.textureBudgetMiB = readUnsigned(argc, argv, i);
+			if (options.textureBudgetMiB < 1) {
+				throw OptionsError{option + " must be at least 1"};
+			}
+		} else if (option == "--texture-layers") {
+			options.textureLayers = readUnsigned(argc, argv, i);
+			if (options.textureLayers < 1) {
+				throw OptionsError{option + " must be at least 1"};
+			}
+		} else if (option == "--texture-dir") {
+			if (i + 1 >= argc) {
+				throw OptionsError{option + " expects a value"};
+			}
+			options.textureDirectory = argv[++i];
+		} else if (option == "--mip-filter") {
+			if (i + 1 >= argc) {
+				throw OptionsError{option + " expects a value"};
+			}
+			const std::string filter = argv[++i];
+			if (filter == "box") {
+				options.mipFilter = MipFilter::Box;
+			} else if (filter == "kaiser") {
+				options.mipFilter = MipFilter::Kaiser;
+			} else {
+				throw OptionsError{option + " expects box or kaiser, got " + filter};
+			}
+		} else if (option == "--shader-cache") {
+			if (i + 1 >= argc) {
+				throw OptionsError{option + " expects a value"};
+			}
+			options.shaderCacheDirectory = argv[++i];
+		} else if (option == "--no-shader-cache") {
+			options.shaderCacheDirectory.clear();
+		} else if (option == "--shader-dir") {
+			if (i + 1 >= argc) {
+				throw OptionsError{option + " expects a value"};
+			}
+			options.shaderDirectory = argv[++i];
+		} else if (option == "--embedded-shaders") {
+			options.shaderDirectory.clear();
+		} else if (option == "--no-prewarm") {
+			options.prewarm = false;
+		} else if (option == "--max-startup-spike") {
+			options.maxStartupSpike = readPositiveFloat(argc, argv, i);
+		} else if (option == "--per-draw") {
+			options.perDrawSubmission = true;
+		} else {
+			spdlog::warn("Ignoring unknown option {}", option);
+		}
+	}
+	return options;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include "frame_controller.h"
+#include "mipmaps.h"
+#include "scene.h"
+#include "simulation.h"
+
+// Settings taken from the command line
+struct Options {
+    // extra cubes added to the scene to stress the render loop (--objects N)
+    uint32_t benchmarkObjects = 0;
+    // job system workers, 0 picks one per spare hardware thread (--threads N)
+    uint32_t workerThreads = 0;
+    // quit after this many frames and log averages for the run, 0 runs until closed (--frames N)
+    uint32_t frameLimit = 0;
+    // submit draws in recording order instead of by sort key (--unsorted)
+    bool unsortedDraws = false;
+    // skip multi-draw indirect and issue one draw call per object (--per-draw)
+    bool perDrawSubmission = false;
+    // frames the cpu may queue ahead of the gpu, 1 to 3 (--frames-in-flight N)
+    uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+    // step the simulation on the render thread instead of its own (--inline-simulation)
+    bool inlineSimulation = false;
+    // fixed simulation steps per second, 1 to 1000 (--sim-hz N)
+    uint32_t simulationHz = DEFAULT_SIMULATION_HZ;
+    // unaccelerated mouse motion where the platform supports it (--raw-mouse)
+    bool rawMouseMotion = false;
+    // synthetic cursor events queued per millisecond to stress input handling (--input-flood N)
+    uint32_t inputFlood = 0;
+    // draw on the cpu instead of through opengl, for machines without a usable gpu (--software)
+    bool softwareRasterizer = false;
+    // path trace a reference image with this many samples per pixel and quit (--path-trace N)
+    uint32_t pathTraceSamples = 0;
+    // where the reference image is written (--output FILE)
+    std::string outputPath = "reference.ppm";
+    // point lights shading the scene, the lamp among them. 0 keeps the flat
+    // colors unless shading is deferred, which always has the lamp (--lights N)
+    uint32_t lightCount = 0;
+    // shade from a g-buffer in a separate pass instead of while drawing (--deferred)
+    bool deferredShading = false;
+    // shade forward with only the lights assigned to each view cluster on the cpu (--clustered)
+    bool clusteredShading = false;
+    // cascaded sun shadows and a cube shadow for the lamp, which lights the scene (--shadows)
+    bool shadows = false;
+    // redraw every shadow caster each frame instead of reusing static depth (--no-shadow-cache)
+    bool shadowCaching = true;
+    // generated textures spread over the objects, streamed mip by mip (--textures N)
+    uint32_t textureCount = 0;
+    // gpu memory the streamed textures may take, in MiB (--texture-budget N)
+    uint32_t textureBudgetMiB = 64;
+    // most images packed into one array texture, 1 to give every image a texture of its own (--texture-layers N)
+    uint32_t textureLayers = 64;
+    // stream the compiled textures, and png and jpeg files, in this directory instead of generated textures (--texture-dir DIR)
+    std::string textureDirectory;
+    // how the mip levels of textures are filtered (--mip-filter box|kaiser)
+    MipFilter mipFilter = MipFilter::Box;
+    // where compiled shader programs and the manifest of variants to prewarm are kept,
+    // empty to compile every shader each run. off unless named, as it is relative to
+    // wherever the program is started; debug builds keep it in the working directory
+    // beside the linked shaders (--shader-cache DIR, --no-shader-cache)
+#ifdef _DEBUG
+    std::string shaderCacheDirectory = "shader_cache";
+#else
+    std::string shaderCacheDirectory;
+#endif
+    // read shader sources from this directory, where R reloads edits to them, instead of the
+    // copies built into the binary. debug builds read the shaders linked next to the binary
+    // (--shader-dir DIR, --embedded-shaders)
+#ifdef _DEBUG
+    std::string shaderDirectory = "shaders";
+#else
+    std::string shaderDirectory;
+#endif
+    // draw a frame into one pixel while loading and after reloading shaders, so the driver
+    // compiles what it defers to first draws before frames are shown (--no-prewarm)
+    bool prewarm = true;
+    // fail a run whose worst frame among the first STARTUP_FRAMES takes more than
+    // this many times the median frame after them, such as 1.5. without it the spike
+    // is only reported (--max-startup-spike RATIO)
+    float maxStartupSpike = 0.0f;
+};
+
+Options parseOptions(int argc, char **argv);
+
+class OptionsError: public std::runtime_error {
+public:
+	OptionsError(const std::string &message)
+		: std::runtime_error{message} {}
+};
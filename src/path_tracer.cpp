@@ -0,0 +1,275 @@
+#include "path_tracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#include <glm/gtc/constants.hpp>
+
+#include "camera.h"
+#include "jobs.h"
+#include "mesh.h"
+#include "scene.h"
+
+namespace {
+
+	// pixels traced by one job
+	constexpr uint32_t TILE_SIZE = 16;
+	// longest path followed, and the bounce after which paths may be cut short
+	constexpr int MAX_BOUNCES = 6;
+	constexpr int ROULETTE_BOUNCE = 3;
+	// how far rays start off the surface they leave, against self intersection
+	constexpr float RAY_OFFSET = 1e-4f;
+	// how much of the way to a light a shadow ray checks, so it misses the light itself
+	constexpr float SHADOW_RAY_EXTENT = 0.999f;
+
+	// bit mixer used to seed each pixel's sequence
+	uint32_t hash(uint32_t x) {
+		x ^= x >> 16;
+		x *= 0x7feb352du;
+		x ^= x >> 15;
+		x *= 0x846ca68bu;
+		x ^= x >> 16;
+		return x;
+	}
+
+	// pcg random numbers in [0, 1)
+	class Random {
+		uint32_t m_state;
+
+	public:
+		explicit Random(uint32_t seed) : m_state{seed} {}
+
+		inline float next() {
+			m_state = m_state * 747796405u + 2891336453u;
+			uint32_t word = ((m_state >> ((m_state >> 28u) + 4u)) ^ m_state) * 277803737u;
+			word = (word >> 22u) ^ word;
+			return static_cast<float>(word >> 8) * (1.0f / 16777216.0f);
+		}
+	};
+
+	// directions around a normal, weighted by the cosine to it
+	glm::vec3 sampleCosine(const glm::vec3 &normal, float u, float v) {
+		// tangent frame without branches, Duff et al. 2017
+		const float sign = std::copysign(1.0f, normal.z);
+		const float a = -1.0f / (sign + normal.z);
+		const float b = normal.x * normal.y * a;
+		const glm::vec3 tangent{1.0f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x};
+		const glm::vec3 bitangent{b, sign + normal.y * normal.y * a, -normal.y};
+
+		const float radius = std::sqrt(u);
+		const float angle = 2.0f * glm::pi<float>() * v;
+		return tangent * (radius * std::cos(angle)) + bitangent * (radius * std::sin(angle)) + normal * std::sqrt(std::max(0.0f, 1.0f - u));
+	}
+
+	uint32_t packColor(const glm::vec3 &color) {
+		auto channel = [](float value) {
+			return static_cast<uint32_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+		};
+		return channel(color.x) | channel(color.y) << 8 | channel(color.z) << 16 | 0xffu << 24;
+	}
+
+	inline bool emits(const PathMaterial &material) {
+		return material.emission.x > 0.0f || material.emission.y > 0.0f || material.emission.z > 0.0f;
+	}
+
+}
+
+void PathTracer::setMaterial(const Shader *shader, const PathMaterial &material) {
+	m_materials[shader] = material;
+}
+
+void PathTracer::setBackground(const glm::vec3 &radiance) {
+	m_background = radiance;
+}
+
+void PathTracer::build(const Scene &scene) {
+	m_vertices.clear();
+	m_normals.clear();
+	m_triangleMaterials.clear();
+	m_emitters.clear();
+	m_emitterCdf.clear();
+	m_emitterArea = 0.0f;
+
+	for (const Object &object : scene.objects) {
+		auto material = m_materials.find(object.shader);
+		if (material == m_materials.end() || object.mesh == nullptr) {
+			continue;
+		}
+
+		const glm::mat4 model = object.modelMatrix();
+		const std::vector<float> &positions = object.mesh->positions();
+		const std::vector<uint32_t> &indices = object.mesh->indices();
+		for (size_t index = 0; index + 3 <= indices.size(); index += 3) {
+			glm::vec3 corners[3];
+			for (int corner = 0; corner < 3; ++corner) {
+				const size_t vertex = static_cast<size_t>(indices[index + corner]) * 3;
+				corners[corner] = glm::vec3{model * glm::vec4{positions[vertex], positions[vertex + 1], positions[vertex + 2], 1.0f}};
+			}
+			const glm::vec3 cross = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+			const float length = glm::length(cross);
+			if (!(length > 0.0f)) {
+				continue;
+			}
+
+			const uint32_t triangle = static_cast<uint32_t>(m_normals.size());
+			m_vertices.insert(m_vertices.end(), corners, corners + 3);
+			m_normals.push_back(cross / length);
+			m_triangleMaterials.push_back(material->second);
+			if (emits(material->second)) {
+				m_emitterArea += length * 0.5f;
+				m_emitters.push_back(triangle);
+				m_emitterCdf.push_back(m_emitterArea);
+			}
+		}
+	}
+
+	m_bvh.build(m_vertices);
+	reset();
+}
+
+void PathTracer::setCamera(const Camera &camera) {
+	m_inverseViewProjection = camera.inverseViewProjection();
+	reset();
+}
+
+void PathTracer::resize(uint32_t width, uint32_t height) {
+	m_width = width;
+	m_height = height;
+	m_accumulation.resize(static_cast<size_t>(width) * height);
+	m_color.resize(m_accumulation.size());
+	reset();
+}
+
+void PathTracer::reset() {
+	std::fill(m_accumulation.begin(), m_accumulation.end(), glm::vec3{0.0f});
+	m_samples = 0;
+	m_rays = 0;
+	m_traceSeconds = 0.0;
+}
+
+void PathTracer::renderPass(JobSystem &jobs) {
+	const uint32_t tilesX = (m_width + TILE_SIZE - 1) / TILE_SIZE;
+	const uint32_t tilesY = (m_height + TILE_SIZE - 1) / TILE_SIZE;
+	const uint32_t sample = m_samples;
+	const float weight = 1.0f / static_cast<float>(sample + 1);
+	m_threads = jobs.threadCount();
+	m_counters.assign(m_threads, ThreadCounters{});
+
+	auto start = std::chrono::steady_clock::now();
+	jobs.parallelFor(static_cast<size_t>(tilesX) * tilesY, 1, [&](size_t begin, size_t end, uint32_t threadIndex) {
+		uint64_t rays = 0;
+		for (size_t tile = begin; tile < end; ++tile) {
+			const uint32_t x0 = static_cast<uint32_t>(tile % tilesX) * TILE_SIZE;
+			const uint32_t y0 = static_cast<uint32_t>(tile / tilesX) * TILE_SIZE;
+			const uint32_t x1 = std::min(x0 + TILE_SIZE, m_width);
+			const uint32_t y1 = std::min(y0 + TILE_SIZE, m_height);
+			for (uint32_t y = y0; y < y1; ++y) {
+				for (uint32_t x = x0; x < x1; ++x) {
+					const size_t pixel = static_cast<size_t>(y) * m_width + x;
+					m_accumulation[pixel] += tracePath(x, y, sample, rays);
+					m_color[pixel] = packColor(m_accumulation[pixel] * weight);
+				}
+			}
+		}
+		m_counters[threadIndex].rays += rays;
+	});
+	m_traceSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	for (const ThreadCounters &counters : m_counters) {
+		m_rays += counters.rays;
+	}
+	++m_samples;
+}
+
+double PathTracer::raysPerSecondPerCore() const {
+	return m_traceSeconds > 0.0 ? static_cast<double>(m_rays) / m_traceSeconds / m_threads : 0.0;
+}
+
+glm::vec3 PathTracer::tracePath(uint32_t x, uint32_t y, uint32_t sample, uint64_t &rays) const {
+	Random random{hash(static_cast<uint32_t>(y * m_width + x) ^ hash(sample))};
+
+	// camera ray through a random point of the pixel, bottom row first
+	const glm::vec2 ndc{(static_cast<float>(x) + random.next()) / static_cast<float>(m_width) * 2.0f - 1.0f,
+	                    (static_cast<float>(y) + random.next()) / static_cast<float>(m_height) * 2.0f - 1.0f};
+	const glm::vec4 nearPoint = m_inverseViewProjection * glm::vec4{ndc, -1.0f, 1.0f};
+	const glm::vec4 farPoint = m_inverseViewProjection * glm::vec4{ndc, 1.0f, 1.0f};
+	Ray ray;
+	ray.origin = glm::vec3{nearPoint} / nearPoint.w;
+	ray.direction = glm::normalize(glm::vec3{farPoint} / farPoint.w - ray.origin);
+	ray.tMax = std::numeric_limits<float>::max();
+
+	glm::vec3 radiance{0.0f};
+	glm::vec3 throughput{1.0f};
+	for (int bounce = 0; bounce < MAX_BOUNCES; ++bounce) {
+		RayHit hit;
+		++rays;
+		if (!m_bvh.intersect(ray, hit)) {
+			radiance += throughput * m_background;
+			break;
+		}
+
+		// lights seen after a bounce were already counted when sampled directly
+		const PathMaterial &material = m_triangleMaterials[hit.triangle];
+		if (bounce == 0) {
+			radiance += throughput * material.emission;
+		}
+		if (material.albedo == glm::vec3{0.0f}) {
+			break;
+		}
+
+		glm::vec3 normal = m_normals[hit.triangle];
+		if (glm::dot(normal, ray.direction) > 0.0f) {
+			normal = -normal;
+		}
+		const glm::vec3 position = ray.origin + ray.direction * hit.t + normal * RAY_OFFSET;
+		const glm::vec3 brdf = material.albedo * glm::one_over_pi<float>();
+
+		// light from a random point on a random emitter
+		if (!m_emitters.empty()) {
+			const float pick = random.next() * m_emitterArea;
+			const size_t emitter = std::min<size_t>(std::upper_bound(m_emitterCdf.begin(), m_emitterCdf.end(), pick) - m_emitterCdf.begin(),
+			                                        m_emitters.size() - 1);
+			const uint32_t light = m_emitters[emitter];
+			const float root = std::sqrt(random.next());
+			const float u = 1.0f - root;
+			const float v = random.next() * root;
+			const glm::vec3 &a = m_vertices[light * 3];
+			const glm::vec3 point = a + (m_vertices[light * 3 + 1] - a) * u + (m_vertices[light * 3 + 2] - a) * v;
+
+			const glm::vec3 toLight = point - position;
+			const float distanceSquared = glm::dot(toLight, toLight);
+			const float distance = std::sqrt(distanceSquared);
+			const glm::vec3 direction = toLight / distance;
+			const float cosSurface = glm::dot(normal, direction);
+			const float cosLight = std::fabs(glm::dot(m_normals[light], direction));
+			if (cosSurface > 0.0f && cosLight > 0.0f) {
+				++rays;
+				if (!m_bvh.occluded(Ray{position, direction, distance * SHADOW_RAY_EXTENT})) {
+					// area sampling pdf converted to solid angle
+					const float pdf = distanceSquared / (cosLight * m_emitterArea);
+					radiance += throughput * brdf * m_triangleMaterials[light].emission * (cosSurface / pdf);
+				}
+			}
+		}
+
+		// cosine weighted bounce, the cosine and pdf cancel against the brdf
+		throughput *= material.albedo;
+		if (bounce + 1 >= ROULETTE_BOUNCE) {
+			const float survival = std::clamp(std::max({throughput.x, throughput.y, throughput.z}), 0.05f, 0.95f);
+			if (random.next() >= survival) {
+				break;
+			}
+			throughput /= survival;
+		}
+		const float u = random.next();
+		const float v = random.next();
+		ray = Ray{position, sampleCosine(normal, u, v), std::numeric_limits<float>::max()};
+	}
+
+	if (!std::isfinite(radiance.x) || !std::isfinite(radiance.y) || !std::isfinite(radiance.z)) {
+		return glm::vec3{0.0f};
+	}
+	return radiance;
+}
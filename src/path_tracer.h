@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "bvh.h"
+
+class Camera;
+class JobSystem;
+class Scene;
+class Shader;
+
+// How the surfaces drawn with one program respond to light
+struct PathMaterial {
+    // diffuse reflectance
+    glm::vec3 albedo{0.0f};
+    // radiance leaving the surface on its own
+    glm::vec3 emission{0.0f};
+};
+
+// Reference renderer: traces paths through the scene's triangles on the cpu
+// and averages one more sample per pixel with every pass. Surfaces are
+// diffuse, emitting triangles are sampled directly at every bounce, and
+// rays leaving the scene see a constant background. Each pixel's random
+// sequence depends only on its position and the sample number, so an image
+// comes out the same however many threads traced it.
+class PathTracer {
+    // everything a thread changes while tracing, apart from its own pixels
+    struct alignas(64) ThreadCounters {
+        uint64_t rays = 0;
+    };
+
+    std::unordered_map<const Shader *, PathMaterial> m_materials;
+    glm::vec3 m_background{0.0f};
+
+    // world space triangles, three vertices each
+    std::vector<glm::vec3> m_vertices;
+    std::vector<glm::vec3> m_normals;
+    std::vector<PathMaterial> m_triangleMaterials;
+    Bvh m_bvh;
+
+    // emitting triangles, picked in proportion to their area
+    std::vector<uint32_t> m_emitters;
+    std::vector<float> m_emitterCdf;
+    float m_emitterArea = 0.0f;
+
+    glm::mat4 m_inverseViewProjection{1.0f};
+
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    std::vector<glm::vec3> m_accumulation;
+    std::vector<uint32_t> m_color;
+    uint32_t m_samples = 0;
+
+    std::vector<ThreadCounters> m_counters;
+    uint64_t m_rays = 0;
+    double m_traceSeconds = 0.0;
+    uint32_t m_threads = 1;
+
+    glm::vec3 tracePath(uint32_t x, uint32_t y, uint32_t sample, uint64_t &rays) const;
+
+public:
+    // objects drawn with a program that has no material are left out
+    void setMaterial(const Shader *shader, const PathMaterial &material);
+
+    // radiance of everything the rays escape to
+    void setBackground(const glm::vec3 &radiance);
+
+    // flattens the scene into world space triangles and builds the bvh over them
+    void build(const Scene &scene);
+
+    // sees the scene from this camera, restarting the accumulation
+    void setCamera(const Camera &camera);
+
+    void resize(uint32_t width, uint32_t height);
+
+    // drops every sample taken so far
+    void reset();
+
+    // traces one sample for every pixel, 16x16 pixel tiles at a time across
+    // the job system, and resolves the average into color()
+    void renderPass(JobSystem &jobs);
+
+    // rays traced per second by each thread, over every pass since the last reset
+    double raysPerSecondPerCore() const;
+
+    inline uint32_t samples() const {
+        return m_samples;
+    }
+
+    inline uint64_t rays() const {
+        return m_rays;
+    }
+
+    inline size_t triangleCount() const {
+        return m_normals.size();
+    }
+
+    inline uint32_t width() const {
+        return m_width;
+    }
+
+    inline uint32_t height() const {
+        return m_height;
+    }
+
+    // rgba8 with the bottom row first, rows are tightly packed
+    inline const uint32_t *color() const {
+        return m_color.data();
+    }
+};
@@ -0,0 +1,262 @@
+#include "png_decoder.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "inflate.h"
+
+namespace {
+
+	constexpr uint8_t SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+	enum ColorType : uint8_t {
+		GRAY = 0,
+		RGB = 2,
+		PALETTE = 3,
+		GRAY_ALPHA = 4,
+		RGB_ALPHA = 6,
+	};
+
+	inline uint32_t readBigEndian(const uint8_t *p) {
+		return static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16 | static_cast<uint32_t>(p[2]) << 8 | p[3];
+	}
+
+	inline uint8_t paeth(uint8_t a, uint8_t b, uint8_t c) {
+		const int p = static_cast<int>(a) + b - c;
+		const int pa = std::abs(p - a);
+		const int pb = std::abs(p - b);
+		const int pc = std::abs(p - c);
+		return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+	}
+
+}
+
+bool PngDecoder::matches(const uint8_t *data, size_t size) {
+	return size >= sizeof(SIGNATURE) && std::memcmp(data, SIGNATURE, sizeof(SIGNATURE)) == 0;
+}
+
+void PngDecoder::parse() {
+	if (!matches(m_data, m_size)) {
+		throw ImageError{"not a png"};
+	}
+
+	size_t offset = sizeof(SIGNATURE);
+	bool header = false;
+	for (;;) {
+		if (m_size - offset < 12) {
+			throw ImageError{"png ends before its IEND chunk"};
+		}
+		const uint32_t length = readBigEndian(m_data + offset);
+		const uint8_t *type = m_data + offset + 4;
+		const uint8_t *chunk = m_data + offset + 8;
+		if (length > m_size - offset - 12) {
+			throw ImageError{"png chunk runs past the end of the file"};
+		}
+		offset += 12 + static_cast<size_t>(length);
+
+		if (std::memcmp(type, "IHDR", 4) == 0) {
+			if (length != 13) {
+				throw ImageError{"png IHDR chunk has the wrong size"};
+			}
+			m_width = readBigEndian(chunk);
+			m_height = readBigEndian(chunk + 4);
+			m_bitDepth = chunk[8];
+			m_colorType = chunk[9];
+			if (m_width == 0 || m_height == 0 || static_cast<uint64_t>(m_width) * m_height > MAX_IMAGE_PIXELS) {
+				throw ImageError{"png size is out of range"};
+			}
+			if (chunk[10] != 0 || chunk[11] != 0) {
+				throw ImageError{"png uses an unknown compression or filter method"};
+			}
+			if (chunk[12] != 0) {
+				throw ImageError{"interlaced pngs are not supported"};
+			}
+
+			const bool validDepth = m_colorType == GRAY ? (m_bitDepth == 1 || m_bitDepth == 2 || m_bitDepth == 4 || m_bitDepth == 8 || m_bitDepth == 16)
+			                        : m_colorType == PALETTE ? (m_bitDepth == 1 || m_bitDepth == 2 || m_bitDepth == 4 || m_bitDepth == 8)
+			                        : m_colorType == RGB || m_colorType == GRAY_ALPHA || m_colorType == RGB_ALPHA ? (m_bitDepth == 8 || m_bitDepth == 16)
+			                        : false;
+			if (!validDepth) {
+				throw ImageError{"png has an invalid color type and bit depth"};
+			}
+			m_channels = m_colorType == GRAY || m_colorType == PALETTE ? 1 : m_colorType == GRAY_ALPHA ? 2 : m_colorType == RGB ? 3 : 4;
+			const uint32_t bitsPerPixel = m_channels * m_bitDepth;
+			m_stride = (static_cast<size_t>(m_width) * bitsPerPixel + 7) / 8;
+			m_filterBytes = std::max(bitsPerPixel / 8, 1u);
+			header = true;
+		} else if (!header) {
+			throw ImageError{"png does not start with an IHDR chunk"};
+		} else if (std::memcmp(type, "PLTE", 4) == 0) {
+			if (length % 3 != 0 || length / 3 > 256) {
+				throw ImageError{"png palette has the wrong size"};
+			}
+			for (uint32_t entry = 0; entry < length / 3; ++entry) {
+				m_palette[entry][0] = chunk[entry * 3];
+				m_palette[entry][1] = chunk[entry * 3 + 1];
+				m_palette[entry][2] = chunk[entry * 3 + 2];
+				m_palette[entry][3] = 255;
+			}
+		} else if (std::memcmp(type, "tRNS", 4) == 0) {
+			if (m_colorType == PALETTE) {
+				for (uint32_t entry = 0; entry < std::min(length, 256u); ++entry) {
+					m_palette[entry][3] = chunk[entry];
+				}
+			} else if ((m_colorType == GRAY && length == 2) || (m_colorType == RGB && length == 6)) {
+				m_hasColorKey = true;
+				for (uint32_t channel = 0; channel < length / 2; ++channel) {
+					m_colorKey[channel] = static_cast<uint16_t>(chunk[channel * 2] << 8 | chunk[channel * 2 + 1]);
+				}
+			}
+		} else if (std::memcmp(type, "IDAT", 4) == 0) {
+			m_compressed.insert(m_compressed.end(), chunk, chunk + length);
+		} else if (std::memcmp(type, "IEND", 4) == 0) {
+			break;
+		} else if ((type[0] & 0x20) == 0) {
+			// ancillary chunks have a lowercase first letter, anything else matters
+			throw ImageError{"png has an unknown critical chunk"};
+		}
+	}
+	if (!header || m_compressed.empty()) {
+		throw ImageError{"png has no image data"};
+	}
+}
+
+void PngDecoder::runSerialTask(size_t) {
+	// a filter byte and the pixels of every row, and never more
+	const size_t expected = (m_stride + 1) * m_height;
+	std::vector<uint8_t> filtered;
+	filtered.reserve(expected);
+	if (!zlibDecompress(m_compressed.data(), m_compressed.size(), filtered, expected)) {
+		throw ImageError{"png image data is corrupt"};
+	}
+	if (filtered.size() < expected) {
+		throw ImageError{"png image data is too short"};
+	}
+	m_compressed = std::vector<uint8_t>{};
+	unfilter(filtered);
+}
+
+void PngDecoder::unfilter(const std::vector<uint8_t> &filtered) {
+	m_rows.resize(m_stride * m_height);
+	const std::vector<uint8_t> zeros(m_stride, 0);
+	const size_t bpp = m_filterBytes;
+	for (uint32_t y = 0; y < m_height; ++y) {
+		const uint8_t *source = filtered.data() + y * (m_stride + 1);
+		const uint8_t filter = *source++;
+		uint8_t *row = m_rows.data() + y * m_stride;
+		const uint8_t *prior = y > 0 ? row - m_stride : zeros.data();
+
+		// bytes before the first whole pixel have no left neighbour
+		switch (filter) {
+			case 0:
+				std::memcpy(row, source, m_stride);
+				break;
+			case 1:
+				std::memcpy(row, source, bpp);
+				for (size_t i = bpp; i < m_stride; ++i) {
+					row[i] = static_cast<uint8_t>(source[i] + row[i - bpp]);
+				}
+				break;
+			case 2:
+				for (size_t i = 0; i < m_stride; ++i) {
+					row[i] = static_cast<uint8_t>(source[i] + prior[i]);
+				}
+				break;
+			case 3:
+				for (size_t i = 0; i < bpp; ++i) {
+					row[i] = static_cast<uint8_t>(source[i] + (prior[i] >> 1));
+				}
+				for (size_t i = bpp; i < m_stride; ++i) {
+					row[i] = static_cast<uint8_t>(source[i] + ((row[i - bpp] + prior[i]) >> 1));
+				}
+				break;
+			case 4:
+				for (size_t i = 0; i < bpp; ++i) {
+					row[i] = static_cast<uint8_t>(source[i] + prior[i]);
+				}
+				for (size_t i = bpp; i < m_stride; ++i) {
+					row[i] = static_cast<uint8_t>(source[i] + paeth(row[i - bpp], prior[i], prior[i - bpp]));
+				}
+				break;
+			default:
+				throw ImageError{"png row has an unknown filter"};
+		}
+	}
+}
+
+void PngDecoder::convertRows(uint32_t block, uint8_t *pixels) const {
+	const uint32_t firstRow = block * rowBlockHeight();
+	const uint32_t lastRow = std::min(firstRow + rowBlockHeight(), m_height);
+	const uint32_t maxValue = (1u << m_bitDepth) - 1;
+	for (uint32_t y = firstRow; y < lastRow; ++y) {
+		const uint8_t *row = m_rows.data() + y * m_stride;
+		uint8_t *out = pixels + static_cast<size_t>(y) * m_width * 4;
+
+		// the common 8 bit layouts
+		if (m_bitDepth == 8 && m_colorType == RGB_ALPHA) {
+			std::memcpy(out, row, static_cast<size_t>(m_width) * 4);
+			continue;
+		}
+		if (m_bitDepth == 8 && m_colorType == RGB && !m_hasColorKey) {
+			for (uint32_t x = 0; x < m_width; ++x) {
+				out[x * 4] = row[x * 3];
+				out[x * 4 + 1] = row[x * 3 + 1];
+				out[x * 4 + 2] = row[x * 3 + 2];
+				out[x * 4 + 3] = 255;
+			}
+			continue;
+		}
+
+		for (uint32_t x = 0; x < m_width; ++x) {
+			// samples at the image's depth, packed most significant bits first below 8
+			uint32_t samples[4];
+			for (uint32_t channel = 0; channel < m_channels; ++channel) {
+				const size_t index = static_cast<size_t>(x) * m_channels + channel;
+				if (m_bitDepth == 16) {
+					samples[channel] = static_cast<uint32_t>(row[index * 2]) << 8 | row[index * 2 + 1];
+				} else if (m_bitDepth == 8) {
+					samples[channel] = row[index];
+				} else {
+					const size_t bit = index * m_bitDepth;
+					samples[channel] = (row[bit / 8] >> (8 - m_bitDepth - bit % 8)) & maxValue;
+				}
+			}
+			auto scale = [&](uint32_t sample) {
+				return static_cast<uint8_t>(m_bitDepth == 16 ? sample >> 8 : sample * 255 / maxValue);
+			};
+
+			uint8_t *texel = out + x * 4;
+			switch (m_colorType) {
+				case GRAY:
+					texel[0] = texel[1] = texel[2] = scale(samples[0]);
+					texel[3] = m_hasColorKey && samples[0] == m_colorKey[0] ? 0 : 255;
+					break;
+				case RGB:
+					texel[0] = scale(samples[0]);
+					texel[1] = scale(samples[1]);
+					texel[2] = scale(samples[2]);
+					texel[3] = m_hasColorKey && samples[0] == m_colorKey[0] && samples[1] == m_colorKey[1] && samples[2] == m_colorKey[2] ? 0 : 255;
+					break;
+				case PALETTE:
+					std::memcpy(texel, m_palette[samples[0]], 4);
+					break;
+				case GRAY_ALPHA:
+					texel[0] = texel[1] = texel[2] = scale(samples[0]);
+					texel[3] = scale(samples[1]);
+					break;
+				default:
+					texel[0] = scale(samples[0]);
+					texel[1] = scale(samples[1]);
+					texel[2] = scale(samples[2]);
+					texel[3] = scale(samples[3]);
+					break;
+			}
+		}
+	}
+}
+
+void PngDecoder::release() {
+	m_compressed = std::vector<uint8_t>{};
+	m_rows = std::vector<uint8_t>{};
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+
+#include "image_decoder.h"
+
+// PNG images of any color type at any bit depth, non-interlaced. The zlib
+// stream and the row filters chain every row to the ones before it, so all
+// of that is one serial task; row blocks then expand the unfiltered rows to
+// rgba8, taking the high byte of 16 bit samples. Chunk checksums are not
+// verified.
+class PngDecoder: public ImageDecoder {
+    uint8_t m_bitDepth = 0;
+    uint8_t m_colorType = 0;
+    uint32_t m_channels = 0;
+    // bytes between the starts of two unfiltered rows, and whole bytes per pixel for filtering
+    size_t m_stride = 0;
+    uint32_t m_filterBytes = 0;
+
+    // rgba entries of the palette, with alpha from tRNS
+    uint8_t m_palette[256][4] = {};
+    // the color that is transparent in gray and rgb images, at the image's depth
+    bool m_hasColorKey = false;
+    uint16_t m_colorKey[3] = {};
+
+    std::vector<uint8_t> m_compressed;
+    // unfiltered rows, without their filter bytes
+    std::vector<uint8_t> m_rows;
+
+    void unfilter(const std::vector<uint8_t> &filtered);
+
+public:
+    using ImageDecoder::ImageDecoder;
+
+    void parse() override;
+
+    inline size_t serialTasks() const override {
+        return 1;
+    }
+
+    void runSerialTask(size_t task) override;
+
+    inline uint32_t rowBlockHeight() const override {
+        return 64;
+    }
+
+    void convertRows(uint32_t block, uint8_t *pixels) const override;
+
+    void release() override;
+
+    // whether data starts with the png signature
+    static bool matches(const uint8_t *data, size_t size);
+};
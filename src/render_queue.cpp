@@ -0,0 +1,141 @@
+#include "render_queue.h"
+
+#include <algorithm>
+#include <array>
+
+#include "glad/glad.h"
+
+#include "gl_state.h"
+#include "texture.h"
+
+namespace {
+
+	constexpr uint32_t PROGRAM_BITS = 12;
+	constexpr uint32_t MATERIAL_BITS = 12;
+	constexpr uint32_t VAO_BITS = 12;
+	constexpr uint32_t DEPTH_BITS = 24;
+
+	constexpr uint32_t DEPTH_SHIFT = 0;
+	constexpr uint32_t VAO_SHIFT = DEPTH_SHIFT + DEPTH_BITS;
+	constexpr uint32_t MATERIAL_SHIFT = VAO_SHIFT + VAO_BITS;
+	constexpr uint32_t PROGRAM_SHIFT = MATERIAL_SHIFT + MATERIAL_BITS;
+	constexpr uint32_t PASS_SHIFT = PROGRAM_SHIFT + PROGRAM_BITS;
+
+	constexpr uint64_t mask(uint32_t bits) {
+		return (uint64_t{1} << bits) - 1;
+	}
+
+	// least significant digit radix sort on 8 bit digits. Digits that are equal
+	// across all keys (usually the pass and program bytes) are skipped.
+	template <typename T>
+	void radixSort(std::vector<T> &values, std::vector<T> &scratch) {
+		const size_t count = values.size();
+		scratch.resize(count);
+
+		// one histogram per byte, filled in a single read of the keys
+		std::array<std::array<uint32_t, 256>, 8> histograms{};
+		for (const T &value : values) {
+			for (uint32_t digit = 0; digit < 8; ++digit) {
+				++histograms[digit][(value.key >> (digit * 8)) & 0xff];
+			}
+		}
+
+		for (uint32_t digit = 0; digit < 8; ++digit) {
+			std::array<uint32_t, 256> &histogram = histograms[digit];
+			const uint32_t firstByte = (values[0].key >> (digit * 8)) & 0xff;
+			if (histogram[firstByte] == count) {
+				continue;
+			}
+
+			// histogram to starting offsets
+			uint32_t offset = 0;
+			for (uint32_t &bucket : histogram) {
+				uint32_t bucketCount = bucket;
+				bucket = offset;
+				offset += bucketCount;
+			}
+
+			for (const T &value : values) {
+				scratch[histogram[(value.key >> (digit * 8)) & 0xff]++] = value;
+			}
+			values.swap(scratch);
+		}
+	}
+
+}
+
+uint64_t makeSortKey(RenderPass pass, uint32_t program, uint32_t material, uint32_t vao, float depth) {
+	// front to back: nearer draws get smaller keys
+	const uint64_t quantizedDepth = static_cast<uint64_t>(std::clamp(depth, 0.0f, 1.0f) * static_cast<float>(mask(DEPTH_BITS)));
+	return (static_cast<uint64_t>(pass) << PASS_SHIFT)
+		| ((program & mask(PROGRAM_BITS)) << PROGRAM_SHIFT)
+		| ((material & mask(MATERIAL_BITS)) << MATERIAL_SHIFT)
+		| ((vao & mask(VAO_BITS)) << VAO_SHIFT)
+		| (quantizedDepth << DEPTH_SHIFT);
+}
+
+void RenderQueue::build(const std::vector<CommandBuffer> &buffers, bool sorted) {
+	m_entries.clear();
+	for (const CommandBuffer &buffer : buffers) {
+		for (const DrawPacket &packet : buffer.packets()) {
+			m_entries.push_back(Entry{packet.key, &packet});
+		}
+	}
+
+	if (sorted && m_entries.size() > 1) {
+		radixSort(m_entries, m_scratch);
+	}
+}
+
+void RenderQueue::submit(FrameStats &stats) const {
+	uint32_t program = 0;
+	uint32_t vao = 0;
+	uint32_t texture = 0;
+	// the image last drawn, and the one the current program's uniforms point at
+	const TextureSlot *image = nullptr;
+	const TextureSlot *uniformImage = nullptr;
+	GLint modelLocation = -1;
+	GLint albedoRectLocation = -1;
+	GLint albedoLayerLocation = -1;
+
+	for (const Entry &entry : m_entries) {
+		const DrawPacket &packet = *entry.packet;
+		if (packet.program != program) {
+			program = packet.program;
+			glstate::useProgram(program);
+			++stats.programChanges;
+
+			modelLocation = glGetUniformLocation(program, "model");
+			albedoRectLocation = glGetUniformLocation(program, "albedoRect");
+			albedoLayerLocation = glGetUniformLocation(program, "albedoLayer");
+			uniformImage = nullptr;
+		}
+		if (packet.vao != vao) {
+			vao = packet.vao;
+			glstate::bindVertexArray(vao);
+			++stats.vaoChanges;
+		}
+		if (packet.texture != nullptr) {
+			const TextureSlot &slot = *packet.texture;
+			if (slot.texture->id() != texture) {
+				texture = slot.texture->id();
+				glstate::bindTexture(ALBEDO_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, texture);
+				++stats.textureChanges;
+			} else if (&slot != image) {
+				++stats.textureBindsSaved;
+			}
+			image = &slot;
+			if (&slot != uniformImage) {
+				uniformImage = &slot;
+				glUniform4fv(albedoRectLocation, 1, &slot.rect[0]);
+				glUniform1i(albedoLayerLocation, static_cast<GLint>(slot.layer));
+			}
+		}
+
+		glUniformMatrix4fv(modelLocation, 1, GL_FALSE, &packet.model[0][0]);
+		glDrawElements(GL_TRIANGLES, packet.indexCount, GL_UNSIGNED_INT,
+		               (void *)(packet.firstIndex * sizeof(uint32_t)));
+		++stats.draws;
+		++stats.drawCalls;
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "command_buffer.h"
+#include "stats.h"
+
+// Passes are the most significant part of a sort key, so every draw of an
+// earlier pass is submitted before any draw of a later one
+enum class RenderPass : uint32_t {
+    Opaque = 0,
+    // depth only, into shadow maps
+    Shadow = 1,
+};
+
+/*
+ *  Sort key layout, most significant bits first:
+ *
+ *  | pass 4 | program 12 | material 12 | vao 12 | depth 24 |
+ *
+ *  Program and VAO names are truncated to their low bits. A collision only
+ *  costs an extra state change, never a wrong draw, since packets keep the
+ *  full names.
+ */
+uint64_t makeSortKey(RenderPass pass, uint32_t program, uint32_t material, uint32_t vao, float depth);
+
+// Merges command buffers recorded in parallel, orders them by sort key and submits
+// them so each program and VAO is bound as few times as possible
+class RenderQueue {
+    struct Entry {
+        uint64_t key;
+        const DrawPacket *packet;
+    };
+
+    std::vector<Entry> m_entries;
+    std::vector<Entry> m_scratch;
+
+public:
+    // gathers packets in the order of the buffers and their packets, sorting them by key when sorted is set
+    void build(const std::vector<CommandBuffer> &buffers, bool sorted = true);
+
+    // replays the queue on the context thread. programs read view and
+    // projection from the Frame uniform block
+    void submit(FrameStats &stats) const;
+
+    inline size_t size() const {
+        return m_entries.size();
+    }
+
+    // packets in submission order
+    inline const DrawPacket &packet(size_t index) const {
+        return *m_entries[index].packet;
+    }
+};
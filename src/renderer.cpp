@@ -0,0 +1,862 @@
+#include "renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <memory>
+#include <numeric>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include "spdlog/spdlog.h"
+
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "image_decoder.h"
+#include "image_loader.h"
+#include "mipmaps.h"
+#include "simulation.h"
+#include "uniforms.h"
+#include "utils.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    // scene colors shared by the opengl, software and path traced paths
+    const glm::vec4 CLEAR_COLOR{0.2f, 0.3f, 0.3f, 1.0f};
+    const glm::vec3 OBJECT_COLOR{1.0f, 0.5f, 0.31f};
+    const glm::vec3 LIGHT_COLOR{1.0f, 1.0f, 1.0f};
+    // brightness of the lamp cube when it lights the path traced scene
+    constexpr float LAMP_RADIANCE = 40.0f;
+    // the lamp as a point light, and the light every lit surface gets regardless
+    constexpr float LAMP_LIGHT_RADIUS = 8.0f;
+    constexpr float LAMP_LIGHT_INTENSITY = 4.0f;
+    constexpr float AMBIENT_LIGHT = 0.1f;
+    // sunlight when shadows are on, falling steeply from behind the camera's start
+    const glm::vec3 SUN_DIRECTION = glm::normalize(glm::vec3{-0.4f, -1.0f, -0.3f});
+    const glm::vec3 SUN_COLOR{0.6f, 0.55f, 0.5f};
+
+    // texture units forward.fs and clustered.fs read the lights and clusters from
+    constexpr uint32_t LIGHT_TEXTURE_UNIT = 1;
+    constexpr uint32_t CLUSTER_TEXTURE_UNIT = 2;
+    // and the shadow maps every lit program reads, clear of the g-buffer's units
+    constexpr uint32_t CASCADE_SHADOW_UNIT = 3;
+    constexpr uint32_t POINT_SHADOW_UNIT = 4;
+
+    // side of the generated textures, squares across them, and bytes streamed in per frame at most
+    constexpr uint32_t TEXTURE_SIZE = 1024;
+    constexpr uint32_t TEXTURE_CHECKS = 8;
+    constexpr size_t TEXTURE_UPLOAD_BUDGET = 8 * 1024 * 1024;
+
+    // parts of a frame timed on the gpu
+    enum GpuScope : uint32_t {
+        GPU_SCENE,
+        GPU_LIGHTING,
+        GPU_SHADOWS,
+        GPU_SCOPE_COUNT,
+    };
+
+}
+
+Renderer::Renderer(GLFWwindow *window, const Options &options, int width, int height)
+        : m_window{window}, m_options{options}, m_width{width}, m_height{height}, m_jobs{options.workerThreads} {
+    m_sortDraws = !options.unsortedDraws;
+}
+
+void Renderer::requestShaderReload() {
+    m_reloadRequested = true;
+}
+
+void Renderer::toggleSorting() {
+    m_sortDraws = !m_sortDraws;
+}
+
+void Renderer::toggleDebugDraw() {
+    m_drawDebug = !m_drawDebug;
+}
+
+void Renderer::resize(int width, int height) {
+    // minimised windows report an empty framebuffer, keep drawing at the last size
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+    m_pendingWidth = width;
+    m_pendingHeight = height;
+    m_resized = true;
+}
+
+bool Renderer::initialize() {
+    // set opengl context
+    spdlog::debug("Setting OpenGL context");
+    glfwMakeContextCurrent(m_window);
+
+    // get opengl function addresses using glad
+    spdlog::debug("Retrieving OpenGL function pointers using glad loader");
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        spdlog::critical("Failed to retrieve OpenGL function pointers");
+        return false;
+    }
+    glext::load((GLADloadproc)glfwGetProcAddress);
+
+    // set opengl viewport to the framebuffer, which is larger than the
+    // window on high density displays
+    spdlog::debug("Setting OpenGL viewport");
+    glViewport(0, 0, m_width, m_height);
+
+    // Enable depth buffer
+    glstate::enable(GL_DEPTH_TEST);
+
+	// setup cube mesh
+	m_cube = Mesh::createCube();
+
+	// pick the submission path
+	m_useIndirect = !m_options.softwareRasterizer && !m_options.perDrawSubmission && glext::support().multiDrawIndirect;
+	if (presentsCpuImages()) {
+		glGenVertexArrays(1, &m_presentVao);
+		glGenTextures(1, &m_presentTexture);
+		resizeCpuTargets();
+	}
+	m_useDeferred = m_options.deferredShading && !presentsCpuImages();
+	if (m_options.deferredShading && !m_useDeferred) {
+		spdlog::warn("Deferred shading needs opengl to draw, ignoring it");
+	}
+	m_useClustered = m_options.clusteredShading && !presentsCpuImages() && !m_useDeferred;
+	if (m_options.clusteredShading && !m_useClustered) {
+		spdlog::warn("Clustered shading needs forward shading with opengl, ignoring it");
+	}
+	m_useShadows = m_options.shadows && !presentsCpuImages();
+	if (m_options.shadows && !m_useShadows) {
+		spdlog::warn("Shadows need opengl to draw, ignoring them");
+	}
+	if (m_useDeferred) {
+		m_deferredRenderer.create(m_width, m_height);
+	}
+	const bool wantsTextures = m_options.textureCount > 0 || !m_options.textureDirectory.empty();
+	m_useTextures = wantsTextures && !presentsCpuImages();
+	if (wantsTextures && !m_useTextures) {
+		spdlog::warn("Textures need opengl to draw, ignoring them");
+	}
+	if (m_useShadows) {
+		m_shadowRenderer.create(m_options.shadowCaching);
+		spdlog::info("Drawing shadows {}", m_options.shadowCaching ? "over cached static casters" : "without caching");
+	}
+	if (m_options.softwareRasterizer) {
+		spdlog::info("Rasterizing on the cpu with the {} kernel", m_softRasterizer.kernelName());
+		m_softRasterizer.setClearColor(CLEAR_COLOR);
+		m_softRasterizer.setMesh(m_cube.vao(), m_cube.positions(), m_cube.indices());
+	} else {
+		spdlog::info("Submitting draws {}", m_useIndirect ? "with multi-draw indirect" : "one call per draw");
+	}
+
+	// bound how far the cpu runs ahead; per-frame resources are indexed by its slots
+	m_frames.create(m_options.framesInFlight);
+	if (m_useIndirect) {
+		m_indirectRenderer.create(m_frames);
+	}
+	m_gpuTimer.create(m_frames, GPU_SCOPE_COUNT);
+
+	// per-frame data is streamed without mapping buffers every frame
+	m_frameUniformStream.create(m_frames, sizeof(FrameUniforms));
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &m_uniformAlignment);
+	m_debugDraw.create(m_frames);
+	if (m_useClustered) {
+		m_clusterStream.create(m_frames, CLUSTER_COUNT * 2 * sizeof(uint32_t));
+		glGenTextures(1, &m_clusterTexture);
+		m_clusterSource = 0;
+	}
+	if (m_useShadows) {
+		m_shadowUniformStream.create(m_frames, sizeof(ShadowUniforms));
+	}
+	spdlog::info("Streaming per-frame data {}", m_frameUniformStream.persistent() ? "through persistent mappings" : "by orphaning buffers");
+
+	// the lights decide how surfaces are shaded, so they come before the shaders
+	createLights();
+
+	// compile and link shader programs, those used in earlier runs first
+	m_shaders.create(m_options.shaderDirectory, m_options.shaderCacheDirectory);
+	defineShaders();
+	m_shaders.prewarm();
+	compileShaders();
+
+	// build the scene
+	m_scene.objects.push_back(Object{glm::vec3{0.0f, 0.0f, 0.0f}, glm::vec3{1.0f}, &m_shader, &m_cube});
+	m_lightObject = m_scene.objects.size();
+	m_scene.objects.push_back(Object{glm::vec3{0.0f}, glm::vec3{0.2f}, &m_lightingShader, &m_cube});
+	// the lamp follows the simulation, so its shadow is never cached
+	m_scene.objects.back().dynamic = true;
+	if (m_options.benchmarkObjects > 0) {
+		spdlog::info("Adding {} benchmark objects", m_options.benchmarkObjects);
+		m_scene.addBenchmarkGrid(m_options.benchmarkObjects, &m_shader, &m_cube);
+	}
+
+	// surfaces without a map of their own read white
+	if (!presentsCpuImages()) {
+		const uint8_t white[4] = {255, 255, 255, 255};
+		m_whiteTexture.create(1, 1, MipChain{std::vector<uint8_t>{white, white + 4}}, 1);
+		glstate::bindTexture(ALBEDO_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, m_whiteTexture.id());
+	}
+	if (m_useTextures) {
+		createTextures();
+	}
+
+	// the lamp lights diffuse cubes, with the clear color as the sky
+	m_pathTracer.setMaterial(&m_shader, PathMaterial{OBJECT_COLOR, glm::vec3{0.0f}});
+	m_pathTracer.setMaterial(&m_lightingShader, PathMaterial{glm::vec3{0.0f}, LIGHT_COLOR * LAMP_RADIANCE});
+	m_pathTracer.setBackground(glm::vec3{CLEAR_COLOR});
+
+	m_shaders.setLoading(false);
+	return true;
+}
+
+void Renderer::shutdown() {
+    // delete opengl objects
+    spdlog::debug("Deleting OpenGL objects");
+    m_frames.destroy();
+    m_shaders.destroy();
+    glstate::deleteTexture(m_presentTexture);
+    glstate::deleteVertexArray(m_presentVao);
+    m_presentTexture = m_presentVao = 0;
+    m_indirectRenderer.destroy();
+    m_deferredRenderer.destroy();
+    m_shadowRenderer.destroy();
+    m_shadowUniformStream.destroy();
+    m_textureStreamer.destroy();
+    m_whiteTexture.destroy();
+    m_gpuTimer.destroy();
+    glstate::deleteTexture(m_lightTexture);
+    m_lightTexture = m_lightSource = 0;
+    m_lightStream.destroy();
+    glstate::deleteTexture(m_clusterTexture);
+    m_clusterTexture = m_clusterSource = 0;
+    m_clusterStream.destroy();
+    m_debugDraw.destroy();
+    m_frameUniformStream.destroy();
+    m_cube.deleteMesh();
+}
+
+void Renderer::defineShaders() {
+	// every program reads view and projection from the shared Frame block, and lit ones the Shadow block
+	for (const UniformBlockBinding &block : UNIFORM_BLOCK_BINDINGS) {
+		m_shaders.bindUniformBlock(block.name, block.binding);
+	}
+
+	m_shaders.define("surface", "surface.vs", "surface.fs");
+	m_shaders.define("lamp", "surface.vs", "lighting.fs");
+	m_shaders.define("gbuffer", "surface.vs", "gbuffer.fs");
+	m_shaders.define("debug", "debug.vs", "debug.fs");
+	m_shaders.define("present", "present.vs", "present.fs");
+	m_shaders.define("deferred_ambient", "present.vs", "deferred_ambient.fs");
+	m_shaders.define("deferred_light", "deferred_light.vs", "deferred_light.fs");
+	m_shaders.define("shadow", "shadow.vs", "shadow.fs");
+}
+
+void Renderer::compileShaders() {
+	// surfaces are lit by the point lights when there are any, and only
+	// write the g-buffer when shading is deferred. programs ignore keywords they lack
+	uint32_t keywords = 0;
+	if (!m_scene.lights.empty()) {
+		keywords |= SHADER_LIT;
+	}
+	if (m_useClustered) {
+		keywords |= SHADER_CLUSTERED;
+	}
+	if (m_useShadows) {
+		keywords |= SHADER_SHADOWS;
+	}
+	if (m_useTextures) {
+		keywords |= SHADER_ALBEDO_MAP;
+	}
+	const char *surfaceProgram = m_useDeferred ? "gbuffer" : "surface";
+	const char *lampProgram = m_useDeferred ? "gbuffer" : "lamp";
+
+	m_shader = m_shaders.variant(surfaceProgram, keywords);
+	m_lightingShader = m_shaders.variant(lampProgram, keywords | SHADER_EMISSIVE);
+	setSurfaceUniforms(m_shader, m_lightingShader);
+
+	// multi-draw indirect variants read per draw data from a buffer
+	if (m_useIndirect) {
+		m_indirectShader = m_shaders.variant(surfaceProgram, keywords | SHADER_INDIRECT);
+		m_indirectLightingShader = m_shaders.variant(lampProgram, keywords | SHADER_EMISSIVE | SHADER_INDIRECT);
+		setSurfaceUniforms(m_indirectShader, m_indirectLightingShader);
+
+		m_indirectRenderer.setVariant(m_shader.id(), m_indirectShader.id());
+		m_indirectRenderer.setVariant(m_lightingShader.id(), m_indirectLightingShader.id());
+	}
+
+	if (m_useDeferred) {
+		m_ambientShader = m_shaders.variant("deferred_ambient", keywords);
+		m_ambientShader.bind();
+		m_ambientShader.setInt("gAlbedo", 0);
+		m_ambientShader.setInt("gNormal", 1);
+		m_ambientShader.setInt("gDepth", 2);
+		m_ambientShader.setFloat("ambient", AMBIENT_LIGHT);
+
+		m_lightVolumeShader = m_shaders.variant("deferred_light", keywords);
+		m_lightVolumeShader.bind();
+		m_lightVolumeShader.setInt("gAlbedo", 0);
+		m_lightVolumeShader.setInt("gNormal", 1);
+		m_lightVolumeShader.setInt("gDepth", 2);
+		for (const Shader *program : {&m_ambientShader, &m_lightVolumeShader}) {
+			program->bind();
+			program->setInt("cascadeShadowMap", CASCADE_SHADOW_UNIT);
+			program->setInt("pointShadowMap", POINT_SHADOW_UNIT);
+		}
+	}
+
+	if (m_useShadows) {
+		m_shadowShader = m_shaders.variant("shadow", 0);
+	}
+
+	// the debug lines can be toggled on in any frame, so their program is built with the rest
+	m_debugShader = m_shaders.variant("debug", 0);
+
+	if (presentsCpuImages()) {
+		m_presentShader = m_shaders.variant("present", 0);
+		m_presentShader.bind();
+		m_presentShader.setInt("image", 0);
+	}
+
+	// the software rasterizer stands in for both programs by id
+	if (m_options.softwareRasterizer) {
+		m_softLightingShader.setColors(OBJECT_COLOR, LIGHT_COLOR);
+		m_softRasterizer.setShader(m_shader.id(), &m_softBasicShader);
+		m_softRasterizer.setShader(m_lightingShader.id(), &m_softLightingShader);
+	}
+}
+
+void Renderer::setSurfaceUniforms(const Shader &surface, const Shader &lamp) const {
+	surface.bind();
+	surface.setInt("albedoMap", ALBEDO_TEXTURE_UNIT);
+	surface.setFloat4("albedoRect", TextureSlot{}.rect);
+	surface.setInt("albedoLayer", 0);
+	if (m_useDeferred) {
+		surface.setFloat3("albedo", OBJECT_COLOR);
+		lamp.bind();
+		lamp.setFloat3("albedo", LIGHT_COLOR * OBJECT_COLOR);
+		return;
+	}
+
+	if (!m_scene.lights.empty()) {
+		surface.setFloat3("albedo", OBJECT_COLOR);
+		surface.setFloat("ambient", AMBIENT_LIGHT);
+		surface.setInt("lights", LIGHT_TEXTURE_UNIT);
+		// the samplers get units of their own, two sampler types may not share one
+		surface.setInt("cascadeShadowMap", CASCADE_SHADOW_UNIT);
+		surface.setInt("pointShadowMap", POINT_SHADOW_UNIT);
+		if (m_useClustered) {
+			surface.setInt("clusters", CLUSTER_TEXTURE_UNIT);
+			surface.setInt3("clusterGrid", glm::ivec3{CLUSTER_TILES_X, CLUSTER_TILES_Y, CLUSTER_SLICES});
+			surface.setFloat2("clusterDepth", LightClusters::depthScaleBias(NEAR_PLANE, FAR_PLANE));
+		} else {
+			surface.setInt("lightCount", static_cast<int>(m_scene.lights.size()));
+		}
+	}
+	lamp.bind();
+	lamp.setFloat3("objectColor", OBJECT_COLOR);
+	lamp.setFloat3("lightColor",  LIGHT_COLOR);
+}
+
+void Renderer::createLights() {
+	// the cpu backends draw flat colors only
+	uint32_t count = presentsCpuImages() ? 0 : m_options.lightCount;
+	if (m_useDeferred || m_useClustered || m_useShadows) {
+		count = std::max(count, 1u);
+	}
+	if (count == 0) {
+		return;
+	}
+
+	// the lamp follows the simulation and is updated every frame
+	m_scene.lights.push_back(PointLight{glm::vec3{0.0f}, LAMP_LIGHT_RADIUS, LIGHT_COLOR * LAMP_LIGHT_INTENSITY});
+	m_scene.addBenchmarkLights(count - 1);
+	spdlog::info("Shading {} point lights {}", m_scene.lights.size(), m_useDeferred ? "deferred" : m_useClustered ? "clustered forward" : "forward");
+
+	// the lamp moves, so all of them are streamed every frame like the other per-frame data
+	m_lightStream.create(m_frames, m_scene.lights.size() * sizeof(PointLight));
+	glGenTextures(1, &m_lightTexture);
+	m_lightSource = 0;
+}
+
+void Renderer::createTextures() {
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<LoadedImage> images;
+	std::vector<std::unique_ptr<TextureFile>> compiled;
+	if (!m_options.textureDirectory.empty()) {
+		// compiled textures are mapped as they are, and stand in for the images they were compiled from
+		std::vector<std::filesystem::path> sources = listImages(m_options.textureDirectory);
+		size_t compiledBytes = 0;
+		for (const std::filesystem::path &path : listTextureFiles(m_options.textureDirectory)) {
+			auto file = std::make_unique<TextureFile>();
+			try {
+				file->open(path);
+			} catch (const ImageError &e) {
+				spdlog::warn("Skipping compiled texture {}: {}", path.string(), e.what());
+				continue;
+			}
+			if (!isFormatSupported(file->format())) {
+				spdlog::warn("Skipping compiled texture {}: {} is unsupported by this context", path.string(), formatName(file->format()));
+				continue;
+			}
+			sources.erase(std::remove_if(sources.begin(), sources.end(), [&path](const std::filesystem::path &source) {
+				return source.stem() == path.stem();
+			}), sources.end());
+			compiledBytes += file->file().size();
+			compiled.push_back(std::move(file));
+		}
+		if (!compiled.empty()) {
+			spdlog::info("Mapped {} compiled textures from {}, {:.1f} MiB, in {:.1f} ms", compiled.size(), m_options.textureDirectory,
+			             compiledBytes / (1024.0 * 1024.0), std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+
+		if (!sources.empty()) {
+			ImageLoadStats load;
+			images = loadImages(m_jobs, sources, m_options.mipFilter, load);
+			spdlog::info("Loaded {} of {} images from {}, {:.1f} MiB of files to {:.1f} MiB of pixels",
+			             images.size(), load.files, m_options.textureDirectory, load.fileBytes / (1024.0 * 1024.0), load.decodedBytes / (1024.0 * 1024.0));
+			spdlog::info("Image loading took {:.1f} ms: {:.1f} ms reading, {:.1f} ms decoding at {:.0f} MB/s, {:.1f} ms making mips",
+			             load.totalMs, load.readMs, load.decodeMs, load.decodeMegabytesPerSecond(), load.mipMs);
+		}
+	} else {
+		// checkers in a color of their own, with dark lines between the squares
+		images.resize(m_options.textureCount);
+		m_jobs.parallelFor(images.size(), 1, [&](size_t begin, size_t end, uint32_t) {
+			for (size_t index = begin; index < end; ++index) {
+				const float hue = std::fmod(0.618034f * static_cast<float>(index), 1.0f) * 6.0f;
+				const glm::vec3 color = glm::clamp(glm::vec3{std::fabs(hue - 3.0f) - 1.0f, 2.0f - std::fabs(hue - 2.0f), 2.0f - std::fabs(hue - 4.0f)}, 0.0f, 1.0f);
+				const uint32_t check = TEXTURE_SIZE / TEXTURE_CHECKS;
+				std::vector<uint8_t> pixels(static_cast<size_t>(TEXTURE_SIZE) * TEXTURE_SIZE * 4);
+				for (uint32_t y = 0; y < TEXTURE_SIZE; ++y) {
+					for (uint32_t x = 0; x < TEXTURE_SIZE; ++x) {
+						const bool line = x % check < 4 || y % check < 4;
+						const float shade = line ? 0.2f : ((x / check + y / check) & 1) != 0 ? 1.0f : 0.6f;
+						uint8_t *texel = &pixels[(static_cast<size_t>(y) * TEXTURE_SIZE + x) * 4];
+						texel[0] = static_cast<uint8_t>(0.5f + 255.0f * shade * (0.3f + 0.7f * color.x));
+						texel[1] = static_cast<uint8_t>(0.5f + 255.0f * shade * (0.3f + 0.7f * color.y));
+						texel[2] = static_cast<uint8_t>(0.5f + 255.0f * shade * (0.3f + 0.7f * color.z));
+						texel[3] = 255;
+					}
+				}
+				images[index].width = TEXTURE_SIZE;
+				images[index].height = TEXTURE_SIZE;
+				images[index].chain = buildMipChain(TEXTURE_SIZE, TEXTURE_SIZE, std::move(pixels), m_options.mipFilter);
+			}
+		});
+	}
+
+	m_textureStreamer.create(m_frames, static_cast<size_t>(m_options.textureBudgetMiB) * 1024 * 1024, TEXTURE_UPLOAD_BUDGET, m_options.textureLayers);
+	std::vector<const TextureSlot *> slots;
+	for (std::unique_ptr<TextureFile> &file : compiled) {
+		slots.push_back(m_textureStreamer.add(std::move(file)));
+	}
+	for (LoadedImage &image : images) {
+		slots.push_back(m_textureStreamer.add(image.width, image.height, std::move(image.chain)));
+	}
+	if (slots.empty()) {
+		spdlog::warn("No textures to stream");
+		return;
+	}
+	m_textureStreamer.pack(m_jobs);
+	spdlog::info("Streaming {} images in {} array textures under a {} MiB budget, {:.1f} ms to load them",
+	             slots.size(), m_textureStreamer.textureCount(), m_options.textureBudgetMiB,
+	             std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+	// every surface gets a map. materials are numbered array by array, so
+	// draws sorted by material bind each array once
+	std::vector<uint32_t> order(slots.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&slots](uint32_t a, uint32_t b) {
+		if (slots[a]->texture->handle() != slots[b]->texture->handle()) {
+			return slots[a]->texture->handle() < slots[b]->texture->handle();
+		}
+		return slots[a]->layer != slots[b]->layer ? slots[a]->layer < slots[b]->layer : a < b;
+	});
+	std::vector<uint32_t> materials(slots.size());
+	for (uint32_t i = 0; i < order.size(); ++i) {
+		materials[order[i]] = i + 1;
+	}
+	for (size_t i = 0; i < m_scene.objects.size(); ++i) {
+		Object &object = m_scene.objects[i];
+		if (i == m_lightObject) {
+			continue;
+		}
+		const size_t slot = i % slots.size();
+		object.texture = slots[slot];
+		object.material = materials[slot];
+	}
+}
+
+size_t Renderer::streamLights() {
+	const size_t bytes = m_scene.lights.size() * sizeof(PointLight);
+	m_lightStream.beginFrame(bytes);
+	const size_t offset = m_lightStream.write(m_scene.lights.data(), bytes, sizeof(PointLight));
+	m_lightStream.flush();
+
+	// as with the clusters, the texture views the whole buffer and shaders start at this frame's part
+	glstate::bindTexture(LIGHT_TEXTURE_UNIT, GL_TEXTURE_BUFFER, m_lightTexture);
+	if (m_lightSource != m_lightStream.id()) {
+		m_lightSource = m_lightStream.id();
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_lightSource);
+	}
+	if (!m_useDeferred) {
+		const int base = static_cast<int>(offset / (sizeof(PointLight) / 2));
+		for (const Shader *program : {&m_shader, &m_indirectShader}) {
+			if (program->id() != 0) {
+				program->bind();
+				program->setInt("lightBase", base);
+			}
+		}
+	}
+	return offset;
+}
+
+void Renderer::assignLights(FrameStats &stats) {
+	auto start = std::chrono::steady_clock::now();
+	m_lightClusters.assign(m_jobs, m_camera, m_scene.lights);
+	stats.lightAssignMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	const std::vector<uint32_t> &data = m_lightClusters.data();
+	const size_t bytes = data.size() * sizeof(uint32_t);
+	m_clusterStream.beginFrame(bytes);
+	const size_t offset = m_clusterStream.write(data.data(), bytes, sizeof(uint32_t));
+	m_clusterStream.flush();
+
+	// growing the stream replaces its buffer, so re-point the texture. the
+	// texture views the whole buffer and shaders start at this frame's part
+	glstate::bindTexture(CLUSTER_TEXTURE_UNIT, GL_TEXTURE_BUFFER, m_clusterTexture);
+	if (m_clusterSource != m_clusterStream.id()) {
+		m_clusterSource = m_clusterStream.id();
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, m_clusterSource);
+	}
+	const int base = static_cast<int>(offset / sizeof(uint32_t));
+	for (const Shader *program : {&m_shader, &m_indirectShader}) {
+		if (program->id() != 0) {
+			program->bind();
+			program->setInt("clusterBase", base);
+		}
+	}
+}
+
+void Renderer::drawShadows(FrameStats &stats) {
+	m_shadowRenderer.update(m_camera, SUN_DIRECTION, SUN_COLOR, m_scene.lights[0]);
+
+	m_gpuTimer.begin(GPU_SHADOWS);
+	m_shadowRenderer.render(m_scene, m_shadowShader, stats);
+	m_gpuTimer.end(GPU_SHADOWS);
+	glViewport(0, 0, m_width, m_height);
+
+	m_shadowUniformStream.beginFrame();
+	const size_t offset = m_shadowUniformStream.write(&m_shadowRenderer.uniforms(), sizeof(ShadowUniforms), m_uniformAlignment);
+	m_shadowUniformStream.flush();
+	glstate::bindBufferRange(GL_UNIFORM_BUFFER, SHADOW_UNIFORMS_BINDING, m_shadowUniformStream.id(), offset, sizeof(ShadowUniforms));
+	m_shadowRenderer.bindMaps(CASCADE_SHADOW_UNIT, POINT_SHADOW_UNIT);
+}
+
+void Renderer::processRequests() {
+    if (m_reloadRequested.exchange(false)) {
+        spdlog::debug("Reloading changed shader sources");
+        m_shaders.reload();
+        compileShaders();
+        m_prewarmPending = true;
+    }
+    if (m_resized.exchange(false)) {
+        spdlog::debug("Window resized. Setting OpenGL viewport");
+        m_width = m_pendingWidth;
+        m_height = m_pendingHeight;
+        glViewport(0, 0, m_width, m_height);
+        if (presentsCpuImages()) {
+            resizeCpuTargets();
+        }
+        if (m_useDeferred) {
+            m_deferredRenderer.resize(m_width, m_height);
+        }
+    }
+}
+
+void Renderer::prewarm(Simulation &simulation) {
+    if (!m_prewarmPending) {
+        return;
+    }
+    m_prewarmPending = false;
+    // images made on the cpu have no programs to warm
+    if (!m_options.prewarm || presentsCpuImages()) {
+        return;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    FrameStats stats;
+    m_frames.beginFrame();
+    glstate::enable(GL_SCISSOR_TEST);
+    glScissor(0, 0, 1, 1);
+    // with the debug lines, which are drawn from when they are first toggled on
+    drawFrame(simulation.latestSnapshot().interpolate(glfwGetTime()), true, stats);
+    glstate::disable(GL_SCISSOR_TEST);
+    // some drivers compile on a thread of their own, wait for them here instead of in a frame
+    glFinish();
+    m_frames.endFrame();
+
+    // the shadow cache only holds the pixel drawn
+    if (m_useShadows) {
+        m_shadowRenderer.invalidate();
+    }
+    spdlog::info("Prewarmed a frame of {} draws and {} shadow draws in {:.1f} ms", stats.drawCalls, stats.shadowDraws,
+                 std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
+
+void Renderer::resizeCpuTargets() {
+    if (m_options.softwareRasterizer) {
+        m_softRasterizer.resize(static_cast<uint32_t>(m_width), static_cast<uint32_t>(m_height));
+    }
+    if (m_options.pathTraceSamples > 0) {
+        m_pathTracer.resize(static_cast<uint32_t>(m_width), static_cast<uint32_t>(m_height));
+    }
+    glstate::bindTexture(0, GL_TEXTURE_2D, m_presentTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_width, m_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+void Renderer::submitSoftware(FrameStats &stats) {
+    m_softRasterizer.render(m_jobs, m_renderQueue, m_camera.viewProjection(), stats);
+    presentImage(m_softRasterizer.color(), m_softRasterizer.stride());
+}
+
+void Renderer::presentImage(const uint32_t *pixels, uint32_t stride) {
+    glstate::bindTexture(0, GL_TEXTURE_2D, m_presentTexture);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(stride));
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+    glstate::disable(GL_DEPTH_TEST);
+    glstate::useProgram(m_presentShader.id());
+    glstate::bindVertexArray(m_presentVao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glstate::enable(GL_DEPTH_TEST);
+}
+
+void Renderer::run(Simulation &simulation) {
+    if (!initialize()) {
+        m_failed = true;
+        glfwSetWindowShouldClose(m_window, true);
+        glfwPostEmptyEvent();
+        return;
+    }
+
+    if (m_options.pathTraceSamples > 0) {
+        traceReference(simulation);
+        shutdown();
+        glfwMakeContextCurrent(nullptr);
+        return;
+    }
+
+    m_prewarmPending = true;
+    prewarm(simulation);
+
+    uint32_t frameCount = 0;
+    bool sortedLastFrame = m_sortDraws;
+    double lastFrame = glfwGetTime();
+    double lastMeasuredInput = 0.0;
+
+    // render loop
+    while (!glfwWindowShouldClose(m_window)) {
+        // update frame time
+        double currentFrame = glfwGetTime();
+        FrameStats stats;
+        stats.frameMs = (currentFrame - lastFrame) * 1000.0;
+        lastFrame = currentFrame;
+
+        // before taking a frame slot, so programs a reload rebuilt are prewarmed in one of their own
+        processRequests();
+        prewarm(simulation);
+        glstate::resetCounters();
+
+        // wait until the gpu has released this frame's slot
+        stats.fenceWaitMs = m_frames.beginFrame();
+
+        // pick up the newest simulation state
+        if (m_options.inlineSimulation) {
+            simulation.tick();
+        }
+        const FrameSnapshot &snapshot = simulation.latestSnapshot();
+
+        if (m_sortDraws != sortedLastFrame) {
+            sortedLastFrame = m_sortDraws;
+            spdlog::info("Draw sorting {}", sortedLastFrame ? "enabled" : "disabled");
+            m_statsReporter.restartWindow(currentFrame);
+        }
+
+        // blend the last two simulation steps for the time this frame is drawn
+        drawFrame(snapshot.interpolate(currentFrame), m_drawDebug, stats);
+
+        // swap buffers
+        glfwSwapBuffers(m_window);
+        m_frames.endFrame();
+
+        // latency from the oldest input in this frame to it being presented
+        if (snapshot.inputTime > lastMeasuredInput) {
+            lastMeasuredInput = snapshot.inputTime;
+            stats.inputLatencyMs = (glfwGetTime() - snapshot.inputTime) * 1000.0;
+            stats.inputLatencySamples = 1;
+        }
+        m_statsReporter.add(stats, currentFrame);
+
+        // benchmark runs stop after a fixed number of frames
+        if (m_options.frameLimit > 0 && ++frameCount >= m_options.frameLimit) {
+            glfwSetWindowShouldClose(m_window, true);
+            glfwPostEmptyEvent();
+        }
+    }
+    m_statsReporter.run().log(m_sortDraws ? "Run (sorted)" : "Run (unsorted)");
+
+    // hitches from work the driver put off until first draws show up here
+    const StartupSpike spike = m_statsReporter.startupSpike();
+    if (spike.ratio > 0.0) {
+        spdlog::info("First {} frames: worst {:.3f} ms at frame {}, {:.1f}x the {:.3f} ms median after them", STARTUP_FRAMES, spike.worstMs,
+                     spike.worstFrame, spike.ratio, spike.medianMs);
+        if (m_options.maxStartupSpike > 0 && spike.ratio > m_options.maxStartupSpike) {
+            spdlog::error("The first frames spiked past --max-startup-spike {}", m_options.maxStartupSpike);
+            m_failed = true;
+        }
+    } else if (m_options.maxStartupSpike > 0) {
+        spdlog::warn("--max-startup-spike needs a run of at least {} frames", 2 * STARTUP_FRAMES);
+    }
+
+    shutdown();
+    glfwMakeContextCurrent(nullptr);
+}
+
+void Renderer::traceReference(Simulation &simulation) {
+    const uint32_t targetSamples = m_options.pathTraceSamples;
+    const SimulationState state = simulation.latestSnapshot().interpolate(glfwGetTime());
+    m_scene.objects[m_lightObject].position = state.lightPos;
+    m_pathTracer.build(m_scene);
+    spdlog::info("Path tracing {} samples per pixel over {} triangles", targetSamples, m_pathTracer.triangleCount());
+
+    uint64_t cameraVersion = 0;
+    while (!glfwWindowShouldClose(m_window) && m_pathTracer.samples() < targetSamples) {
+        // resizing starts the image over
+        processRequests();
+        updateCamera(state);
+        if (m_camera.version() != cameraVersion) {
+            cameraVersion = m_camera.version();
+            m_pathTracer.setCamera(m_camera);
+        }
+
+        m_pathTracer.renderPass(m_jobs);
+        presentImage(m_pathTracer.color(), m_pathTracer.width());
+        glfwSwapBuffers(m_window);
+        spdlog::debug("Sample {}: {:.2f} Mrays/s per core", m_pathTracer.samples(), m_pathTracer.raysPerSecondPerCore() * 1e-6);
+    }
+
+    spdlog::info("Traced {} samples per pixel, {} rays at {:.2f} Mrays/s per core on {} threads",
+                 m_pathTracer.samples(), m_pathTracer.rays(), m_pathTracer.raysPerSecondPerCore() * 1e-6, m_jobs.threadCount());
+    if (m_pathTracer.samples() >= targetSamples) {
+        if (utils::fileWritePpm(fs::path{m_options.outputPath}, m_pathTracer.width(), m_pathTracer.height(), m_pathTracer.color(), m_pathTracer.width())) {
+            spdlog::info("Wrote reference image to {}", m_options.outputPath);
+        } else {
+            spdlog::error("Failed to write reference image to {}", m_options.outputPath);
+        }
+    }
+
+    glfwSetWindowShouldClose(m_window, true);
+    glfwPostEmptyEvent();
+}
+
+void Renderer::updateCamera(const SimulationState &state) {
+    m_camera.setPosition(state.cameraPosition);
+    m_camera.setOrientation(state.yaw, state.pitch);
+    m_camera.setZoom(state.zoom);
+    m_camera.setPerspective(static_cast<float>(m_width) / static_cast<float>(m_height), NEAR_PLANE, FAR_PLANE);
+    m_camera.update();
+}
+
+void Renderer::drawFrame(const SimulationState &state, bool drawDebug, FrameStats &stats) {
+    // gpu times of the last frame that used this slot
+    m_gpuTimer.collect();
+    stats.gpuSceneMs = m_gpuTimer.milliseconds(GPU_SCENE);
+    stats.gpuLightingMs = m_gpuTimer.milliseconds(GPU_LIGHTING);
+    stats.gpuShadowMs = m_gpuTimer.milliseconds(GPU_SHADOWS);
+
+    // set the screen to a static color
+    glClearColor(CLEAR_COLOR.x, CLEAR_COLOR.y, CLEAR_COLOR.z, CLEAR_COLOR.w);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    /*
+     *  Draw triangles
+     */
+
+    // record draw packets off the gl thread
+    updateCamera(state);
+
+    m_scene.objects[m_lightObject].position = state.lightPos;
+    if (m_useTextures) {
+        m_textureStreamer.update(m_scene, m_camera, static_cast<uint32_t>(m_height), stats);
+    }
+    m_scene.record(m_jobs, m_camera, m_commandBuffers);
+
+    // only the lamp moves, but the lights are streamed whole so no frame in flight sees them change
+    size_t lightOffset = 0;
+    if (!m_scene.lights.empty()) {
+        m_scene.lights[0].position = state.lightPos;
+        lightOffset = streamLights();
+    }
+    if (m_useClustered) {
+        assignLights(stats);
+    }
+    if (m_useShadows) {
+        drawShadows(stats);
+    }
+
+    // stream projection and view matrices, only rebuilt when the camera changed
+    if (m_camera.version() != m_frameUniformsVersion) {
+        m_frameUniformsVersion = m_camera.version();
+        m_frameUniforms.view = m_camera.view();
+        m_frameUniforms.projection = m_camera.projection();
+        m_frameUniforms.viewProjection = m_camera.viewProjection();
+        m_frameUniforms.inverseViewProjection = m_camera.inverseViewProjection();
+    }
+    m_frameUniforms.viewport = glm::vec4{static_cast<float>(m_width), static_cast<float>(m_height), 1.0f / static_cast<float>(m_width), 1.0f / static_cast<float>(m_height)};
+    m_frameUniformStream.beginFrame();
+    size_t frameUniformOffset = m_frameUniformStream.write(&m_frameUniforms, sizeof(FrameUniforms), m_uniformAlignment);
+    m_frameUniformStream.flush();
+    glstate::bindBufferRange(GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, m_frameUniformStream.id(), frameUniformOffset, sizeof(FrameUniforms));
+
+    // sort and replay recorded draws
+    auto submitStart = std::chrono::steady_clock::now();
+    m_renderQueue.build(m_commandBuffers, m_sortDraws);
+    if (m_options.softwareRasterizer) {
+        submitSoftware(stats);
+    } else {
+        m_gpuTimer.begin(GPU_SCENE);
+        if (m_useDeferred) {
+            m_deferredRenderer.beginGeometry();
+        }
+        if (m_useIndirect) {
+            m_indirectRenderer.submit(m_renderQueue, stats);
+        } else {
+            m_renderQueue.submit(stats);
+        }
+        m_gpuTimer.end(GPU_SCENE);
+    }
+    if (m_useDeferred) {
+        m_gpuTimer.begin(GPU_LIGHTING);
+        m_deferredRenderer.light(m_ambientShader, m_lightVolumeShader, m_lightStream.id(), lightOffset, static_cast<uint32_t>(m_scene.lights.size()), stats);
+        m_gpuTimer.end(GPU_LIGHTING);
+    }
+    stats.submitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - submitStart).count();
+    stats.stateCallsIssued = glstate::counters().issued;
+    stats.stateCallsElided = glstate::counters().elided;
+
+    // debug lines for the world origin and the light
+    if (drawDebug) {
+        if (m_useDeferred) {
+            m_deferredRenderer.copyDepth();
+        }
+        m_debugDraw.axes(glm::vec3{0.0f}, 1.0f);
+        m_debugDraw.cross(state.lightPos, 0.5f, glm::vec3{1.0f, 1.0f, 0.0f});
+        m_debugDraw.submit(m_debugShader, stats);
+    }
+}
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "camera.h"
+#include "command_buffer.h"
+#include "debug_draw.h"
+#include "deferred.h"
+#include "frame_controller.h"
+#include "gpu_timer.h"
+#include "indirect.h"
+#include "jobs.h"
+#include "light_clusters.h"
+#include "mesh.h"
+#include "options.h"
+#include "path_tracer.h"
+#include "render_queue.h"
+#include "scene.h"
+#include "shader_library.h"
+#include "shaders.h"
+#include "shadows.h"
+#include "soft_raster.h"
+#include "stats.h"
+#include "stream_buffer.h"
+#include "texture.h"
+#include "texture_streamer.h"
+#include "uniforms.h"
+
+struct GLFWwindow;
+struct SimulationState;
+class Simulation;
+
+// Clip planes
+constexpr float NEAR_PLANE = 0.1f;
+constexpr float FAR_PLANE = 100.0f;
+
+// Owns the opengl context and everything created with it, and draws frames
+// interpolated from simulation snapshots. run() is the render thread; the request methods
+// may be called from any thread and take effect at the start of a frame.
+class Renderer {
+    GLFWwindow *m_window;
+    Options m_options;
+    int m_width;
+    int m_height;
+
+    // requests from other threads
+    std::atomic<bool> m_reloadRequested{false};
+    std::atomic<bool> m_sortDraws{true};
+    std::atomic<bool> m_drawDebug{false};
+    std::atomic<bool> m_resized{false};
+    std::atomic<int> m_pendingWidth{0};
+    std::atomic<int> m_pendingHeight{0};
+    std::atomic<bool> m_failed{false};
+    // whether programs were built since the last prewarm
+    bool m_prewarmPending = false;
+
+    // shader programs, the variants of m_shaders this configuration draws with
+    ShaderLibrary m_shaders;
+    Shader m_shader{0};
+    Shader m_lightingShader{0};
+    Shader m_indirectShader{0};
+    Shader m_indirectLightingShader{0};
+    Shader m_presentShader{0};
+    Shader m_ambientShader{0};
+    Shader m_lightVolumeShader{0};
+    Shader m_shadowShader{0};
+    Shader m_debugShader{0};
+
+    // scene
+    Camera m_camera;
+    FrameUniforms m_frameUniforms;
+    uint64_t m_frameUniformsVersion = 0;
+    Mesh m_cube;
+    Scene m_scene;
+    size_t m_lightObject = 0;
+    // the scene's point lights, the lamp first, streamed every frame and read
+    // as vertex attributes by the light volumes and through a buffer texture
+    // when shading forward
+    StreamBuffer m_lightStream;
+    uint32_t m_lightTexture = 0;
+    // buffer the light texture currently views
+    uint32_t m_lightSource = 0;
+
+    // forward shading with lights sorted into view clusters every frame
+    bool m_useClustered = false;
+    LightClusters m_lightClusters;
+    StreamBuffer m_clusterStream;
+    uint32_t m_clusterTexture = 0;
+    // buffer the cluster texture currently views
+    uint32_t m_clusterSource = 0;
+
+    // submission
+    bool m_useIndirect = false;
+    FrameController m_frames;
+    StreamBuffer m_frameUniformStream;
+    int m_uniformAlignment = 0;
+    IndirectRenderer m_indirectRenderer;
+    DebugDraw m_debugDraw;
+    JobSystem m_jobs;
+    std::vector<CommandBuffer> m_commandBuffers;
+    RenderQueue m_renderQueue;
+    StatsReporter m_statsReporter;
+    GpuTimer m_gpuTimer;
+
+    // shading from a g-buffer after drawing
+    bool m_useDeferred = false;
+    DeferredRenderer m_deferredRenderer;
+
+    // sun shadows from cascades and lamp shadows from a cube map
+    bool m_useShadows = false;
+    ShadowRenderer m_shadowRenderer;
+    StreamBuffer m_shadowUniformStream;
+
+    // albedo maps streamed in by how large they are on screen
+    bool m_useTextures = false;
+    TextureStreamer m_textureStreamer;
+    // bound for surfaces drawn without a map of their own
+    Texture m_whiteTexture;
+
+    // images made on the cpu, shown by copying them into a texture
+    SoftwareRasterizer m_softRasterizer;
+    SoftBasicShader m_softBasicShader;
+    SoftLightingShader m_softLightingShader;
+    PathTracer m_pathTracer;
+    uint32_t m_presentTexture = 0;
+    uint32_t m_presentVao = 0;
+
+    // loads opengl and creates all resources, on the render thread
+    bool initialize();
+
+    void shutdown();
+
+    // names every program the renderer may draw with, for m_shaders
+    void defineShaders();
+
+    // picks the variant of each program for the enabled features, compiling
+    // those not built yet, and sets their constant uniforms
+    void compileShaders();
+
+    // sets what the surface and lamp programs shade with, for whichever of
+    // flat, forward lit, clustered or g-buffer shading they were built for
+    void setSurfaceUniforms(const Shader &surface, const Shader &lamp) const;
+
+    // fits the shadows to this frame's camera, draws what changed in them and streams their uniforms
+    void drawShadows(FrameStats &stats);
+
+    // adds the lamp's light and the benchmark lights, and the stream they are uploaded through
+    void createLights();
+
+    // loads or generates the textures and spreads them over the objects
+    void createTextures();
+
+    // streams the lights into this frame's region and points the forward
+    // programs at it, returning its offset in the stream
+    size_t streamLights();
+
+    // sorts the lights into the camera's clusters and streams the result
+    void assignLights(FrameStats &stats);
+
+    // applies requests made from other threads
+    void processRequests();
+
+    // draws a frame into one pixel of every target without showing it, so the
+    // driver compiles what it defers to the first draw of each program with a
+    // vertex format and state before frames are timed
+    void prewarm(Simulation &simulation);
+
+    // whether frames are made on the cpu and presented through a texture
+    inline bool presentsCpuImages() const {
+        return m_options.softwareRasterizer || m_options.pathTraceSamples > 0;
+    }
+
+    // points the camera at the state and fits its projection to the window
+    void updateCamera(const SimulationState &state);
+
+    // draws the scene, and over it the debug lines when drawDebug is set
+    void drawFrame(const SimulationState &state, bool drawDebug, FrameStats &stats);
+
+    // path traces the scene as the simulation starts until enough samples
+    // are averaged, showing progress, then writes the image out
+    void traceReference(Simulation &simulation);
+
+    // sizes the cpu framebuffers and the texture they are shown through to the window
+    void resizeCpuTargets();
+
+    // draws the queue on the cpu and copies the result to the screen
+    void submitSoftware(FrameStats &stats);
+
+    // copies rgba8 pixels, bottom row first, over the whole screen
+    void presentImage(const uint32_t *pixels, uint32_t stride);
+
+public:
+    // width and height are the framebuffer size in pixels
+    Renderer(GLFWwindow *window, const Options &options, int width, int height);
+
+    // makes the context current and renders until the window should close
+    void run(Simulation &simulation);
+
+    // whether initialization on the render thread failed, or a benchmark run exceeded its --max-startup-spike
+    inline bool failed() const {
+        return m_failed;
+    }
+
+    void requestShaderReload();
+
+    void toggleSorting();
+
+    void toggleDebugDraw();
+
+    void resize(int width, int height);
+};
@@ -0,0 +1,81 @@
+#include "scene.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "camera.h"
+#include "jobs.h"
+#include "mesh.h"
+#include "render_queue.h"
+#include "shaders.h"
+
+// objects handed to a thread at a time when recording
+constexpr size_t RECORD_CHUNK_SIZE = 256;
+
+glm::mat4 Object::modelMatrix() const {
+    glm::mat4 model = glm::mat4{1.0f};
+    model = glm::translate(model, position);
+    model = glm::scale(model, scale);
+    return model;
+}
+
+void Scene::addBenchmarkGrid(uint32_t count, const Shader *shader, const Mesh *mesh) {
+    // lay the cubes out in a square behind the origin
+    const uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(count))));
+    const float spacing = 0.5f;
+    objects.reserve(objects.size() + count);
+    for (uint32_t i = 0; i < count; ++i) {
+        float x = (static_cast<float>(i % side) - side / 2.0f) * spacing;
+        float z = -2.0f - static_cast<float>(i / side) * spacing;
+        objects.push_back(Object{glm::vec3{x, -1.5f, z}, glm::vec3{0.2f}, shader, mesh});
+    }
+    ++staticVersion;
+}
+
+void Scene::addBenchmarkLights(uint32_t count) {
+    // low discrepancy points spread the lights evenly without a random generator
+    const float goldenRatio = 0.618034f;
+    const float plasticRatio = 0.754878f;
+    lights.reserve(lights.size() + count);
+    for (uint32_t i = 0; i < count; ++i) {
+        const float u = std::fmod(0.5f + goldenRatio * static_cast<float>(i), 1.0f);
+        const float v = std::fmod(0.5f + plasticRatio * static_cast<float>(i), 1.0f);
+        const float w = std::fmod(0.5f + 0.569840f * static_cast<float>(i), 1.0f);
+        const glm::vec3 position{(u - 0.5f) * 12.0f, -1.3f + w * 2.3f, 2.0f - v * 12.0f};
+
+        // saturated colors around the hue circle, dimmer as there are more of them
+        const float hue = u * 6.0f;
+        const glm::vec3 color = glm::clamp(glm::vec3{std::fabs(hue - 3.0f) - 1.0f, 2.0f - std::fabs(hue - 2.0f), 2.0f - std::fabs(hue - 4.0f)}, 0.0f, 1.0f);
+        const float radius = 1.5f + 1.5f * v;
+        lights.push_back(PointLight{position, radius, color * (2.0f / std::sqrt(static_cast<float>(count)))});
+    }
+}
+
+void Scene::record(JobSystem &jobs, const Camera &camera, std::vector<CommandBuffer> &buffers) const {
+    const Frustum &frustum = camera.frustum();
+    const glm::vec3 &viewPosition = camera.position();
+    const float farPlane = camera.farPlane();
+
+    // a buffer per chunk rather than per thread, so the buffers in order hold
+    // the draws in object order however the chunks were shared out
+    buffers.resize((objects.size() + RECORD_CHUNK_SIZE - 1) / RECORD_CHUNK_SIZE);
+    for (CommandBuffer &buffer : buffers) {
+        buffer.reset();
+    }
+
+    jobs.parallelFor(objects.size(), RECORD_CHUNK_SIZE, [&](size_t begin, size_t end, uint32_t) {
+        CommandBuffer &commands = buffers[begin / RECORD_CHUNK_SIZE];
+        for (size_t i = begin; i < end; ++i) {
+            const Object &object = objects[i];
+            const float radius = object.mesh->boundingRadius() * std::max({object.scale.x, object.scale.y, object.scale.z});
+            if (!frustum.intersectsSphere(object.position, radius)) {
+                continue;
+            }
+            const float depth = glm::distance(viewPosition, object.position) / farPlane;
+            const uint64_t key = makeSortKey(RenderPass::Opaque, object.shader->id(), object.material, object.mesh->vao(), depth);
+            commands.draw(key, *object.shader, *object.mesh, object.modelMatrix(), object.texture);
+        }
+    });
+}
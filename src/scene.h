@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "command_buffer.h"
+
+class Camera;
+class JobSystem;
+class Mesh;
+class Shader;
+struct TextureSlot;
+
+// A mesh placed in the world and the program used to draw it
+struct Object {
+    glm::vec3 position;
+    glm::vec3 scale;
+    const Shader *shader;
+    const Mesh *mesh;
+    // uniform set used by the shader, only used for ordering draws so far
+    uint32_t material = 0;
+    // albedo map, or none to leave whatever is bound
+    const TextureSlot *texture = nullptr;
+    // moved or changed every frame, so never cached in shadow maps
+    bool dynamic = false;
+
+    glm::mat4 modelMatrix() const;
+};
+
+// most point lights a scene may hold
+constexpr uint32_t MAX_LIGHTS = 4096;
+
+// A point light as the shaders read it, two vec4s
+struct PointLight {
+    glm::vec3 position;
+    // distance at which the light has faded out completely
+    float radius;
+    glm::vec3 color;
+    float padding = 0.0f;
+};
+
+// Every object drawn in a frame, and the lights shading them
+class Scene {
+public:
+    std::vector<Object> objects;
+    std::vector<PointLight> lights;
+    // bump after adding, removing or moving objects that are not dynamic
+    uint64_t staticVersion = 0;
+
+    // adds count small cubes laid out in a grid, used to stress the render loop
+    void addBenchmarkGrid(uint32_t count, const Shader *shader, const Mesh *mesh);
+
+    // adds count colored lights scattered just above the benchmark grid and
+    // around the origin, the same ones every run
+    void addBenchmarkLights(uint32_t count);
+
+    // records a draw for every object the camera can see across the job
+    // system, one buffer per chunk of objects so the buffers in order hold the
+    // draws in object order. draws are keyed front to back. the camera
+    // has to be up to date as the threads read it concurrently
+    void record(JobSystem &jobs, const Camera &camera, std::vector<CommandBuffer> &buffers) const;
+};
@@ -0,0 +1,463 @@
+#include "shader_library.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "glad/glad.h"
+#include "spdlog/spdlog.h"
+
+#include "embedded_shaders.h"
+#include "gl_ext.h"
+#include "utils.h"
+
+namespace {
+
+	// by bit, as defined in the sources
+	const char *const KEYWORD_NAMES[] = {"INDIRECT", "LIT", "CLUSTERED", "SHADOWS", "ALBEDO_MAP", "EMISSIVE"};
+	constexpr uint32_t KEYWORD_COUNT = sizeof(KEYWORD_NAMES) / sizeof(KEYWORD_NAMES[0]);
+
+	// starts every saved program binary, before the driver's format
+	constexpr uint32_t BINARY_MAGIC = 0x4e494253;
+
+	uint32_t keywordBit(const std::string &name) {
+		for (uint32_t i = 0; i < KEYWORD_COUNT; ++i) {
+			if (name == KEYWORD_NAMES[i]) {
+				return 1u << i;
+			}
+		}
+		return 0;
+	}
+
+	// the program and its keywords as a manifest line
+	std::string describe(const std::string &program, uint32_t keywords) {
+		std::string text = program;
+		for (uint32_t i = 0; i < KEYWORD_COUNT; ++i) {
+			if (keywords & (1u << i)) {
+				text += ' ';
+				text += KEYWORD_NAMES[i];
+			}
+		}
+		return text;
+	}
+
+	// 64 bit fnv-1a, with a zero after the text so consecutive texts cannot run together
+	uint64_t hashText(uint64_t hash, const std::string &text) {
+		for (const char c : text) {
+			hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001b3ull;
+		}
+		return hash * 0x100000001b3ull;
+	}
+
+	double millisecondsSince(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+}
+
+void ShaderLibrary::create(const std::filesystem::path &sourceDirectory, const std::filesystem::path &cacheDirectory) {
+	m_sourceDirectory = sourceDirectory;
+	if (!m_sourceDirectory.empty()) {
+		spdlog::info("Reading shader sources from {}", m_sourceDirectory.string());
+	}
+
+	m_glslVersion = glext::support().glslVersion;
+
+	m_cacheDirectory = cacheDirectory;
+	m_binaries = false;
+	if (m_cacheDirectory.empty()) {
+		return;
+	}
+	std::error_code error;
+	std::filesystem::create_directories(m_cacheDirectory, error);
+	if (error) {
+		spdlog::warn("Cannot create the shader cache {}: {}", m_cacheDirectory.string(), error.message());
+		m_cacheDirectory.clear();
+		return;
+	}
+
+	// binaries are only good for the driver that saved them
+	m_binaries = glext::support().programBinary;
+	if (m_binaries) {
+		for (const GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+			const char *value = reinterpret_cast<const char *>(glGetString(name));
+			m_driver += value ? value : "";
+			m_driver += '\n';
+		}
+	}
+	readManifest();
+	spdlog::info("Caching shaders in {} {}, {} variants in its manifest", m_cacheDirectory.string(),
+	             m_binaries ? "as program binaries" : "without program binaries, which this driver lacks", m_manifest.size());
+}
+
+void ShaderLibrary::destroy() {
+	writeManifest();
+	for (auto &[key, shader] : m_variants) {
+		shader.deleteShader();
+	}
+	m_variants.clear();
+	m_programs.clear();
+	m_blockBindings.clear();
+	m_manifest.clear();
+	m_manifestChanged = false;
+}
+
+void ShaderLibrary::define(const std::string &name, const std::filesystem::path &vertexName, const std::filesystem::path &fragmentName) {
+	Program &program = m_programs[name];
+	program.vertex.path = vertexName;
+	program.fragment.path = fragmentName;
+	program.loaded = false;
+}
+
+void ShaderLibrary::bindUniformBlock(const std::string &name, uint32_t binding) {
+	m_blockBindings.emplace_back(name, binding);
+}
+
+const std::string &ShaderLibrary::readFile(const std::filesystem::path &path) {
+	auto found = m_files.find(path);
+	if (found != m_files.end()) {
+		return found->second.text;
+	}
+	if (m_sourceDirectory.empty()) {
+		const EmbeddedShader *shader = findEmbeddedShader(path.generic_string());
+		if (!shader) {
+			throw ShaderSourceError{"No shader source " + path.generic_string() + " is built in"};
+		}
+		File &file = m_files[path];
+		file.text = shader->text;
+		return file.text;
+	}
+
+	const std::filesystem::path filePath = m_sourceDirectory / path;
+	std::error_code error;
+	const auto time = std::filesystem::last_write_time(filePath, error);
+	if (error || !std::filesystem::is_regular_file(filePath, error)) {
+		throw ShaderSourceError{"Cannot read shader source " + filePath.string()};
+	}
+	File &file = m_files[path];
+	file.time = time;
+	file.text = utils::fileReadString(filePath);
+	return file.text;
+}
+
+void ShaderLibrary::preprocess(Source &source, const std::filesystem::path &path) {
+	const size_t number = source.files.size();
+	source.files.push_back(path);
+
+	std::istringstream lines{readFile(path)};
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(lines, line)) {
+		++lineNumber;
+		std::istringstream words{line};
+		std::string directive;
+		words >> directive;
+		if (number == 0 && lineNumber == 1 && directive == "#version") {
+			words >> source.version;
+			continue;
+		}
+
+		if (directive == "#include") {
+			const size_t open = line.find('"');
+			const size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+			if (close == std::string::npos) {
+				throw ShaderSourceError{path.string() + ":" + std::to_string(lineNumber) + ": #include needs a file name in quotes"};
+			}
+			const std::filesystem::path included = (path.parent_path() / line.substr(open + 1, close - open - 1)).lexically_normal();
+			if (std::find(source.files.begin(), source.files.end(), included) != source.files.end()) {
+				source.body += '\n';
+				continue;
+			}
+			// numbered so compile errors point into the right file, then back to the next line here
+			source.body += "#line 1 " + std::to_string(source.files.size()) + "\n";
+			preprocess(source, included);
+			source.body += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(number) + "\n";
+			continue;
+		}
+
+		std::string pragma;
+		std::string name;
+		if (directive != "#pragma" || !(words >> pragma) || pragma != "keyword" || !(words >> name)) {
+			source.body += line;
+			source.body += '\n';
+			continue;
+		}
+
+		// blanked rather than dropped so compile errors keep their line numbers
+		source.body += '\n';
+		const uint32_t bit = keywordBit(name);
+		if (bit == 0) {
+			spdlog::warn("{} declares unknown shader keyword {}", path.string(), name);
+			continue;
+		}
+		source.keywords |= bit;
+		int version = 0;
+		if (words >> version) {
+			source.keywordVersions[bit] = version;
+		}
+	}
+}
+
+void ShaderLibrary::load(Program &program) {
+	// read whole before replacing, so a program whose files cannot be read keeps its sources
+	Source vertex;
+	vertex.path = program.vertex.path;
+	preprocess(vertex, vertex.path.lexically_normal());
+	Source fragment;
+	fragment.path = program.fragment.path;
+	preprocess(fragment, fragment.path.lexically_normal());
+	program.vertex = std::move(vertex);
+	program.fragment = std::move(fragment);
+	program.loaded = true;
+	program.failed = false;
+}
+
+int ShaderLibrary::version(const Source &source, uint32_t keywords) {
+	int version = source.version;
+	for (const auto &[bit, needed] : source.keywordVersions) {
+		if (keywords & bit) {
+			version = std::max(version, needed);
+		}
+	}
+	return version;
+}
+
+Shader ShaderLibrary::build(const Program &program, uint32_t keywords) {
+	// each source gets a #define per keyword it declares, after the newest #version they need
+	std::string texts[2];
+	const Source *sources[2] = {&program.vertex, &program.fragment};
+	for (int i = 0; i < 2; ++i) {
+		const Source &source = *sources[i];
+		const int version = ShaderLibrary::version(source, keywords);
+		if (version > 0) {
+			texts[i] = "#version " + std::to_string(version) + " core\n";
+		}
+		for (uint32_t bit = 0; bit < KEYWORD_COUNT; ++bit) {
+			if (keywords & source.keywords & (1u << bit)) {
+				texts[i] += std::string{"#define "} + KEYWORD_NAMES[bit] + "\n";
+			}
+		}
+		texts[i] += version > 0 ? "#line 2\n" : "#line 1\n";
+		texts[i] += source.body;
+	}
+
+	Shader shader{0};
+	std::filesystem::path binaryPath;
+	if (m_binaries) {
+		std::ostringstream name;
+		name << std::hex << std::setw(16) << std::setfill('0') << hashText(hashText(hashText(0xcbf29ce484222325ull, m_driver), texts[0]), texts[1]) << ".bin";
+		binaryPath = m_cacheDirectory / name.str();
+
+		std::vector<uint8_t> bytes;
+		uint32_t header[2] = {};
+		if (utils::fileReadBytes(binaryPath, bytes) && bytes.size() > sizeof(header)) {
+			std::memcpy(header, bytes.data(), sizeof(header));
+			if (header[0] == BINARY_MAGIC) {
+				shader = Shader::createFromBinary(header[1], std::vector<uint8_t>(bytes.begin() + sizeof(header), bytes.end()));
+			}
+		}
+	}
+
+	if (shader.id() != 0) {
+		++m_loadedBinaries;
+	} else {
+		try {
+			shader = Shader::createProgram(texts[0], texts[1], m_binaries);
+		} catch (const std::runtime_error &) {
+			// the compiler's log numbers included files rather than naming them
+			for (const Source *source : sources) {
+				std::string files;
+				for (size_t i = 1; i < source->files.size(); ++i) {
+					files += (i > 1 ? ", " : "") + std::to_string(i) + " " + source->files[i].string();
+				}
+				if (!files.empty()) {
+					spdlog::critical("In errors from {}, source strings are {}", source->path.string(), files);
+				}
+			}
+			throw;
+		}
+		++m_compiled;
+		uint32_t header[2] = {BINARY_MAGIC, 0};
+		std::vector<uint8_t> bytes;
+		if (m_binaries && shader.binary(header[1], bytes)) {
+			std::ofstream file(binaryPath, std::ios::binary);
+			file.write(reinterpret_cast<const char *>(header), sizeof(header));
+			file.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+			if (!file) {
+				spdlog::warn("Cannot write shader binary {}", binaryPath.string());
+			}
+		}
+	}
+
+	for (const auto &[name, binding] : m_blockBindings) {
+		shader.bindUniformBlock(name, binding);
+	}
+	return shader;
+}
+
+const Shader &ShaderLibrary::variant(const std::string &name, uint32_t keywords) {
+	Program &program = m_programs.at(name);
+	if (!program.loaded) {
+		load(program);
+	}
+	const VariantKey key{name, keywords & (program.vertex.keywords | program.fragment.keywords)};
+	auto found = m_variants.find(key);
+	if (found != m_variants.end()) {
+		return found->second;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	const Shader shader = build(program, key.second);
+	const double milliseconds = millisecondsSince(start);
+	m_buildMs += milliseconds;
+	if (!m_loading) {
+		spdlog::warn("Built shader variant {} after loading, holding up the frame {:.1f} ms", describe(key.first, key.second), milliseconds);
+	}
+	if (m_manifest.insert(key).second) {
+		m_manifestChanged = true;
+	}
+	return m_variants.emplace(key, shader).first->second;
+}
+
+void ShaderLibrary::prewarm() {
+	const auto start = std::chrono::steady_clock::now();
+	uint32_t count = 0;
+	// copied, as variants of sources whose keywords changed are added under new keys
+	const std::set<VariantKey> manifest = m_manifest;
+	for (const VariantKey &key : manifest) {
+		// left by builds of the renderer with other programs
+		auto found = m_programs.find(key.first);
+		if (found == m_programs.end()) {
+			continue;
+		}
+		// or by runs on newer contexts
+		Program &program = found->second;
+		if (!program.loaded) {
+			load(program);
+		}
+		if (m_glslVersion > 0 && std::max(version(program.vertex, key.second), version(program.fragment, key.second)) > m_glslVersion) {
+			continue;
+		}
+		variant(key.first, key.second);
+		++count;
+	}
+	if (count > 0) {
+		spdlog::info("Prewarmed {} shader variants from the manifest in {:.1f} ms", count, millisecondsSince(start));
+	}
+}
+
+void ShaderLibrary::reload() {
+	if (m_sourceDirectory.empty()) {
+		spdlog::warn("Shader sources are built into the binary, start with --shader-dir to reload them");
+		return;
+	}
+	const auto start = std::chrono::steady_clock::now();
+	const uint32_t compiled = m_compiled;
+	const uint32_t loadedBinaries = m_loadedBinaries;
+
+	// files are only reread when their time changed, and count as changed when their text did
+	std::set<std::filesystem::path> changed;
+	for (auto it = m_files.begin(); it != m_files.end();) {
+		std::error_code error;
+		const auto time = std::filesystem::last_write_time(m_sourceDirectory / it->first, error);
+		if (error) {
+			// gone, so the programs including it fail to load and keep their builds
+			changed.insert(it->first);
+			it = m_files.erase(it);
+			continue;
+		}
+		if (time != it->second.time) {
+			it->second.time = time;
+			std::string text = utils::fileReadString(m_sourceDirectory / it->first);
+			if (text != it->second.text) {
+				it->second.text = std::move(text);
+				changed.insert(it->first);
+			}
+		}
+		++it;
+	}
+
+	// then the programs reading any of them
+	std::set<std::string> reloaded;
+	for (auto &[name, program] : m_programs) {
+		if (!program.loaded) {
+			continue;
+		}
+		bool affected = program.failed;
+		for (const Source *source : {&program.vertex, &program.fragment}) {
+			for (const std::filesystem::path &path : source->files) {
+				affected = affected || changed.count(path) > 0;
+			}
+		}
+		if (!affected) {
+			continue;
+		}
+		try {
+			load(program);
+			reloaded.insert(name);
+		} catch (const ShaderSourceError &e) {
+			spdlog::error("{}, keeping the previous build of {}", e.what(), name);
+			program.failed = true;
+		}
+	}
+
+	uint32_t rebuilt = 0;
+	for (auto &[key, shader] : m_variants) {
+		if (reloaded.count(key.first) == 0) {
+			continue;
+		}
+		try {
+			const Shader updated = build(m_programs.at(key.first), key.second);
+			shader.deleteShader();
+			shader = updated;
+			++rebuilt;
+		} catch (const std::runtime_error &) {
+			spdlog::error("Keeping the previous build of shader variant {}", describe(key.first, key.second));
+		}
+	}
+	spdlog::info("{} shader files changed, rebuilt {} of {} shader variants in {:.1f} ms, {} compiled and {} loaded from binaries", changed.size(),
+	             rebuilt, m_variants.size(), millisecondsSince(start), m_compiled - compiled, m_loadedBinaries - loadedBinaries);
+}
+
+void ShaderLibrary::setLoading(bool loading) {
+	if (m_loading && !loading) {
+		spdlog::info("{} shader variants ready before the first frame, {} compiled and {} loaded from binaries in {:.1f} ms", m_variants.size(),
+		             m_compiled, m_loadedBinaries, m_buildMs);
+	}
+	m_loading = loading;
+}
+
+void ShaderLibrary::readManifest() {
+	std::ifstream file(m_cacheDirectory / "manifest.txt");
+	std::string line;
+	while (std::getline(file, line)) {
+		std::istringstream words{line};
+		std::string program;
+		if (!(words >> program)) {
+			continue;
+		}
+		uint32_t keywords = 0;
+		std::string name;
+		while (words >> name) {
+			keywords |= keywordBit(name);
+		}
+		m_manifest.emplace(program, keywords);
+	}
+	m_manifestChanged = false;
+}
+
+void ShaderLibrary::writeManifest() const {
+	if (m_cacheDirectory.empty() || !m_manifestChanged) {
+		return;
+	}
+	std::ofstream file(m_cacheDirectory / "manifest.txt");
+	for (const VariantKey &key : m_manifest) {
+		file << describe(key.first, key.second) << '\n';
+	}
+	if (!file) {
+		spdlog::warn("Cannot write the shader manifest in {}", m_cacheDirectory.string());
+	}
+}
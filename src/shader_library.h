@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "shaders.h"
+
+// Features a shader source may be built with. A source declares the ones it
+// has with lines like
+//     #pragma keyword SHADOWS
+// and is compiled with SHADOWS defined in the variants that have it. A
+// keyword needing a newer glsl than the source's #version names it after:
+//     #pragma keyword INDIRECT 430
+enum ShaderKeyword : uint32_t {
+    // model and albedo slot read per draw from a buffer, for multi-draw indirect
+    SHADER_INDIRECT = 1 << 0,
+    // shaded by the point lights while drawing
+    SHADER_LIT = 1 << 1,
+    // by only the lights of the fragment's view cluster
+    SHADER_CLUSTERED = 1 << 2,
+    // in the sun's cascades and the lamp's cube shadow
+    SHADER_SHADOWS = 1 << 3,
+    // with albedo read from the bound texture array
+    SHADER_ALBEDO_MAP = 1 << 4,
+    // giving off its albedo as light instead of being lit
+    SHADER_EMISSIVE = 1 << 5,
+};
+
+// A source file that cannot be read, named or included
+class ShaderSourceError: public std::runtime_error {
+public:
+    explicit ShaderSourceError(const std::string &message)
+        : std::runtime_error{message} {}
+};
+
+// Programs made of a vertex and a fragment source, each compiled once per
+// set of keywords asked for, on first use or ahead of it by prewarm(). Keywords
+// neither source declares are dropped first, so they share a variant.
+// Variants are shared by everyone asking for them, uniforms set on them too.
+//
+// Sources are named by their paths in a source directory, or in the shaders
+// directory when they are the copies built into the binary, and may pull in
+// shared code with
+//     #include "frame.glsl"
+// relative to the including file. A file is included at most once per source,
+// so includes may include each other, and an include inside an #ifdef is
+// expanded wherever it comes first. Every file a program's sources read is
+// remembered, so reload() rebuilds only the programs reading a changed file
+// in the source directory.
+//
+// With a cache directory, linked programs are saved there as driver binaries
+// named by a hash of their sources and the driver, so later runs load them
+// instead of compiling, and every variant compiled is listed in a manifest
+// there that the next run's prewarm() compiles before the first frame.
+class ShaderLibrary {
+    struct Source {
+        std::filesystem::path path;
+        // the text after the #version line, with keyword lines blanked
+        std::string body;
+        int version = 0;
+        uint32_t keywords = 0;
+        // newer glsl versions some declared keywords need
+        std::map<uint32_t, int> keywordVersions;
+        // the source and what it includes, in order, each file's index being the
+        // source string number #line gives its lines in compile errors
+        std::vector<std::filesystem::path> files;
+    };
+
+    struct Program {
+        Source vertex;
+        Source fragment;
+        bool loaded = false;
+        // whether its last reload failed to read, so the next one retries it
+        bool failed = false;
+    };
+
+    // a source file as last read, to tell whether it changed
+    struct File {
+        std::filesystem::file_time_type time;
+        std::string text;
+    };
+
+    using VariantKey = std::pair<std::string, uint32_t>;
+
+    std::map<std::string, Program> m_programs;
+    std::map<VariantKey, Shader> m_variants;
+    // uniform blocks pointed at their bindings in every variant
+    std::vector<std::pair<std::string, uint32_t>> m_blockBindings;
+    // read from the copies built into the binary when empty
+    std::filesystem::path m_sourceDirectory;
+    // every file read, by name, shared by the sources including it
+    std::map<std::filesystem::path, File> m_files;
+
+    // newest glsl the context compiles, as in #version
+    int m_glslVersion = 0;
+
+    // program binaries and the manifest, when there is a directory to keep them in
+    std::filesystem::path m_cacheDirectory;
+    bool m_binaries = false;
+    std::string m_driver;
+    std::set<VariantKey> m_manifest;
+    bool m_manifestChanged = false;
+
+    // variants compiled after this is cleared are logged as hitches
+    bool m_loading = true;
+    uint32_t m_compiled = 0;
+    uint32_t m_loadedBinaries = 0;
+    double m_buildMs = 0.0;
+
+    // a file's text, read on first use
+    const std::string &readFile(const std::filesystem::path &path);
+
+    // appends a file to a source's body with its includes expanded, collecting
+    // the keywords it declares. the top level file may start with #version
+    void preprocess(Source &source, const std::filesystem::path &path);
+
+    // reads a program's sources and the keywords they declare
+    void load(Program &program);
+
+    // the #version a source is compiled with for keywords
+    static int version(const Source &source, uint32_t keywords);
+
+    // compiles or loads a variant, with its uniform blocks bound
+    Shader build(const Program &program, uint32_t keywords);
+
+    void readManifest();
+
+    void writeManifest() const;
+
+public:
+    // sourceDirectory may be empty to use the sources built into the binary,
+    // and cacheDirectory to compile every variant in every run
+    void create(const std::filesystem::path &sourceDirectory, const std::filesystem::path &cacheDirectory);
+
+    // writes the manifest and deletes every variant
+    void destroy();
+
+    // names a program for variant(). its sources are read when it is first compiled
+    void define(const std::string &name, const std::filesystem::path &vertexName, const std::filesystem::path &fragmentName);
+
+    // points the named uniform block at binding in every variant, when it has it
+    void bindUniformBlock(const std::string &name, uint32_t binding);
+
+    // the named program built with keywords, a mask of ShaderKeyword
+    const Shader &variant(const std::string &name, uint32_t keywords);
+
+    // builds every variant in the manifest of a defined program, skipping
+    // those the context's glsl is too old for
+    void prewarm();
+
+    // rereads the files in the source directory that changed since they were
+    // read and rebuilds the variants of the programs reading them, keeping the
+    // old build of any that fail to compile
+    void reload();
+
+    // whether the renderer is still loading; variants built afterwards are logged as hitches
+    void setLoading(bool loading);
+};
@@ -5,7 +5,10 @@
 #include "glad/glad.h"
 #include "spdlog/spdlog.h"
 
-Shader Shader::createProgram(const std::string &vertexSource, const std::string &fragmentSource) {
+#include "gl_ext.h"
+#include "gl_state.h"
+
+Shader Shader::createProgram(const std::string &vertexSource, const std::string &fragmentSource, bool retrievableBinary) {
 	// compile vertex shader source code
     spdlog::debug("Compiling vertex shader");
 	uint32_t vertexShader = glCreateShader(GL_VERTEX_SHADER);
@@ -20,6 +23,8 @@ Shader Shader::createProgram(const std::string &vertexSource, const std::string
 	if (!success) {
 		glGetShaderInfoLog(vertexShader, 512, nullptr, infoLog);
         spdlog::critical("Vertex shader failed to compile: {}", infoLog);
+		// errors are recovered from by reloading, so nothing may be left behind
+		glDeleteShader(vertexShader);
 		throw ShaderCompileError(ShaderType::Vertex);
 	}
 
@@ -35,6 +40,8 @@ Shader Shader::createProgram(const std::string &vertexSource, const std::string
 	if (!success) {
 		glGetShaderInfoLog(fragmentShader, 512, nullptr, infoLog);
         spdlog::critical("Fragment shader failed to compile: {}", infoLog);
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
 		throw ShaderCompileError(ShaderType::Fragment);
 	}
 
@@ -43,6 +50,9 @@ Shader Shader::createProgram(const std::string &vertexSource, const std::string
 	uint32_t shaderProgram = glCreateProgram();
 	glAttachShader(shaderProgram, vertexShader);
 	glAttachShader(shaderProgram, fragmentShader);
+	if (retrievableBinary) {
+		glProgramParameteri(shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
 	glLinkProgram(shaderProgram);
 
 	// check for linking errors
@@ -50,6 +60,9 @@ Shader Shader::createProgram(const std::string &vertexSource, const std::string
 	if (!success) {
 		glGetProgramInfoLog(shaderProgram, 512, nullptr, infoLog);
         spdlog::critical("Shader program linking failed: {}", infoLog);
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+		glDeleteProgram(shaderProgram);
 		throw ShaderLinkError();
 	}
 
@@ -62,17 +75,50 @@ Shader Shader::createProgram(const std::string &vertexSource, const std::string
 	return Shader(shaderProgram);
 }
 
+Shader Shader::createFromBinary(uint32_t format, const std::vector<uint8_t> &binary) {
+	uint32_t program = glCreateProgram();
+	glProgramBinary(program, format, binary.data(), static_cast<GLsizei>(binary.size()));
+	int success;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success) {
+		glDeleteProgram(program);
+		return Shader(0);
+	}
+	return Shader(program);
+}
+
+bool Shader::binary(uint32_t &format, std::vector<uint8_t> &bytes) const {
+	GLint length = 0;
+	glGetProgramiv(m_id, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) {
+		return false;
+	}
+	bytes.resize(static_cast<size_t>(length));
+	GLenum binaryFormat = 0;
+	glGetProgramBinary(m_id, length, &length, &binaryFormat, bytes.data());
+	bytes.resize(static_cast<size_t>(length));
+	format = binaryFormat;
+	return length > 0;
+}
+
 void Shader::bind() const {
-	glUseProgram(m_id);
+	glstate::useProgram(m_id);
 }
 
 void Shader::deleteShader() {
-    glDeleteProgram(m_id);
+    glstate::deleteProgram(m_id);
     m_id = 0;
 }
 
 void Shader::unbind() const {
-	glUseProgram(0);
+	glstate::useProgram(0);
+}
+
+void Shader::bindUniformBlock(const std::string &name, uint32_t binding) const {
+	GLuint index = glGetUniformBlockIndex(m_id, name.c_str());
+	if (index != GL_INVALID_INDEX) {
+		glUniformBlockBinding(m_id, index, binding);
+	}
 }
 
 void Shader::setBool(const std::string &name, bool value) const {
@@ -87,10 +133,22 @@ void Shader::setFloat(const std::string &name, float value) const {
     glUniform1f(glGetUniformLocation(m_id, name.c_str()), value);
 }
 
+void Shader::setInt3(const std::string &name, const glm::ivec3 &vec) const {
+	glUniform3i(glGetUniformLocation(m_id, name.c_str()), vec.x, vec.y, vec.z);
+}
+
+void Shader::setFloat2(const std::string &name, const glm::vec2 &vec) const {
+	glUniform2f(glGetUniformLocation(m_id, name.c_str()), vec.x, vec.y);
+}
+
 void Shader::setFloat3(const std::string &name, const glm::vec3 &vec) const {
 	glUniform3f(glGetUniformLocation(m_id, name.c_str()), vec.x, vec.y, vec.z);
 }
 
+void Shader::setFloat4(const std::string &name, const glm::vec4 &vec) const {
+	glUniform4f(glGetUniformLocation(m_id, name.c_str()), vec.x, vec.y, vec.z, vec.w);
+}
+
 void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const {
     glUniformMatrix4fv(glGetUniformLocation(m_id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
 }
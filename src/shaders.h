@@ -4,6 +4,7 @@
 #include <exception>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include <glm/glm.hpp>
 
@@ -14,7 +15,15 @@ class Shader {
 public:
 	Shader(uint32_t id) : m_id{id} {}
 
-	static Shader createProgram(const std::string &vertexSource, const std::string &fragmentSource);
+	// retrievableBinary asks the driver to keep the linked program for binary()
+	static Shader createProgram(const std::string &vertexSource, const std::string &fragmentSource, bool retrievableBinary = false);
+
+	// a program from a binary saved by binary(), or a null one if the driver
+	// no longer takes it, as happens when it is updated
+	static Shader createFromBinary(uint32_t format, const std::vector<uint8_t> &binary);
+
+	// the linked program in the driver's format, false if it cannot give it
+	bool binary(uint32_t &format, std::vector<uint8_t> &bytes) const;
 
 	void bind() const;
 
@@ -24,14 +33,23 @@ public:
 		return m_id;
 	}
 
+	// points the named uniform block at a buffer binding, if the program has it
+	void bindUniformBlock(const std::string &name, uint32_t binding) const;
+
 	void setBool(const std::string &name, bool value) const;
 
 	void setInt(const std::string &name, int value) const;
 
+	void setInt3(const std::string &name, const glm::ivec3 &vec) const;
+
 	void setFloat(const std::string &name, float value) const;
 
+	void setFloat2(const std::string &name, const glm::vec2 &vec) const;
+
 	void setFloat3(const std::string &name, const glm::vec3 &vec) const;
 
+	void setFloat4(const std::string &name, const glm::vec4 &vec) const;
+
     void setMat4(const std::string &name, const glm::mat4 &mat) const;
 
 	void unbind() const;
@@ -0,0 +1,295 @@
+#include "shadows.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "glad/glad.h"
+
+#include "camera.h"
+#include "gl_state.h"
+#include "mesh.h"
+#include "shaders.h"
+
+namespace {
+
+	// blend between logarithmic and even cascade splits, 1 is fully logarithmic
+	constexpr float CASCADE_SPLIT_LAMBDA = 0.75f;
+	// how far towards the sun of a cascade casters are still drawn
+	constexpr float CASCADE_CASTER_DISTANCE = 40.0f;
+	// closest a caster may be to the shadowed point light
+	constexpr float POINT_SHADOW_NEAR = 0.05f;
+	// depth bias on top of the lookups' normal offset
+	constexpr float SHADOW_SLOPE_BIAS = 1.5f;
+	constexpr float SHADOW_CONSTANT_BIAS = 2.0f;
+
+	// cube face directions and up vectors in the order opengl numbers the faces
+	const glm::vec3 CUBE_FACE_DIRECTIONS[6] = {
+		{1.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, -1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, -1.0f},
+	};
+	const glm::vec3 CUBE_FACE_UPS[6] = {
+		{0.0f, -1.0f, 0.0f}, {0.0f, -1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, -1.0f}, {0.0f, -1.0f, 0.0f}, {0.0f, -1.0f, 0.0f},
+	};
+
+	void setDepthParameters(GLenum target, bool compare) {
+		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, compare ? GL_LINEAR : GL_NEAREST);
+		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, compare ? GL_LINEAR : GL_NEAREST);
+		glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		if (compare) {
+			glTexParameteri(target, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+			glTexParameteri(target, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		}
+	}
+
+	uint32_t createCascadeArray(bool compare) {
+		uint32_t texture = 0;
+		glGenTextures(1, &texture);
+		glstate::bindTexture(0, GL_TEXTURE_2D_ARRAY, texture);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, CASCADE_RESOLUTION, CASCADE_RESOLUTION, SHADOW_CASCADES, 0,
+		             GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+		setDepthParameters(GL_TEXTURE_2D_ARRAY, compare);
+		return texture;
+	}
+
+	uint32_t createCube(bool compare) {
+		uint32_t texture = 0;
+		glGenTextures(1, &texture);
+		glstate::bindTexture(0, GL_TEXTURE_CUBE_MAP, texture);
+		for (GLenum face = 0; face < 6; ++face) {
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_DEPTH_COMPONENT24, POINT_SHADOW_RESOLUTION, POINT_SHADOW_RESOLUTION, 0,
+			             GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+		}
+		setDepthParameters(GL_TEXTURE_CUBE_MAP, compare);
+		return texture;
+	}
+
+}
+
+void ShadowRenderer::create(bool caching) {
+	m_caching = caching;
+	m_cascadeMaps = createCascadeArray(true);
+	m_pointMap = createCube(true);
+	if (m_caching) {
+		m_cascadeStatic = createCascadeArray(false);
+		m_pointStatic = createCube(false);
+	}
+
+	// depth only
+	glGenFramebuffers(1, &m_drawFramebuffer);
+	glGenFramebuffers(1, &m_readFramebuffer);
+	for (uint32_t framebuffer : {m_drawFramebuffer, m_readFramebuffer}) {
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	for (View &view : m_cascades) {
+		view = View{};
+	}
+	for (View &view : m_pointFaces) {
+		view = View{};
+	}
+}
+
+void ShadowRenderer::destroy() {
+	for (uint32_t *texture : {&m_cascadeMaps, &m_cascadeStatic, &m_pointMap, &m_pointStatic}) {
+		glstate::deleteTexture(*texture);
+		*texture = 0;
+	}
+	glDeleteFramebuffers(1, &m_drawFramebuffer);
+	glDeleteFramebuffers(1, &m_readFramebuffer);
+	m_drawFramebuffer = m_readFramebuffer = 0;
+}
+
+void ShadowRenderer::update(const Camera &camera, const glm::vec3 &sunDirection, const glm::vec3 &sunColor, const PointLight &pointLight) {
+	// the sun looks down -z of its view, which only rotates
+	const glm::vec3 up = std::fabs(sunDirection.y) > 0.99f ? glm::vec3{0.0f, 0.0f, 1.0f} : glm::vec3{0.0f, 1.0f, 0.0f};
+	const glm::mat4 sunView = glm::lookAt(glm::vec3{0.0f}, sunDirection, up);
+
+	const float nearPlane = camera.nearPlane();
+	const float farPlane = std::min(SHADOW_DISTANCE, camera.farPlane());
+	float cascadeStart = nearPlane;
+	for (uint32_t cascade = 0; cascade < SHADOW_CASCADES; ++cascade) {
+		const float fraction = static_cast<float>(cascade + 1) / SHADOW_CASCADES;
+		const float logarithmic = nearPlane * std::pow(farPlane / nearPlane, fraction);
+		const float even = nearPlane + (farPlane - nearPlane) * fraction;
+		const float cascadeEnd = CASCADE_SPLIT_LAMBDA * logarithmic + (1.0f - CASCADE_SPLIT_LAMBDA) * even;
+
+		// a sphere around the slice keeps its size however the camera turns
+		glm::vec3 corners[8];
+		camera.frustumCorners(cascadeStart, cascadeEnd, corners);
+		glm::vec3 center{0.0f};
+		for (const glm::vec3 &corner : corners) {
+			center += corner / 8.0f;
+		}
+		float radius = 0.0f;
+		for (const glm::vec3 &corner : corners) {
+			radius = std::max(radius, glm::distance(center, corner));
+		}
+		radius = std::ceil(radius * 16.0f) / 16.0f;
+
+		// move in whole texels so static shadows stay put and stay cached
+		const float texel = 2.0f * radius / CASCADE_RESOLUTION;
+		glm::vec3 lightCenter{sunView * glm::vec4{center, 1.0f}};
+		lightCenter = glm::floor(lightCenter / texel) * texel;
+
+		// looking at the sphere from far enough towards the sun to catch the casters in front of it
+		const glm::vec3 eye{lightCenter.x, lightCenter.y, lightCenter.z + radius + CASCADE_CASTER_DISTANCE};
+		Camera &camera = m_cascadeCameras[cascade];
+		camera.setPosition(glm::transpose(glm::mat3{sunView}) * eye);
+		camera.setDirection(sunDirection, up);
+		camera.setOrthographic(glm::vec2{radius}, 0.0f, 2.0f * radius + CASCADE_CASTER_DISTANCE);
+
+		m_uniforms.cascadeEnds[cascade] = cascadeEnd;
+		m_uniforms.cascadeTexelSizes[cascade] = texel;
+		cascadeStart = cascadeEnd;
+	}
+	m_uniforms.sunDirection = glm::vec4{sunDirection, 0.0f};
+	m_uniforms.sunColor = glm::vec4{sunColor, 0.0f};
+
+	for (uint32_t face = 0; face < 6; ++face) {
+		Camera &camera = m_pointCameras[face];
+		camera.setPosition(pointLight.position);
+		camera.setDirection(CUBE_FACE_DIRECTIONS[face], CUBE_FACE_UPS[face]);
+		camera.setZoom(90.0f);
+		camera.setPerspective(1.0f, POINT_SHADOW_NEAR, pointLight.radius);
+	}
+
+	// ready before render() reads them
+	const Camera *cameras[SHADOW_CASCADES + 6];
+	for (uint32_t cascade = 0; cascade < SHADOW_CASCADES; ++cascade) {
+		cameras[cascade] = &m_cascadeCameras[cascade];
+	}
+	for (uint32_t face = 0; face < 6; ++face) {
+		cameras[SHADOW_CASCADES + face] = &m_pointCameras[face];
+	}
+	Camera::updateAll(cameras, SHADOW_CASCADES + 6);
+
+	for (uint32_t cascade = 0; cascade < SHADOW_CASCADES; ++cascade) {
+		m_uniforms.cascadeViewProjection[cascade] = m_cascadeCameras[cascade].viewProjection();
+	}
+	m_uniforms.pointShadowPosition = glm::vec4{pointLight.position, 1.0f};
+	m_uniforms.pointShadowPlanes = glm::vec4{POINT_SHADOW_NEAR, pointLight.radius, 0.0f, 0.0f};
+}
+
+void ShadowRenderer::render(const Scene &scene, const Shader &shader, FrameStats &stats) {
+	glstate::depthMask(true);
+	glstate::enable(GL_DEPTH_TEST);
+	glstate::enable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(SHADOW_SLOPE_BIAS, SHADOW_CONSTANT_BIAS);
+
+	glViewport(0, 0, CASCADE_RESOLUTION, CASCADE_RESOLUTION);
+	for (uint32_t cascade = 0; cascade < SHADOW_CASCADES; ++cascade) {
+		renderView(scene, shader, m_cascades[cascade], m_cascadeCameras[cascade],
+		           m_cascadeMaps, m_cascadeStatic, false, cascade, nullptr, stats);
+	}
+
+	const glm::vec3 pointLight{m_uniforms.pointShadowPosition};
+	glViewport(0, 0, POINT_SHADOW_RESOLUTION, POINT_SHADOW_RESOLUTION);
+	for (uint32_t face = 0; face < 6; ++face) {
+		renderView(scene, shader, m_pointFaces[face], m_pointCameras[face], m_pointMap, m_pointStatic, true, face, &pointLight, stats);
+	}
+
+	glstate::disable(GL_POLYGON_OFFSET_FILL);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ShadowRenderer::renderView(const Scene &scene, const Shader &shader, View &view, const Camera &camera,
+                                uint32_t liveTexture, uint32_t staticTexture, bool cube, uint32_t layer,
+                                const glm::vec3 *pointLight, FrameStats &stats) {
+	if (!m_caching) {
+		attach(GL_DRAW_FRAMEBUFFER, liveTexture, cube, layer);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		for (bool dynamic : {false, true}) {
+			if (recordCasters(scene, shader, camera, dynamic, pointLight)) {
+				drawCasters(shader, camera, stats);
+			}
+		}
+		return;
+	}
+
+	if (!view.cached || view.cameraVersion != camera.version() || view.staticVersion != scene.staticVersion) {
+		attach(GL_DRAW_FRAMEBUFFER, staticTexture, cube, layer);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		if (recordCasters(scene, shader, camera, false, pointLight)) {
+			drawCasters(shader, camera, stats);
+		}
+		view.cameraVersion = camera.version();
+		view.staticVersion = scene.staticVersion;
+		view.cached = true;
+		view.liveIsStatic = false;
+		++stats.shadowViewsDrawn;
+	}
+
+	// a live map still holding only the static depth needs nothing this frame
+	const bool dynamicCasters = recordCasters(scene, shader, camera, true, pointLight);
+	if (!dynamicCasters && view.liveIsStatic) {
+		return;
+	}
+
+	const uint32_t resolution = cube ? POINT_SHADOW_RESOLUTION : CASCADE_RESOLUTION;
+	attach(GL_READ_FRAMEBUFFER, staticTexture, cube, layer);
+	attach(GL_DRAW_FRAMEBUFFER, liveTexture, cube, layer);
+	glBlitFramebuffer(0, 0, resolution, resolution, 0, 0, resolution, resolution, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	view.liveIsStatic = !dynamicCasters;
+	if (dynamicCasters) {
+		drawCasters(shader, camera, stats);
+	}
+}
+
+bool ShadowRenderer::recordCasters(const Scene &scene, const Shader &shader, const Camera &camera, bool dynamic,
+                                   const glm::vec3 *pointLight) {
+	m_casters[0].reset();
+	const Frustum &frustum = camera.frustum();
+	for (const Object &object : scene.objects) {
+		if (object.dynamic != dynamic || object.mesh == nullptr) {
+			continue;
+		}
+		// casters around the light itself would cover it completely
+		const float radius = object.mesh->boundingRadius() * std::max({object.scale.x, object.scale.y, object.scale.z});
+		if ((pointLight != nullptr && glm::distance(object.position, *pointLight) < radius) || !frustum.intersectsSphere(object.position, radius)) {
+			continue;
+		}
+		m_casters[0].draw(makeSortKey(RenderPass::Shadow, shader.id(), 0, object.mesh->vao(), 0.0f), shader, *object.mesh, object.modelMatrix());
+	}
+	return !m_casters[0].packets().empty();
+}
+
+void ShadowRenderer::drawCasters(const Shader &shader, const Camera &camera, FrameStats &stats) {
+	shader.bind();
+	shader.setMat4("lightViewProjection", camera.viewProjection());
+	m_queue.build(m_casters);
+
+	// the queue's program and vao counters belong to the scene pass
+	FrameStats shadowStats;
+	m_queue.submit(shadowStats);
+	stats.shadowDraws += shadowStats.draws;
+}
+
+void ShadowRenderer::attach(uint32_t framebuffer, uint32_t texture, bool cube, uint32_t layer) {
+	const uint32_t bound = framebuffer == GL_READ_FRAMEBUFFER ? m_readFramebuffer : m_drawFramebuffer;
+	glBindFramebuffer(framebuffer, bound);
+	if (cube) {
+		glFramebufferTexture2D(framebuffer, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + layer, texture, 0);
+	} else {
+		glFramebufferTextureLayer(framebuffer, GL_DEPTH_ATTACHMENT, texture, 0, layer);
+	}
+}
+
+void ShadowRenderer::invalidate() {
+	for (View &view : m_cascades) {
+		view = View{};
+	}
+	for (View &view : m_pointFaces) {
+		view = View{};
+	}
+}
+
+void ShadowRenderer::bindMaps(uint32_t cascadeUnit, uint32_t pointUnit) const {
+	glstate::bindTexture(cascadeUnit, GL_TEXTURE_2D_ARRAY, m_cascadeMaps);
+	glstate::bindTexture(pointUnit, GL_TEXTURE_CUBE_MAP, m_pointMap);
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include "command_buffer.h"
+#include "render_queue.h"
+#include "scene.h"
+#include "stats.h"
+#include "uniforms.h"
+
+class Shader;
+
+// texels along each side of a cascade and of a cube face
+constexpr uint32_t CASCADE_RESOLUTION = 1024;
+constexpr uint32_t POINT_SHADOW_RESOLUTION = 512;
+// how far from the camera the cascades reach
+constexpr float SHADOW_DISTANCE = 30.0f;
+
+// Shadows for the sun, from cascades fitted to slices of the camera's
+// frustum, and for one point light from a cube map. Each cascade and cube
+// face is drawn from a camera of its own, orthographic or perspective.
+// Cascades are fitted around bounding spheres and snapped to whole texels,
+// so their cameras only change when the camera moves by a texel.
+//
+// With caching, each cascade and cube face keeps the depth of the static
+// objects in a texture of its own, redrawn only when its camera's version or
+// the scene's static version changes. Every frame that layer is copied into
+// the map the shaders read and dynamic objects are drawn over it; when there
+// are no dynamic objects in view the copy is skipped too. Without caching
+// every caster is drawn every frame.
+class ShadowRenderer {
+    // what a cascade or cube face was last drawn with
+    struct View {
+        uint64_t cameraVersion = 0;
+        uint64_t staticVersion = 0;
+        // static depth is cached for the versions above
+        bool cached = false;
+        // the live map holds only the cached static depth
+        bool liveIsStatic = false;
+    };
+
+    bool m_caching = true;
+
+    // 2D arrays with a layer per cascade, and cube maps. the live ones compare
+    uint32_t m_cascadeMaps = 0;
+    uint32_t m_cascadeStatic = 0;
+    uint32_t m_pointMap = 0;
+    uint32_t m_pointStatic = 0;
+    uint32_t m_drawFramebuffer = 0;
+    uint32_t m_readFramebuffer = 0;
+
+    Camera m_cascadeCameras[SHADOW_CASCADES];
+    Camera m_pointCameras[6];
+    View m_cascades[SHADOW_CASCADES];
+    View m_pointFaces[6];
+    ShadowUniforms m_uniforms;
+
+    std::vector<CommandBuffer> m_casters{1};
+    RenderQueue m_queue;
+
+    // points the draw or read framebuffer's depth at a layer of a cascade array or a cube face
+    void attach(uint32_t framebuffer, uint32_t texture, bool cube, uint32_t layer);
+
+    // records the objects whose dynamic flag matches dynamic and that the camera can see,
+    // returning whether there were any
+    bool recordCasters(const Scene &scene, const Shader &shader, const Camera &camera, bool dynamic,
+                       const glm::vec3 *pointLight);
+
+    // draws what recordCasters recorded
+    void drawCasters(const Shader &shader, const Camera &camera, FrameStats &stats);
+
+    // brings one cascade or cube face up to date
+    void renderView(const Scene &scene, const Shader &shader, View &view, const Camera &camera,
+                    uint32_t liveTexture, uint32_t staticTexture, bool cube, uint32_t layer,
+                    const glm::vec3 *pointLight, FrameStats &stats);
+
+public:
+    void create(bool caching);
+
+    void destroy();
+
+    // fits the cascades to the camera for sunlight travelling along sunDirection,
+    // and fits the cube shadow to pointLight
+    void update(const Camera &camera, const glm::vec3 &sunDirection, const glm::vec3 &sunColor, const PointLight &pointLight);
+
+    // draws whatever changed into the shadow maps with shader (shadow.vs +
+    // shadow.fs). leaves the default framebuffer bound, the viewport has to be restored
+    void render(const Scene &scene, const Shader &shader, FrameStats &stats);
+
+    // forgets the cached static depth, so every view is redrawn next frame
+    void invalidate();
+
+    // binds the cascades as a sampler2DArrayShadow and the cube as a samplerCubeShadow
+    void bindMaps(uint32_t cascadeUnit, uint32_t pointUnit) const;
+
+    inline const ShadowUniforms &uniforms() const {
+        return m_uniforms;
+    }
+};
@@ -0,0 +1,239 @@
+#include "simulation.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include <GLFW/glfw3.h>
+
+#include "spdlog/spdlog.h"
+
+namespace {
+
+	// most steps one tick catches up on; a longer backlog is dropped rather
+	// than letting slow steps fall further and further behind
+	constexpr uint32_t MAX_STEPS_PER_TICK = 8;
+
+	// the simulation thread wakes at least this often so stop() stays quick
+	constexpr double MAX_SLEEP_SECONDS = 0.01;
+
+	// times pushInput retries with a full queue before giving up on an event
+	constexpr uint32_t MAX_PUSH_ATTEMPTS = 10000;
+
+	// keys that move the camera, in Movement order
+	constexpr int MOVEMENT_KEYS[4] = {GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D};
+
+}
+
+SimulationState SimulationState::mix(const SimulationState &a, const SimulationState &b, float t) {
+    SimulationState result;
+    result.cameraPosition = glm::mix(a.cameraPosition, b.cameraPosition, t);
+    result.yaw = glm::mix(a.yaw, b.yaw, t);
+    result.pitch = glm::mix(a.pitch, b.pitch, t);
+    result.zoom = glm::mix(a.zoom, b.zoom, t);
+    result.lightPos = glm::mix(a.lightPos, b.lightPos, t);
+    return result;
+}
+
+SimulationState FrameSnapshot::interpolate(double time) const {
+    if (stepSeconds <= 0.0) {
+        return current;
+    }
+    const double t = std::clamp((time - stepTime) / stepSeconds, 0.0, 1.0);
+    return SimulationState::mix(previous, current, static_cast<float>(t));
+}
+
+Simulation::Simulation(const Camera &camera, const glm::vec3 &lightPos, uint32_t stepsPerSecond)
+        : m_camera{camera}, m_lightPos{lightPos}, m_stepSeconds{1.0 / stepsPerSecond} {
+    spdlog::debug("Simulating at {} steps per second", stepsPerSecond);
+
+    // make a valid snapshot available before the first tick
+    m_previous = currentState();
+    publish();
+    m_snapshots.update();
+}
+
+Simulation::~Simulation() {
+    stop();
+}
+
+void Simulation::start() {
+    spdlog::debug("Starting simulation thread");
+    m_running = true;
+    m_thread = std::thread([this] {
+        while (m_running) {
+            // sleep until the next step is due
+            const double wait = std::clamp(tick(), 0.0, MAX_SLEEP_SECONDS);
+            std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+        }
+    });
+}
+
+void Simulation::stop() {
+    m_running = false;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+double Simulation::tick() {
+    const double now = glfwGetTime();
+    // the clock starts with the first tick
+    if (m_stepTime == 0.0) {
+        m_stepTime = now;
+    }
+
+    InputEvent event;
+    while (m_inputQueue.pop(event)) {
+        m_input.push_back(event);
+    }
+
+    // input the renderer has already shown no longer counts towards latency
+    if (m_oldestInput > 0.0 && m_consumedSequence.load(std::memory_order_acquire) >= m_oldestInputSequence) {
+        m_oldestInput = 0.0;
+    }
+
+    // avoid the spiral of death: after a stall, skip ahead instead of
+    // running every missed step
+    uint32_t steps = static_cast<uint32_t>((now - m_stepTime) / m_stepSeconds);
+    if (steps > MAX_STEPS_PER_TICK) {
+        const uint32_t dropped = steps - MAX_STEPS_PER_TICK;
+        spdlog::debug("Simulation fell behind, dropping {} steps", dropped);
+        m_stepTime += dropped * m_stepSeconds;
+        steps = MAX_STEPS_PER_TICK;
+    }
+
+    for (uint32_t i = 0; i < steps; ++i) {
+        auto stepStart = std::chrono::steady_clock::now();
+        m_stepTime += m_stepSeconds;
+        step();
+        m_stepMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stepStart).count();
+        ++m_steps;
+    }
+    if (steps > 0) {
+        publish();
+    }
+
+    return m_stepTime + m_stepSeconds - now;
+}
+
+void Simulation::step() {
+    m_previous = currentState();
+
+    // input lands in the step it arrived in, whatever the tick rate
+    size_t consumed = 0;
+    while (consumed < m_input.size() && m_input[consumed].time <= m_stepTime) {
+        const InputEvent &event = m_input[consumed++];
+        applyInput(event);
+        if (m_oldestInput == 0.0) {
+            m_oldestInput = event.time;
+            m_oldestInputSequence = m_sequence + 1;
+        }
+    }
+    m_input.erase(m_input.begin(), m_input.begin() + consumed);
+    m_inputEvents += consumed;
+
+    // however many events came in, the camera vectors are rebuilt once
+    if (m_cursorDelta != glm::vec2{0.0f}) {
+        m_camera.rotate(m_cursorDelta.x, m_cursorDelta.y);
+        m_cursorDelta = glm::vec2{0.0f};
+    }
+    if (m_scrollDelta != 0.0f) {
+        m_camera.zoom(m_scrollDelta);
+        m_scrollDelta = 0.0f;
+    }
+
+    // move camera
+    for (int i = 0; i < 4; ++i) {
+        if (m_heldKeys & (1u << i)) {
+            m_camera.move(static_cast<Movement>(i), static_cast<float>(m_stepSeconds));
+        }
+    }
+}
+
+void Simulation::applyInput(const InputEvent &event) {
+    switch (event.type) {
+        case InputEvent::Type::Key:
+            for (int i = 0; i < 4; ++i) {
+                if (event.key != MOVEMENT_KEYS[i] || event.action == GLFW_REPEAT) {
+                    continue;
+                }
+                if (event.action == GLFW_PRESS) {
+                    m_heldKeys |= 1u << i;
+                } else {
+                    m_heldKeys &= ~(1u << i);
+                }
+            }
+            break;
+        case InputEvent::Type::CursorMove: {
+            if (m_firstCursor) {
+                m_lastX = event.x;
+                m_lastY = event.y;
+                m_firstCursor = false;
+            }
+
+            m_cursorDelta.x += static_cast<float>(event.x - m_lastX);
+            m_cursorDelta.y += static_cast<float>(m_lastY - event.y);
+
+            m_lastX = event.x;
+            m_lastY = event.y;
+            break;
+        }
+        case InputEvent::Type::Scroll:
+            m_scrollDelta += static_cast<float>(event.y);
+            break;
+    }
+}
+
+SimulationState Simulation::currentState() const {
+    SimulationState state;
+    state.cameraPosition = m_camera.position();
+    state.yaw = m_camera.yaw();
+    state.pitch = m_camera.pitch();
+    state.zoom = m_camera.zoomOffset();
+    state.lightPos = m_lightPos;
+    return state;
+}
+
+void Simulation::publish() {
+    FrameSnapshot &snapshot = m_snapshots.writeBuffer();
+    snapshot.sequence = ++m_sequence;
+    snapshot.previous = m_previous;
+    snapshot.current = currentState();
+    snapshot.stepTime = m_stepTime;
+    snapshot.stepSeconds = m_stepSeconds;
+    snapshot.inputTime = m_oldestInput;
+    m_snapshots.publish();
+}
+
+void Simulation::pushInput(const InputEvent &event) {
+    if (m_inputQueue.push(event)) {
+        return;
+    }
+    // cursor positions are absolute, so the next one makes up for a lost one,
+    // but keys and scrolling are worth waiting for the queue to drain
+    if (event.type != InputEvent::Type::CursorMove) {
+        for (uint32_t attempt = 0; attempt < MAX_PUSH_ATTEMPTS; ++attempt) {
+            std::this_thread::yield();
+            if (m_inputQueue.push(event)) {
+                return;
+            }
+        }
+    }
+    ++m_droppedInputEvents;
+}
+
+void Simulation::logStats() const {
+    if (m_steps == 0) {
+        return;
+    }
+    const double n = static_cast<double>(m_steps);
+    spdlog::info("Simulation: {} steps, {:.1f} input events/step, {:.4f} ms/step, {} input events dropped",
+                 m_steps, m_inputEvents / n, m_stepMs / n, m_droppedInputEvents);
+}
+
+const FrameSnapshot &Simulation::latestSnapshot() {
+    m_snapshots.update();
+    const FrameSnapshot &snapshot = m_snapshots.readBuffer();
+    m_consumedSequence.store(snapshot.sequence, std::memory_order_release);
+    return snapshot;
+}
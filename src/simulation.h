@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include "spsc_queue.h"
+#include "triple_buffer.h"
+
+// Simulation steps per second
+constexpr uint32_t DEFAULT_SIMULATION_HZ = 60;
+constexpr uint32_t MAX_SIMULATION_HZ = 1000;
+
+// The part of the simulation the renderer sees, at the end of one step
+struct SimulationState {
+    glm::vec3 cameraPosition{0.0f};
+    float yaw = YAW;
+    float pitch = PITCH;
+    float zoom = ZOOM;
+    glm::vec3 lightPos{0.0f};
+
+    // blends from a to b
+    static SimulationState mix(const SimulationState &a, const SimulationState &b, float t);
+};
+
+// Everything the renderer needs from one simulation tick. Never modified after
+// being published, so the render thread can read it while the next is built.
+struct FrameSnapshot {
+    // increases by one per published snapshot, 0 before the first
+    uint64_t sequence = 0;
+    // state before and after the newest fixed step
+    SimulationState previous;
+    SimulationState current;
+    // glfw time current belongs to and the length of a step in seconds
+    double stepTime = 0.0;
+    double stepSeconds = 0.0;
+    // glfw time of the oldest input folded into this or an earlier snapshot
+    // the renderer has not picked up yet, 0 when there is none
+    double inputTime = 0.0;
+
+    // state to draw at glfw time, which is shown one step late so there are
+    // always two states to blend between
+    SimulationState interpolate(double time) const;
+};
+
+// Input events the main thread can queue before the simulation drains them
+constexpr size_t INPUT_QUEUE_SIZE = 4096;
+
+// Input as received from glfw on the main thread
+struct InputEvent {
+    enum class Type {
+        Key,
+        CursorMove,
+        Scroll,
+    };
+
+    Type type;
+    // glfw time the event arrived
+    double time;
+    int key;
+    int action;
+    double x;
+    double y;
+};
+
+// Owns the camera and scene state and advances it from input in fixed steps,
+// either on its own thread or ticked by the render loop. Input arrives from
+// the main thread and results leave through a triple buffer of snapshots.
+class Simulation {
+    Camera m_camera;
+    glm::vec3 m_lightPos;
+    double m_stepSeconds;
+
+    // input handed over from the main thread
+    SpscQueue<InputEvent, INPUT_QUEUE_SIZE> m_inputQueue;
+    // main thread only
+    uint64_t m_droppedInputEvents = 0;
+
+    // simulation thread state
+    std::vector<InputEvent> m_input;
+    // bit per Movement for keys held down
+    uint32_t m_heldKeys = 0;
+    bool m_firstCursor = true;
+    double m_lastX = 0.0;
+    double m_lastY = 0.0;
+    // glfw time the current state belongs to, 0 until the first tick
+    double m_stepTime = 0.0;
+    SimulationState m_previous;
+    uint64_t m_sequence = 0;
+    double m_oldestInput = 0.0;
+    uint64_t m_oldestInputSequence = 0;
+
+    // what one step gathered from its input, applied to the camera at once
+    glm::vec2 m_cursorDelta{0.0f};
+    float m_scrollDelta = 0.0f;
+
+    // totals for the run, logged by stop()
+    uint64_t m_steps = 0;
+    uint64_t m_inputEvents = 0;
+    double m_stepMs = 0.0;
+
+    TripleBuffer<FrameSnapshot> m_snapshots;
+    // newest snapshot the renderer has picked up
+    std::atomic<uint64_t> m_consumedSequence{0};
+
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+
+    // folds an event into this step's totals
+    void applyInput(const InputEvent &event);
+
+    // advances the state by one fixed step ending at m_stepTime
+    void step();
+
+    SimulationState currentState() const;
+
+    void publish();
+
+public:
+    Simulation(const Camera &camera, const glm::vec3 &lightPos, uint32_t stepsPerSecond = DEFAULT_SIMULATION_HZ);
+
+    ~Simulation();
+
+    // runs tick() on a dedicated thread until stop()
+    void start();
+
+    void stop();
+
+    // runs the fixed steps that have come due since the last tick and
+    // publishes a snapshot if there were any. returns the seconds until the
+    // next step is due. call from a single thread only
+    double tick();
+
+    // called from the main thread by glfw callbacks, which must be the only
+    // thread pushing input
+    void pushInput(const InputEvent &event);
+
+    // logs step and input totals, once the simulation has stopped
+    void logStats() const;
+
+    // called by the render thread: returns the newest snapshot, which stays
+    // valid until the next call
+    const FrameSnapshot &latestSnapshot();
+};
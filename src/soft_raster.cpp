@@ -0,0 +1,383 @@
+#include "soft_raster.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "spdlog/spdlog.h"
+
+#include "jobs.h"
+#include "soft_raster_kernel.h"
+
+namespace softraster {
+
+	void rasterizeTileScalar(const TileTarget &target, const Triangle *const *triangles, size_t count, SoftFragments &fragments) {
+		rasterizeTile<ScalarLanes>(target, triangles, count, fragments);
+	}
+
+#if defined(__SSE2__) || defined(_M_X64)
+	void rasterizeTileSse2(const TileTarget &target, const Triangle *const *triangles, size_t count, SoftFragments &fragments) {
+		rasterizeTile<Sse2Lanes>(target, triangles, count, fragments);
+	}
+#endif
+
+}
+
+using softraster::Triangle;
+using softraster::TileTarget;
+using softraster::TILE_SIZE;
+
+namespace {
+
+	// draws handed to a thread at a time when setting up triangles
+	constexpr size_t SETUP_CHUNK_SIZE = 64;
+
+	struct ClipVertex {
+		glm::vec4 clip;
+		glm::vec3 world;
+	};
+
+	uint32_t packColor(const glm::vec4 &color) {
+		auto channel = [](float value) {
+			return static_cast<uint32_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+		};
+		return channel(color.x) | channel(color.y) << 8 | channel(color.z) << 16 | channel(color.w) << 24;
+	}
+
+#if defined(SOFT_RASTER_AVX2)
+	bool cpuHasAvx2() {
+#if defined(__GNUC__)
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#else
+		return false;
+#endif
+	}
+#endif
+
+	// whether all three vertices are outside the same clip plane other than near
+	bool outsideFrustum(const ClipVertex *vertices) {
+		for (int axis = 0; axis < 3; ++axis) {
+			bool allAbove = true;
+			bool allBelow = axis < 2;
+			for (int i = 0; i < 3; ++i) {
+				const glm::vec4 &clip = vertices[i].clip;
+				allAbove = allAbove && clip[axis] > clip.w;
+				allBelow = allBelow && clip[axis] < -clip.w;
+			}
+			if (allAbove || allBelow) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// clips a triangle against the near plane, z >= -w, leaving a fan of up to
+	// four vertices
+	int clipNear(const ClipVertex *in, ClipVertex *out) {
+		int count = 0;
+		for (int i = 0; i < 3; ++i) {
+			const ClipVertex &a = in[i];
+			const ClipVertex &b = in[(i + 1) % 3];
+			const float distanceA = a.clip.z + a.clip.w;
+			const float distanceB = b.clip.z + b.clip.w;
+			if (distanceA >= 0.0f) {
+				out[count++] = a;
+			}
+			if ((distanceA >= 0.0f) != (distanceB >= 0.0f)) {
+				const float t = distanceA / (distanceA - distanceB);
+				out[count++] = ClipVertex{a.clip + (b.clip - a.clip) * t, a.world + (b.world - a.world) * t};
+			}
+		}
+		return count;
+	}
+
+	// edge function through a and b, positive on the left. Always computed
+	// from the same end whichever way round the edge is walked, so two
+	// triangles sharing it get exactly opposite values on every pixel
+	void edgeFunction(const glm::vec2 &a, const glm::vec2 &b, float *edge) {
+		const bool swapped = b.x < a.x || (b.x == a.x && b.y < a.y);
+		const glm::vec2 &from = swapped ? b : a;
+		const glm::vec2 &to = swapped ? a : b;
+		const float sign = swapped ? -1.0f : 1.0f;
+		edge[0] = sign * (from.y - to.y);
+		edge[1] = sign * (to.x - from.x);
+		edge[2] = sign * (from.x * to.y - to.x * from.y);
+	}
+
+	// plane through per-vertex values, from the edge functions opposite each vertex
+	void interpolationPlane(const float (&edges)[3][3], float invArea, float v0, float v1, float v2, float *plane) {
+		for (int i = 0; i < 3; ++i) {
+			plane[i] = (v0 * edges[0][i] + v1 * edges[1][i] + v2 * edges[2][i]) * invArea;
+		}
+	}
+
+	// projects a clipped triangle to the screen and sets up its planes,
+	// returns false when it covers no pixel centre
+	bool setupTriangle(const ClipVertex &a, const ClipVertex &b, const ClipVertex &c, float width, float height, const SoftShader *shader, Triangle &triangle) {
+		const ClipVertex *vertices[3] = {&a, &b, &c};
+		glm::vec2 screen[3];
+		float depth[3];
+		float invW[3];
+		for (int i = 0; i < 3; ++i) {
+			const glm::vec4 &clip = vertices[i]->clip;
+			invW[i] = 1.0f / clip.w;
+			screen[i] = glm::vec2{(clip.x * invW[i] * 0.5f + 0.5f) * width, (clip.y * invW[i] * 0.5f + 0.5f) * height};
+			depth[i] = clip.z * invW[i] * 0.5f + 0.5f;
+		}
+
+		const float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+		if (!(std::abs(area) > 0.0f) || !std::isfinite(area)) {
+			return false;
+		}
+
+		// pixel centres inside the bounding box
+		const float minX = std::min({screen[0].x, screen[1].x, screen[2].x});
+		const float maxX = std::max({screen[0].x, screen[1].x, screen[2].x});
+		const float minY = std::min({screen[0].y, screen[1].y, screen[2].y});
+		const float maxY = std::max({screen[0].y, screen[1].y, screen[2].y});
+		triangle.minX = static_cast<int>(std::max(0.0f, std::ceil(minX - 0.5f)));
+		triangle.minY = static_cast<int>(std::max(0.0f, std::ceil(minY - 0.5f)));
+		triangle.maxX = static_cast<int>(std::min(width, std::floor(maxX - 0.5f) + 1.0f));
+		triangle.maxY = static_cast<int>(std::min(height, std::floor(maxY - 0.5f) + 1.0f));
+		if (triangle.minX >= triangle.maxX || triangle.minY >= triangle.maxY) {
+			return false;
+		}
+
+		// edge i is opposite vertex i, flipped so the inside is positive
+		edgeFunction(screen[1], screen[2], triangle.edges[0]);
+		edgeFunction(screen[2], screen[0], triangle.edges[1]);
+		edgeFunction(screen[0], screen[1], triangle.edges[2]);
+		const float orientation = area < 0.0f ? -1.0f : 1.0f;
+		for (int i = 0; i < 3; ++i) {
+			for (float &coefficient : triangle.edges[i]) {
+				coefficient *= orientation;
+			}
+			// of two triangles sharing an edge exactly one owns the pixels on it
+			const float edgeA = triangle.edges[i][0];
+			const float edgeB = triangle.edges[i][1];
+			triangle.inclusive[i] = edgeA > 0.0f || (edgeA == 0.0f && edgeB > 0.0f);
+		}
+
+		const float invArea = 1.0f / std::abs(area);
+		interpolationPlane(triangle.edges, invArea, depth[0], depth[1], depth[2], triangle.depth);
+		interpolationPlane(triangle.edges, invArea, invW[0], invW[1], invW[2], triangle.invW);
+		for (int axis = 0; axis < 3; ++axis) {
+			interpolationPlane(triangle.edges, invArea,
+			                   a.world[axis] * invW[0], b.world[axis] * invW[1], c.world[axis] * invW[2], triangle.world[axis]);
+		}
+		triangle.shader = shader;
+		return true;
+	}
+
+}
+
+void SoftBasicShader::shade(const SoftFragments &fragments, uint32_t *colors) const {
+	for (uint32_t i = 0; i < fragments.count; ++i) {
+		if (fragments.mask & (1u << i)) {
+			colors[i] = 0xffffffff;
+		}
+	}
+}
+
+void SoftLightingShader::setColors(const glm::vec3 &objectColor, const glm::vec3 &lightColor) {
+	m_color = packColor(glm::vec4{lightColor * objectColor, 1.0f});
+}
+
+void SoftLightingShader::shade(const SoftFragments &fragments, uint32_t *colors) const {
+	for (uint32_t i = 0; i < fragments.count; ++i) {
+		if (fragments.mask & (1u << i)) {
+			colors[i] = m_color;
+		}
+	}
+}
+
+SoftwareRasterizer::SoftwareRasterizer() {
+#if defined(SOFT_RASTER_AVX2)
+	if (cpuHasAvx2()) {
+		m_kernel = softraster::rasterizeTileAvx2;
+		m_kernelName = "AVX2";
+		return;
+	}
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+	m_kernel = softraster::rasterizeTileSse2;
+	m_kernelName = "SSE2";
+#else
+	m_kernel = softraster::rasterizeTileScalar;
+	m_kernelName = "scalar";
+#endif
+}
+
+SoftwareRasterizer::~SoftwareRasterizer() = default;
+
+void SoftwareRasterizer::resize(uint32_t width, uint32_t height) {
+	m_width = width;
+	m_height = height;
+	m_tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	m_tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+	m_stride = m_tilesX * TILE_SIZE;
+	m_color.assign(static_cast<size_t>(m_stride) * m_tilesY * TILE_SIZE, m_clearColor);
+	m_depth.assign(m_color.size(), 1.0f);
+}
+
+void SoftwareRasterizer::setClearColor(const glm::vec4 &color) {
+	m_clearColor = packColor(color);
+}
+
+void SoftwareRasterizer::setMesh(uint32_t vao, const std::vector<float> &positions, const std::vector<uint32_t> &indices) {
+	Mesh &mesh = m_meshes[vao];
+	mesh.positions.clear();
+	for (size_t i = 0; i + 2 < positions.size(); i += 3) {
+		mesh.positions.emplace_back(positions[i], positions[i + 1], positions[i + 2]);
+	}
+	mesh.indices = indices;
+}
+
+void SoftwareRasterizer::setShader(uint32_t program, const SoftShader *shader) {
+	m_shaders[program] = shader;
+}
+
+void SoftwareRasterizer::render(JobSystem &jobs, const RenderQueue &queue, const glm::mat4 &viewProjection, FrameStats &stats) {
+	setupDraws(jobs, queue, viewProjection);
+	rasterizeTiles(jobs);
+	for (const ThreadData &thread : m_threads) {
+		stats.draws += thread.draws;
+	}
+
+	// the state changes the queue would have cost on the gpu, so runs on
+	// either backend report the same counters
+	uint32_t program = 0;
+	uint32_t vao = 0;
+	for (size_t i = 0; i < queue.size(); ++i) {
+		const DrawPacket &packet = queue.packet(i);
+		if (packet.program != program) {
+			program = packet.program;
+			++stats.programChanges;
+		}
+		if (packet.vao != vao) {
+			vao = packet.vao;
+			++stats.vaoChanges;
+		}
+	}
+}
+
+void SoftwareRasterizer::setupDraws(JobSystem &jobs, const RenderQueue &queue, const glm::mat4 &viewProjection) {
+	const size_t tileCount = static_cast<size_t>(m_tilesX) * m_tilesY;
+	m_threads.resize(jobs.threadCount());
+	for (ThreadData &thread : m_threads) {
+		thread.draws = 0;
+		thread.triangles.clear();
+		thread.bins.resize(tileCount);
+		for (std::vector<BinEntry> &bin : thread.bins) {
+			bin.clear();
+		}
+	}
+
+	const float width = static_cast<float>(m_width);
+	const float height = static_cast<float>(m_height);
+	jobs.parallelFor(queue.size(), SETUP_CHUNK_SIZE, [&](size_t begin, size_t end, uint32_t threadIndex) {
+		ThreadData &thread = m_threads[threadIndex];
+		for (size_t i = begin; i < end; ++i) {
+			const DrawPacket &packet = queue.packet(i);
+			auto mesh = m_meshes.find(packet.vao);
+			auto shader = m_shaders.find(packet.program);
+			if (mesh == m_meshes.end() || shader == m_shaders.end()) {
+				continue;
+			}
+			++thread.draws;
+
+			// transform every vertex once, the triangles share them
+			const std::vector<glm::vec3> &positions = mesh->second.positions;
+			const glm::mat4 modelViewProjection = viewProjection * packet.model;
+			thread.clipPositions.resize(positions.size());
+			thread.worldPositions.resize(positions.size());
+			for (size_t v = 0; v < positions.size(); ++v) {
+				const glm::vec4 position{positions[v], 1.0f};
+				thread.clipPositions[v] = modelViewProjection * position;
+				thread.worldPositions[v] = glm::vec3{packet.model * position};
+			}
+
+			const std::vector<uint32_t> &indices = mesh->second.indices;
+			const size_t lastIndex = std::min<size_t>(packet.firstIndex + packet.indexCount, indices.size());
+			for (size_t index = packet.firstIndex; index + 3 <= lastIndex; index += 3) {
+				ClipVertex vertices[3];
+				for (int corner = 0; corner < 3; ++corner) {
+					const uint32_t vertex = indices[index + corner];
+					vertices[corner] = ClipVertex{thread.clipPositions[vertex], thread.worldPositions[vertex]};
+				}
+				if (outsideFrustum(vertices)) {
+					continue;
+				}
+
+				ClipVertex clipped[4];
+				const int clippedCount = clipNear(vertices, clipped);
+				for (int fan = 1; fan + 1 < clippedCount; ++fan) {
+					Triangle triangle;
+					if (!setupTriangle(clipped[0], clipped[fan], clipped[fan + 1], width, height, shader->second, triangle)) {
+						continue;
+					}
+
+					const BinEntry entry{static_cast<uint32_t>(i), static_cast<uint32_t>(thread.triangles.size())};
+					thread.triangles.push_back(triangle);
+					const int firstTileX = triangle.minX / TILE_SIZE;
+					const int lastTileX = (triangle.maxX - 1) / TILE_SIZE;
+					const int firstTileY = triangle.minY / TILE_SIZE;
+					const int lastTileY = (triangle.maxY - 1) / TILE_SIZE;
+					for (int tileY = firstTileY; tileY <= lastTileY; ++tileY) {
+						for (int tileX = firstTileX; tileX <= lastTileX; ++tileX) {
+							thread.bins[static_cast<size_t>(tileY) * m_tilesX + tileX].push_back(entry);
+						}
+					}
+				}
+			}
+		}
+	});
+}
+
+void SoftwareRasterizer::rasterizeTiles(JobSystem &jobs) {
+	const size_t tileCount = static_cast<size_t>(m_tilesX) * m_tilesY;
+	jobs.parallelFor(tileCount, 1, [&](size_t begin, size_t end, uint32_t threadIndex) {
+		ThreadData &thread = m_threads[threadIndex];
+		SoftFragments fragments;
+		for (size_t tile = begin; tile < end; ++tile) {
+			TileTarget target;
+			target.color = m_color.data();
+			target.depth = m_depth.data();
+			target.stride = m_stride;
+			target.x0 = static_cast<int>(tile % m_tilesX) * TILE_SIZE;
+			target.y0 = static_cast<int>(tile / m_tilesX) * TILE_SIZE;
+			target.x1 = target.x0 + TILE_SIZE;
+			target.y1 = target.y0 + TILE_SIZE;
+
+			// the tile is cleared by whoever draws it, while it is in cache
+			for (int y = target.y0; y < target.y1; ++y) {
+				const size_t row = static_cast<size_t>(y) * m_stride + target.x0;
+				std::fill_n(m_color.begin() + row, TILE_SIZE, m_clearColor);
+				std::fill_n(m_depth.begin() + row, TILE_SIZE, 1.0f);
+			}
+
+			// every thread's bin is already in queue order, merge them
+			thread.tileTriangles.clear();
+			thread.mergeHeads.assign(m_threads.size(), 0);
+			while (true) {
+				size_t next = m_threads.size();
+				uint32_t nextOrder = 0;
+				for (size_t source = 0; source < m_threads.size(); ++source) {
+					const std::vector<BinEntry> &bin = m_threads[source].bins[tile];
+					const size_t head = thread.mergeHeads[source];
+					if (head < bin.size() && (next == m_threads.size() || bin[head].order < nextOrder)) {
+						next = source;
+						nextOrder = bin[head].order;
+					}
+				}
+				if (next == m_threads.size()) {
+					break;
+				}
+				const BinEntry &entry = m_threads[next].bins[tile][thread.mergeHeads[next]++];
+				thread.tileTriangles.push_back(&m_threads[next].triangles[entry.triangle]);
+			}
+
+			m_kernel(target, thread.tileTriangles.data(), thread.tileTriangles.size(), fragments);
+		}
+	});
+}
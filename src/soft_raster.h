@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "render_queue.h"
+#include "stats.h"
+
+class JobSystem;
+
+// widest batch of pixels the rasterizer shades at once
+constexpr uint32_t SOFT_MAX_LANES = 8;
+
+// A batch of neighbouring pixels in one row of one triangle
+struct SoftFragments {
+    // pixels in the batch, and the ones that passed coverage and depth as bits
+    uint32_t count;
+    uint32_t mask;
+    alignas(32) float depth[SOFT_MAX_LANES];
+    // world space position, only filled for shaders that ask for it
+    alignas(32) float worldX[SOFT_MAX_LANES];
+    alignas(32) float worldY[SOFT_MAX_LANES];
+    alignas(32) float worldZ[SOFT_MAX_LANES];
+};
+
+// Fragment stage of the software rasterizer, the counterpart of a program's
+// fragment shader. Shaders are shared between threads, so shade() must not
+// modify the shader.
+class SoftShader {
+public:
+    // interpolate world positions into the fragments, which costs a divide per pixel
+    bool needsWorldPosition = false;
+
+    virtual ~SoftShader() = default;
+
+    // writes an rgba8 color for every fragment in the mask, colors points at
+    // the first pixel of the batch
+    virtual void shade(const SoftFragments &fragments, uint32_t *colors) const = 0;
+};
+
+// basic.fs
+class SoftBasicShader: public SoftShader {
+public:
+    void shade(const SoftFragments &fragments, uint32_t *colors) const override;
+};
+
+// lighting.fs
+class SoftLightingShader: public SoftShader {
+    uint32_t m_color = 0;
+
+public:
+    void setColors(const glm::vec3 &objectColor, const glm::vec3 &lightColor);
+
+    void shade(const SoftFragments &fragments, uint32_t *colors) const override;
+};
+
+namespace softraster {
+    struct Triangle;
+    struct TileTarget;
+}
+
+// Draws a render queue on the cpu, for machines without a usable gpu. Draws
+// are transformed, clipped and binned into 64x64 tiles in parallel, then each
+// tile is rasterized by one thread with edge functions evaluated for 8 (AVX2),
+// 4 (SSE2) or 1 pixel at a time, depending on what the cpu supports.
+// Produces rgba8 color with the bottom row first, as opengl reads it back.
+class SoftwareRasterizer {
+    struct Mesh {
+        std::vector<glm::vec3> positions;
+        std::vector<uint32_t> indices;
+    };
+
+    // a triangle binned into a tile: its index in the thread's list, and the
+    // queue position it came from so tiles replay draws in submission order
+    struct BinEntry {
+        uint32_t order;
+        uint32_t triangle;
+    };
+
+    // everything one job system thread writes while setting up and rasterizing
+    struct alignas(64) ThreadData {
+        uint32_t draws = 0;
+        std::vector<softraster::Triangle> triangles;
+        std::vector<std::vector<BinEntry>> bins;
+        std::vector<glm::vec4> clipPositions;
+        std::vector<glm::vec3> worldPositions;
+        std::vector<const softraster::Triangle *> tileTriangles;
+        std::vector<size_t> mergeHeads;
+    };
+
+    using TileKernel = void (*)(const softraster::TileTarget &, const softraster::Triangle *const *, size_t, SoftFragments &);
+
+    std::unordered_map<uint32_t, Mesh> m_meshes;
+    std::unordered_map<uint32_t, const SoftShader *> m_shaders;
+
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    // padded to whole tiles
+    uint32_t m_stride = 0;
+    uint32_t m_tilesX = 0;
+    uint32_t m_tilesY = 0;
+    std::vector<uint32_t> m_color;
+    std::vector<float> m_depth;
+    uint32_t m_clearColor = 0;
+
+    std::vector<ThreadData> m_threads;
+    TileKernel m_kernel;
+    const char *m_kernelName;
+
+    void setupDraws(JobSystem &jobs, const RenderQueue &queue, const glm::mat4 &viewProjection);
+
+    void rasterizeTiles(JobSystem &jobs);
+
+public:
+    SoftwareRasterizer();
+
+    ~SoftwareRasterizer();
+
+    void resize(uint32_t width, uint32_t height);
+
+    void setClearColor(const glm::vec4 &color);
+
+    // keeps a copy of a mesh's tightly packed vec3 positions and triangle
+    // indices, for the draws that use this vertex array
+    void setMesh(uint32_t vao, const std::vector<float> &positions, const std::vector<uint32_t> &indices);
+
+    // shades the draws made with this program
+    void setShader(uint32_t program, const SoftShader *shader);
+
+    // clears the frame and draws the queue. draws with a program or vertex
+    // array the rasterizer does not know are skipped. program and vertex
+    // array changes are counted as the opengl path would make them
+    void render(JobSystem &jobs, const RenderQueue &queue, const glm::mat4 &viewProjection, FrameStats &stats);
+
+    inline const char *kernelName() const {
+        return m_kernelName;
+    }
+
+    inline uint32_t width() const {
+        return m_width;
+    }
+
+    inline uint32_t height() const {
+        return m_height;
+    }
+
+    // pixels between the starts of two rows
+    inline uint32_t stride() const {
+        return m_stride;
+    }
+
+    inline const uint32_t *color() const {
+        return m_color.data();
+    }
+};
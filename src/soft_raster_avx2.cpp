@@ -0,0 +1,13 @@
+// Built with AVX2 enabled when the compiler targets x86, and only called once
+// the cpu has been checked for it
+#include "soft_raster_kernel.h"
+
+#if defined(__AVX2__)
+namespace softraster {
+
+	void rasterizeTileAvx2(const TileTarget &target, const Triangle *const *triangles, size_t count, SoftFragments &fragments) {
+		rasterizeTile<Avx2Lanes>(target, triangles, count, fragments);
+	}
+
+}
+#endif
@@ -0,0 +1,215 @@
+#pragma once
+
+// Internal to the software rasterizer: triangle setup shared between the
+// binning code and the tile kernels, and the kernels themselves written once
+// against a small lane abstraction. Each kernel is instantiated in exactly
+// one translation unit, compiled for its instruction set, and everything here
+// has internal linkage so no AVX2 code can leak into the baseline build.
+
+#include <cstddef>
+#include <cstdint>
+
+#include "soft_raster.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace softraster {
+
+	// A triangle after setup. Edge functions, depth and interpolated values are
+	// planes a * x + b * y + c over pixel centres, with edges oriented so the
+	// inside is positive.
+	struct Triangle {
+		float edges[3][3];
+		// whether pixels exactly on the edge are covered, by the top-left rule
+		bool inclusive[3];
+		float depth[3];
+		// 1 / w and world position / w, for perspective correct interpolation
+		float invW[3];
+		float world[3][3];
+		// covered pixel rows and columns, max exclusive
+		int minX;
+		int minY;
+		int maxX;
+		int maxY;
+		const SoftShader *shader;
+	};
+
+	// The part of the framebuffer one tile kernel call may touch
+	struct TileTarget {
+		uint32_t *color;
+		float *depth;
+		uint32_t stride;
+		int x0;
+		int y0;
+		int x1;
+		int y1;
+	};
+
+	// the tile width is a multiple of every lane count, so batches never cross tiles
+	constexpr int TILE_SIZE = 64;
+
+	void rasterizeTileScalar(const TileTarget &target, const Triangle *const *triangles, size_t count, SoftFragments &fragments);
+	void rasterizeTileSse2(const TileTarget &target, const Triangle *const *triangles, size_t count, SoftFragments &fragments);
+	void rasterizeTileAvx2(const TileTarget &target, const Triangle *const *triangles, size_t count, SoftFragments &fragments);
+
+	namespace {
+
+		inline int minInt(int a, int b) {
+			return a < b ? a : b;
+		}
+
+		inline int maxInt(int a, int b) {
+			return a > b ? a : b;
+		}
+
+		struct ScalarLanes {
+			static constexpr int WIDTH = 1;
+			using Float = float;
+			using Mask = bool;
+
+			static inline Float splat(float v) { return v; }
+			static inline Float ramp() { return 0.0f; }
+			static inline Float load(const float *p) { return *p; }
+			static inline void store(float *p, Float v) { *p = v; }
+			static inline void storeMasked(float *p, Mask m, Float v) { if (m) { *p = v; } }
+			static inline Float add(Float a, Float b) { return a + b; }
+			static inline Float mul(Float a, Float b) { return a * b; }
+			static inline Float madd(Float a, Float b, Float c) { return a * b + c; }
+			static inline Float div(Float a, Float b) { return a / b; }
+			static inline Mask greaterEqual(Float a, Float b) { return a >= b; }
+			static inline Mask greater(Float a, Float b) { return a > b; }
+			static inline Mask less(Float a, Float b) { return a < b; }
+			static inline Mask both(Mask a, Mask b) { return a && b; }
+			static inline uint32_t bits(Mask m) { return m ? 1u : 0u; }
+		};
+
+#if defined(__SSE2__) || defined(_M_X64)
+		struct Sse2Lanes {
+			static constexpr int WIDTH = 4;
+			using Float = __m128;
+			using Mask = __m128;
+
+			static inline Float splat(float v) { return _mm_set1_ps(v); }
+			static inline Float ramp() { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+			static inline Float load(const float *p) { return _mm_loadu_ps(p); }
+			static inline void store(float *p, Float v) { _mm_storeu_ps(p, v); }
+			static inline void storeMasked(float *p, Mask m, Float v) {
+				_mm_storeu_ps(p, _mm_or_ps(_mm_and_ps(m, v), _mm_andnot_ps(m, _mm_loadu_ps(p))));
+			}
+			static inline Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+			static inline Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+			static inline Float madd(Float a, Float b, Float c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+			static inline Float div(Float a, Float b) { return _mm_div_ps(a, b); }
+			static inline Mask greaterEqual(Float a, Float b) { return _mm_cmpge_ps(a, b); }
+			static inline Mask greater(Float a, Float b) { return _mm_cmpgt_ps(a, b); }
+			static inline Mask less(Float a, Float b) { return _mm_cmplt_ps(a, b); }
+			static inline Mask both(Mask a, Mask b) { return _mm_and_ps(a, b); }
+			static inline uint32_t bits(Mask m) { return static_cast<uint32_t>(_mm_movemask_ps(m)); }
+		};
+#endif
+
+#if defined(__AVX2__)
+		struct Avx2Lanes {
+			static constexpr int WIDTH = 8;
+			using Float = __m256;
+			using Mask = __m256;
+
+			static inline Float splat(float v) { return _mm256_set1_ps(v); }
+			static inline Float ramp() { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+			static inline Float load(const float *p) { return _mm256_loadu_ps(p); }
+			static inline void store(float *p, Float v) { _mm256_storeu_ps(p, v); }
+			static inline void storeMasked(float *p, Mask m, Float v) {
+				_mm256_maskstore_ps(p, _mm256_castps_si256(m), v);
+			}
+			static inline Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+			static inline Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+			// no fma, so every kernel rounds the same way and draws the same pixels
+			static inline Float madd(Float a, Float b, Float c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+			static inline Float div(Float a, Float b) { return _mm256_div_ps(a, b); }
+			static inline Mask greaterEqual(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+			static inline Mask greater(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+			static inline Mask less(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+			static inline Mask both(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+			static inline uint32_t bits(Mask m) { return static_cast<uint32_t>(_mm256_movemask_ps(m)); }
+		};
+#endif
+
+		// edge test for one edge, honouring the fill rule
+		template <typename Lanes>
+		inline typename Lanes::Mask insideEdge(typename Lanes::Float value, bool inclusive) {
+			const typename Lanes::Float zero = Lanes::splat(0.0f);
+			return inclusive ? Lanes::greaterEqual(value, zero) : Lanes::greater(value, zero);
+		}
+
+		// evaluates a plane for a batch of pixels in a row
+		template <typename Lanes>
+		inline typename Lanes::Float plane(const float *coefficients, typename Lanes::Float x, float y) {
+			return Lanes::madd(Lanes::splat(coefficients[0]), x, Lanes::splat(coefficients[1] * y + coefficients[2]));
+		}
+
+		// Draws triangles into one tile in order, with a less-than depth test.
+		// Every value is evaluated from its plane at each pixel rather than
+		// stepped, so triangles sharing an edge agree exactly on its pixels.
+		template <typename Lanes>
+		void rasterizeTile(const TileTarget &target, const Triangle *const *triangles, size_t count, SoftFragments &fragments) {
+			using Float = typename Lanes::Float;
+			using Mask = typename Lanes::Mask;
+			constexpr int WIDTH = Lanes::WIDTH;
+
+			const Float laneOffset = Lanes::add(Lanes::ramp(), Lanes::splat(0.5f));
+			fragments.count = WIDTH;
+
+			for (size_t i = 0; i < count; ++i) {
+				const Triangle &triangle = *triangles[i];
+				// start on a lane boundary, the edge tests reject the pixels before minX
+				const int minX = maxInt(triangle.minX, target.x0) / WIDTH * WIDTH;
+				const int maxX = minInt(triangle.maxX, target.x1);
+				const int minY = maxInt(triangle.minY, target.y0);
+				const int maxY = minInt(triangle.maxY, target.y1);
+				const bool needsPosition = triangle.shader->needsWorldPosition;
+
+				for (int y = minY; y < maxY; ++y) {
+					const float pixelY = static_cast<float>(y) + 0.5f;
+					float *depthRow = target.depth + static_cast<size_t>(y) * target.stride;
+					uint32_t *colorRow = target.color + static_cast<size_t>(y) * target.stride;
+
+					for (int x = minX; x < maxX; x += WIDTH) {
+						const Float pixelX = Lanes::add(Lanes::splat(static_cast<float>(x)), laneOffset);
+
+						Mask covered = insideEdge<Lanes>(plane<Lanes>(triangle.edges[0], pixelX, pixelY), triangle.inclusive[0]);
+						covered = Lanes::both(covered, insideEdge<Lanes>(plane<Lanes>(triangle.edges[1], pixelX, pixelY), triangle.inclusive[1]));
+						covered = Lanes::both(covered, insideEdge<Lanes>(plane<Lanes>(triangle.edges[2], pixelX, pixelY), triangle.inclusive[2]));
+						if (Lanes::bits(covered) == 0) {
+							continue;
+						}
+
+						const Float depth = plane<Lanes>(triangle.depth, pixelX, pixelY);
+						const Mask passed = Lanes::both(covered, Lanes::less(depth, Lanes::load(depthRow + x)));
+						const uint32_t passedBits = Lanes::bits(passed);
+						if (passedBits == 0) {
+							continue;
+						}
+						Lanes::storeMasked(depthRow + x, passed, depth);
+
+						Lanes::store(fragments.depth, depth);
+						if (needsPosition) {
+							const Float w = Lanes::div(Lanes::splat(1.0f), plane<Lanes>(triangle.invW, pixelX, pixelY));
+							Lanes::store(fragments.worldX, Lanes::mul(plane<Lanes>(triangle.world[0], pixelX, pixelY), w));
+							Lanes::store(fragments.worldY, Lanes::mul(plane<Lanes>(triangle.world[1], pixelX, pixelY), w));
+							Lanes::store(fragments.worldZ, Lanes::mul(plane<Lanes>(triangle.world[2], pixelX, pixelY), w));
+						}
+						fragments.mask = passedBits;
+						triangle.shader->shade(fragments, colorRow + x);
+					}
+				}
+			}
+		}
+
+	}
+
+}
@@ -0,0 +1,89 @@
+#include "stats.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "spdlog/spdlog.h"
+
+void StatsTotals::add(const FrameStats &stats) {
+    ++frames;
+    draws += stats.draws;
+    drawCalls += stats.drawCalls;
+    programChanges += stats.programChanges;
+    vaoChanges += stats.vaoChanges;
+    textureChanges += stats.textureChanges;
+    textureBindsSaved += stats.textureBindsSaved;
+    shadowDraws += stats.shadowDraws;
+    shadowViewsDrawn += stats.shadowViewsDrawn;
+    stateCallsIssued += stats.stateCallsIssued;
+    stateCallsElided += stats.stateCallsElided;
+    submitMs += stats.submitMs;
+    lightAssignMs += stats.lightAssignMs;
+    fenceWaitMs += stats.fenceWaitMs;
+    frameMs += stats.frameMs;
+    frameMsSquared += stats.frameMs * stats.frameMs;
+    gpuSceneMs += stats.gpuSceneMs;
+    gpuLightingMs += stats.gpuLightingMs;
+    gpuShadowMs += stats.gpuShadowMs;
+    textureResidentBytes += stats.textureResidentBytes;
+    textureLevelsStreamed += stats.textureLevelsStreamed;
+    textureLevelsEvicted += stats.textureLevelsEvicted;
+    textureStreamLatencyMs += stats.textureStreamLatencyMs;
+    textureStreamLatencySamples += stats.textureStreamLatencySamples;
+    inputLatencyMs += stats.inputLatencyMs;
+    inputLatencySamples += stats.inputLatencySamples;
+}
+
+void StatsTotals::log(const char *label) const {
+    if (frames == 0) {
+        return;
+    }
+    const double n = static_cast<double>(frames);
+    const double meanFrameMs = frameMs / n;
+    const double jitterMs = std::sqrt(std::max(0.0, frameMsSquared / n - meanFrameMs * meanFrameMs));
+    const double latencyMs = inputLatencySamples > 0 ? inputLatencyMs / inputLatencySamples : 0.0;
+    const double streamLatencyMs = textureStreamLatencySamples > 0 ? textureStreamLatencyMs / textureStreamLatencySamples : 0.0;
+    spdlog::info("{}: {} frames, {:.3f} ms/frame, jitter {:.3f} ms, input latency {:.3f} ms, {:.0f} draws in {:.0f} calls, {:.1f} program changes, {:.1f} VAO changes, {:.1f} texture changes, {:.1f} saved, "
+                 "{:.1f} state calls issued, {:.1f} elided, submit {:.3f} ms, light assignment {:.3f} ms, fence wait {:.3f} ms, gpu scene {:.3f} ms, gpu lighting {:.3f} ms, "
+                 "{:.1f} shadow draws, {:.2f} shadow views redrawn, gpu shadows {:.3f} ms, "
+                 "{:.1f} MiB of textures resident, {:.2f} levels streamed in, {:.2f} trimmed, stream-in latency {:.3f} ms",
+                 label, frames, meanFrameMs, jitterMs, latencyMs, draws / n, drawCalls / n, programChanges / n, vaoChanges / n, textureChanges / n, textureBindsSaved / n,
+                 stateCallsIssued / n, stateCallsElided / n, submitMs / n, lightAssignMs / n, fenceWaitMs / n, gpuSceneMs / n, gpuLightingMs / n,
+                 shadowDraws / n, shadowViewsDrawn / n, gpuShadowMs / n,
+                 textureResidentBytes / n / (1024.0 * 1024.0), textureLevelsStreamed / n, textureLevelsEvicted / n, streamLatencyMs);
+}
+
+void StatsReporter::add(const FrameStats &stats, double now) {
+    if (m_lastReport < 0.0) {
+        m_lastReport = now;
+    }
+    m_window.add(stats);
+    m_run.add(stats);
+    m_frameMs.push_back(stats.frameMs);
+
+    if (now - m_lastReport >= m_interval) {
+        m_window.log("Frame stats");
+        restartWindow(now);
+    }
+}
+
+void StatsReporter::restartWindow(double now) {
+    m_window = StatsTotals{};
+    m_lastReport = now;
+}
+
+StartupSpike StatsReporter::startupSpike() const {
+    StartupSpike spike;
+    if (m_frameMs.size() < 2 * STARTUP_FRAMES) {
+        return spike;
+    }
+    const auto worst = std::max_element(m_frameMs.begin(), m_frameMs.begin() + STARTUP_FRAMES);
+    spike.worstMs = *worst;
+    spike.worstFrame = static_cast<uint32_t>(worst - m_frameMs.begin());
+
+    std::vector<double> after(m_frameMs.begin() + STARTUP_FRAMES, m_frameMs.end());
+    std::nth_element(after.begin(), after.begin() + after.size() / 2, after.end());
+    spike.medianMs = after[after.size() / 2];
+    spike.ratio = spike.medianMs > 0.0 ? spike.worstMs / spike.medianMs : 0.0;
+    return spike;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// frames at the start of a run checked for hitches against the frames after them
+constexpr uint32_t STARTUP_FRAMES = 10;
+
+// Counters gathered while rendering one frame
+struct FrameStats {
+    // objects drawn, and the draw calls it took to draw them
+    uint32_t draws = 0;
+    uint32_t drawCalls = 0;
+    uint32_t programChanges = 0;
+    uint32_t vaoChanges = 0;
+    uint32_t textureChanges = 0;
+    // draws that changed image without a bind, as it was in the array already bound
+    uint32_t textureBindsSaved = 0;
+    // objects drawn into shadow maps, and cascades or cube faces whose static depth was redrawn
+    uint32_t shadowDraws = 0;
+    uint32_t shadowViewsDrawn = 0;
+    // state calls that reached the driver and that the state cache dropped
+    uint32_t stateCallsIssued = 0;
+    uint32_t stateCallsElided = 0;
+    // cpu time spent sorting and replaying draws
+    double submitMs = 0.0;
+    // cpu time sorting lights into view clusters
+    double lightAssignMs = 0.0;
+    // cpu time blocked waiting for the gpu to release a frame slot
+    double fenceWaitMs = 0.0;
+    // wall time since the previous frame
+    double frameMs = 0.0;
+    // gpu time drawing the scene, and shading it from the g-buffer when deferred,
+    // measured a few frames late
+    double gpuSceneMs = 0.0;
+    double gpuLightingMs = 0.0;
+    // gpu time bringing the shadow maps up to date
+    double gpuShadowMs = 0.0;
+    // gpu memory held by texture mips, levels streamed in and trimmed, and the
+    // time from textures wanting levels to having them all, for those that got them
+    uint64_t textureResidentBytes = 0;
+    uint32_t textureLevelsStreamed = 0;
+    uint32_t textureLevelsEvicted = 0;
+    double textureStreamLatencyMs = 0.0;
+    uint32_t textureStreamLatencySamples = 0;
+    // time from input arriving to the first frame showing it being swapped,
+    // when this frame showed new input
+    double inputLatencyMs = 0.0;
+    uint32_t inputLatencySamples = 0;
+};
+
+// Sums of frame stats over a number of frames
+struct StatsTotals {
+    uint64_t frames = 0;
+    uint64_t draws = 0;
+    uint64_t drawCalls = 0;
+    uint64_t programChanges = 0;
+    uint64_t vaoChanges = 0;
+    uint64_t textureChanges = 0;
+    uint64_t textureBindsSaved = 0;
+    uint64_t shadowDraws = 0;
+    uint64_t shadowViewsDrawn = 0;
+    uint64_t stateCallsIssued = 0;
+    uint64_t stateCallsElided = 0;
+    double submitMs = 0.0;
+    double lightAssignMs = 0.0;
+    double fenceWaitMs = 0.0;
+    double frameMs = 0.0;
+    // for the frame time standard deviation
+    double frameMsSquared = 0.0;
+    double gpuSceneMs = 0.0;
+    double gpuLightingMs = 0.0;
+    double gpuShadowMs = 0.0;
+    uint64_t textureResidentBytes = 0;
+    uint64_t textureLevelsStreamed = 0;
+    uint64_t textureLevelsEvicted = 0;
+    double textureStreamLatencyMs = 0.0;
+    uint64_t textureStreamLatencySamples = 0;
+    double inputLatencyMs = 0.0;
+    uint64_t inputLatencySamples = 0;
+
+    void add(const FrameStats &stats);
+
+    // logs per-frame averages prefixed by label
+    void log(const char *label) const;
+};
+
+// The slowest of the first STARTUP_FRAMES frames of a run, against the frames after them
+struct StartupSpike {
+    double worstMs = 0.0;
+    // counted from 0, the frame the time was measured at the start of
+    uint32_t worstFrame = 0;
+    double medianMs = 0.0;
+    // worstMs over medianMs, 0 when the run has too few frames after the first to tell
+    double ratio = 0.0;
+};
+
+// Averages frame stats and logs them at a fixed interval
+class StatsReporter {
+    double m_interval;
+    double m_lastReport = -1.0;
+    StatsTotals m_window;
+    StatsTotals m_run;
+    // every frame time of the run, for the startup spike
+    std::vector<double> m_frameMs;
+
+public:
+    explicit StatsReporter(double intervalSeconds = 2.0) : m_interval{intervalSeconds} {}
+
+    // now is the current time in seconds
+    void add(const FrameStats &stats, double now);
+
+    // drops the current window, e.g. after changing what is being measured
+    void restartWindow(double now);
+
+    // averages over every frame added
+    inline const StatsTotals &run() const {
+        return m_run;
+    }
+
+    // how far the first frames stood out, once at least STARTUP_FRAMES more followed them
+    StartupSpike startupSpike() const;
+};
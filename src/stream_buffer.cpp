@@ -0,0 +1,121 @@
+#include "stream_buffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "spdlog/spdlog.h"
+
+#include "frame_controller.h"
+#include "gl_ext.h"
+#include "gl_state.h"
+
+namespace {
+
+	// regions start on this boundary so any buffer offset alignment a driver
+	// asks for (uniform buffers usually want 256) holds at region starts
+	constexpr size_t REGION_ALIGNMENT = 256;
+
+	// buffers are allocated and filled through the copy target so no VAO or
+	// indexed binding is disturbed
+	constexpr GLenum UPLOAD_TARGET = GL_COPY_WRITE_BUFFER;
+
+	constexpr GLbitfield PERSISTENT_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	inline size_t alignUp(size_t value, size_t alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	void deleteBuffer(GLuint buffer, bool mapped) {
+		if (mapped) {
+			glstate::bindBuffer(UPLOAD_TARGET, buffer);
+			glUnmapBuffer(UPLOAD_TARGET);
+		}
+		glstate::deleteBuffer(buffer);
+	}
+
+}
+
+void StreamBuffer::create(FrameController &frames, size_t regionSize) {
+	m_frames = &frames;
+	m_regionSize = alignUp(std::max<size_t>(regionSize, 1), REGION_ALIGNMENT);
+	m_persistent = glext::support().bufferStorage;
+	m_regionOffset = 0;
+	m_cursor = 0;
+	allocate();
+}
+
+void StreamBuffer::destroy() {
+	if (m_buffer != 0) {
+		deleteBuffer(m_buffer, m_mapping != nullptr);
+	}
+	m_buffer = 0;
+	m_mapping = nullptr;
+	m_staging.clear();
+	m_staging.shrink_to_fit();
+}
+
+void StreamBuffer::allocate() {
+	glGenBuffers(1, &m_buffer);
+	glstate::bindBuffer(UPLOAD_TARGET, m_buffer);
+
+	if (m_persistent) {
+		const size_t size = m_regionSize * m_frames->framesInFlight();
+		glBufferStorage(UPLOAD_TARGET, size, nullptr, PERSISTENT_FLAGS);
+		m_mapping = static_cast<uint8_t *>(glMapBufferRange(UPLOAD_TARGET, 0, size, PERSISTENT_FLAGS));
+	} else {
+		// orphaning only ever needs the one region
+		glBufferData(UPLOAD_TARGET, m_regionSize, nullptr, GL_STREAM_DRAW);
+		m_staging.reserve(m_regionSize);
+	}
+}
+
+void StreamBuffer::retireBuffer() {
+	// frames still in flight may read the old buffer, so it outlives them
+	const GLuint buffer = m_buffer;
+	const bool mapped = m_mapping != nullptr;
+	m_frames->deferRelease([buffer, mapped] {
+		deleteBuffer(buffer, mapped);
+	});
+	m_buffer = 0;
+	m_mapping = nullptr;
+}
+
+void StreamBuffer::beginFrame(size_t requiredSize) {
+	if (requiredSize > m_regionSize) {
+		spdlog::debug("Growing stream buffer regions from {} to {} bytes", m_regionSize, requiredSize);
+		retireBuffer();
+		m_regionSize = alignUp(std::max(requiredSize, m_regionSize * 2), REGION_ALIGNMENT);
+		allocate();
+	}
+
+	// the frame controller already waited for the gpu to leave this region
+	m_regionOffset = m_persistent ? m_frames->slot() * m_regionSize : 0;
+	m_cursor = 0;
+	m_staging.clear();
+}
+
+size_t StreamBuffer::write(const void *data, size_t size, size_t alignment) {
+	const size_t offset = alignUp(m_cursor, alignment);
+	if (offset + size > m_regionSize) {
+		throw StreamBufferOverflow();
+	}
+	m_cursor = offset + size;
+
+	if (m_persistent) {
+		std::memcpy(m_mapping + m_regionOffset + offset, data, size);
+	} else {
+		m_staging.resize(m_cursor);
+		std::memcpy(m_staging.data() + offset, data, size);
+	}
+	return m_regionOffset + offset;
+}
+
+void StreamBuffer::flush() {
+	// coherent mappings need no flushing
+	if (m_persistent || m_staging.empty()) {
+		return;
+	}
+	glstate::bindBuffer(UPLOAD_TARGET, m_buffer);
+	glBufferData(UPLOAD_TARGET, m_regionSize, nullptr, GL_STREAM_DRAW);
+	glBufferSubData(UPLOAD_TARGET, 0, m_staging.size(), m_staging.data());
+}
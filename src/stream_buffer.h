@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "glad/glad.h"
+
+class FrameController;
+
+// A buffer the cpu refills every frame for the gpu to read during that frame.
+//
+// With buffer storage (GL 4.4 or ARB_buffer_storage) the buffer is mapped once,
+// persistently and coherently, and split into one region per frame in flight.
+// The frame controller's fences guarantee the gpu is done with a region by the
+// time its slot comes around again. Without it writes are staged on the cpu
+// and uploaded by flush() into an orphaned buffer with glBufferSubData.
+//
+// Per frame, between the controller's beginFrame() and endFrame():
+// beginFrame(), write() as often as needed, flush(), then issue the draws.
+class StreamBuffer {
+    FrameController *m_frames = nullptr;
+    GLuint m_buffer = 0;
+    size_t m_regionSize = 0;
+    bool m_persistent = false;
+
+    // persistent path
+    uint8_t *m_mapping = nullptr;
+
+    // orphaning path
+    std::vector<uint8_t> m_staging;
+
+    size_t m_regionOffset = 0;
+    size_t m_cursor = 0;
+
+    void allocate();
+
+    // hands the buffer to the frame controller, to delete once no frame reads it
+    void retireBuffer();
+
+public:
+    void create(FrameController &frames, size_t regionSize);
+
+    // the gpu must be idle, see FrameController::waitIdle()
+    void destroy();
+
+    // moves to the current frame's region, growing regions to at least requiredSize
+    void beginFrame(size_t requiredSize = 0);
+
+    // copies size bytes into this frame's region and returns their offset
+    // in the buffer, aligned to alignment. throws if the region is full
+    size_t write(const void *data, size_t size, size_t alignment = 16);
+
+    // makes everything written this frame visible to the gpu
+    void flush();
+
+    inline GLuint id() const {
+        return m_buffer;
+    }
+
+    inline bool persistent() const {
+        return m_persistent;
+    }
+};
+
+class StreamBufferOverflow: public std::runtime_error {
+public:
+	StreamBufferOverflow()
+		: std::runtime_error{"Stream buffer region is full"} {}
+};
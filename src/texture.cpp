@@ -0,0 +1,137 @@
+#include "texture.h"
+
+#include <algorithm>
+
+#include "glad/glad.h"
+
+#include "gl_ext.h"
+#include "gl_state.h"
+
+namespace {
+
+	GLenum internalFormat(TextureFormat format) {
+		switch (format) {
+			case TextureFormat::Bc1:
+				return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+			case TextureFormat::Bc3:
+				return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+			case TextureFormat::Bc5:
+				return GL_COMPRESSED_RG_RGTC2;
+			case TextureFormat::Bc7:
+				return GL_COMPRESSED_RGBA_BPTC_UNORM;
+			default:
+				return GL_RGBA8;
+		}
+	}
+
+	// an array of layers with storage for count levels, starting at level top of the chain
+	uint32_t allocate(TextureFormat format, uint32_t width, uint32_t height, uint32_t layers, uint32_t top, uint32_t count) {
+		uint32_t texture = 0;
+		glGenTextures(1, &texture);
+		glstate::bindTexture(0, GL_TEXTURE_2D_ARRAY, texture);
+		if (glext::support().textureStorage) {
+			glTexStorage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLsizei>(count), internalFormat(format), mipLevelSize(width, top), mipLevelSize(height, top),
+			               static_cast<GLsizei>(layers));
+		} else {
+			for (uint32_t level = 0; level < count; ++level) {
+				const uint32_t levelWidth = mipLevelSize(width, top + level);
+				const uint32_t levelHeight = mipLevelSize(height, top + level);
+				if (isBlockCompressed(format)) {
+					glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(level), internalFormat(format), levelWidth, levelHeight, layers,
+					                       0, static_cast<GLsizei>(levelBytes(format, levelWidth, levelHeight) * layers), nullptr);
+				} else {
+					glTexImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(level), GL_RGBA8, levelWidth, levelHeight, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+				}
+			}
+		}
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(count - 1));
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		return texture;
+	}
+
+}
+
+bool isFormatSupported(TextureFormat format) {
+	switch (format) {
+		case TextureFormat::Bc1:
+		case TextureFormat::Bc3:
+			return glext::support().s3tc;
+		case TextureFormat::Bc7:
+			return glext::support().bptc;
+		default:
+			return true;
+	}
+}
+
+void Texture::create(uint32_t width, uint32_t height, const MipChain &chain, uint32_t resident, uint32_t handle) {
+	create(TextureFormat::Rgba8, width, height, 1, resident, [&chain](uint32_t, uint32_t level) -> const void * {
+		return chain[level].data();
+	}, handle);
+}
+
+void Texture::create(TextureFormat format, uint32_t width, uint32_t height, uint32_t layers, uint32_t resident, const LevelSource &source,
+                     uint32_t handle) {
+	m_format = format;
+	m_width = width;
+	m_height = height;
+	m_layers = layers;
+	m_levels = mipLevelCount(width, height);
+	m_handle = handle;
+	setResidentLevels(resident, source);
+}
+
+void Texture::destroy() {
+	glstate::deleteTexture(m_id);
+	m_id = 0;
+	m_residentLevels = 0;
+	m_residentBytes = 0;
+}
+
+void Texture::setResidentLevels(uint32_t resident, const LevelSource &source) {
+	resident = std::clamp(resident, 1u, m_levels);
+	if (resident == m_residentLevels) {
+		return;
+	}
+
+	const uint32_t top = m_levels - resident;
+	const uint32_t oldTop = m_levels - m_residentLevels;
+	const uint32_t kept = std::min(resident, m_residentLevels);
+	const uint32_t texture = allocate(m_format, m_width, m_height, m_layers, top, resident);
+
+	for (uint32_t level = top; level < m_levels; ++level) {
+		const GLsizei width = static_cast<GLsizei>(mipLevelSize(m_width, level));
+		const GLsizei height = static_cast<GLsizei>(mipLevelSize(m_height, level));
+		if (level >= m_levels - kept && glext::support().copyImage) {
+			glCopyImageSubData(m_id, GL_TEXTURE_2D_ARRAY, static_cast<GLint>(level - oldTop), 0, 0, 0,
+			                   texture, GL_TEXTURE_2D_ARRAY, static_cast<GLint>(level - top), 0, 0, 0, width, height, static_cast<GLsizei>(m_layers));
+			continue;
+		}
+		for (uint32_t layer = 0; layer < m_layers; ++layer) {
+			if (isBlockCompressed(m_format)) {
+				glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(level - top), 0, 0, static_cast<GLint>(layer), width, height, 1,
+				                          internalFormat(m_format), static_cast<GLsizei>(levelBytes(m_format, width, height)), source(layer, level));
+			} else {
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(level - top), 0, 0, static_cast<GLint>(layer), width, height, 1,
+				                GL_RGBA, GL_UNSIGNED_BYTE, source(layer, level));
+			}
+		}
+	}
+
+	// the driver keeps the old storage alive until frames in flight are done with it
+	glstate::deleteTexture(m_id);
+	m_id = texture;
+	m_residentLevels = resident;
+	m_residentBytes = chainBytes(m_format, m_width, m_height, resident) * m_layers;
+}
+
+size_t Texture::chainBytes(TextureFormat format, uint32_t width, uint32_t height, uint32_t count) {
+	const uint32_t levels = mipLevelCount(width, height);
+	size_t bytes = 0;
+	for (uint32_t level = levels - std::min(count, levels); level < levels; ++level) {
+		bytes += levelBytes(format, mipLevelSize(width, level), mipLevelSize(height, level));
+	}
+	return bytes;
+}
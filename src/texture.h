@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "texture_format.h"
+
+// texture unit surface programs read their albedo map from, an array bound when it changes between draws
+constexpr uint32_t ALBEDO_TEXTURE_UNIT = 5;
+
+// where glTexSubImage3D, or glCompressedTexSubImage3D, reads a level of a layer from: client
+// memory, or an offset cast to a pointer while a GL_PIXEL_UNPACK_BUFFER is bound
+using LevelSource = std::function<const void *(uint32_t layer, uint32_t level)>;
+
+// whether the current context can sample textures in format
+bool isFormatSupported(TextureFormat format);
+
+// A 2D array texture with immutable storage that holds only the smallest
+// levels of its layers' mip chains, rgba8 or block compressed. Changing how
+// many levels are resident allocates new storage of that size: levels both
+// hold are copied on the gpu where glCopyImageSubData exists, and uploaded
+// again from the chains otherwise. Without immutable storage (before GL 4.2
+// or ARB_texture_storage) the levels are allocated one by one and capped
+// with GL_TEXTURE_MAX_LEVEL.
+class Texture {
+    uint32_t m_id = 0;
+    // the full chain, of which the last m_residentLevels are resident
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_layers = 0;
+    uint32_t m_levels = 0;
+    uint32_t m_residentLevels = 0;
+    size_t m_residentBytes = 0;
+    TextureFormat m_format = TextureFormat::Rgba8;
+    // index of the texture in the streamer that owns it
+    uint32_t m_handle = 0;
+
+public:
+    // makes the smallest resident levels of chain resident, as the only layer
+    void create(uint32_t width, uint32_t height, const MipChain &chain, uint32_t resident, uint32_t handle = 0);
+
+    // the same for layers of levels in any format, read from source
+    void create(TextureFormat format, uint32_t width, uint32_t height, uint32_t layers, uint32_t resident, const LevelSource &source,
+                uint32_t handle = 0);
+
+    void destroy();
+
+    // reallocates storage for the smallest resident levels, reading the
+    // levels it does not copy from the old storage from source
+    void setResidentLevels(uint32_t resident, const LevelSource &source);
+
+    inline uint32_t id() const {
+        return m_id;
+    }
+
+    inline uint32_t width() const {
+        return m_width;
+    }
+
+    inline uint32_t height() const {
+        return m_height;
+    }
+
+    inline uint32_t layers() const {
+        return m_layers;
+    }
+
+    inline TextureFormat format() const {
+        return m_format;
+    }
+
+    inline uint32_t levels() const {
+        return m_levels;
+    }
+
+    inline uint32_t residentLevels() const {
+        return m_residentLevels;
+    }
+
+    // gpu memory taken by the resident levels
+    inline size_t residentBytes() const {
+        return m_residentBytes;
+    }
+
+    inline uint32_t handle() const {
+        return m_handle;
+    }
+
+    // bytes of the smallest count levels of a width x height chain
+    static size_t chainBytes(TextureFormat format, uint32_t width, uint32_t height, uint32_t count);
+};
+
+// Where a texture's image is: a layer of an array texture, or part of a
+// layer when small images were packed into it as an atlas. Materials point
+// at their slot, so draws with images in the same array bind it only once.
+struct TextureSlot {
+    const Texture *texture = nullptr;
+    uint32_t layer = 0;
+    // size of the image itself
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // offset and size of the image in the layer, in texture coordinates
+    glm::vec4 rect{0.0f, 0.0f, 1.0f, 1.0f};
+
+    inline bool isAtlased() const {
+        return rect.z < 1.0f || rect.w < 1.0f;
+    }
+};
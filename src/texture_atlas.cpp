@@ -0,0 +1,131 @@
+#include "texture_atlas.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "block_compression.h"
+#include "mipmaps.h"
+
+namespace {
+
+	uint32_t alignUp(uint32_t value, uint32_t alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// side of a block in texels, 1 for rgba8
+	uint32_t blockSize(TextureFormat format) {
+		return isBlockCompressed(format) ? 4 : 1;
+	}
+
+}
+
+AtlasPacker::AtlasPacker(uint32_t size) {
+	m_free.push_back(Rect{0, 0, size, size});
+}
+
+bool AtlasPacker::insert(uint32_t width, uint32_t height, uint32_t alignment, uint32_t &x, uint32_t &y) {
+	// the free rectangle left with the least area after the rectangle goes in
+	size_t best = m_free.size();
+	uint64_t bestWaste = std::numeric_limits<uint64_t>::max();
+	for (size_t i = 0; i < m_free.size(); ++i) {
+		const Rect &rect = m_free[i];
+		const uint32_t left = alignUp(rect.x, alignment);
+		const uint32_t top = alignUp(rect.y, alignment);
+		if (left + width > rect.x + rect.width || top + height > rect.y + rect.height) {
+			continue;
+		}
+		const uint64_t waste = static_cast<uint64_t>(rect.width) * rect.height - static_cast<uint64_t>(width) * height;
+		if (waste < bestWaste) {
+			best = i;
+			bestWaste = waste;
+		}
+	}
+	if (best == m_free.size()) {
+		return false;
+	}
+
+	// the alignment gap above and left of the rectangle is given up
+	const Rect rect = m_free[best];
+	x = alignUp(rect.x, alignment);
+	y = alignUp(rect.y, alignment);
+	const uint32_t usedWidth = x + width - rect.x;
+	const uint32_t usedHeight = y + height - rect.y;
+	const uint32_t rightWidth = rect.width - usedWidth;
+	const uint32_t bottomHeight = rect.height - usedHeight;
+	Rect right;
+	Rect bottom;
+	if (rightWidth < bottomHeight) {
+		right = Rect{rect.x + usedWidth, rect.y, rightWidth, usedHeight};
+		bottom = Rect{rect.x, rect.y + usedHeight, rect.width, bottomHeight};
+	} else {
+		right = Rect{rect.x + usedWidth, rect.y, rightWidth, rect.height};
+		bottom = Rect{rect.x, rect.y + usedHeight, usedWidth, bottomHeight};
+	}
+	m_free.erase(m_free.begin() + static_cast<std::ptrdiff_t>(best));
+	for (const Rect &part : {right, bottom}) {
+		if (part.width > 0 && part.height > 0) {
+			m_free.push_back(part);
+		}
+	}
+	return true;
+}
+
+uint32_t atlasAlignment(uint32_t width, uint32_t height) {
+	return std::min(width, height);
+}
+
+MipChain composeAtlas(TextureFormat format, uint32_t size, const std::vector<AtlasTile> &tiles) {
+	const uint32_t levels = mipLevelCount(size, size);
+	const uint32_t block = blockSize(format);
+	const uint32_t blockBytes = formatBlockBytes(format);
+	MipChain chain(levels);
+	for (uint32_t level = 0; level < levels; ++level) {
+		chain[level].resize(levelBytes(format, mipLevelSize(size, level), mipLevelSize(size, level)));
+	}
+
+	// levels where every tile still covers whole blocks
+	uint32_t copied = levels;
+	for (const AtlasTile &tile : tiles) {
+		copied = std::min(copied, mipLevelCount(std::min(tile.width, tile.height) / block, 1));
+	}
+	for (uint32_t level = 0; level < copied; ++level) {
+		const size_t rowBytes = static_cast<size_t>(mipLevelSize(size, level) / block) * blockBytes;
+		for (const AtlasTile &tile : tiles) {
+			const uint32_t width = tile.width >> level;
+			const uint32_t height = tile.height >> level;
+			const size_t tileRowBytes = static_cast<size_t>(width / block) * blockBytes;
+			const uint8_t *source = tile.levels[level];
+			uint8_t *target = chain[level].data() + static_cast<size_t>((tile.y >> level) / block) * rowBytes
+				+ static_cast<size_t>((tile.x >> level) / block) * blockBytes;
+			for (uint32_t row = 0; row < height / block; ++row) {
+				std::memcpy(target + row * rowBytes, source + row * tileRowBytes, tileRowBytes);
+			}
+		}
+	}
+	if (copied == levels || copied == 0) {
+		return chain;
+	}
+
+	// the rest are filtered from the last level copied, as rgba8
+	const uint32_t last = copied - 1;
+	const uint32_t lastSize = mipLevelSize(size, last);
+	std::vector<uint8_t> pixels;
+	if (isBlockCompressed(format)) {
+		pixels.resize(static_cast<size_t>(lastSize) * lastSize * 4);
+		decompressBlocks(format, chain[last].data(), lastSize, lastSize, pixels.data());
+	} else {
+		pixels = chain[last];
+	}
+	MipChain filtered = buildMipChain(lastSize, lastSize, std::move(pixels));
+	for (uint32_t level = copied; level < levels; ++level) {
+		std::vector<uint8_t> &source = filtered[level - last];
+		if (isBlockCompressed(format)) {
+			const uint32_t levelSize = mipLevelSize(size, level);
+			compressBlocks(format, CompressionQuality::Fast, source.data(), levelSize, levelSize, chain[level].data(), 0, (levelSize + 3) / 4);
+		} else {
+			chain[level] = std::move(source);
+		}
+	}
+	return chain;
+}
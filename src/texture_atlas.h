@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "texture_format.h"
+
+// Packs rectangles into a square with guillotine cuts: each rectangle goes
+// in the free rectangle it fills best, and what is left of that is cut in
+// two along the shorter leftover side. Fills well when rectangles come
+// largest first.
+class AtlasPacker {
+    struct Rect {
+        uint32_t x;
+        uint32_t y;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    std::vector<Rect> m_free;
+
+public:
+    explicit AtlasPacker(uint32_t size);
+
+    // finds room for a width x height rectangle with its corner on a
+    // multiple of alignment, returning false when there is none
+    bool insert(uint32_t width, uint32_t height, uint32_t alignment, uint32_t &x, uint32_t &y);
+};
+
+// An image placed in an atlas, with its levels largest first
+struct AtlasTile {
+    const uint8_t *const *levels;
+    uint32_t width;
+    uint32_t height;
+    uint32_t x;
+    uint32_t y;
+};
+
+// corner alignment that keeps a width x height image's mips on whole
+// texels, or whole blocks, at every level it is copied into the atlas
+uint32_t atlasAlignment(uint32_t width, uint32_t height);
+
+// builds the full mip chain of a size x size atlas in format from the levels
+// of tiles, which must have power of two sizes and be placed with
+// atlasAlignment(). tiles are copied in down to the level where the smallest
+// would be under a block, or a texel for rgba8; the levels below are box
+// filtered from the last one copied, mixing neighbouring tiles, and block
+// compressed again. space no tile covers is left zero
+MipChain composeAtlas(TextureFormat format, uint32_t size, const std::vector<AtlasTile> &tiles);
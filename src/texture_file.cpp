@@ -0,0 +1,154 @@
+#include "texture_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "spdlog/spdlog.h"
+
+#include "image_decoder.h"
+
+namespace {
+
+	constexpr uint8_t IDENTIFIER[12] = {0xab, 'C', 'T', 'E', 'X', ' ', '1', 0xbb, '\r', '\n', 0x1a, '\n'};
+	// identifier, format, width, height and level count
+	constexpr size_t HEADER_BYTES = sizeof(IDENTIFIER) + 4 * 4;
+	// offset and length of a level
+	constexpr size_t INDEX_ENTRY_BYTES = 2 * 8;
+	constexpr size_t LEVEL_ALIGNMENT = 16;
+	// larger than any texture size gl implementations allow
+	constexpr uint32_t MAX_SIZE = 1 << 16;
+
+	void put(std::string &bytes, uint64_t value, uint32_t size) {
+		for (uint32_t i = 0; i < size; ++i) {
+			bytes.push_back(static_cast<char>((value >> (i * 8)) & 0xff));
+		}
+	}
+
+	uint64_t get(const uint8_t *bytes, uint32_t size) {
+		uint64_t value = 0;
+		for (uint32_t i = 0; i < size; ++i) {
+			value |= static_cast<uint64_t>(bytes[i]) << (i * 8);
+		}
+		return value;
+	}
+
+	size_t alignUp(size_t value) {
+		return (value + LEVEL_ALIGNMENT - 1) / LEVEL_ALIGNMENT * LEVEL_ALIGNMENT;
+	}
+
+	bool isKnownFormat(uint32_t format) {
+		switch (static_cast<TextureFormat>(format)) {
+			case TextureFormat::Rgba8:
+			case TextureFormat::Bc1:
+			case TextureFormat::Bc3:
+			case TextureFormat::Bc5:
+			case TextureFormat::Bc7:
+				return true;
+			default:
+				return false;
+		}
+	}
+
+}
+
+std::vector<std::filesystem::path> listTextureFiles(const std::filesystem::path &directory) {
+	std::vector<std::filesystem::path> paths;
+	std::error_code error;
+	for (const auto &entry : std::filesystem::directory_iterator{directory, error}) {
+		if (entry.is_regular_file() && entry.path().extension() == TEXTURE_FILE_EXTENSION) {
+			paths.push_back(entry.path());
+		}
+	}
+	if (error) {
+		spdlog::warn("Failed to list compiled textures in {}: {}", directory.string(), error.message());
+	}
+	std::sort(paths.begin(), paths.end());
+	return paths;
+}
+
+bool writeTextureFile(const std::filesystem::path &path, TextureFormat format, uint32_t width, uint32_t height, const MipChain &levels) {
+	std::string header(reinterpret_cast<const char *>(IDENTIFIER), sizeof(IDENTIFIER));
+	put(header, static_cast<uint32_t>(format), 4);
+	put(header, width, 4);
+	put(header, height, 4);
+	put(header, levels.size(), 4);
+
+	// offsets of the levels, smallest first after the index
+	std::vector<size_t> offsets(levels.size());
+	size_t offset = alignUp(HEADER_BYTES + levels.size() * INDEX_ENTRY_BYTES);
+	for (size_t level = levels.size(); level-- > 0;) {
+		offsets[level] = offset;
+		offset = alignUp(offset + levels[level].size());
+	}
+	for (size_t level = 0; level < levels.size(); ++level) {
+		put(header, offsets[level], 8);
+		put(header, levels[level].size(), 8);
+	}
+
+	std::ofstream fileStream(path, std::ios::binary);
+	if (!fileStream) {
+		return false;
+	}
+	fileStream.write(header.data(), static_cast<std::streamsize>(header.size()));
+	size_t written = header.size();
+	const char padding[LEVEL_ALIGNMENT] = {};
+	for (size_t level = levels.size(); level-- > 0;) {
+		fileStream.write(padding, static_cast<std::streamsize>(offsets[level] - written));
+		fileStream.write(reinterpret_cast<const char *>(levels[level].data()), static_cast<std::streamsize>(levels[level].size()));
+		written = offsets[level] + levels[level].size();
+	}
+	return static_cast<bool>(fileStream);
+}
+
+void TextureFile::open(const std::filesystem::path &path) {
+	close();
+	if (!m_file.open(path)) {
+		throw ImageError{"cannot map the file"};
+	}
+	const uint8_t *data = m_file.data();
+	const size_t size = m_file.size();
+	if (size < HEADER_BYTES || std::memcmp(data, IDENTIFIER, sizeof(IDENTIFIER)) != 0) {
+		throw ImageError{"not a compiled texture"};
+	}
+	const uint32_t format = static_cast<uint32_t>(get(data + 12, 4));
+	m_width = static_cast<uint32_t>(get(data + 16, 4));
+	m_height = static_cast<uint32_t>(get(data + 20, 4));
+	const uint32_t levels = static_cast<uint32_t>(get(data + 24, 4));
+	if (!isKnownFormat(format)) {
+		throw ImageError{"unknown texture format " + std::to_string(format)};
+	}
+	m_format = static_cast<TextureFormat>(format);
+	if (m_width == 0 || m_height == 0 || m_width > MAX_SIZE || m_height > MAX_SIZE) {
+		throw ImageError{"bad texture size"};
+	}
+	// the streamer needs every level down to 1x1
+	if (levels != mipLevelCount(m_width, m_height)) {
+		throw ImageError{"incomplete mip chain"};
+	}
+	if (size < HEADER_BYTES + static_cast<size_t>(levels) * INDEX_ENTRY_BYTES) {
+		throw ImageError{"truncated level index"};
+	}
+
+	for (uint32_t level = 0; level < levels; ++level) {
+		const uint8_t *entry = data + HEADER_BYTES + static_cast<size_t>(level) * INDEX_ENTRY_BYTES;
+		const uint64_t offset = get(entry, 8);
+		const uint64_t length = get(entry + 8, 8);
+		if (length != levelSize(level) || offset > size || length > size - offset) {
+			throw ImageError{"level " + std::to_string(level) + " is out of bounds or the wrong size"};
+		}
+		m_levels.push_back(data + offset);
+	}
+}
+
+void TextureFile::close() {
+	m_file.close();
+	m_levels.clear();
+	m_width = 0;
+	m_height = 0;
+}
+
+size_t TextureFile::levelSize(uint32_t level) const {
+	return levelBytes(m_format, mipLevelSize(m_width, level), mipLevelSize(m_height, level));
+}
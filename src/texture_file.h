@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "mapped_file.h"
+#include "texture_format.h"
+
+// file extension of compiled textures
+constexpr const char *TEXTURE_FILE_EXTENSION = ".ctex";
+
+// Compiled textures hold a full mip chain in the format it is uploaded in,
+// so loading one is mapping it and pointing the uploads at the levels. The
+// layout follows KTX2's: a 12 byte identifier, the format, width, height and
+// level count as 32-bit values, an index of each level's 64-bit offset and
+// length, largest level first, then the levels themselves, smallest first
+// so the levels a texture starts with sit together, each 16 byte aligned.
+// All little endian. It is not KTX2 itself: the format is a TextureFormat
+// rather than a VkFormat, and there is no data format descriptor, key/value
+// data or supercompression.
+
+// compiled textures directly in directory, sorted by name
+std::vector<std::filesystem::path> listTextureFiles(const std::filesystem::path &directory);
+
+// writes the levels of a width x height chain in format, largest first.
+// returns false if the file cannot be written
+bool writeTextureFile(const std::filesystem::path &path, TextureFormat format, uint32_t width, uint32_t height, const MipChain &levels);
+
+// A compiled texture mapped into memory
+class TextureFile {
+    MappedFile m_file;
+    TextureFormat m_format = TextureFormat::Rgba8;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    // where each level starts in the mapping, largest first
+    std::vector<const uint8_t *> m_levels;
+
+public:
+    // maps the file and checks its header and index against its size, throwing
+    // ImageError when it is not a compiled texture or is cut short
+    void open(const std::filesystem::path &path);
+
+    void close();
+
+    inline TextureFormat format() const {
+        return m_format;
+    }
+
+    inline uint32_t width() const {
+        return m_width;
+    }
+
+    inline uint32_t height() const {
+        return m_height;
+    }
+
+    inline uint32_t levelCount() const {
+        return static_cast<uint32_t>(m_levels.size());
+    }
+
+    inline const uint8_t *level(uint32_t level) const {
+        return m_levels[level];
+    }
+
+    size_t levelSize(uint32_t level) const;
+
+    inline const MappedFile &file() const {
+        return m_file;
+    }
+};
@@ -0,0 +1,50 @@
+#include "texture_format.h"
+
+#include <algorithm>
+
+uint32_t mipLevelCount(uint32_t width, uint32_t height) {
+	uint32_t levels = 1;
+	for (uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+		++levels;
+	}
+	return levels;
+}
+
+uint32_t mipLevelSize(uint32_t size, uint32_t level) {
+	return std::max(size >> level, 1u);
+}
+
+uint32_t formatBlockBytes(TextureFormat format) {
+	switch (format) {
+		case TextureFormat::Bc1:
+			return 8;
+		case TextureFormat::Bc3:
+		case TextureFormat::Bc5:
+		case TextureFormat::Bc7:
+			return 16;
+		default:
+			return 4;
+	}
+}
+
+size_t levelBytes(TextureFormat format, uint32_t width, uint32_t height) {
+	if (!isBlockCompressed(format)) {
+		return static_cast<size_t>(width) * height * formatBlockBytes(format);
+	}
+	return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * formatBlockBytes(format);
+}
+
+const char *formatName(TextureFormat format) {
+	switch (format) {
+		case TextureFormat::Bc1:
+			return "bc1";
+		case TextureFormat::Bc3:
+			return "bc3";
+		case TextureFormat::Bc5:
+			return "bc5";
+		case TextureFormat::Bc7:
+			return "bc7";
+		default:
+			return "rgba8";
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// rgba8 pixels of each mip level, largest first, rows tightly packed
+using MipChain = std::vector<std::vector<uint8_t>>;
+
+// How the texels of a level are stored. Rgba8 is a byte per channel; the
+// rest are block compressed, 4x4 texels to a block, with levels smaller than
+// a block still taking a whole one. BC1 keeps rgb in 8 bytes a block, BC3
+// adds a BC4 alpha block, BC5 keeps red and green as two BC4 blocks, for
+// normal maps, and BC7 keeps rgba in 16 bytes at the best quality of them.
+// The values are stored in compiled texture files.
+enum class TextureFormat : uint32_t {
+    Rgba8 = 0,
+    Bc1 = 1,
+    Bc3 = 3,
+    Bc5 = 5,
+    Bc7 = 7,
+};
+
+// levels in a full mip chain down to 1x1
+uint32_t mipLevelCount(uint32_t width, uint32_t height);
+
+// size of a level of a width x height image
+uint32_t mipLevelSize(uint32_t size, uint32_t level);
+
+// bytes a 4x4 block takes, or a texel for rgba8
+uint32_t formatBlockBytes(TextureFormat format);
+
+inline bool isBlockCompressed(TextureFormat format) {
+    return format != TextureFormat::Rgba8;
+}
+
+// bytes of a width x height level
+size_t levelBytes(TextureFormat format, uint32_t width, uint32_t height);
+
+// lowercase name, as the texture compiler takes it
+const char *formatName(TextureFormat format);
@@ -0,0 +1,343 @@
+#include "texture_streamer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "camera.h"
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "jobs.h"
+#include "mesh.h"
+#include "scene.h"
+#include "texture_atlas.h"
+
+namespace {
+
+	bool isPowerOfTwo(uint32_t value) {
+		return value != 0 && (value & (value - 1)) == 0;
+	}
+
+}
+
+void TextureStreamer::create(FrameController &frames, size_t budget, size_t uploadBudget, uint32_t maxLayers) {
+	GLint layerLimit = 0;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &layerLimit);
+	m_maxLayers = std::clamp(maxLayers, 1u, static_cast<uint32_t>(std::max(layerLimit, 1)));
+	m_budget = budget;
+	m_uploadBudget = uploadBudget;
+	m_largestLevel = 0;
+	m_residentBytes = 0;
+	m_frame = 0;
+
+	// staging only pays off when the levels a texture keeps need no upload
+	m_staged = glext::support().copyImage;
+	if (m_staged) {
+		m_staging.create(frames, uploadBudget);
+	}
+}
+
+void TextureStreamer::destroy() {
+	for (Entry &entry : m_entries) {
+		entry.texture.destroy();
+	}
+	m_entries.clear();
+	m_slots.clear();
+	m_pending.clear();
+	m_residentBytes = 0;
+	if (m_staged) {
+		m_staging.destroy();
+	}
+}
+
+const TextureSlot *TextureStreamer::add(uint32_t width, uint32_t height, MipChain chain) {
+	Layer layer;
+	layer.chain = std::move(chain);
+	for (const std::vector<uint8_t> &level : layer.chain) {
+		layer.levels.push_back(level.data());
+	}
+	return addPending(TextureFormat::Rgba8, width, height, std::move(layer));
+}
+
+const TextureSlot *TextureStreamer::add(std::unique_ptr<TextureFile> file) {
+	Layer layer;
+	for (uint32_t level = 0; level < file->levelCount(); ++level) {
+		layer.levels.push_back(file->level(level));
+	}
+	const TextureFormat format = file->format();
+	const uint32_t width = file->width();
+	const uint32_t height = file->height();
+	layer.file = std::move(file);
+	return addPending(format, width, height, std::move(layer));
+}
+
+const TextureSlot *TextureStreamer::addPending(TextureFormat format, uint32_t width, uint32_t height, Layer layer) {
+	TextureSlot &slot = m_slots.emplace_back();
+	slot.width = width;
+	slot.height = height;
+	m_pending.push_back(Pending{format, width, height, std::move(layer), {&slot}});
+	return &slot;
+}
+
+uint32_t TextureStreamer::arrayLayers(TextureFormat format, uint32_t width, uint32_t height) const {
+	const size_t bytes = Texture::chainBytes(format, width, height, mipLevelCount(width, height));
+	return static_cast<uint32_t>(std::clamp<size_t>(m_budget / 4 / bytes, 1, m_maxLayers));
+}
+
+std::vector<TextureStreamer::Pending> TextureStreamer::buildAtlases(JobSystem &jobs) {
+	// power of two images small enough, and at least a block across
+	std::vector<Pending> rest;
+	std::vector<Pending> small;
+	for (Pending &pending : m_pending) {
+		const uint32_t block = isBlockCompressed(pending.format) ? 4 : 1;
+		const bool fits = isPowerOfTwo(pending.width) && isPowerOfTwo(pending.height)
+			&& std::max(pending.width, pending.height) <= ATLAS_MAX_IMAGE && std::min(pending.width, pending.height) >= block;
+		(fits ? small : rest).push_back(std::move(pending));
+	}
+	m_pending.clear();
+
+	// largest first, each into the first atlas of its format with room
+	std::stable_sort(small.begin(), small.end(), [](const Pending &a, const Pending &b) {
+		const uint32_t aLarger = std::max(a.width, a.height);
+		const uint32_t bLarger = std::max(b.width, b.height);
+		if (aLarger != bLarger) {
+			return aLarger > bLarger;
+		}
+		return std::min(a.width, a.height) > std::min(b.width, b.height);
+	});
+	struct Atlas {
+		TextureFormat format;
+		AtlasPacker packer;
+		std::vector<AtlasTile> tiles;
+		std::vector<TextureSlot *> slots;
+	};
+	std::vector<Atlas> atlases;
+	for (Pending &image : small) {
+		const uint32_t alignment = atlasAlignment(image.width, image.height);
+		uint32_t x = 0;
+		uint32_t y = 0;
+		auto atlas = std::find_if(atlases.begin(), atlases.end(), [&](Atlas &candidate) {
+			return candidate.format == image.format && candidate.packer.insert(image.width, image.height, alignment, x, y);
+		});
+		if (atlas == atlases.end()) {
+			atlases.push_back(Atlas{image.format, AtlasPacker{ATLAS_SIZE}, {}, {}});
+			atlas = atlases.end() - 1;
+			atlas->packer.insert(image.width, image.height, alignment, x, y);
+		}
+		atlas->tiles.push_back(AtlasTile{image.layer.levels.data(), image.width, image.height, x, y});
+		TextureSlot *slot = image.slots.front();
+		slot->rect = glm::vec4{static_cast<float>(x), static_cast<float>(y), static_cast<float>(image.width), static_cast<float>(image.height)}
+			/ static_cast<float>(ATLAS_SIZE);
+		atlas->slots.push_back(slot);
+	}
+
+	std::vector<MipChain> chains(atlases.size());
+	jobs.parallelFor(atlases.size(), 1, [&](size_t begin, size_t end, uint32_t) {
+		for (size_t i = begin; i < end; ++i) {
+			chains[i] = composeAtlas(atlases[i].format, ATLAS_SIZE, atlases[i].tiles);
+		}
+	});
+	for (size_t i = 0; i < atlases.size(); ++i) {
+		Layer layer;
+		layer.chain = std::move(chains[i]);
+		for (const std::vector<uint8_t> &level : layer.chain) {
+			layer.levels.push_back(level.data());
+		}
+		rest.push_back(Pending{atlases[i].format, ATLAS_SIZE, ATLAS_SIZE, std::move(layer), std::move(atlases[i].slots)});
+	}
+	return rest;
+}
+
+void TextureStreamer::pack(JobSystem &jobs) {
+	std::vector<Pending> pending = buildAtlases(jobs);
+
+	// images of a format and size fill arrays in the order they were added
+	std::stable_sort(pending.begin(), pending.end(), [](const Pending &a, const Pending &b) {
+		if (a.format != b.format) {
+			return a.format < b.format;
+		}
+		return a.width != b.width ? a.width < b.width : a.height < b.height;
+	});
+	for (size_t begin = 0; begin < pending.size();) {
+		const Pending &first = pending[begin];
+		const uint32_t capacity = arrayLayers(first.format, first.width, first.height);
+		std::vector<Layer> layers;
+		std::vector<TextureSlot *> slots;
+		size_t end = begin;
+		for (; end < pending.size() && layers.size() < capacity; ++end) {
+			Pending &next = pending[end];
+			if (next.format != first.format || next.width != first.width || next.height != first.height) {
+				break;
+			}
+			for (TextureSlot *slot : next.slots) {
+				slot->layer = static_cast<uint32_t>(layers.size());
+				slots.push_back(slot);
+			}
+			layers.push_back(std::move(next.layer));
+		}
+		addEntry(first.format, first.width, first.height, std::move(layers), slots);
+		begin = end;
+	}
+}
+
+void TextureStreamer::addEntry(TextureFormat format, uint32_t width, uint32_t height, std::vector<Layer> layers, const std::vector<TextureSlot *> &slots) {
+	Entry &entry = m_entries.emplace_back();
+	entry.layers = std::move(layers);
+	const uint32_t layerCount = static_cast<uint32_t>(entry.layers.size());
+	const uint32_t minimum = std::min(mipLevelCount(width, height), MIN_RESIDENT_LEVELS);
+	entry.texture.create(format, width, height, layerCount, minimum, levelSource(entry), static_cast<uint32_t>(m_entries.size() - 1));
+	entry.wantedLevels = minimum;
+	m_residentBytes += entry.texture.residentBytes();
+	m_largestLevel = std::max(m_largestLevel, levelBytes(format, width, height) * layerCount);
+	for (TextureSlot *slot : slots) {
+		slot->texture = &entry.texture;
+	}
+}
+
+LevelSource TextureStreamer::levelSource(const Entry &entry) {
+	return [&entry](uint32_t layer, uint32_t level) -> const void * {
+		return entry.layers[layer].levels[level];
+	};
+}
+
+void TextureStreamer::update(const Scene &scene, const Camera &camera, uint32_t viewportHeight, FrameStats &stats) {
+	++m_frame;
+	for (Entry &entry : m_entries) {
+		entry.wantedLevels = std::min(entry.texture.levels(), MIN_RESIDENT_LEVELS);
+	}
+
+	// pixels a world unit covers at distance 1, falling off with distance
+	const Frustum &frustum = camera.frustum();
+	const glm::vec3 &viewPosition = camera.position();
+	const float pixelsPerUnit = static_cast<float>(viewportHeight) * 0.5f * camera.projection()[1][1];
+	for (const Object &object : scene.objects) {
+		if (object.texture == nullptr || object.texture->texture == nullptr) {
+			continue;
+		}
+		const float radius = object.mesh->boundingRadius() * std::max({object.scale.x, object.scale.y, object.scale.z});
+		if (!frustum.intersectsSphere(object.position, radius)) {
+			continue;
+		}
+
+		// the nearest point of the object decides, where texels are biggest on screen.
+		// an atlas's levels line up with those of the images in it
+		const float distance = std::max(glm::distance(viewPosition, object.position) - radius, camera.nearPlane());
+		const TextureSlot &slot = *object.texture;
+		const Texture &texture = *slot.texture;
+		const float texelsPerPixel = static_cast<float>(std::max(slot.width, slot.height)) * distance / (pixelsPerUnit * TEXTURE_WORLD_SIZE);
+		const uint32_t topLevel = texelsPerPixel > 1.0f ? static_cast<uint32_t>(std::log2(texelsPerPixel)) : 0;
+		Entry &entry = m_entries[texture.handle()];
+		entry.wantedLevels = std::max(entry.wantedLevels, texture.levels() - std::min(topLevel, texture.levels() - 1));
+		entry.lastUsed = m_frame;
+	}
+
+	// latency counts from a texture first wanting more than it has
+	const Clock::time_point now = Clock::now();
+	m_streamOrder.clear();
+	m_evictOrder.clear();
+	for (uint32_t i = 0; i < m_entries.size(); ++i) {
+		Entry &entry = m_entries[i];
+		const uint32_t resident = entry.texture.residentLevels();
+		if (entry.wantedLevels > resident) {
+			if (!entry.requested) {
+				entry.requested = true;
+				entry.requestedAt = now;
+			}
+			m_streamOrder.push_back(i);
+		} else {
+			entry.requested = false;
+			if (entry.wantedLevels < resident) {
+				m_evictOrder.push_back(i);
+			}
+		}
+	}
+
+	// the most blurred textures first, and the least recently used out first
+	std::sort(m_streamOrder.begin(), m_streamOrder.end(), [this](uint32_t a, uint32_t b) {
+		const Entry &first = m_entries[a];
+		const Entry &second = m_entries[b];
+		return first.wantedLevels - first.texture.residentLevels() > second.wantedLevels - second.texture.residentLevels();
+	});
+	std::sort(m_evictOrder.begin(), m_evictOrder.end(), [this](uint32_t a, uint32_t b) {
+		return m_entries[a].lastUsed < m_entries[b].lastUsed;
+	});
+
+	// a level bigger than the upload budget goes on its own
+	if (m_staged) {
+		m_staging.beginFrame(std::max(m_uploadBudget, m_largestLevel));
+	}
+	m_uploads.clear();
+	m_stagedOffsets.clear();
+	size_t uploaded = 0;
+	size_t nextEviction = 0;
+	for (uint32_t index : m_streamOrder) {
+		Entry &entry = m_entries[index];
+		Texture &texture = entry.texture;
+
+		// one level at a time, the largest level last, until a budget runs out
+		uint32_t resident = texture.residentLevels();
+		while (resident < entry.wantedLevels) {
+			const size_t bytes = (Texture::chainBytes(texture.format(), texture.width(), texture.height(), resident + 1)
+				- Texture::chainBytes(texture.format(), texture.width(), texture.height(), resident)) * texture.layers();
+			if ((uploaded > 0 && uploaded + bytes > m_uploadBudget) || !makeRoom(bytes, nextEviction, stats)) {
+				break;
+			}
+			uploaded += bytes;
+			m_residentBytes += bytes;
+			++resident;
+			++stats.textureLevelsStreamed;
+		}
+		if (resident == texture.residentLevels()) {
+			break;
+		}
+
+		if (!m_staged) {
+			texture.setResidentLevels(resident, levelSource(entry));
+			finishRequest(entry, stats);
+			continue;
+		}
+		m_uploads.push_back(Upload{index, resident, m_stagedOffsets.size()});
+		for (uint32_t level = texture.levels() - resident; level < texture.levels() - texture.residentLevels(); ++level) {
+			const size_t size = levelBytes(texture.format(), mipLevelSize(texture.width(), level), mipLevelSize(texture.height(), level));
+			for (const Layer &layer : entry.layers) {
+				m_stagedOffsets.push_back(m_staging.write(layer.levels[level], size, 4));
+			}
+		}
+	}
+
+	// evictions above upload from client memory, so the staging buffer is bound only now
+	if (!m_uploads.empty()) {
+		m_staging.flush();
+		glstate::bindBuffer(GL_PIXEL_UNPACK_BUFFER, m_staging.id());
+		for (const Upload &upload : m_uploads) {
+			Entry &entry = m_entries[upload.entry];
+			const uint32_t top = entry.texture.levels() - upload.resident;
+			const uint32_t layers = entry.texture.layers();
+			entry.texture.setResidentLevels(upload.resident, [this, &upload, top, layers](uint32_t layer, uint32_t level) {
+				return reinterpret_cast<const void *>(m_stagedOffsets[upload.firstOffset + (level - top) * layers + layer]);
+			});
+			finishRequest(entry, stats);
+		}
+		glstate::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	stats.textureResidentBytes = m_residentBytes;
+}
+
+bool TextureStreamer::makeRoom(size_t bytes, size_t &nextEviction, FrameStats &stats) {
+	while (m_residentBytes + bytes > m_budget && nextEviction < m_evictOrder.size()) {
+		Entry &entry = m_entries[m_evictOrder[nextEviction++]];
+		const size_t before = entry.texture.residentBytes();
+		stats.textureLevelsEvicted += entry.texture.residentLevels() - entry.wantedLevels;
+		entry.texture.setResidentLevels(entry.wantedLevels, levelSource(entry));
+		m_residentBytes -= before - entry.texture.residentBytes();
+	}
+	return m_residentBytes + bytes <= m_budget;
+}
+
+void TextureStreamer::finishRequest(Entry &entry, FrameStats &stats) {
+	if (entry.texture.residentLevels() == entry.wantedLevels) {
+		entry.requested = false;
+		stats.textureStreamLatencyMs += std::chrono::duration<double, std::milli>(Clock::now() - entry.requestedAt).count();
+		++stats.textureStreamLatencySamples;
+	}
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "stats.h"
+#include "stream_buffer.h"
+#include "texture.h"
+#include "texture_file.h"
+
+class Camera;
+class FrameController;
+class JobSystem;
+class Scene;
+
+// levels every texture keeps resident, 32x32 and smaller for square textures
+constexpr uint32_t MIN_RESIDENT_LEVELS = 6;
+// world units one repeat of a texture covers, as the surface shaders map them
+constexpr float TEXTURE_WORLD_SIZE = 1.0f;
+// side of the atlas layers small images are packed into, and the largest image packed
+constexpr uint32_t ATLAS_SIZE = 1024;
+constexpr uint32_t ATLAS_MAX_IMAGE = 256;
+
+// Keeps the mip levels of textures resident that objects on screen need,
+// under a gpu memory budget.
+//
+// Images of the same format and size are packed as layers into array
+// textures, and small images with power of two sizes as tiles into the
+// layers of atlas arrays, so draws of objects with different images bind a
+// texture only when the array changes. An array holds as many layers as
+// the layer limit allows, and no more than a quarter of the budget at full
+// resolution, since all its layers stream in and out together.
+//
+// Textures start with only their smallest levels; each frame the streamer
+// works out from every visible textured object's distance how many texels a
+// pixel covers, and so which level its image needs, then brings textures
+// missing levels up to it, most missing first, uploading no more than a
+// fixed number of bytes per frame, or one level when a level is bigger than
+// that. When a level would go over the budget,
+// textures holding more than they need are trimmed down to what they need,
+// least recently seen first.
+//
+// Where levels already resident are copied on the gpu, new levels go through
+// a staging stream buffer bound as the pixel unpack buffer, so uploads are
+// read from memory the gpu is done with rather than stalling on the copy
+// the driver would make of client memory. Without the copy every level is
+// uploaded again, straight from memory.
+//
+// Decoded images, and atlases, keep their full mip chains in memory on the
+// cpu. Compiled textures stay mapped instead, so a level is only read from
+// the file when it is first uploaded, and the page cache can drop it again
+// after; those packed into atlases are copied out at pack().
+class TextureStreamer {
+    using Clock = std::chrono::steady_clock;
+
+    // an image, or an atlas of them
+    struct Layer {
+        // where the levels are, largest first: chain for a decoded image or an atlas, file for a compiled texture
+        MipChain chain;
+        std::unique_ptr<TextureFile> file;
+        std::vector<const uint8_t *> levels;
+    };
+
+    // an image added since the last pack(), or an atlas of them and the slots of its images
+    struct Pending {
+        TextureFormat format;
+        uint32_t width;
+        uint32_t height;
+        Layer layer;
+        std::vector<TextureSlot *> slots;
+    };
+
+    struct Entry {
+        Texture texture;
+        std::vector<Layer> layers;
+        // levels the objects seen this frame need
+        uint32_t wantedLevels = 0;
+        uint64_t lastUsed = 0;
+        // when the texture first wanted levels it has yet to get
+        bool requested = false;
+        Clock::time_point requestedAt;
+    };
+
+    // a texture gaining levels this frame, and where its first new level is in m_stagedOffsets
+    struct Upload {
+        uint32_t entry = 0;
+        uint32_t resident = 0;
+        size_t firstOffset = 0;
+    };
+
+    // stable addresses, objects point at the slots and the slots at the textures
+    std::deque<Entry> m_entries;
+    std::deque<TextureSlot> m_slots;
+    std::vector<Pending> m_pending;
+    uint32_t m_maxLayers = 1;
+    size_t m_budget = 0;
+    size_t m_uploadBudget = 0;
+    size_t m_largestLevel = 0;
+    size_t m_residentBytes = 0;
+    uint64_t m_frame = 0;
+
+    StreamBuffer m_staging;
+    bool m_staged = false;
+
+    // scratch, reused every frame
+    std::vector<uint32_t> m_streamOrder;
+    std::vector<uint32_t> m_evictOrder;
+    std::vector<Upload> m_uploads;
+    // offsets of the staged levels in the staging buffer
+    std::vector<size_t> m_stagedOffsets;
+
+    // trims least recently used textures until bytes more fit, returning whether they do
+    bool makeRoom(size_t bytes, size_t &nextEviction, FrameStats &stats);
+
+    // counts the latency of a texture that has got the levels it wanted
+    void finishRequest(Entry &entry, FrameStats &stats);
+
+    // queues an image for the next pack()
+    const TextureSlot *addPending(TextureFormat format, uint32_t width, uint32_t height, Layer layer);
+
+    // layers of width x height images in format one array may hold
+    uint32_t arrayLayers(TextureFormat format, uint32_t width, uint32_t height) const;
+
+    // packs small images of the same format into atlas layers, leaving the rest pending
+    std::vector<Pending> buildAtlases(JobSystem &jobs);
+
+    // makes an array of layers with their smallest levels resident, pointing the slots at it
+    void addEntry(TextureFormat format, uint32_t width, uint32_t height, std::vector<Layer> layers, const std::vector<TextureSlot *> &slots);
+
+    // reads levels from the entry's memory
+    static LevelSource levelSource(const Entry &entry);
+
+public:
+    // budget is the gpu memory all textures may take, uploadBudget what a
+    // frame may stream in, and maxLayers the most layers an array may hold
+    void create(FrameController &frames, size_t budget, size_t uploadBudget, uint32_t maxLayers);
+
+    // the gpu must be idle, see FrameController::waitIdle()
+    void destroy();
+
+    // adds an image, which is streamed after the next pack(). chain is a
+    // full mip chain of a width x height image. the slot stays valid until destroy()
+    const TextureSlot *add(uint32_t width, uint32_t height, MipChain chain);
+
+    // the same for a compiled texture, uploading levels straight from its mapping
+    const TextureSlot *add(std::unique_ptr<TextureFile> file);
+
+    // packs the images added since the last pack into arrays and atlases,
+    // with only their smallest levels resident, and points their slots at them
+    void pack(JobSystem &jobs);
+
+    // streams levels in for the textured objects camera sees, and out under
+    // the budget. viewportHeight is in pixels. call once per frame, between
+    // the frame controller's beginFrame() and endFrame()
+    void update(const Scene &scene, const Camera &camera, uint32_t viewportHeight, FrameStats &stats);
+
+    inline size_t residentBytes() const {
+        return m_residentBytes;
+    }
+
+    // array textures, and the images in them
+    inline size_t textureCount() const {
+        return m_entries.size();
+    }
+
+    inline size_t imageCount() const {
+        return m_slots.size();
+    }
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Hands the newest value from one writer thread to one reader thread without
+// locks or waiting. The writer fills writeBuffer() and publishes it; the
+// reader picks up the newest published value with update(). Values published
+// in between are dropped, and a value stays untouched while it is being read.
+template <typename T>
+class TripleBuffer {
+    static constexpr uint32_t SLOT_MASK = 3;
+    // set on the shared slot index when it holds a value the reader has not seen
+    static constexpr uint32_t FRESH = 4;
+
+    T m_slots[3]{};
+    std::atomic<uint32_t> m_shared{1};
+    // only touched by the writer and the reader respectively
+    uint32_t m_writeSlot = 0;
+    uint32_t m_readSlot = 2;
+
+public:
+    inline T &writeBuffer() {
+        return m_slots[m_writeSlot];
+    }
+
+    // makes the write buffer visible to the reader and starts a new one
+    inline void publish() {
+        uint32_t previous = m_shared.exchange(m_writeSlot | FRESH, std::memory_order_acq_rel);
+        m_writeSlot = previous & SLOT_MASK;
+    }
+
+    // moves the newest published value to the read buffer, returns whether there was one
+    inline bool update() {
+        if (!(m_shared.load(std::memory_order_relaxed) & FRESH)) {
+            return false;
+        }
+        uint32_t previous = m_shared.exchange(m_readSlot, std::memory_order_acq_rel);
+        m_readSlot = previous & SLOT_MASK;
+        return true;
+    }
+
+    inline const T &readBuffer() const {
+        return m_slots[m_readSlot];
+    }
+};
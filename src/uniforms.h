@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+
+// FrameUniforms and ShadowUniforms with their bindings, generated from the
+// shaders' uniform blocks at build time by tools/shader_reflect.cpp
+#include "shader_uniforms.h"
+
+// cascades splitting the view for directional shadows
+constexpr uint32_t SHADOW_CASCADES = 4;
+static_assert(sizeof(ShadowUniforms::cascadeViewProjection) == SHADOW_CASCADES * sizeof(glm::mat4), "the Shadow block has a matrix per cascade");
@@ -20,4 +20,66 @@ namespace utils {
 		return fileContents;
 	}
 
+	bool fileReadBytes(const std::filesystem::path &filePath, std::vector<uint8_t> &bytes) {
+		std::ifstream fileStream(filePath, std::ios::binary | std::ios::ate);
+		if (!fileStream) {
+			return false;
+		}
+		const std::streamsize size = fileStream.tellg();
+		if (size < 0) {
+			return false;
+		}
+		bytes.resize(static_cast<size_t>(size));
+		fileStream.seekg(0);
+		return static_cast<bool>(fileStream.read(reinterpret_cast<char *>(bytes.data()), size));
+	}
+
+	bool fileWritePpm(const std::filesystem::path &filePath, uint32_t width, uint32_t height, const uint32_t *pixels, uint32_t stride) {
+		std::ofstream fileStream(filePath, std::ios::binary);
+		if (!fileStream) {
+			return false;
+		}
+		fileStream << "P6\n" << width << " " << height << "\n255\n";
+
+		// ppm rows run top to bottom
+		std::string row(static_cast<size_t>(width) * 3, '\0');
+		for (uint32_t y = height; y-- > 0;) {
+			const uint32_t *source = pixels + static_cast<size_t>(y) * stride;
+			for (uint32_t x = 0; x < width; ++x) {
+				row[x * 3] = static_cast<char>(source[x] & 0xff);
+				row[x * 3 + 1] = static_cast<char>((source[x] >> 8) & 0xff);
+				row[x * 3 + 2] = static_cast<char>((source[x] >> 16) & 0xff);
+			}
+			fileStream.write(row.data(), static_cast<std::streamsize>(row.size()));
+		}
+		return static_cast<bool>(fileStream);
+	}
+
+	bool fileReadPpm(const std::filesystem::path &filePath, uint32_t &width, uint32_t &height, std::vector<uint32_t> &pixels) {
+		std::ifstream fileStream(filePath, std::ios::binary);
+		std::string magic;
+		uint32_t maxValue = 0;
+		if (!(fileStream >> magic >> width >> height >> maxValue) || magic != "P6" || maxValue != 255) {
+			return false;
+		}
+		// a single whitespace character separates the header from the pixels
+		fileStream.get();
+
+		std::string row(static_cast<size_t>(width) * 3, '\0');
+		pixels.resize(static_cast<size_t>(width) * height);
+		for (uint32_t y = height; y-- > 0;) {
+			if (!fileStream.read(&row[0], static_cast<std::streamsize>(row.size()))) {
+				return false;
+			}
+			uint32_t *target = pixels.data() + static_cast<size_t>(y) * width;
+			for (uint32_t x = 0; x < width; ++x) {
+				target[x] = static_cast<uint32_t>(static_cast<uint8_t>(row[x * 3]))
+				          | static_cast<uint32_t>(static_cast<uint8_t>(row[x * 3 + 1])) << 8
+				          | static_cast<uint32_t>(static_cast<uint8_t>(row[x * 3 + 2])) << 16
+				          | 0xffu << 24;
+			}
+		}
+		return true;
+	}
+
 }
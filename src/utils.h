@@ -1,14 +1,24 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
 #include <string>
+#include <vector>
 
 namespace utils {
 
 	// read contents of file into string
 	std::string fileReadString(const std::filesystem::path &filePath);
 
-	// this prototype might be useful in the future
-	//std::vector<uint8_t> fileReadBytes(const fs::path &filePath);
+	// write rgba8 pixels stored bottom row first to a binary ppm, dropping alpha.
+	// stride is the number of pixels between the starts of two rows
+	bool fileWritePpm(const std::filesystem::path &filePath, uint32_t width, uint32_t height, const uint32_t *pixels, uint32_t stride);
+
+	// read a binary ppm written by fileWritePpm back into rgba8 pixels, bottom
+	// row first with an opaque alpha. returns false if it is not one
+	bool fileReadPpm(const std::filesystem::path &filePath, uint32_t &width, uint32_t &height, std::vector<uint32_t> &pixels);
+
+	// read contents of file as raw bytes. returns false if it cannot be read
+	bool fileReadBytes(const std::filesystem::path &filePath, std::vector<uint8_t> &bytes);
 
 }
@@ -0,0 +1,76 @@
+#include "image_compare.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace {
+
+	float toLinear(float value) {
+		return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	float labCurve(float t) {
+		return t > 0.008856f ? std::cbrt(t) : 7.787f * t + 16.0f / 116.0f;
+	}
+
+	// srgb pixel to CIELAB with a D65 white point
+	glm::vec3 toLab(uint32_t pixel) {
+		const float r = toLinear(static_cast<float>(pixel & 0xff) / 255.0f);
+		const float g = toLinear(static_cast<float>((pixel >> 8) & 0xff) / 255.0f);
+		const float b = toLinear(static_cast<float>((pixel >> 16) & 0xff) / 255.0f);
+		const float x = labCurve((0.4124f * r + 0.3576f * g + 0.1805f * b) / 0.95047f);
+		const float y = labCurve(0.2126f * r + 0.7152f * g + 0.0722f * b);
+		const float z = labCurve((0.0193f * r + 0.1192f * g + 0.9505f * b) / 1.08883f);
+		return glm::vec3{116.0f * y - 16.0f, 500.0f * (x - y), 200.0f * (y - z)};
+	}
+
+	std::vector<glm::vec3> blurredLab(const uint32_t *pixels, uint32_t width, uint32_t height) {
+		std::vector<glm::vec3> lab(static_cast<size_t>(width) * height);
+		for (size_t i = 0; i < lab.size(); ++i) {
+			lab[i] = toLab(pixels[i]);
+		}
+
+		std::vector<glm::vec3> blurred(lab.size());
+		for (uint32_t y = 0; y < height; ++y) {
+			for (uint32_t x = 0; x < width; ++x) {
+				glm::vec3 sum{0.0f};
+				float count = 0.0f;
+				for (uint32_t sy = y > 0 ? y - 1 : 0; sy <= std::min(y + 1, height - 1); ++sy) {
+					for (uint32_t sx = x > 0 ? x - 1 : 0; sx <= std::min(x + 1, width - 1); ++sx) {
+						sum += lab[static_cast<size_t>(sy) * width + sx];
+						count += 1.0f;
+					}
+				}
+				blurred[static_cast<size_t>(y) * width + x] = sum / count;
+			}
+		}
+		return blurred;
+	}
+
+}
+
+ImageDifference compareImages(const uint32_t *expected, const uint32_t *actual, uint32_t width, uint32_t height) {
+	ImageDifference difference;
+	const size_t count = static_cast<size_t>(width) * height;
+	if (count == 0) {
+		return difference;
+	}
+
+	const std::vector<glm::vec3> a = blurredLab(expected, width, height);
+	const std::vector<glm::vec3> b = blurredLab(actual, width, height);
+	size_t noticeable = 0;
+	for (size_t i = 0; i < count; ++i) {
+		const double deltaE = glm::length(a[i] - b[i]);
+		difference.meanDeltaE += deltaE;
+		difference.maxDeltaE = std::max(difference.maxDeltaE, deltaE);
+		if (deltaE > NOTICEABLE_DELTA_E) {
+			++noticeable;
+		}
+	}
+	difference.meanDeltaE /= static_cast<double>(count);
+	difference.noticeableFraction = static_cast<double>(noticeable) / static_cast<double>(count);
+	return difference;
+}
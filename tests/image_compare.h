@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+// colour difference a viewer can just about notice, in CIE76 delta E
+constexpr double NOTICEABLE_DELTA_E = 2.3;
+
+// How far apart two images look
+struct ImageDifference {
+    // pixels that differ noticeably, as a fraction of the image
+    double noticeableFraction = 0.0;
+    double meanDeltaE = 0.0;
+    double maxDeltaE = 0.0;
+};
+
+// Compares two rgba8 images of the same size in CIELAB. Both are blurred over
+// 3x3 pixels first, so lone noisy pixels and edges moved by rounding count far
+// less than changes a viewer would see.
+ImageDifference compareImages(const uint32_t *expected, const uint32_t *actual, uint32_t width, uint32_t height);
@@ -0,0 +1,398 @@
+/*
+ *  Image decoding tests
+ *
+ *  Decodes the tiny png and jpeg files under images/ and checks them against
+ *  the pixels they were written from, feeds the decoders files cut short or
+ *  corrupted, and filters known levels down with both mip filters.
+ *
+ *  image_tests [--images DIR] CASE...
+ *
+ *  The files, each a few hundred bytes:
+ *    filters.png            5x5 rgb8, one row per filter type, see filtersPixel()
+ *    palette.png            3x2, 2 bit palette with tRNS
+ *    gray_alpha16.png       2x2 gray and alpha, 16 bits a sample
+ *    oversized.png          4x4 rgb8 whose data inflates to 1 MiB
+ *    gradient_restarts.jpg  24x16 YCbCr 4:4:4 gradient, a restart marker every 2 MCUs
+ *    quadrants_420.jpg      32x32 YCbCr 4:2:0, four flat quadrants
+ *    gray.jpg               12x10 gray gradient, not a whole number of blocks
+ *  The jpegs are quantized by tables of ones, so they decode to within
+ *  rounding of what they were encoded from.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "image_decoder.h"
+#include "mipmaps.h"
+#include "utils.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+	// how far a decoded jpeg channel may be from what was encoded
+	constexpr int JPEG_TOLERANCE = 3;
+
+	struct Image {
+		uint32_t width = 0;
+		uint32_t height = 0;
+		// rgba8, top row first
+		std::vector<uint8_t> pixels;
+
+		inline const uint8_t *pixel(uint32_t x, uint32_t y) const {
+			return pixels.data() + (static_cast<size_t>(y) * width + x) * 4;
+		}
+	};
+
+	struct TestCase {
+		const char *name;
+		// prints what failed and returns false
+		std::function<bool(const fs::path &)> run;
+	};
+
+	std::vector<uint8_t> readImage(const fs::path &path) {
+		std::vector<uint8_t> bytes;
+		if (!utils::fileReadBytes(path, bytes)) {
+			std::printf("could not read %s\n", path.string().c_str());
+		}
+		return bytes;
+	}
+
+	// every stage of a decoder on this thread, as the loader spreads them over jobs.
+	// throws ImageError
+	Image decode(const std::vector<uint8_t> &bytes) {
+		std::unique_ptr<ImageDecoder> decoder = ImageDecoder::create(bytes.data(), bytes.size());
+		if (decoder == nullptr) {
+			throw ImageError{"not a png or jpeg"};
+		}
+		decoder->parse();
+		for (size_t task = 0; task < decoder->serialTasks(); ++task) {
+			decoder->runSerialTask(task);
+		}
+		Image image;
+		image.width = decoder->width();
+		image.height = decoder->height();
+		image.pixels.resize(static_cast<size_t>(image.width) * image.height * 4);
+		for (uint32_t block = 0; block < decoder->rowBlocks(); ++block) {
+			decoder->convertRows(block, image.pixels.data());
+		}
+		return image;
+	}
+
+	// whether decoding throws ImageError, rather than succeeding or crashing
+	bool fails(const std::vector<uint8_t> &bytes) {
+		try {
+			decode(bytes);
+		} catch (const ImageError &) {
+			return true;
+		}
+		return false;
+	}
+
+	bool checkSize(const Image &image, uint32_t width, uint32_t height) {
+		if (image.width != width || image.height != height) {
+			std::printf("decoded %ux%u, expected %ux%u\n", image.width, image.height, width, height);
+			return false;
+		}
+		return true;
+	}
+
+	bool checkPixel(const Image &image, uint32_t x, uint32_t y, const uint8_t (&expected)[4], int tolerance = 0) {
+		const uint8_t *actual = image.pixel(x, y);
+		for (int channel = 0; channel < 4; ++channel) {
+			if (std::abs(actual[channel] - expected[channel]) > tolerance) {
+				std::printf("pixel %u,%u is %u %u %u %u, expected %u %u %u %u\n", x, y, actual[0], actual[1], actual[2], actual[3],
+				            expected[0], expected[1], expected[2], expected[3]);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// what filters.png was written from
+	void filtersPixel(uint32_t x, uint32_t y, uint8_t (&pixel)[4]) {
+		pixel[0] = static_cast<uint8_t>(x * 53 + y * 31);
+		pixel[1] = static_cast<uint8_t>((x * 17) ^ (y * 91));
+		pixel[2] = static_cast<uint8_t>(x * y * 29 + 7);
+		pixel[3] = 255;
+	}
+
+	// checks every pixel of a decoded jpeg against expected(x, y)
+	bool checkJpeg(const Image &image, const std::function<void(uint32_t, uint32_t, uint8_t (&)[4])> &expected) {
+		for (uint32_t y = 0; y < image.height; ++y) {
+			for (uint32_t x = 0; x < image.width; ++x) {
+				uint8_t pixel[4];
+				expected(x, y, pixel);
+				if (!checkPixel(image, x, y, pixel, JPEG_TOLERANCE)) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	// a mip chain of a width x height level of one rgba8 color repeated
+	MipChain flatChain(uint32_t width, uint32_t height, const uint8_t (&color)[4], MipFilter filter) {
+		std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+		for (size_t i = 0; i < pixels.size(); ++i) {
+			pixels[i] = color[i % 4];
+		}
+		return buildMipChain(width, height, std::move(pixels), filter);
+	}
+
+	const std::vector<TestCase> &testCases() {
+		static const std::vector<TestCase> cases = {
+			// none, sub, up, average and paeth filtered rows
+			{"png_filters", [](const fs::path &images) {
+				const Image image = decode(readImage(images / "filters.png"));
+				if (!checkSize(image, 5, 5)) {
+					return false;
+				}
+				for (uint32_t y = 0; y < 5; ++y) {
+					for (uint32_t x = 0; x < 5; ++x) {
+						uint8_t expected[4];
+						filtersPixel(x, y, expected);
+						if (!checkPixel(image, x, y, expected)) {
+							return false;
+						}
+					}
+				}
+				return true;
+			}},
+			// packed indices and alpha from tRNS, the entry past its end opaque
+			{"png_palette", [](const fs::path &images) {
+				const Image image = decode(readImage(images / "palette.png"));
+				const uint8_t red[4] = {255, 0, 0, 255};
+				const uint8_t green[4] = {0, 255, 0, 128};
+				const uint8_t blue[4] = {0, 0, 255, 0};
+				const uint8_t white[4] = {255, 255, 255, 255};
+				return checkSize(image, 3, 2)
+				    && checkPixel(image, 0, 0, red) && checkPixel(image, 1, 0, green) && checkPixel(image, 2, 0, blue)
+				    && checkPixel(image, 0, 1, white) && checkPixel(image, 1, 1, blue) && checkPixel(image, 2, 1, green);
+			}},
+			// the high byte of each 16 bit sample
+			{"png_gray_alpha16", [](const fs::path &images) {
+				const Image image = decode(readImage(images / "gray_alpha16.png"));
+				const uint8_t topLeft[4] = {0x12, 0x12, 0x12, 0xff};
+				const uint8_t topRight[4] = {0xab, 0xab, 0xab, 0x00};
+				const uint8_t bottomLeft[4] = {0xff, 0xff, 0xff, 0x80};
+				const uint8_t bottomRight[4] = {0x00, 0x00, 0x00, 0x7f};
+				return checkSize(image, 2, 2)
+				    && checkPixel(image, 0, 0, topLeft) && checkPixel(image, 1, 0, topRight)
+				    && checkPixel(image, 0, 1, bottomLeft) && checkPixel(image, 1, 1, bottomRight);
+			}},
+			// cut anywhere, a png is missing chunks or image data
+			{"png_truncated", [](const fs::path &images) {
+				const std::vector<uint8_t> bytes = readImage(images / "filters.png");
+				for (size_t size = 8; size < bytes.size() - 12; ++size) {
+					if (!fails(std::vector<uint8_t>(bytes.begin(), bytes.begin() + size))) {
+						std::printf("decoded filters.png cut to %zu of %zu bytes\n", size, bytes.size());
+						return false;
+					}
+				}
+				return true;
+			}},
+			// a zlib header that does not check out, and deflate data flipped bit by bit
+			{"png_corrupt", [](const fs::path &images) {
+				std::vector<uint8_t> bytes = readImage(images / "filters.png");
+				// IDAT data starts after the signature, IHDR and the IDAT length and type
+				const size_t idat = 8 + 25 + 8;
+				std::vector<uint8_t> header = bytes;
+				header[idat + 1] ^= 1;
+				if (!fails(header)) {
+					std::printf("decoded filters.png with a broken zlib header\n");
+					return false;
+				}
+				// whatever a flipped bit does to the stream, decoding must fail or finish, never crash
+				for (size_t offset = idat + 2; offset < bytes.size() - 16; ++offset) {
+					for (int bit = 0; bit < 8; ++bit) {
+						std::vector<uint8_t> flipped = bytes;
+						flipped[offset] ^= static_cast<uint8_t>(1 << bit);
+						fails(flipped);
+					}
+				}
+				return true;
+			}},
+			// data inflating past the image's size stops at it
+			{"png_oversized", [](const fs::path &images) {
+				if (!fails(readImage(images / "oversized.png"))) {
+					std::printf("decoded oversized.png\n");
+					return false;
+				}
+				return true;
+			}},
+			// a frame header claiming 65535x65535, which would take tens of GB to decode into
+			{"jpeg_oversized", [](const fs::path &images) {
+				std::vector<uint8_t> bytes = readImage(images / "quadrants_420.jpg");
+				for (size_t i = 0; i + 9 < bytes.size(); ++i) {
+					if (bytes[i] == 0xff && bytes[i + 1] == 0xc0) {
+						// length, precision, then height and width
+						std::fill_n(bytes.begin() + i + 5, 4, 0xff);
+						break;
+					}
+				}
+				if (!fails(bytes)) {
+					std::printf("decoded quadrants_420.jpg resized to 65535x65535\n");
+					return false;
+				}
+				return true;
+			}},
+			{"jpeg_restarts", [](const fs::path &images) {
+				const std::vector<uint8_t> bytes = readImage(images / "gradient_restarts.jpg");
+				std::unique_ptr<ImageDecoder> decoder = ImageDecoder::create(bytes.data(), bytes.size());
+				decoder->parse();
+				if (decoder->serialTasks() != 3) {
+					std::printf("split into %zu restart intervals, expected 3\n", decoder->serialTasks());
+					return false;
+				}
+				const Image image = decode(bytes);
+				return checkSize(image, 24, 16) && checkJpeg(image, [](uint32_t x, uint32_t y, uint8_t (&pixel)[4]) {
+					pixel[0] = static_cast<uint8_t>(x * 10);
+					pixel[1] = static_cast<uint8_t>(y * 15);
+					pixel[2] = 128;
+					pixel[3] = 255;
+				});
+			}},
+			{"jpeg_subsampled", [](const fs::path &images) {
+				const Image image = decode(readImage(images / "quadrants_420.jpg"));
+				return checkSize(image, 32, 32) && checkJpeg(image, [](uint32_t x, uint32_t y, uint8_t (&pixel)[4]) {
+					static const uint8_t QUADRANTS[4][4] = {{200, 40, 40, 255}, {40, 200, 40, 255}, {40, 40, 200, 255}, {220, 220, 220, 255}};
+					std::copy_n(QUADRANTS[(y / 16) * 2 + x / 16], 4, pixel);
+				});
+			}},
+			{"jpeg_gray", [](const fs::path &images) {
+				const Image image = decode(readImage(images / "gray.jpg"));
+				return checkSize(image, 12, 10) && checkJpeg(image, [](uint32_t x, uint32_t y, uint8_t (&pixel)[4]) {
+					// the far corner is 256, clamped
+					pixel[0] = pixel[1] = pixel[2] = static_cast<uint8_t>(std::min<uint32_t>(x * 20 + y * 4, 255));
+					pixel[3] = 255;
+				});
+			}},
+			// cut in its headers a jpeg fails. cut in its entropy coded data it
+			// still decodes, the rest reading as zeros as in other decoders
+			{"jpeg_truncated", [](const fs::path &images) {
+				const std::vector<uint8_t> bytes = readImage(images / "quadrants_420.jpg");
+				size_t scan = 0;
+				for (size_t i = 0; i + 1 < bytes.size(); ++i) {
+					if (bytes[i] == 0xff && bytes[i + 1] == 0xda) {
+						scan = i;
+						break;
+					}
+				}
+				for (size_t size = 2; size < bytes.size(); ++size) {
+					const std::vector<uint8_t> cut(bytes.begin(), bytes.begin() + size);
+					if (size <= scan + 2 && !fails(cut)) {
+						std::printf("decoded quadrants_420.jpg cut to %zu bytes, inside its headers\n", size);
+						return false;
+					}
+					if (size > scan + 14) {
+						if (!checkSize(decode(cut), 32, 32)) {
+							return false;
+						}
+					}
+				}
+				return true;
+			}},
+			{"unknown_format", [](const fs::path &) {
+				const uint8_t bytes[] = {'G', 'I', 'F', '8', '9', 'a', 0, 0};
+				if (ImageDecoder::create(bytes, sizeof(bytes)) != nullptr || ImageDecoder::create(bytes, 0) != nullptr) {
+					std::printf("made a decoder for a gif\n");
+					return false;
+				}
+				return true;
+			}},
+			// black and white average to middle gray in linear light, not to 128
+			{"mip_box_gamma", [](const fs::path &) {
+				std::vector<uint8_t> pixels = {0, 0, 0, 255, 255, 255, 255, 0, 255, 255, 255, 255, 0, 0, 0, 0};
+				const MipChain chain = buildMipChain(2, 2, pixels, MipFilter::Box);
+				if (chain.size() != 2 || chain[1].size() != 4) {
+					std::printf("made %zu levels from 2x2, expected 2\n", chain.size());
+					return false;
+				}
+				const uint8_t *texel = chain[1].data();
+				const bool gray = texel[0] >= 187 && texel[0] <= 189 && texel[1] == texel[0] && texel[2] == texel[0];
+				const bool alpha = texel[3] >= 127 && texel[3] <= 128;
+				if (!gray || !alpha) {
+					std::printf("filtered to %u %u %u %u, expected about 188 188 188 128\n", texel[0], texel[1], texel[2], texel[3]);
+					return false;
+				}
+				return true;
+			}},
+			// odd sizes halve rounding down to 1x1, and flat levels stay flat under both filters
+			{"mip_flat", [](const fs::path &) {
+				const uint8_t color[4] = {30, 140, 220, 77};
+				for (MipFilter filter : {MipFilter::Box, MipFilter::Kaiser}) {
+					const MipChain chain = flatChain(13, 6, color, filter);
+					if (chain.size() != 4) {
+						std::printf("made %zu levels from 13x6, expected 4\n", chain.size());
+						return false;
+					}
+					const uint32_t widths[4] = {13, 6, 3, 1};
+					const uint32_t heights[4] = {6, 3, 1, 1};
+					for (size_t level = 0; level < chain.size(); ++level) {
+						if (chain[level].size() != static_cast<size_t>(widths[level]) * heights[level] * 4) {
+							std::printf("level %zu holds %zu bytes, expected %ux%u texels\n", level, chain[level].size(), widths[level], heights[level]);
+							return false;
+						}
+						for (size_t i = 0; i < chain[level].size(); ++i) {
+							if (std::abs(chain[level][i] - color[i % 4]) > 1) {
+								std::printf("level %zu byte %zu is %u, expected %u\n", level, i, chain[level][i], color[i % 4]);
+								return false;
+							}
+						}
+					}
+				}
+				return true;
+			}},
+		};
+		return cases;
+	}
+
+	bool runTest(const TestCase &test, const fs::path &imageDirectory) {
+		bool passed = false;
+		try {
+			passed = test.run(imageDirectory);
+		} catch (const ImageError &e) {
+			std::printf("failed to decode: %s\n", e.what());
+		}
+		std::printf("%s %s\n", passed ? "PASS" : "FAIL", test.name);
+		return passed;
+	}
+
+}
+
+int main(int argc, char **argv) {
+	fs::path imageDirectory = "images";
+	std::vector<std::string> names;
+	for (int i = 1; i < argc; ++i) {
+		const std::string argument = argv[i];
+		if (argument == "--images" && i + 1 < argc) {
+			imageDirectory = argv[++i];
+		} else {
+			names.push_back(argument);
+		}
+	}
+
+	// every case when none are named
+	std::vector<const TestCase *> selected;
+	for (const TestCase &test : testCases()) {
+		if (names.empty() || std::find(names.begin(), names.end(), test.name) != names.end()) {
+			selected.push_back(&test);
+		}
+	}
+	if (selected.size() < std::max<size_t>(names.size(), 1)) {
+		std::printf("Unknown case\n");
+		return EXIT_FAILURE;
+	}
+
+	bool passed = true;
+	for (const TestCase *test : selected) {
+		passed = runTest(*test, imageDirectory) && passed;
+	}
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
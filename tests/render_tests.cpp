@@ -0,0 +1,378 @@
+/*
+ *  Golden image tests
+ *
+ *  Renders fixed scenes without a window, on the software rasterizer and the
+ *  path tracer, and compares them to images checked in under golden/. The same
+ *  run counts each scene's draws, state changes and rays and checks them
+ *  against baselines.txt, so a change that breaks the picture or draws more
+ *  fails on any machine and in any build.
+ *
+ *  render_tests [--update] [--golden DIR] [--baselines FILE] [--perf FILE] SCENE...
+ *
+ *  --update rewrites the golden images and baselines from this run instead.
+ *  --perf also checks frame times against FILE, which holds times measured on
+ *  this machine with this build and so belongs outside the source tree. Times
+ *  it has no baseline for yet are recorded into it, and --update rewrites it.
+ *  RENDER_TESTS_MAX_SLOWDOWN sets how many times slower than its baseline a
+ *  scene may get, 1.5 by default.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include "command_buffer.h"
+#include "image_compare.h"
+#include "jobs.h"
+#include "mesh.h"
+#include "path_tracer.h"
+#include "render_queue.h"
+#include "scene.h"
+#include "shaders.h"
+#include "soft_raster.h"
+#include "stats.h"
+#include "utils.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+	// frames rendered per raster scene, the median is reported
+	constexpr uint32_t RASTER_FRAMES = 15;
+	// times under this are too small to tell apart from noise
+	constexpr double MIN_SLACK_MS = 0.5;
+	constexpr double DEFAULT_MAX_SLOWDOWN = 1.5;
+
+	// the renderer's scene colors
+	const glm::vec4 CLEAR_COLOR{0.2f, 0.3f, 0.3f, 1.0f};
+	const glm::vec3 OBJECT_COLOR{1.0f, 0.5f, 0.31f};
+	const glm::vec3 LIGHT_COLOR{1.0f, 1.0f, 1.0f};
+	constexpr float LAMP_RADIANCE = 40.0f;
+
+	// stand-ins for the two programs, the cpu backends only use them as keys
+	const Shader BASIC_SHADER{1};
+	const Shader LIGHTING_SHADER{2};
+
+	// what the renderer draws at startup: a cube, the lamp and optionally the benchmark grid
+	struct World {
+		Mesh cube = Mesh::createCube(false);
+		Scene scene;
+		Camera camera;
+
+		World(const glm::vec3 &lightPos, uint32_t benchmarkObjects, const glm::vec3 &cameraPosition, float yaw, float pitch)
+			: camera{cameraPosition, glm::vec3{0.0f, 1.0f, 0.0f}, yaw, pitch} {
+			scene.objects.push_back(Object{glm::vec3{0.0f}, glm::vec3{1.0f}, &BASIC_SHADER, &cube});
+			scene.objects.push_back(Object{lightPos, glm::vec3{0.2f}, &LIGHTING_SHADER, &cube});
+			if (benchmarkObjects > 0) {
+				scene.addBenchmarkGrid(benchmarkObjects, &BASIC_SHADER, &cube);
+			}
+		}
+	};
+
+	struct SceneResult {
+		uint32_t width = 0;
+		uint32_t height = 0;
+		// rgba8, bottom row first, tightly packed
+		std::vector<uint32_t> pixels;
+		std::map<std::string, double> metrics;
+	};
+
+	struct TestCase {
+		const char *name;
+		// largest share of pixels allowed to differ noticeably from the golden image
+		double maxNoticeableFraction;
+		std::function<SceneResult(JobSystem &)> render;
+	};
+
+	double median(std::vector<double> values) {
+		std::sort(values.begin(), values.end());
+		return values[values.size() / 2];
+	}
+
+	SceneResult rasterize(JobSystem &jobs, World &world, uint32_t width, uint32_t height) {
+		SoftwareRasterizer rasterizer;
+		rasterizer.resize(width, height);
+		rasterizer.setClearColor(CLEAR_COLOR);
+		rasterizer.setMesh(world.cube.vao(), world.cube.positions(), world.cube.indices());
+		SoftBasicShader basicShader;
+		SoftLightingShader lightingShader;
+		lightingShader.setColors(OBJECT_COLOR, LIGHT_COLOR);
+		rasterizer.setShader(BASIC_SHADER.id(), &basicShader);
+		rasterizer.setShader(LIGHTING_SHADER.id(), &lightingShader);
+
+		world.camera.setPerspective(static_cast<float>(width) / static_cast<float>(height), 0.1f, 100.0f);
+		world.camera.update();
+
+		std::vector<CommandBuffer> buffers;
+		RenderQueue queue;
+		FrameStats stats;
+		std::vector<double> frameMs;
+		for (uint32_t frame = 0; frame < RASTER_FRAMES; ++frame) {
+			stats = FrameStats{};
+			auto start = std::chrono::steady_clock::now();
+			world.scene.record(jobs, world.camera, buffers);
+			queue.build(buffers, true);
+			rasterizer.render(jobs, queue, world.camera.viewProjection(), stats);
+			frameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+
+		SceneResult result;
+		result.width = width;
+		result.height = height;
+		result.pixels.resize(static_cast<size_t>(width) * height);
+		for (uint32_t y = 0; y < height; ++y) {
+			std::copy_n(rasterizer.color() + static_cast<size_t>(y) * rasterizer.stride(), width, result.pixels.begin() + static_cast<size_t>(y) * width);
+		}
+		result.metrics["frameMs"] = median(frameMs);
+		result.metrics["draws"] = stats.draws;
+		result.metrics["stateChanges"] = stats.programChanges + stats.vaoChanges;
+		return result;
+	}
+
+	SceneResult pathTrace(JobSystem &jobs, World &world, uint32_t width, uint32_t height, uint32_t samples) {
+		PathTracer tracer;
+		tracer.setMaterial(&BASIC_SHADER, PathMaterial{OBJECT_COLOR, glm::vec3{0.0f}});
+		tracer.setMaterial(&LIGHTING_SHADER, PathMaterial{glm::vec3{0.0f}, LIGHT_COLOR * LAMP_RADIANCE});
+		tracer.setBackground(glm::vec3{CLEAR_COLOR});
+		tracer.build(world.scene);
+		tracer.resize(width, height);
+		world.camera.setPerspective(static_cast<float>(width) / static_cast<float>(height), 0.1f, 100.0f);
+		tracer.setCamera(world.camera);
+
+		std::vector<double> passMs;
+		for (uint32_t sample = 0; sample < samples; ++sample) {
+			auto start = std::chrono::steady_clock::now();
+			tracer.renderPass(jobs);
+			passMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+
+		SceneResult result;
+		result.width = width;
+		result.height = height;
+		result.pixels.assign(tracer.color(), tracer.color() + static_cast<size_t>(width) * height);
+		result.metrics["frameMs"] = median(passMs);
+		result.metrics["rays"] = static_cast<double>(tracer.rays());
+		return result;
+	}
+
+	const std::vector<TestCase> &testCases() {
+		static const std::vector<TestCase> cases = {
+			// the startup view
+			{"cube", 0.001, [](JobSystem &jobs) {
+				World world{glm::vec3{2.0f, 2.0f, -2.0f}, 0, glm::vec3{0.0f, 0.0f, 3.0f}, YAW, PITCH};
+				return rasterize(jobs, world, 320, 240);
+			}},
+			// three faces meeting at a corner, where cracks between triangles show
+			{"corner", 0.001, [](JobSystem &jobs) {
+				World world{glm::vec3{2.0f, 2.0f, -2.0f}, 0, glm::vec3{2.0f, 1.6f, 2.4f}, -130.0f, -25.0f};
+				return rasterize(jobs, world, 320, 240);
+			}},
+			// a camera grazing the cube, so triangles cross the near plane
+			{"near_clip", 0.001, [](JobSystem &jobs) {
+				World world{glm::vec3{2.0f, 2.0f, -2.0f}, 256, glm::vec3{0.53f, 0.1f, 0.56f}, -160.0f, -10.0f};
+				return rasterize(jobs, world, 320, 240);
+			}},
+			// the benchmark grid, for draw and state change counts
+			{"grid", 0.001, [](JobSystem &jobs) {
+				World world{glm::vec3{2.0f, 2.0f, -2.0f}, 4096, glm::vec3{0.0f, 1.0f, 3.0f}, YAW, -20.0f};
+				return rasterize(jobs, world, 320, 240);
+			}},
+			// lighting reference, deterministic for any number of threads
+			{"path_traced", 0.01, [](JobSystem &jobs) {
+				World world{glm::vec3{1.2f, 1.0f, -2.0f}, 64, glm::vec3{3.0f, 2.0f, -4.0f}, 126.9f, -21.8f};
+				return pathTrace(jobs, world, 160, 120, 16);
+			}},
+		};
+		return cases;
+	}
+
+	using Baselines = std::map<std::string, double>;
+
+	// lines of "scene metric value", # starts a comment
+	Baselines readBaselines(const fs::path &path) {
+		Baselines baselines;
+		std::ifstream file(path);
+		std::string line;
+		while (std::getline(file, line)) {
+			if (line.empty() || line[0] == '#') {
+				continue;
+			}
+			std::istringstream fields(line);
+			std::string scene;
+			std::string metric;
+			double value = 0.0;
+			if (fields >> scene >> metric >> value) {
+				baselines[scene + " " + metric] = value;
+			}
+		}
+		return baselines;
+	}
+
+	bool writeBaselines(const fs::path &path, const Baselines &baselines, const char *source) {
+		std::ofstream file(path);
+		file << "# scene metric baseline, " << source << "\n";
+		for (const auto &[key, value] : baselines) {
+			file << key << " " << value << "\n";
+		}
+		return static_cast<bool>(file);
+	}
+
+	double maxSlowdown() {
+		const char *value = std::getenv("RENDER_TESTS_MAX_SLOWDOWN");
+		return value ? std::atof(value) : DEFAULT_MAX_SLOWDOWN;
+	}
+
+	// times depend on the machine and the build, everything else is counted
+	bool isTiming(const std::string &metric) {
+		return metric == "frameMs";
+	}
+
+	// whether a metric is within its threshold; counts may never grow, times may grow by the allowed slowdown
+	bool checkMetric(const std::string &metric, double value, double baseline) {
+		if (isTiming(metric)) {
+			return value <= std::max(baseline * maxSlowdown(), baseline + MIN_SLACK_MS);
+		}
+		return value <= baseline;
+	}
+
+	// timings is null unless frame times are checked. times missing from it are
+	// added, setting timingsChanged
+	bool runTest(const TestCase &test, JobSystem &jobs, const fs::path &goldenDirectory, Baselines &baselines, Baselines *timings,
+	             bool &timingsChanged, bool update) {
+		const SceneResult result = test.render(jobs);
+		const fs::path goldenPath = goldenDirectory / (std::string{test.name} + ".ppm");
+
+		std::printf("PERF %s", test.name);
+		for (const auto &[metric, value] : result.metrics) {
+			std::printf(" %s=%.3f", metric.c_str(), value);
+		}
+		std::printf("\n");
+
+		if (update) {
+			for (const auto &[metric, value] : result.metrics) {
+				Baselines *expected = isTiming(metric) ? timings : &baselines;
+				if (expected != nullptr) {
+					(*expected)[std::string{test.name} + " " + metric] = value;
+				}
+			}
+			if (!utils::fileWritePpm(goldenPath, result.width, result.height, result.pixels.data(), result.width)) {
+				std::printf("FAIL %s: could not write %s\n", test.name, goldenPath.string().c_str());
+				return false;
+			}
+			std::printf("UPDATED %s\n", test.name);
+			return true;
+		}
+
+		bool passed = true;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<uint32_t> golden;
+		if (!utils::fileReadPpm(goldenPath, width, height, golden)) {
+			std::printf("FAIL %s: no golden image at %s\n", test.name, goldenPath.string().c_str());
+			passed = false;
+		} else if (width != result.width || height != result.height) {
+			std::printf("FAIL %s: golden image is %ux%u, rendered %ux%u\n", test.name, width, height, result.width, result.height);
+			passed = false;
+		} else {
+			const ImageDifference difference = compareImages(golden.data(), result.pixels.data(), width, height);
+			std::printf("IMAGE %s noticeable=%.4f%% mean=%.3f max=%.3f\n", test.name,
+			            difference.noticeableFraction * 100.0, difference.meanDeltaE, difference.maxDeltaE);
+			if (difference.noticeableFraction > test.maxNoticeableFraction) {
+				std::printf("FAIL %s: %.4f%% of pixels differ noticeably, at most %.4f%% allowed\n", test.name,
+				            difference.noticeableFraction * 100.0, test.maxNoticeableFraction * 100.0);
+				passed = false;
+			}
+		}
+
+		for (const auto &[metric, value] : result.metrics) {
+			const std::string key = std::string{test.name} + " " + metric;
+			Baselines *expected = isTiming(metric) ? timings : &baselines;
+			if (expected == nullptr) {
+				continue;
+			}
+			auto baseline = expected->find(key);
+			if (baseline == expected->end() && isTiming(metric)) {
+				(*expected)[key] = value;
+				timingsChanged = true;
+				std::printf("RECORDED %s %s=%.3f as this machine's baseline\n", test.name, metric.c_str(), value);
+			} else if (baseline == expected->end()) {
+				std::printf("FAIL %s: no baseline for %s\n", test.name, metric.c_str());
+				passed = false;
+			} else if (!checkMetric(metric, value, baseline->second)) {
+				std::printf("FAIL %s: %s regressed to %.3f from %.3f\n", test.name, metric.c_str(), value, baseline->second);
+				passed = false;
+			}
+		}
+
+		// keep what was drawn for inspection
+		if (!passed) {
+			utils::fileWritePpm(fs::path{std::string{test.name} + ".actual.ppm"}, result.width, result.height, result.pixels.data(), result.width);
+		}
+		return passed;
+	}
+
+}
+
+int main(int argc, char **argv) {
+	bool update = false;
+	fs::path goldenDirectory = "golden";
+	fs::path baselinesPath = "baselines.txt";
+	fs::path timingsPath;
+	std::vector<std::string> names;
+	for (int i = 1; i < argc; ++i) {
+		const std::string argument = argv[i];
+		if (argument == "--update") {
+			update = true;
+		} else if (argument == "--golden" && i + 1 < argc) {
+			goldenDirectory = argv[++i];
+		} else if (argument == "--baselines" && i + 1 < argc) {
+			baselinesPath = argv[++i];
+		} else if (argument == "--perf" && i + 1 < argc) {
+			timingsPath = argv[++i];
+		} else {
+			names.push_back(argument);
+		}
+	}
+
+	// every scene when none are named
+	std::vector<const TestCase *> selected;
+	for (const TestCase &test : testCases()) {
+		if (names.empty() || std::find(names.begin(), names.end(), test.name) != names.end()) {
+			selected.push_back(&test);
+		}
+	}
+	if (selected.size() < std::max<size_t>(names.size(), 1)) {
+		std::printf("Unknown scene\n");
+		return EXIT_FAILURE;
+	}
+
+	JobSystem jobs;
+	Baselines baselines = readBaselines(baselinesPath);
+	// frame times only when asked for, measured on this machine the first time
+	const bool checkTimings = !timingsPath.empty();
+	Baselines timings = checkTimings ? readBaselines(timingsPath) : Baselines{};
+	bool timingsChanged = update;
+	bool passed = true;
+	for (const TestCase *test : selected) {
+		passed = runTest(*test, jobs, goldenDirectory, baselines, checkTimings ? &timings : nullptr, timingsChanged, update) && passed;
+	}
+	if (update && !writeBaselines(baselinesPath, baselines, "rewritten by render_tests --update")) {
+		std::printf("FAIL could not write %s\n", baselinesPath.string().c_str());
+		passed = false;
+	}
+	if (checkTimings && timingsChanged && !writeBaselines(timingsPath, timings, "measured on this machine by render_tests --perf")) {
+		std::printf("FAIL could not write %s\n", timingsPath.string().c_str());
+		passed = false;
+	}
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
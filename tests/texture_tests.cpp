@@ -0,0 +1,293 @@
+/*
+ *  Texture compression and compiled texture tests
+ *
+ *  Compresses a small gradient to each block format at each quality and
+ *  decodes it back, checking how far it moved, and writes compiled texture
+ *  files and maps them back in, whole, cut short and overwritten.
+ *
+ *  texture_tests CASE...
+ *
+ *  The gradient is 14x10, so the blocks along its right and bottom edges
+ *  repeat texels, and ramps every channel along the diagonal, so the texels
+ *  of a block lie on a line through color space, which is what the formats
+ *  store. Compiled textures are written to the system's temporary directory
+ *  and removed after.
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "block_compression.h"
+#include "image_decoder.h"
+#include "texture_file.h"
+#include "texture_format.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+	constexpr uint32_t WIDTH = 14;
+	constexpr uint32_t HEIGHT = 10;
+
+	constexpr CompressionQuality QUALITIES[] = {CompressionQuality::Fast, CompressionQuality::Normal, CompressionQuality::High};
+	constexpr const char *QUALITY_NAMES[] = {"fast", "normal", "high"};
+
+	struct TestCase {
+		const char *name;
+		// prints what failed and returns false
+		std::function<bool()> run;
+	};
+
+	// how far a format may move a channel of the gradient, and which channels it keeps
+	struct FormatCase {
+		TextureFormat format;
+		int tolerance;
+		int channels;
+	};
+
+	// rgba8 ramp down the diagonal, alpha falling along it
+	std::vector<uint8_t> gradient() {
+		std::vector<uint8_t> pixels(WIDTH * HEIGHT * 4);
+		for (uint32_t y = 0; y < HEIGHT; ++y) {
+			for (uint32_t x = 0; x < WIDTH; ++x) {
+				uint8_t *pixel = &pixels[(y * WIDTH + x) * 4];
+				const uint32_t step = x + y;
+				pixel[0] = static_cast<uint8_t>(20 + step * 10);
+				pixel[1] = static_cast<uint8_t>(40 + step * 8);
+				pixel[2] = static_cast<uint8_t>(230 - step * 9);
+				pixel[3] = static_cast<uint8_t>(255 - step * 11);
+			}
+		}
+		return pixels;
+	}
+
+	std::vector<uint8_t> compress(TextureFormat format, CompressionQuality quality, const std::vector<uint8_t> &pixels) {
+		std::vector<uint8_t> blocks(levelBytes(format, WIDTH, HEIGHT));
+		compressBlocks(format, quality, pixels.data(), WIDTH, HEIGHT, blocks.data(), 0, (HEIGHT + 3) / 4);
+		return blocks;
+	}
+
+	// compresses at each quality and decodes back. fails if a kept channel moves
+	// past the tolerance, or if a higher quality ends up further off in total
+	bool roundTrip(const FormatCase &test) {
+		const std::vector<uint8_t> pixels = gradient();
+		uint64_t lastError = UINT64_MAX;
+		for (size_t quality = 0; quality < std::size(QUALITIES); ++quality) {
+			const std::vector<uint8_t> blocks = compress(test.format, QUALITIES[quality], pixels);
+			std::vector<uint8_t> decoded(pixels.size());
+			decompressBlocks(test.format, blocks.data(), WIDTH, HEIGHT, decoded.data());
+
+			int worst = 0;
+			uint64_t error = 0;
+			for (size_t i = 0; i < pixels.size(); ++i) {
+				const int channel = static_cast<int>(i % 4);
+				if (channel >= test.channels) {
+					continue;
+				}
+				const int difference = std::abs(decoded[i] - pixels[i]);
+				worst = std::max(worst, difference);
+				error += static_cast<uint64_t>(difference * difference);
+			}
+			if (worst > test.tolerance) {
+				std::printf("%s moved a channel by %d, at most %d allowed\n", QUALITY_NAMES[quality], worst, test.tolerance);
+				return false;
+			}
+			if (error > lastError) {
+				std::printf("%s is off by %llu squared, more than the quality below it at %llu\n", QUALITY_NAMES[quality],
+				            static_cast<unsigned long long>(error), static_cast<unsigned long long>(lastError));
+				return false;
+			}
+			lastError = error;
+		}
+		return true;
+	}
+
+	// a file in the temporary directory, removed when it goes out of scope
+	struct TemporaryFile {
+		fs::path path;
+
+		TemporaryFile(const char *name)
+			: path{fs::temp_directory_path() / (std::string{"texture_tests_"} + name + TEXTURE_FILE_EXTENSION)} {}
+
+		~TemporaryFile() {
+			std::error_code error;
+			fs::remove(path, error);
+		}
+	};
+
+	// a BC1 chain of the gradient, compressed level by level
+	MipChain gradientChain() {
+		MipChain levels;
+		const std::vector<uint8_t> pixels = gradient();
+		for (uint32_t level = 0; level < mipLevelCount(WIDTH, HEIGHT); ++level) {
+			const uint32_t width = mipLevelSize(WIDTH, level);
+			const uint32_t height = mipLevelSize(HEIGHT, level);
+			// the texel at the same place in the gradient, which is enough to tell levels apart
+			std::vector<uint8_t> texels(width * height * 4);
+			for (uint32_t y = 0; y < height; ++y) {
+				for (uint32_t x = 0; x < width; ++x) {
+					std::copy_n(&pixels[((y << level) * WIDTH + (x << level)) * 4], 4, &texels[(y * width + x) * 4]);
+				}
+			}
+			std::vector<uint8_t> blocks(levelBytes(TextureFormat::Bc1, width, height));
+			compressBlocks(TextureFormat::Bc1, CompressionQuality::Fast, texels.data(), width, height, blocks.data(), 0, (height + 3) / 4);
+			levels.push_back(std::move(blocks));
+		}
+		return levels;
+	}
+
+	// whether opening path throws ImageError
+	bool failsToOpen(const fs::path &path) {
+		TextureFile file;
+		try {
+			file.open(path);
+		} catch (const ImageError &) {
+			return true;
+		}
+		return false;
+	}
+
+	void writeBytes(const fs::path &path, const std::vector<char> &bytes) {
+		std::ofstream stream{path, std::ios::binary | std::ios::trunc};
+		stream.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+	}
+
+	std::vector<char> readBytes(const fs::path &path) {
+		std::ifstream stream{path, std::ios::binary};
+		return std::vector<char>{std::istreambuf_iterator<char>{stream}, std::istreambuf_iterator<char>{}};
+	}
+
+	const std::vector<TestCase> &testCases() {
+		static const std::vector<TestCase> cases = {
+			// 565 endpoints and 2-bit indices, alpha not kept
+			{"bc1", [] { return roundTrip({TextureFormat::Bc1, 14, 3}); }},
+			// a BC4 alpha block of 3-bit indices beside the BC1 one
+			{"bc3", [] { return roundTrip({TextureFormat::Bc3, 14, 4}); }},
+			// red and green only
+			{"bc5", [] { return roundTrip({TextureFormat::Bc5, 5, 2}); }},
+			// a line through rgba with 4-bit indices, in mode 6
+			{"bc7", [] { return roundTrip({TextureFormat::Bc7, 4, 4}); }},
+			// compressing a level in row ranges, as the compiler does over jobs, writes the same blocks as all at once
+			{"bc_row_ranges", [] {
+				const std::vector<uint8_t> pixels = gradient();
+				for (TextureFormat format : {TextureFormat::Bc1, TextureFormat::Bc3, TextureFormat::Bc5, TextureFormat::Bc7}) {
+					const std::vector<uint8_t> whole = compress(format, CompressionQuality::Normal, pixels);
+					std::vector<uint8_t> split(whole.size());
+					for (uint32_t row = 0; row < (HEIGHT + 3) / 4; ++row) {
+						compressBlocks(format, CompressionQuality::Normal, pixels.data(), WIDTH, HEIGHT, split.data(), row, row + 1);
+					}
+					if (split != whole) {
+						std::printf("%s blocks differ when compressed a row at a time\n", formatName(format));
+						return false;
+					}
+				}
+				return true;
+			}},
+			{"file_round_trip", [] {
+				const TemporaryFile temporary{"round_trip"};
+				const MipChain levels = gradientChain();
+				if (!writeTextureFile(temporary.path, TextureFormat::Bc1, WIDTH, HEIGHT, levels)) {
+					std::printf("could not write %s\n", temporary.path.string().c_str());
+					return false;
+				}
+				TextureFile file;
+				file.open(temporary.path);
+				if (file.format() != TextureFormat::Bc1 || file.width() != WIDTH || file.height() != HEIGHT
+				    || file.levelCount() != levels.size()) {
+					std::printf("read back %s %ux%u with %u levels, expected bc1 %ux%u with %zu\n", formatName(file.format()),
+					            file.width(), file.height(), file.levelCount(), WIDTH, HEIGHT, levels.size());
+					return false;
+				}
+				for (uint32_t level = 0; level < file.levelCount(); ++level) {
+					if (file.levelSize(level) != levels[level].size()
+					    || !std::equal(levels[level].begin(), levels[level].end(), file.level(level))) {
+						std::printf("level %u does not read back as written\n", level);
+						return false;
+					}
+					if (reinterpret_cast<uintptr_t>(file.level(level)) % 16 != 0) {
+						std::printf("level %u is not 16 byte aligned\n", level);
+						return false;
+					}
+				}
+				return true;
+			}},
+			// cut anywhere, the header or index points past the end of the file
+			{"file_truncated", [] {
+				const TemporaryFile whole{"whole"};
+				const TemporaryFile cut{"truncated"};
+				writeTextureFile(whole.path, TextureFormat::Bc1, WIDTH, HEIGHT, gradientChain());
+				const std::vector<char> bytes = readBytes(whole.path);
+				for (size_t size = 0; size < bytes.size(); ++size) {
+					writeBytes(cut.path, std::vector<char>(bytes.begin(), bytes.begin() + size));
+					if (!failsToOpen(cut.path)) {
+						std::printf("opened a compiled texture cut to %zu of %zu bytes\n", size, bytes.size());
+						return false;
+					}
+				}
+				return true;
+			}},
+			// another identifier, an unknown format, and a level count the size does not allow
+			{"file_corrupt", [] {
+				const TemporaryFile whole{"valid"};
+				const TemporaryFile corrupt{"corrupt"};
+				writeTextureFile(whole.path, TextureFormat::Bc1, WIDTH, HEIGHT, gradientChain());
+				const std::vector<char> bytes = readBytes(whole.path);
+				// identifier, then format, width, height and level count
+				const std::pair<size_t, char> edits[] = {{1, 'X'}, {12, 2}, {24, 9}};
+				for (const auto &[offset, value] : edits) {
+					std::vector<char> edited = bytes;
+					edited[offset] = value;
+					writeBytes(corrupt.path, edited);
+					if (!failsToOpen(corrupt.path)) {
+						std::printf("opened a compiled texture with byte %zu set to %d\n", offset, value);
+						return false;
+					}
+				}
+				return !failsToOpen(whole.path);
+			}},
+		};
+		return cases;
+	}
+
+	bool runTest(const TestCase &test) {
+		bool passed = false;
+		try {
+			passed = test.run();
+		} catch (const ImageError &e) {
+			std::printf("failed to open: %s\n", e.what());
+		}
+		std::printf("%s %s\n", passed ? "PASS" : "FAIL", test.name);
+		return passed;
+	}
+
+}
+
+int main(int argc, char **argv) {
+	const std::vector<std::string> names(argv + 1, argv + argc);
+
+	// every case when none are named
+	std::vector<const TestCase *> selected;
+	for (const TestCase &test : testCases()) {
+		if (names.empty() || std::find(names.begin(), names.end(), test.name) != names.end()) {
+			selected.push_back(&test);
+		}
+	}
+	if (selected.size() < std::max<size_t>(names.size(), 1)) {
+		std::printf("Unknown case\n");
+		return EXIT_FAILURE;
+	}
+
+	bool passed = true;
+	for (const TestCase *test : selected) {
+		passed = runTest(*test) && passed;
+	}
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,301 @@
+/*
+ *  Shader reflection
+ *
+ *  Reads the std140 uniform blocks declared in shader sources and writes a
+ *  header with a struct for each, padded to put every member where std140
+ *  does and checked with static_asserts, and the binding point each block is
+ *  given. The renderer fills the structs and uploads each with one copy.
+ *
+ *  A block is named Name in the shaders and NameUniforms in c++, with
+ *  NAME_UNIFORMS_BINDING as its binding. Blocks declared in more than one
+ *  source must agree. Comments on the lines before a block or a member are
+ *  copied to the header.
+ *
+ *  shader_reflect --output <header> <shader>...
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+namespace {
+
+	class ReflectError: public std::runtime_error {
+	public:
+		ReflectError(const std::string &message)
+			: std::runtime_error{message} {}
+	};
+
+	// how std140 lays out a glsl type, and the c++ type with the same layout
+	struct TypeLayout {
+		const char *glsl;
+		const char *cpp;
+		uint32_t size;
+		uint32_t alignment;
+	};
+
+	// matrices are columns of vec4s, so only mat4 matches glm's layout
+	const TypeLayout TYPES[] = {
+		{"float", "float", 4, 4},
+		{"int", "int32_t", 4, 4},
+		{"uint", "uint32_t", 4, 4},
+		{"bool", "uint32_t", 4, 4},
+		{"vec2", "glm::vec2", 8, 8},
+		{"vec3", "glm::vec3", 12, 16},
+		{"vec4", "glm::vec4", 16, 16},
+		{"ivec2", "glm::ivec2", 8, 8},
+		{"ivec3", "glm::ivec3", 12, 16},
+		{"ivec4", "glm::ivec4", 16, 16},
+		{"uvec2", "glm::uvec2", 8, 8},
+		{"uvec3", "glm::uvec3", 12, 16},
+		{"uvec4", "glm::uvec4", 16, 16},
+		{"mat4", "glm::mat4", 64, 16},
+	};
+
+	struct Member {
+		const TypeLayout *type = nullptr;
+		std::string name;
+		// array elements, 0 when not an array
+		uint32_t count = 0;
+		std::vector<std::string> comment;
+	};
+
+	struct Block {
+		std::string name;
+		std::filesystem::path source;
+		std::vector<Member> members;
+		std::vector<std::string> comment;
+	};
+
+	std::string readValue(int argc, char **argv, int &i) {
+		const std::string option = argv[i];
+		if (i + 1 >= argc) {
+			throw ReflectError{option + " expects a value"};
+		}
+		return argv[++i];
+	}
+
+	const TypeLayout &findType(const std::string &name, const std::string &where) {
+		for (const TypeLayout &type : TYPES) {
+			if (name == type.glsl) {
+				return type;
+			}
+		}
+		throw ReflectError{where + ": " + name + " has no c++ type with its std140 layout"};
+	}
+
+	uint32_t alignUp(uint32_t value, uint32_t alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// Name to NAME and FrameData to FRAME_DATA
+	std::string constantCase(const std::string &name) {
+		std::string result;
+		for (size_t i = 0; i < name.size(); ++i) {
+			if (i > 0 && std::isupper(static_cast<unsigned char>(name[i]))) {
+				result += '_';
+			}
+			result += static_cast<char>(std::toupper(static_cast<unsigned char>(name[i])));
+		}
+		return result;
+	}
+
+	std::vector<Block> readBlocks(const std::filesystem::path &path) {
+		std::ifstream file(path);
+		if (!file) {
+			throw ReflectError{"Cannot read " + path.string()};
+		}
+		static const std::regex comment{R"(^\s*(//.*)$)"};
+		static const std::regex blockStart{R"(^\s*layout\s*\(\s*std140\s*\)\s*uniform\s+(\w+)\s*\{\s*$)"};
+		static const std::regex blockEnd{R"(^\s*\}\s*;\s*$)"};
+		static const std::regex member{R"(^\s*(\w+)\s+(\w+)\s*(?:\[\s*(\d+)\s*\])?\s*;\s*$)"};
+
+		std::vector<Block> blocks;
+		std::vector<std::string> comments;
+		Block *block = nullptr;
+		std::string line;
+		int lineNumber = 0;
+		while (std::getline(file, line)) {
+			++lineNumber;
+			const std::string where = path.filename().string() + ":" + std::to_string(lineNumber);
+			std::smatch match;
+			if (std::regex_match(line, match, comment)) {
+				comments.push_back(match[1]);
+				continue;
+			}
+			if (block == nullptr) {
+				if (std::regex_match(line, match, blockStart)) {
+					block = &blocks.emplace_back();
+					block->name = match[1];
+					block->source = path.filename();
+					block->comment = std::move(comments);
+				}
+				comments.clear();
+				continue;
+			}
+
+			if (std::regex_match(line, match, blockEnd)) {
+				if (block->members.empty()) {
+					throw ReflectError{where + ": block " + block->name + " is empty"};
+				}
+				block = nullptr;
+			} else if (std::regex_match(line, match, member)) {
+				Member &added = block->members.emplace_back();
+				added.type = &findType(match[1], where);
+				added.name = match[2];
+				added.count = match[3].matched ? static_cast<uint32_t>(std::stoul(match[3])) : 0;
+				added.comment = std::move(comments);
+				// std140 rounds array elements up to a vec4
+				if (added.count > 0 && added.type->size % 16 != 0) {
+					throw ReflectError{where + ": arrays of " + added.type->glsl + " are padded to vec4s in std140, declare them as vec4"};
+				}
+			} else if (line.find_first_not_of(" \t\r") != std::string::npos) {
+				throw ReflectError{where + ": cannot reflect \"" + line + "\" in block " + block->name};
+			}
+			comments.clear();
+		}
+		if (block != nullptr) {
+			throw ReflectError{path.filename().string() + ": block " + block->name + " is not closed"};
+		}
+		return blocks;
+	}
+
+	bool sameMembers(const Block &a, const Block &b) {
+		return std::equal(a.members.begin(), a.members.end(), b.members.begin(), b.members.end(), [](const Member &x, const Member &y) {
+			return x.type == y.type && x.name == y.name && x.count == y.count;
+		});
+	}
+
+	void writeComment(std::ostream &out, const std::vector<std::string> &comment, const char *indent) {
+		for (const std::string &line : comment) {
+			out << indent << line << '\n';
+		}
+	}
+
+	void writeBlock(std::ostream &out, const Block &block) {
+		const std::string type = block.name + "Uniforms";
+		out << "// Uniform block \"" << block.name << "\" of " << block.source.generic_string() << ", std140 layout\n";
+		writeComment(out, block.comment, "");
+		out << "struct " << type << " {\n";
+
+		std::vector<std::pair<std::string, uint32_t>> offsets;
+		uint32_t offset = 0;
+		uint32_t padding = 0;
+		for (const Member &member : block.members) {
+			const uint32_t aligned = alignUp(offset, member.type->alignment);
+			if (aligned > offset) {
+				out << "    float padding" << padding++ << "[" << (aligned - offset) / 4 << "];\n";
+			}
+			writeComment(out, member.comment, "    ");
+			out << "    " << member.type->cpp << ' ' << member.name;
+			if (member.count > 0) {
+				out << '[' << member.count << ']';
+			}
+			out << ";\n";
+			offsets.emplace_back(member.name, aligned);
+			offset = aligned + member.type->size * std::max(member.count, 1u);
+		}
+		// whole vec4s, so blocks can follow one another in a buffer
+		const uint32_t size = alignUp(offset, 16);
+		if (size > offset) {
+			out << "    float padding" << padding++ << "[" << (size - offset) / 4 << "];\n";
+		}
+		out << "};\n\n";
+
+		for (const auto &[name, memberOffset] : offsets) {
+			out << "static_assert(offsetof(" << type << ", " << name << ") == " << memberOffset << ", \"" << type << "::" << name
+			    << " is not where std140 puts it\");\n";
+		}
+		out << "static_assert(sizeof(" << type << ") == " << size << ", \"" << type << " is not the size of its std140 block\");\n\n";
+	}
+
+}
+
+int main(int argc, char **argv) {
+	std::filesystem::path output;
+	std::vector<std::filesystem::path> inputs;
+	try {
+		for (int i = 1; i < argc; ++i) {
+			const std::string option = argv[i];
+			if (option == "--output") {
+				output = readValue(argc, argv, i);
+			} else if (!option.empty() && option[0] == '-') {
+				throw ReflectError{"Unknown option " + option};
+			} else {
+				inputs.emplace_back(option);
+			}
+		}
+		if (output.empty() || inputs.empty()) {
+			throw ReflectError{"Expected an output header and shader sources"};
+		}
+	} catch (const ReflectError &e) {
+		spdlog::error("{}", e.what());
+		spdlog::info("usage: shader_reflect --output <header> <shader>...");
+		return 1;
+	}
+
+	// by name, so a block keeps its binding wherever it is declared
+	std::map<std::string, Block> blocks;
+	try {
+		for (const std::filesystem::path &input : inputs) {
+			for (Block &block : readBlocks(input)) {
+				auto found = blocks.find(block.name);
+				if (found == blocks.end()) {
+					blocks.emplace(block.name, std::move(block));
+				} else if (!sameMembers(found->second, block)) {
+					throw ReflectError{"Block " + block.name + " differs between " + found->second.source.string() + " and " + block.source.string()};
+				}
+			}
+		}
+	} catch (const ReflectError &e) {
+		spdlog::error("{}", e.what());
+		return 1;
+	}
+
+	std::ostringstream out;
+	out << "// generated by shader_reflect from the shader sources, do not edit\n";
+	out << "#pragma once\n\n#include <cstddef>\n#include <cstdint>\n\n#include <glm/glm.hpp>\n\n";
+	uint32_t binding = 0;
+	for (const auto &[name, block] : blocks) {
+		writeBlock(out, block);
+		out << "// uniform buffer binding point of the " << name << " block\n";
+		out << "constexpr uint32_t " << constantCase(name) << "_UNIFORMS_BINDING = " << binding++ << ";\n\n";
+	}
+	out << "// every block above, for pointing programs at their bindings\n";
+	out << "struct UniformBlockBinding {\n    const char *name;\n    uint32_t binding;\n};\n\n";
+	out << "constexpr UniformBlockBinding UNIFORM_BLOCK_BINDINGS[] = {\n";
+	for (const auto &[name, block] : blocks) {
+		out << "    {\"" << name << "\", " << constantCase(name) << "_UNIFORMS_BINDING},\n";
+	}
+	out << "};\n";
+
+	// rewritten only when it changes, so what includes it is not rebuilt for nothing
+	std::string previous;
+	{
+		std::ifstream existing(output);
+		previous.assign(std::istreambuf_iterator<char>{existing}, std::istreambuf_iterator<char>{});
+	}
+	if (previous != out.str()) {
+		std::error_code error;
+		if (output.has_parent_path()) {
+			std::filesystem::create_directories(output.parent_path(), error);
+		}
+		std::ofstream file(output);
+		file << out.str();
+		if (!file) {
+			spdlog::error("Failed to write {}", output.string());
+			return 1;
+		}
+	}
+	spdlog::info("Reflected {} uniform blocks into {}", blocks.size(), output.string());
+	return 0;
+}
@@ -0,0 +1,283 @@
+/*
+ *  Texture compiler
+ *
+ *  Block compresses png and jpeg textures ahead of time, writing each one
+ *  with its full mip chain to a compiled texture the renderer maps and
+ *  uploads as it is, instead of decoding and filtering mips at startup.
+ *
+ *  texture_compiler [options] <image or directory>...
+ *      --output DIR                where compiled textures are written, "." by default
+ *      --format bc1|bc3|bc5|bc7    bc7 by default
+ *      --quality fast|normal|high  normal by default
+ *      --mip-filter box|kaiser     box by default
+ *      --threads N                 job system workers, 0 picks one per spare hardware thread
+ *      --compare                   time loading the sources against loading the compiled textures
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+#include "block_compression.h"
+#include "image_decoder.h"
+#include "image_loader.h"
+#include "jobs.h"
+#include "mipmaps.h"
+#include "texture_file.h"
+
+namespace {
+
+	using Clock = std::chrono::steady_clock;
+
+	// block rows of a level one job compresses
+	constexpr uint32_t BLOCK_ROWS_PER_JOB = 8;
+
+	struct Settings {
+		std::filesystem::path outputDirectory = ".";
+		TextureFormat format = TextureFormat::Bc7;
+		CompressionQuality quality = CompressionQuality::Normal;
+		MipFilter mipFilter = MipFilter::Box;
+		uint32_t workerThreads = 0;
+		bool compare = false;
+		std::vector<std::filesystem::path> inputs;
+	};
+
+	class UsageError: public std::runtime_error {
+	public:
+		UsageError(const std::string &message)
+			: std::runtime_error{message} {}
+	};
+
+	std::string readValue(int argc, char **argv, int &i) {
+		if (i + 1 >= argc) {
+			throw UsageError{std::string{argv[i]} + " expects a value"};
+		}
+		return argv[++i];
+	}
+
+	Settings parseSettings(int argc, char **argv) {
+		Settings settings;
+		for (int i = 1; i < argc; ++i) {
+			const std::string option = argv[i];
+			if (option == "--output") {
+				settings.outputDirectory = readValue(argc, argv, i);
+			} else if (option == "--format") {
+				const std::string format = readValue(argc, argv, i);
+				if (format == "bc1") {
+					settings.format = TextureFormat::Bc1;
+				} else if (format == "bc3") {
+					settings.format = TextureFormat::Bc3;
+				} else if (format == "bc5") {
+					settings.format = TextureFormat::Bc5;
+				} else if (format == "bc7") {
+					settings.format = TextureFormat::Bc7;
+				} else {
+					throw UsageError{option + " expects bc1, bc3, bc5 or bc7, got " + format};
+				}
+			} else if (option == "--quality") {
+				const std::string quality = readValue(argc, argv, i);
+				if (quality == "fast") {
+					settings.quality = CompressionQuality::Fast;
+				} else if (quality == "normal") {
+					settings.quality = CompressionQuality::Normal;
+				} else if (quality == "high") {
+					settings.quality = CompressionQuality::High;
+				} else {
+					throw UsageError{option + " expects fast, normal or high, got " + quality};
+				}
+			} else if (option == "--mip-filter") {
+				const std::string filter = readValue(argc, argv, i);
+				if (filter == "box") {
+					settings.mipFilter = MipFilter::Box;
+				} else if (filter == "kaiser") {
+					settings.mipFilter = MipFilter::Kaiser;
+				} else {
+					throw UsageError{option + " expects box or kaiser, got " + filter};
+				}
+			} else if (option == "--threads") {
+				const std::string value = readValue(argc, argv, i);
+				char *end = nullptr;
+				const unsigned long threads = std::strtoul(value.c_str(), &end, 10);
+				if (value.empty() || *end != '\0') {
+					throw UsageError{option + " expects a number, got " + value};
+				}
+				settings.workerThreads = static_cast<uint32_t>(threads);
+			} else if (option == "--compare") {
+				settings.compare = true;
+			} else if (option.rfind("--", 0) == 0) {
+				throw UsageError{"unknown option " + option};
+			} else {
+				settings.inputs.emplace_back(option);
+			}
+		}
+		if (settings.inputs.empty()) {
+			throw UsageError{"no images given"};
+		}
+		return settings;
+	}
+
+	double millisecondsSince(Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	// peak signal to noise ratio of the channels format keeps, over the largest level
+	double measurePsnr(TextureFormat format, const LoadedImage &image, const std::vector<uint8_t> &blocks) {
+		std::vector<uint8_t> decoded(image.chain.front().size());
+		decompressBlocks(format, blocks.data(), image.width, image.height, decoded.data());
+		const uint32_t channels = format == TextureFormat::Bc1 ? 3 : format == TextureFormat::Bc5 ? 2 : 4;
+		double squared = 0.0;
+		for (size_t texel = 0; texel < decoded.size(); texel += 4) {
+			for (uint32_t c = 0; c < channels; ++c) {
+				const double difference = static_cast<double>(decoded[texel + c]) - static_cast<double>(image.chain.front()[texel + c]);
+				squared += difference * difference;
+			}
+		}
+		const double mean = squared / (static_cast<double>(decoded.size() / 4) * channels);
+		return mean > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mean) : INFINITY;
+	}
+
+	// maps every compiled texture and copies its levels out, as uploading them all would
+	double loadCompiled(const std::vector<std::filesystem::path> &paths, size_t &bytes) {
+		const Clock::time_point start = Clock::now();
+		std::vector<uint8_t> staging;
+		bytes = 0;
+		for (const std::filesystem::path &path : paths) {
+			TextureFile file;
+			file.open(path);
+			for (uint32_t level = 0; level < file.levelCount(); ++level) {
+				const size_t size = file.levelSize(level);
+				staging.resize(std::max(staging.size(), size));
+				std::memcpy(staging.data(), file.level(level), size);
+				bytes += size;
+			}
+		}
+		return millisecondsSince(start);
+	}
+
+}
+
+int main(int argc, char **argv) {
+	Settings settings;
+	try {
+		settings = parseSettings(argc, argv);
+	} catch (const UsageError &e) {
+		spdlog::error("{}", e.what());
+		spdlog::info("usage: texture_compiler [--output DIR] [--format bc1|bc3|bc5|bc7] [--quality fast|normal|high] "
+		             "[--mip-filter box|kaiser] [--threads N] [--compare] <image or directory>...");
+		return 1;
+	}
+
+	std::vector<std::filesystem::path> paths;
+	for (const std::filesystem::path &input : settings.inputs) {
+		if (std::filesystem::is_directory(input)) {
+			const std::vector<std::filesystem::path> listed = listImages(input);
+			paths.insert(paths.end(), listed.begin(), listed.end());
+		} else {
+			paths.push_back(input);
+		}
+	}
+
+	JobSystem jobs{settings.workerThreads};
+	ImageLoadStats loadStats;
+	const std::vector<LoadedImage> images = loadImages(jobs, paths, settings.mipFilter, loadStats);
+	spdlog::info("Loaded {} of {} images on {} threads in {:.1f} ms: decoding {:.1f} ms ({:.0f} MB/s), mips {:.1f} ms",
+	             images.size(), loadStats.files, jobs.threadCount(), loadStats.totalMs, loadStats.decodeMs,
+	             loadStats.decodeMegabytesPerSecond(), loadStats.mipMs);
+	if (images.empty()) {
+		spdlog::error("No images to compile");
+		return 1;
+	}
+
+	// every level of every image is split into runs of block rows, all compressed at once
+	struct Task {
+		uint32_t image;
+		uint32_t level;
+		uint32_t firstRow;
+	};
+	std::vector<MipChain> compressed(images.size());
+	std::vector<Task> tasks;
+	size_t texels = 0;
+	size_t sourceBytes = 0;
+	size_t compressedBytes = 0;
+	for (uint32_t i = 0; i < images.size(); ++i) {
+		const LoadedImage &image = images[i];
+		for (uint32_t level = 0; level < image.chain.size(); ++level) {
+			const uint32_t width = mipLevelSize(image.width, level);
+			const uint32_t height = mipLevelSize(image.height, level);
+			compressed[i].emplace_back(levelBytes(settings.format, width, height));
+			for (uint32_t row = 0; row < (height + 3) / 4; row += BLOCK_ROWS_PER_JOB) {
+				tasks.push_back(Task{i, level, row});
+			}
+			texels += static_cast<size_t>(width) * height;
+			sourceBytes += image.chain[level].size();
+			compressedBytes += compressed[i].back().size();
+		}
+	}
+	const Clock::time_point encodeStart = Clock::now();
+	jobs.parallelFor(tasks.size(), 1, [&](size_t begin, size_t end, uint32_t) {
+		for (size_t t = begin; t < end; ++t) {
+			const Task &task = tasks[t];
+			const LoadedImage &image = images[task.image];
+			const uint32_t width = mipLevelSize(image.width, task.level);
+			const uint32_t height = mipLevelSize(image.height, task.level);
+			compressBlocks(settings.format, settings.quality, image.chain[task.level].data(), width, height, compressed[task.image][task.level].data(),
+			               task.firstRow, std::min(task.firstRow + BLOCK_ROWS_PER_JOB, (height + 3) / 4));
+		}
+	});
+	const double encodeMs = millisecondsSince(encodeStart);
+	spdlog::info("Compressed {:.1f} Mtexels to {} in {:.1f} ms: {:.1f} Mtexels/s, {:.1f} MB/s of rgba8, {:.1f} MiB down to {:.1f} MiB",
+	             static_cast<double>(texels) / 1e6, formatName(settings.format), encodeMs, static_cast<double>(texels) / (encodeMs * 1000.0),
+	             static_cast<double>(sourceBytes) / (encodeMs * 1000.0), static_cast<double>(sourceBytes) / (1 << 20),
+	             static_cast<double>(compressedBytes) / (1 << 20));
+
+	std::vector<double> psnr(images.size());
+	jobs.parallelFor(images.size(), 1, [&](size_t begin, size_t end, uint32_t) {
+		for (size_t i = begin; i < end; ++i) {
+			psnr[i] = measurePsnr(settings.format, images[i], compressed[i].front());
+		}
+	});
+
+	std::error_code error;
+	std::filesystem::create_directories(settings.outputDirectory, error);
+	std::vector<std::filesystem::path> outputs;
+	double psnrTotal = 0.0;
+	for (size_t i = 0; i < images.size(); ++i) {
+		const std::filesystem::path output = settings.outputDirectory / images[i].path.stem().concat(TEXTURE_FILE_EXTENSION);
+		if (!writeTextureFile(output, settings.format, images[i].width, images[i].height, compressed[i])) {
+			spdlog::error("Failed to write {}", output.string());
+			return 1;
+		}
+		spdlog::info("{}: {}x{}, {:.2f} dB", output.string(), images[i].width, images[i].height, psnr[i]);
+		outputs.push_back(output);
+		psnrTotal += std::isinf(psnr[i]) ? 99.0 : psnr[i];
+	}
+	spdlog::info("Wrote {} compiled textures, {:.2f} dB on average", outputs.size(), psnrTotal / static_cast<double>(outputs.size()));
+
+	if (settings.compare) {
+		// both from the page cache: the sources were just read, the outputs just written
+		ImageLoadStats decodeStats;
+		loadImages(jobs, paths, settings.mipFilter, decodeStats);
+		size_t mappedBytes = 0;
+		double mappedMs = 0.0;
+		try {
+			mappedMs = loadCompiled(outputs, mappedBytes);
+		} catch (const ImageError &e) {
+			spdlog::error("Failed to map a compiled texture: {}", e.what());
+			return 1;
+		}
+		spdlog::info("Loading the sources takes {:.1f} ms on {} threads (decoding {:.1f} ms, mips {:.1f} ms), "
+		             "mapping and copying out the {:.1f} MiB of compiled textures {:.1f} ms on one, {:.1f}x faster",
+		             decodeStats.totalMs, jobs.threadCount(), decodeStats.decodeMs, decodeStats.mipMs,
+		             static_cast<double>(mappedBytes) / (1 << 20), mappedMs, mappedMs > 0.0 ? decodeStats.totalMs / mappedMs : 0.0);
+	}
+	return 0;
+}